@@ -12,6 +12,7 @@
 #define __ALL_DRIVER_POTENTIAL_PAIR_GPU_CUH__
 
 #include "hoomd/md/PotentialPairGPU.cuh"
+#include "EvaluatorPairPolydisperseParams.h"
 //The above line might be potentially problematic
 
 //! Compute lj pair forces on the GPU with PairEvaluatorLJPlugin
@@ -23,17 +24,17 @@ cudaError_t gpu_compute_forceshiftedljplugintemp_forces(const pair_args_t& pair_
 
 //! Compute ludovic potential pair forces on the GPU with PairEvaluatorLudovic
 cudaError_t gpu_compute_polydispersetemp_forces(const pair_args_t& pair_args,
-                                      const Scalar3 *d_params);
+                                      const polydisperse_params *d_params);
 //! Compute ludovic potential pair forces on the GPU with PairEvaluatorLudovic
 cudaError_t gpu_compute_polydisperse_ljtemp_forces(const pair_args_t& pair_args,
-                                      const Scalar3 *d_params);
+                                      const polydisperse_params *d_params);
 cudaError_t gpu_compute_polydisperse_18temp_forces(const pair_args_t& pair_args,
-                                      const Scalar3 *d_params);
+                                      const polydisperse_params *d_params);
 
 cudaError_t gpu_compute_polydisperse_10temp_forces(const pair_args_t& pair_args,
-                                      const Scalar3 *d_params);
+                                      const polydisperse_params *d_params);
 
 cudaError_t gpu_compute_polydisperse_LJ106temp_forces(const pair_args_t& pair_args,
-                                      const Scalar3 *d_params);
+                                      const polydisperse_params *d_params);
 
 #endif
@@ -10,11 +10,9 @@
 #include "hoomd/md/PotentialPair.h"
 #include "EvaluatorPairLJPlugin.h"
 #include "EvaluatorPairForceShiftedLJPlugin.h"
-#include "EvaluatorPairPolydisperse.h"
-#include "EvaluatorPairPolydisperseLJ.h"
-#include "EvaluatorPairPolydisperse18.h"
-#include "EvaluatorPairPolydisperse10.h"
-#include "EvaluatorPairPolydisperseLJ106.h"
+#include "EvaluatorPairPolydisperseMNQ.h"
+#include "PotentialPairPolymd.h"
+#include "UpdaterSwapMC.h"
 
 #ifdef ENABLE_CUDA
 #include "hoomd/md/PotentialPairGPU.h"
@@ -38,6 +36,20 @@ typedef PotentialPair<EvaluatorPairPolydisperse18> PotentialPairPolydisperse18;
 typedef PotentialPair<EvaluatorPairPolydisperse10> PotentialPairPolydisperse10;
 typedef PotentialPair<EvaluatorPairPolydisperseLJ106> PotentialPairPolydisperseLJ106;
 
+//! Multithreaded pair potential force computes for the polydisperse forces on the CPU
+typedef PotentialPairPolymd<EvaluatorPairPolydisperse> PotentialPairPolymdPolydisperse;
+typedef PotentialPairPolymd<EvaluatorPairPolydisperseLJ> PotentialPairPolymdPolydisperseLJ;
+typedef PotentialPairPolymd<EvaluatorPairPolydisperse18> PotentialPairPolymdPolydisperse18;
+typedef PotentialPairPolymd<EvaluatorPairPolydisperse10> PotentialPairPolymdPolydisperse10;
+typedef PotentialPairPolymd<EvaluatorPairPolydisperseLJ106> PotentialPairPolymdPolydisperseLJ106;
+
+//! Diameter swap Monte Carlo updaters for the polydisperse forces on the CPU
+typedef UpdaterSwapMC<EvaluatorPairPolydisperse> UpdaterSwapMCPolydisperse;
+typedef UpdaterSwapMC<EvaluatorPairPolydisperseLJ> UpdaterSwapMCPolydisperseLJ;
+typedef UpdaterSwapMC<EvaluatorPairPolydisperse18> UpdaterSwapMCPolydisperse18;
+typedef UpdaterSwapMC<EvaluatorPairPolydisperse10> UpdaterSwapMCPolydisperse10;
+typedef UpdaterSwapMC<EvaluatorPairPolydisperseLJ106> UpdaterSwapMCPolydisperseLJ106;
+
 #ifdef ENABLE_CUDA
 //! Pair potential force compute for lj forces on the GPU
 typedef PotentialPairGPU< EvaluatorPairLJPlugin, gpu_compute_ljplugintemp_forces > PotentialPairLJPluginGPU;
@@ -171,6 +171,40 @@ class EvaluatorPairForceShiftedLJPlugin
                 return false;
             }
 
+        //! Evaluate the energy only
+        /*! \param pair_eng Output parameter to write the computed pair energy
+            \param energy_shift If true, the potential must be shifted so that V(r) is continuous at the cutoff
+
+            Same energy as evalForceAndEnergy(), without the force.
+            \return True if it is evaluated or false if it is not because we are beyond the cutoff
+        */
+        DEVICE bool evalEnergy(Scalar& pair_eng, bool energy_shift)
+            {
+            Scalar sigma = 0.5*(d_i+d_j);
+            Scalar actualcutsq = rcutsq*sigma*sigma;
+            if (rsq < actualcutsq && lj1 != 0)
+                {
+                Scalar r2inv = sigma*sigma*Scalar(1.0)/rsq;
+                Scalar r6inv = r2inv * r2inv * r2inv;
+                pair_eng = r6inv * (lj1*r6inv - lj2);
+
+                Scalar rcut2inv = Scalar(1.0)/rcutsq;
+                Scalar rcut6inv = rcut2inv * rcut2inv * rcut2inv;
+
+                if (energy_shift)
+                    {
+                    pair_eng -= rcut6inv * (lj1*rcut6inv - lj2);
+                    }
+
+                Scalar rcut_r_inv = fast::rsqrt(rsq*actualcutsq);
+                Scalar force_rcut_at_rcut = rcut6inv * (Scalar(12.0)*lj1*rcut6inv - Scalar(6.0)*lj2);
+                pair_eng += (rsq*rcut_r_inv-Scalar(1.0))*force_rcut_at_rcut;
+                return true;
+                }
+            else
+                return false;
+            }
+
         #ifndef NVCC
         //! Get the name of this potential
         /*! \returns The potential name. Must be short and all lowercase, as this is the name energies will be logged as
@@ -0,0 +1,614 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __PAIR_EVALUATOR_POLYDISPERSE_MNQ_H__
+#define __PAIR_EVALUATOR_POLYDISPERSE_MNQ_H__
+
+#ifndef NVCC
+#include <cmath>
+#include <limits>
+#include <string>
+#endif
+
+#include "hoomd/HOOMDMath.h"
+#include "EvaluatorPairPolydisperseParams.h"
+
+/*! \file EvaluatorPairPolydisperseMNQ.h
+    \brief Defines the pair evaluator template for the (m, n, q) family of polydisperse potentials
+*/
+
+// need to declare these class methods with __device__ qualifiers when building in nvcc
+// DEVICE is __host__ __device__ when included in nvcc and blank when included into the host compiler
+#ifdef NVCC
+#define DEVICE __device__
+#else
+#define DEVICE
+#endif
+
+// the batch kernels must be inlined into the instruction set specific wrappers of PolydisperseBatch.cc
+#if defined(__GNUC__) && !defined(NVCC)
+#define POLYDISPERSE_FORCEINLINE inline __attribute__((always_inline))
+#else
+#define POLYDISPERSE_FORCEINLINE inline
+#endif
+
+//! Compile time helpers for the polydisperse evaluators
+namespace polydisperse
+{
+//! Integer power x^p by repeated squaring, unrolled at compile time
+template<unsigned int p>
+struct int_pow
+    {
+    template<class Real>
+    DEVICE static inline Real eval(Real x)
+        {
+        return (p & 1u) ? x*int_pow<p/2>::eval(x*x) : int_pow<p/2>::eval(x*x);
+        }
+    };
+
+//! Terminates the recursion of int_pow
+template<>
+struct int_pow<0>
+    {
+    template<class Real>
+    DEVICE static inline Real eval(Real)
+        {
+        return Real(1.0);
+        }
+    };
+
+//! Terminates the recursion of int_pow
+template<>
+struct int_pow<1>
+    {
+    template<class Real>
+    DEVICE static inline Real eval(Real x)
+        {
+        return x;
+        }
+    };
+
+//! (sigma/r)^m from (sigma/r)^2, with a single square root only for odd m
+template<unsigned int m, bool odd = (m & 1u)>
+struct inv_pow
+    {
+    template<class Real>
+    DEVICE static inline Real eval(Real r2inv)
+        {
+        return int_pow<m/2>::eval(r2inv);
+        }
+    };
+
+//! (sigma/r)^m for odd m
+template<unsigned int m>
+struct inv_pow<m, true>
+    {
+    template<class Real>
+    DEVICE static inline Real eval(Real r2inv)
+        {
+        return int_pow<m/2>::eval(r2inv)*sqrt(r2inv);
+        }
+    };
+
+//! Horner evaluation of c[k] + c[k+1] x + ... + c[q] x^(q-k), unrolled at compile time
+template<unsigned int k, unsigned int q>
+struct horner
+    {
+    template<class Real>
+    DEVICE static inline Real eval(const Real *c, Real x)
+        {
+        return c[k] + x*horner<k+1, q>::eval(c, x);
+        }
+    };
+
+//! Terminates the recursion of horner
+template<unsigned int q>
+struct horner<q, q>
+    {
+    template<class Real>
+    DEVICE static inline Real eval(const Real *c, Real)
+        {
+        return c[q];
+        }
+    };
+
+//! Horner evaluation of the x derivative of the smoothing polynomial, times two, starting at term k
+/*! Evaluates 2k c[k] + 2(k+1) c[k+1] x + ... + 2q c[q] x^(q-k), which is -sigma^2/r dV/dr of the polynomial part.
+*/
+template<unsigned int k, unsigned int q>
+struct dhorner
+    {
+    template<class Real>
+    DEVICE static inline Real eval(const Real *c, Real x)
+        {
+        return Real(2*k)*c[k] + x*dhorner<k+1, q>::eval(c, x);
+        }
+    };
+
+//! Terminates the recursion of dhorner
+template<unsigned int q>
+struct dhorner<q, q>
+    {
+    template<class Real>
+    DEVICE static inline Real eval(const Real *c, Real)
+        {
+        return Real(2*q)*c[q];
+        }
+    };
+
+//! (p)(p+1)...(p+j-1)/j!, the generalized binomial coefficient C(p+j-1, j)
+constexpr double rising_binomial(double p, unsigned int j)
+    {
+    return (j == 0) ? 1.0 : rising_binomial(p, j-1)*(p + double(j) - 1.0)/double(j);
+    }
+
+//! Binomial coefficient C(j, k)
+constexpr double binomial(unsigned int j, unsigned int k)
+    {
+    return (k == 0) ? 1.0 : binomial(j, k-1)*double(j - k + 1)/double(k);
+    }
+
+//! Sum over j = k..q of C(p+j-1, j) C(j, k)
+constexpr double smoothing_sum(double p, unsigned int q, unsigned int k, unsigned int j)
+    {
+    return (j > q) ? 0.0 : rising_binomial(p, j)*binomial(j, k) + smoothing_sum(p, q, k, j+1);
+    }
+
+//! Coefficient of (r/sigma)^(2k) in the smoothing polynomial of (sigma/r)^m, for a unit cutoff
+/*! The polynomial sum_k a_k x^k in x = (r/sigma)^2 cancels x^(-m/2) and its first q derivatives at x = 1. It is
+    minus the degree q Taylor expansion of x^(-m/2) around 1, which gives
+    a_k = (-1)^(k+1) sum_{j=k}^{q} C(m/2+j-1, j) C(j, k). For a cutoff scaledr_cut the coefficients become
+    a_k scaledr_cut^(-m-2k).
+*/
+constexpr double smoothing_coeff(unsigned int m, unsigned int q, unsigned int k)
+    {
+    return (m == 0) ? 0.0 : ((k & 1u) ? 1.0 : -1.0)*smoothing_sum(0.5*double(m), q, k, k);
+    }
+
+//! Unsigned integer as wide as Real, for the neighbor counts of the batch kernels
+template<class Real>
+struct count_type
+    {
+    typedef unsigned int type;
+    };
+
+//! 64 bit count for the double precision kernels
+template<>
+struct count_type<double>
+    {
+    typedef unsigned long long type;
+    };
+
+//! Pair of Real, for the cached (1/sigma_ij^2, cutoff^2) of the batch kernels
+template<class Real>
+struct pair_type
+    {
+    typedef float2 type;
+    };
+
+//! Pair of doubles for the double precision kernels
+template<>
+struct pair_type<double>
+    {
+    typedef double2 type;
+    };
+
+} // end namespace polydisperse
+
+//! Class for evaluating the (m, n, q) family of polydisperse pair potentials
+/*! <b>General Overview</b>
+
+    See EvaluatorPairLJPlugin for the general design of pair evaluators and how PotentialPair uses them.
+
+    <b>Polydisperse specifics</b>
+
+    EvaluatorPairPolydisperseMNQ evaluates the function:
+    \f[ V(r) = v_0 \left[ \left( \frac{\sigma_{ij}}{r} \right)^{m} - \left( \frac{\sigma_{ij}}{r} \right)^{n} \right]
+               + \sum_{k=0}^{q} c_k \left( \frac{r}{\sigma_{ij}} \right)^{2k} \f]
+    for \f$ r < \tilde{r}_c \sigma_{ij} \f$ and 0 otherwise, where
+    \f[ \sigma_{ij} = \frac{1}{2} (d_i + d_j) (1 - \varepsilon |d_i - d_j|) \f]
+    and the \f$ c_k \f$ make V and its first q derivatives vanish at the cutoff. n = 0 drops the attractive term.
+
+    The exponents are template parameters, so the inverse powers are unrolled into multiplications by repeated squaring
+    and the smoothing polynomial and its derivative into Horner schemes at compile time. Odd exponents cost one extra
+    square root. The per type pair parameters are stored in a polydisperse_params, filled by
+    make_polydisperse_params() when the pair coefficients are set.
+
+    \tparam m Exponent of the repulsive term
+    \tparam n Exponent of the attractive term, 0 to disable it
+    \tparam q Order of the smoothing polynomial
+*/
+template<unsigned int m, unsigned int n, unsigned int q>
+class EvaluatorPairPolydisperseMNQ
+    {
+    public:
+        //! Define the parameter type used by this pair potential evaluator
+        typedef polydisperse_params param_type;
+
+        //! Constructs the pair potential evaluator
+        /*! \param _rsq Squared distance between the particles
+            \param _rcutsq Squared distance at which the potential goes to 0
+            \param _params Per type pair parameters of this potential
+        */
+        DEVICE EvaluatorPairPolydisperseMNQ(Scalar _rsq, Scalar _rcutsq, const param_type& _params)
+            : rsq(_rsq), rcutsq(_rcutsq), v0(_params.v0), eps(_params.eps), scaledrcutsq(_params.scaledrcutsq)
+            {
+            for (unsigned int k = 0; k <= q; ++k)
+                c[k] = _params.c[k];
+            }
+
+        //! Polydisperse potentials use the diameter
+        DEVICE static bool needsDiameter() { return true; }
+        //! Accept the optional diameter values
+        /*! \param di Diameter of particle i
+            \param dj Diameter of particle j
+        */
+        DEVICE void setDiameter(Scalar di, Scalar dj)
+            {
+            d_i = di;
+            d_j = dj;
+            }
+
+        //! Polydisperse potentials don't use charge
+        DEVICE static bool needsCharge() { return false; }
+        //! Accept the optional diameter values
+        /*! \param qi Charge of particle i
+            \param qj Charge of particle j
+        */
+        DEVICE void setCharge(Scalar qi, Scalar qj) { }
+
+        //! Evaluate the force and energy
+        /*! \param force_divr Output parameter to write the computed force divided by r.
+            \param pair_eng Output parameter to write the computed pair energy
+            \param energy_shift Ignored, the smoothing polynomial already takes V(r) to zero at the cutoff
+            \note There is no need to check if rsq < rcutsq in this method. Cutoff tests are performed
+                  in PotentialPair.
+
+            \return True if they are evaluated or false if they are not because we are beyond the cutoff
+        */
+        DEVICE bool evalForceAndEnergy(Scalar& force_divr, Scalar& pair_eng, bool energy_shift)
+            {
+            Scalar sigma = Scalar(0.5)*(d_i+d_j)*(Scalar(1.0)-eps*fabs(d_i-d_j));
+            Scalar sigmasq = sigma*sigma;
+            Scalar actualcutsq = scaledrcutsq*sigmasq;
+            // compute the force divided by r in force_divr
+            if (rsq < actualcutsq && v0 != 0)
+                {
+                // one reciprocal gives (sigma/r)^2, (r/sigma)^2 and 1/sigma^2
+                Scalar inv = Scalar(1.0)/(rsq*sigmasq);
+                Scalar r2inv = sigmasq*sigmasq*inv;
+                Scalar _rsq = rsq*rsq*inv;
+                Scalar sigmasq_inv = rsq*inv;
+
+                Scalar rminv = polydisperse::inv_pow<m>::eval(r2inv);
+                Scalar rninv = (n > 0) ? polydisperse::inv_pow<n>::eval(r2inv) : Scalar(0.0);
+                force_divr = (v0*(Scalar(m)*rminv - Scalar(n)*rninv)*r2inv
+                              - polydisperse::dhorner<1, q>::eval(c, _rsq))*sigmasq_inv;
+
+                //No energy shift is needed
+                pair_eng = v0*(rminv - rninv) + polydisperse::horner<0, q>::eval(c, _rsq);
+                return true;
+                }
+            else
+                return false;
+            }
+
+        //! Evaluate the energy only
+        /*! \param pair_eng Output parameter to write the computed pair energy
+            \param energy_shift Ignored, the smoothing polynomial already takes V(r) to zero at the cutoff
+
+            Same energy as evalForceAndEnergy(), without the force and the derivative of the smoothing polynomial.
+            \return True if it is evaluated or false if it is not because we are beyond the cutoff
+        */
+        DEVICE bool evalEnergy(Scalar& pair_eng, bool energy_shift)
+            {
+            Scalar sigma = Scalar(0.5)*(d_i+d_j)*(Scalar(1.0)-eps*fabs(d_i-d_j));
+            Scalar sigmasq = sigma*sigma;
+            Scalar actualcutsq = scaledrcutsq*sigmasq;
+            if (rsq < actualcutsq && v0 != 0)
+                {
+                Scalar inv = Scalar(1.0)/(rsq*sigmasq);
+                Scalar r2inv = sigmasq*sigmasq*inv;
+                Scalar _rsq = rsq*rsq*inv;
+
+                Scalar rminv = polydisperse::inv_pow<m>::eval(r2inv);
+                Scalar rninv = (n > 0) ? polydisperse::inv_pow<n>::eval(r2inv) : Scalar(0.0);
+                pair_eng = v0*(rminv - rninv) + polydisperse::horner<0, q>::eval(c, _rsq);
+                return true;
+                }
+            else
+                return false;
+            }
+
+        #ifndef NVCC
+        //! Get the name of this potential
+        /*! \returns The potential name. Must be short and all lowercase, as this is the name energies will be logged as
+            via analyze.log.
+        */
+        static std::string getName()
+            {
+            return std::string("polydisperse_") + std::to_string(m) + "_" + std::to_string(n) + "_" + std::to_string(q);
+            }
+        std::string getShapeSpec() const
+            {
+            throw std::runtime_error("Shape definition not supported for this pair potential.");
+            }
+
+        //! Evaluate one particle against a contiguous batch of its neighbors
+        /*! \param params Per type pair parameters, shared by all neighbors in the batch
+            \param di Diameter of particle i
+            \param rsq Squared distances to the neighbors
+            \param dj Diameters of the neighbors
+            \param n_neigh Number of neighbors in the batch
+            \param force_divr Output force divided by r for each neighbor
+            \param pair_eng Output pair energy for each neighbor, not written when \a energy is false
+            \returns Number of neighbors inside the cutoff
+            \tparam Real Precision of the pair arithmetic and of the arrays, Scalar or float for the mixed precision
+                         kernels. The caller converts the distances and diameters to float once when it gathers the
+                         neighbors, so that the loop runs on float vectors without conversions.
+            \tparam energy False for the force only build, which skips the smoothing polynomial and the energy stores
+
+            Neighbors beyond the cutoff get zero force and energy. Instead of branching on the cutoff, every lane is
+            evaluated at its distance clamped to the cutoff and masked afterwards, so the compiler turns the loop into
+            vector code. Pairs with sigma_ij = 0 (a zero diameter, or eps |d_i - d_j| = 1) have no range, as in
+            evalForceAndEnergy(). They are evaluated at sigma_ij = 1 and masked, which keeps their lanes finite.
+            PolydisperseBatch.h selects an AVX2 or AVX-512 build of this loop at runtime.
+
+            The masks are blends of copysign() and the only select is between two computed values. A select with a
+            constant arm, like sigma_sq > 0 ? sigma_sq : 1, lets GCC move the division that follows into the arms.
+            It then cannot if-convert a division that may trap, and only the masked AVX-512 build vectorizes. The count
+            is an integer sum of the same comparisons, as wide as Real. SSE2 has no vector form of a double comparison
+            summed into a 64 bit integer, so the double loops of the baseline build stay scalar. The float loops and
+            all AVX2 and AVX-512 builds vectorize.
+        */
+        template<class Real, bool energy = true>
+        POLYDISPERSE_FORCEINLINE static unsigned int evalBatch(const param_type& params,
+                                                               Scalar di,
+                                                               const Real *__restrict__ rsq,
+                                                               const Real *__restrict__ dj,
+                                                               unsigned int n_neigh,
+                                                               Real *__restrict__ force_divr,
+                                                               Real *__restrict__ pair_eng)
+            {
+            const Real v0 = Real(params.v0);
+            const Real eps = Real(params.eps);
+            const Real scaledrcutsq = Real(params.scaledrcutsq);
+            Real c[q+1];
+            for (unsigned int k = 0; k <= q; ++k)
+                c[k] = Real(params.c[k]);
+
+            if (v0 == Real(0.0))
+                {
+                for (unsigned int k = 0; k < n_neigh; ++k)
+                    {
+                    force_divr[k] = Real(0.0);
+                    if (energy)
+                        pair_eng[k] = Real(0.0);
+                    }
+                return 0;
+                }
+
+            const Real d_i = Real(di);
+            const Real sigma_sq_min = std::numeric_limits<Real>::min();
+            // count in an integer as wide as Real, so the count does not halve the vector length
+            typename polydisperse::count_type<Real>::type n_in = 0;
+            for (unsigned int k = 0; k < n_neigh; ++k)
+                {
+                const Real d_j = dj[k];
+                const Real r_sq = rsq[k];
+                const Real sigma = Real(0.5)*(d_i+d_j)*(Real(1.0)-eps*std::fabs(d_i-d_j));
+                const Real sigma_sq = sigma*sigma;
+
+                // 1 if sigma_ij has a range and 0 if not, then sigma_ij^2 or 1
+                const Real valid = Real(0.5) + std::copysign(Real(0.5), sigma_sq - sigma_sq_min);
+                const Real sigmasq = sigma_sq + (Real(1.0) - valid);
+                const Real actualcutsq = scaledrcutsq*sigmasq;
+
+                // 1 strictly inside the cutoff and 0 beyond, clamp with a select, fmin does not vectorize
+                const Real mask = valid*(Real(0.5) - std::copysign(Real(0.5), r_sq - actualcutsq));
+                const Real r_eval = r_sq < actualcutsq ? r_sq : actualcutsq;
+
+                const Real inv = Real(1.0)/(r_eval*sigmasq);
+                const Real r2inv = sigmasq*sigmasq*inv;
+                const Real _rsq = r_eval*r_eval*inv;
+                const Real sigmasq_inv = r_eval*inv;
+
+                const Real rminv = polydisperse::inv_pow<m>::eval(r2inv);
+                const Real rninv = (n > 0) ? polydisperse::inv_pow<n>::eval(r2inv) : Real(0.0);
+                const Real f = (v0*(Real(m)*rminv - Real(n)*rninv)*r2inv
+                                - polydisperse::dhorner<1, q>::eval(c, _rsq))*sigmasq_inv;
+                force_divr[k] = mask*f;
+                if (energy)
+                    {
+                    const Real e = v0*(rminv - rninv) + polydisperse::horner<0, q>::eval(c, _rsq);
+                    pair_eng[k] = mask*e;
+                    }
+                n_in += (r_sq < actualcutsq) & (sigma_sq >= sigma_sq_min);
+                }
+            return (unsigned int)n_in;
+            }
+
+        //! Evaluate one particle against a contiguous batch of its neighbors, from cached pair diameters
+        /*! \param params Per type pair parameters, shared by all neighbors in the batch
+            \param rsq Squared distances to the neighbors
+            \param pair_cache (1/sigma_ij^2, (scaledr_cut sigma_ij)^2) of each neighbor, see NeighborListDiameterClass
+            \param n_neigh Number of neighbors in the batch
+            \param force_divr Output force divided by r for each neighbor
+            \param pair_eng Output pair energy for each neighbor, not written when \a energy is false
+            \returns Number of neighbors inside the cutoff
+            \tparam Real Precision of the pair arithmetic, see evalBatch()
+            \tparam energy False for the force only build, see evalBatch()
+
+            Same results as evalBatch(), without the diameters, the non-additive sigma_ij and the cutoff of every pair.
+        */
+        template<class Real, bool energy = true>
+        POLYDISPERSE_FORCEINLINE static unsigned int evalBatchCached(
+            const param_type& params,
+            const Real *__restrict__ rsq,
+            const typename polydisperse::pair_type<Real>::type *__restrict__ pair_cache,
+            unsigned int n_neigh,
+            Real *__restrict__ force_divr,
+            Real *__restrict__ pair_eng)
+            {
+            const Real v0 = Real(params.v0);
+            Real c[q+1];
+            for (unsigned int k = 0; k <= q; ++k)
+                c[k] = Real(params.c[k]);
+
+            if (v0 == Real(0.0))
+                {
+                for (unsigned int k = 0; k < n_neigh; ++k)
+                    {
+                    force_divr[k] = Real(0.0);
+                    if (energy)
+                        pair_eng[k] = Real(0.0);
+                    }
+                return 0;
+                }
+
+            typename polydisperse::count_type<Real>::type n_in = 0;
+            for (unsigned int k = 0; k < n_neigh; ++k)
+                {
+                const Real r_sq = rsq[k];
+                const Real sigmasq_inv = pair_cache[k].x;
+                const Real actualcutsq = pair_cache[k].y;
+                const Real mask = Real(0.5) - std::copysign(Real(0.5), r_sq - actualcutsq);
+
+                const Real _rsq = r_sq*sigmasq_inv;
+                const Real r2inv = Real(1.0)/_rsq;
+
+                const Real rminv = polydisperse::inv_pow<m>::eval(r2inv);
+                const Real rninv = (n > 0) ? polydisperse::inv_pow<n>::eval(r2inv) : Real(0.0);
+                const Real f = (v0*(Real(m)*rminv - Real(n)*rninv)*r2inv
+                                - polydisperse::dhorner<1, q>::eval(c, _rsq))*sigmasq_inv;
+
+                force_divr[k] = mask*f;
+                if (energy)
+                    {
+                    const Real e = v0*(rminv - rninv) + polydisperse::horner<0, q>::eval(c, _rsq);
+                    pair_eng[k] = mask*e;
+                    }
+                n_in += r_sq < actualcutsq;
+                }
+            return (unsigned int)n_in;
+            }
+
+        //! Evaluate the energies of one particle against a contiguous batch of its neighbors
+        /*! \param params Per type pair parameters, shared by all neighbors in the batch
+            \param di Diameter of particle i
+            \param rsq Squared distances to the neighbors
+            \param dj Diameters of the neighbors
+            \param n_neigh Number of neighbors in the batch
+            \param pair_eng Output pair energy for each neighbor
+            \returns Sum of the pair energies of the batch
+
+            The energy half of evalBatch(), with the same clamping and masking of the neighbors beyond the cutoff.
+        */
+        POLYDISPERSE_FORCEINLINE static Scalar evalEnergyBatch(const param_type& params,
+                                                               Scalar di,
+                                                               const Scalar *__restrict__ rsq,
+                                                               const Scalar *__restrict__ dj,
+                                                               unsigned int n_neigh,
+                                                               Scalar *__restrict__ pair_eng)
+            {
+            const Scalar v0 = params.v0;
+            const Scalar eps = params.eps;
+            const Scalar scaledrcutsq = params.scaledrcutsq;
+            Scalar c[q+1];
+            for (unsigned int k = 0; k <= q; ++k)
+                c[k] = params.c[k];
+
+            if (v0 == Scalar(0.0))
+                {
+                for (unsigned int k = 0; k < n_neigh; ++k)
+                    pair_eng[k] = Scalar(0.0);
+                return Scalar(0.0);
+                }
+
+            const Scalar sigma_sq_min = std::numeric_limits<Scalar>::min();
+            Scalar sum = Scalar(0.0);
+            for (unsigned int k = 0; k < n_neigh; ++k)
+                {
+                const Scalar d_j = dj[k];
+                const Scalar r_sq = rsq[k];
+                const Scalar sigma = Scalar(0.5)*(di+d_j)*(Scalar(1.0)-eps*std::fabs(di-d_j));
+                const Scalar sigma_sq = sigma*sigma;
+
+                const Scalar valid = Scalar(0.5) + std::copysign(Scalar(0.5), sigma_sq - sigma_sq_min);
+                const Scalar sigmasq = sigma_sq + (Scalar(1.0) - valid);
+                const Scalar actualcutsq = scaledrcutsq*sigmasq;
+                const Scalar mask = valid*(Scalar(0.5) - std::copysign(Scalar(0.5), r_sq - actualcutsq));
+                const Scalar r_eval = r_sq < actualcutsq ? r_sq : actualcutsq;
+
+                const Scalar inv = Scalar(1.0)/(r_eval*sigmasq);
+                const Scalar r2inv = sigmasq*sigmasq*inv;
+                const Scalar _rsq = r_eval*r_eval*inv;
+
+                const Scalar rminv = polydisperse::inv_pow<m>::eval(r2inv);
+                const Scalar rninv = (n > 0) ? polydisperse::inv_pow<n>::eval(r2inv) : Scalar(0.0);
+                const Scalar e = mask*(v0*(rminv - rninv) + polydisperse::horner<0, q>::eval(c, _rsq));
+
+                pair_eng[k] = e;
+                sum += e;
+                }
+            return sum;
+            }
+        #endif
+
+    protected:
+        Scalar rsq;     //!< Stored rsq from the constructor
+        Scalar rcutsq;  //!< Stored rcutsq from the constructor
+        Scalar d_i;     //!< d_i diameter of particle i
+        Scalar d_j;     //!< d_j diameter of particle j
+
+        //Parameters to be read
+        Scalar v0;
+        Scalar eps;
+        Scalar scaledrcutsq;
+
+        //Smoothing coefficients, precomputed in make_polydisperse_params()
+        Scalar c[q+1];
+
+        static_assert(q >= 1 && q < POLYDISPERSE_MAX_COEFFS, "smoothing order out of range");
+        static_assert(m > n, "the repulsive exponent must be larger than the attractive one");
+    };
+
+//! Compute the per type pair parameters of EvaluatorPairPolydisperseMNQ
+/*! \param v0 Energy scale of the potential
+    \param eps Non-additivity of the pair diameter
+    \param scaledr_cut Cutoff radius in units of sigma_ij
+    \returns Parameters with the smoothing coefficients evaluated for this cutoff
+*/
+template<unsigned int m, unsigned int n, unsigned int q>
+inline polydisperse_params make_polydisperse_params(Scalar v0, Scalar eps, Scalar scaledr_cut)
+    {
+    polydisperse_params params = make_polydisperse_base_params(v0, eps, scaledr_cut);
+    for (unsigned int k = 0; k <= q; ++k)
+        {
+        params.c[k] = Scalar(polydisperse::smoothing_coeff(m, q, k))*v0/pow(scaledr_cut, Scalar(m + 2*k));
+        if (n > 0)
+            params.c[k] -= Scalar(polydisperse::smoothing_coeff(n, q, k))*v0/pow(scaledr_cut, Scalar(n + 2*k));
+        }
+    return params;
+    }
+
+//! The models listed in the README, see polymd/pair.py for their names
+typedef EvaluatorPairPolydisperseMNQ<12, 0, 2> EvaluatorPairPolydisperse;
+typedef EvaluatorPairPolydisperseMNQ<18, 0, 2> EvaluatorPairPolydisperse18;
+typedef EvaluatorPairPolydisperseMNQ<10, 0, 3> EvaluatorPairPolydisperse10;
+typedef EvaluatorPairPolydisperseMNQ<12, 6, 2> EvaluatorPairPolydisperseLJ;
+typedef EvaluatorPairPolydisperseMNQ<10, 6, 2> EvaluatorPairPolydisperseLJ106;
+
+#ifndef NVCC
+// keep the log names of the models that existed before the template
+template<> inline std::string EvaluatorPairPolydisperse::getName() { return std::string("polydisperse-12"); }
+template<> inline std::string EvaluatorPairPolydisperse18::getName() { return std::string("polydisperse18"); }
+template<> inline std::string EvaluatorPairPolydisperse10::getName() { return std::string("polydisperse10"); }
+template<> inline std::string EvaluatorPairPolydisperseLJ::getName() { return std::string("polydisperse_lj"); }
+template<> inline std::string EvaluatorPairPolydisperseLJ106::getName() { return std::string("polydisperse_lj"); }
+#endif
+
+#endif // __PAIR_EVALUATOR_POLYDISPERSE_MNQ_H__
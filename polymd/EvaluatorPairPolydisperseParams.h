@@ -0,0 +1,49 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __PAIR_EVALUATOR_POLYDISPERSE_PARAMS_H__
+#define __PAIR_EVALUATOR_POLYDISPERSE_PARAMS_H__
+
+#include "hoomd/HOOMDMath.h"
+
+/*! \file EvaluatorPairPolydisperseParams.h
+    \brief Defines the per type pair parameters shared by the polydisperse pair evaluators
+*/
+
+//! Maximum number of smoothing polynomial coefficients stored per type pair
+const unsigned int POLYDISPERSE_MAX_COEFFS = 5;
+
+//! Per type pair parameters of the polydisperse pair potentials
+/*! The smoothing polynomial coefficients only depend on v0 and scaledr_cut, so they are computed once on the host
+    when the pair coefficients are set (see make_polydisperse_params() in EvaluatorPairPolydisperseMNQ.h) instead of
+    once per particle pair in the evaluator constructor.
+*/
+struct polydisperse_params
+    {
+    Scalar v0;                              //!< Energy scale of the potential
+    Scalar eps;                             //!< Non-additivity of the pair diameter sigma_ij
+    Scalar scaledrcutsq;                    //!< Square of the cutoff radius in units of sigma_ij
+    Scalar c[POLYDISPERSE_MAX_COEFFS];      //!< Coefficients of the smoothing polynomial in (r/sigma_ij)^2
+    };
+
+//! Helper to initialize the parameters that do not depend on the model
+/*! \param v0 Energy scale of the potential
+    \param eps Non-additivity of the pair diameter
+    \param scaledr_cut Cutoff radius in units of sigma_ij
+    \returns Parameters with all smoothing coefficients set to zero
+*/
+inline polydisperse_params make_polydisperse_base_params(Scalar v0, Scalar eps, Scalar scaledr_cut)
+    {
+    polydisperse_params params;
+    params.v0 = v0;
+    params.eps = eps;
+    params.scaledrcutsq = scaledr_cut*scaledr_cut;
+    for (unsigned int k = 0; k < POLYDISPERSE_MAX_COEFFS; ++k)
+        params.c[k] = Scalar(0.0);
+    return params;
+    }
+
+#endif // __PAIR_EVALUATOR_POLYDISPERSE_PARAMS_H__
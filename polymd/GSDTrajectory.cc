@@ -0,0 +1,252 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+/*! \file GSDTrajectory.cc
+    \brief Defines the GSDTrajectory class
+*/
+
+#include "GSDTrajectory.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+//! Magic number at the start of every GSD file
+static const uint64_t GSD_MAGIC_ID = 0x65DF65DF65DF65DFULL;
+
+//! Size of a name in the name list of file layer 1.x, and the unit of the name list size
+static const unsigned int GSD_NAME_SIZE = 64;
+
+//! Data types of the GSD file layer
+enum gsd_type
+    {
+    GSD_TYPE_UINT8 = 1,
+    GSD_TYPE_UINT16,
+    GSD_TYPE_UINT32,
+    GSD_TYPE_UINT64,
+    GSD_TYPE_INT8,
+    GSD_TYPE_INT16,
+    GSD_TYPE_INT32,
+    GSD_TYPE_INT64,
+    GSD_TYPE_FLOAT,
+    GSD_TYPE_DOUBLE,
+    GSD_TYPE_CHARACTER
+    };
+
+//! Header at the start of a GSD file
+struct gsd_header
+    {
+    uint64_t magic;                         //!< GSD_MAGIC_ID
+    uint64_t index_location;                //!< Offset of the index
+    uint64_t index_allocated_entries;       //!< Number of entries allocated in the index
+    uint64_t namelist_location;             //!< Offset of the name list
+    uint64_t namelist_allocated_entries;    //!< Size of the name list in units of GSD_NAME_SIZE
+    uint32_t schema_version;                //!< Version of the schema
+    uint32_t gsd_version;                   //!< Version of the file layer, major << 16 | minor
+    char application[64];                   //!< Application that wrote the file
+    char schema[64];                        //!< Schema name
+    char reserved[80];                      //!< Reserved
+    };
+
+//! An entry of the index, as stored in the file
+struct gsd_file_index_entry
+    {
+    int64_t frame;
+    int64_t N;
+    int64_t location;
+    uint32_t M;
+    uint16_t id;
+    uint8_t type;
+    uint8_t flags;
+    };
+
+/*! \param filename Name of the GSD file
+*/
+GSDTrajectory::GSDTrajectory(const std::string& filename)
+    : m_filename(filename), m_fd(-1), m_data(NULL), m_size(0), m_n_frames(0)
+    {
+    m_fd = open(filename.c_str(), O_RDONLY);
+    if (m_fd < 0)
+        throw runtime_error("Error opening " + filename);
+
+    struct stat st;
+    if (fstat(m_fd, &st) != 0 || st.st_size < (off_t)sizeof(gsd_header))
+        {
+        close(m_fd);
+        throw runtime_error(filename + " is not a GSD file");
+        }
+    m_size = uint64_t(st.st_size);
+
+    void *map = mmap(NULL, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+    if (map == MAP_FAILED)
+        {
+        close(m_fd);
+        throw runtime_error("Error mapping " + filename);
+        }
+    m_data = (const char *)map;
+
+    try
+        {
+        gsd_header header;
+        memcpy(&header, m_data, sizeof(gsd_header));
+        if (header.magic != GSD_MAGIC_ID)
+            throw runtime_error(filename + " is not a GSD file");
+
+        const unsigned int major = header.gsd_version >> 16;
+        if (major != 1 && major != 2)
+            throw runtime_error(filename + ": unsupported GSD file layer version");
+
+        header.schema[sizeof(header.schema)-1] = 0;
+        m_schema = header.schema;
+
+        // the name list, fixed size entries in 1.x and packed null terminated names in 2.x
+        const uint64_t names_size = header.namelist_allocated_entries*GSD_NAME_SIZE;
+        if (header.namelist_location + names_size > m_size)
+            throw runtime_error(filename + ": the name list is beyond the end of the file");
+        const char *names = m_data + header.namelist_location;
+        uint64_t offset = 0;
+        while (offset < names_size && names[offset] != 0)
+            {
+            const uint64_t remaining = (major == 1) ? GSD_NAME_SIZE : names_size - offset;
+            const uint64_t length = strnlen(names + offset, remaining);
+            const uint16_t id = (uint16_t)m_names.size();
+            m_names[string(names + offset, length)] = id;
+            offset += (major == 1) ? GSD_NAME_SIZE : length + 1;
+            }
+
+        // the index, unused entries have a zero location
+        const uint64_t index_size = header.index_allocated_entries*sizeof(gsd_file_index_entry);
+        if (header.index_location + index_size > m_size)
+            throw runtime_error(filename + ": the index is beyond the end of the file");
+        for (uint64_t k = 0; k < header.index_allocated_entries; ++k)
+            {
+            gsd_file_index_entry e;
+            memcpy(&e, m_data + header.index_location + k*sizeof(gsd_file_index_entry), sizeof(e));
+            if (e.location == 0)
+                continue;
+
+            if (e.frame < 0 || e.N < 0 || typeSize(e.type) == 0
+                || uint64_t(e.location) + uint64_t(e.N)*e.M*typeSize(e.type) > m_size)
+                throw runtime_error(filename + ": corrupt index entry");
+
+            index_entry entry;
+            entry.frame = e.frame;
+            entry.N = e.N;
+            entry.location = e.location;
+            entry.M = e.M;
+            entry.id = e.id;
+            entry.type = e.type;
+            entry.flags = e.flags;
+            m_index[make_pair(uint64_t(e.frame), e.id)] = entry;
+            m_n_frames = std::max(m_n_frames, uint64_t(e.frame) + 1);
+            }
+        }
+    catch (...)
+        {
+        munmap((void *)m_data, m_size);
+        close(m_fd);
+        throw;
+        }
+    }
+
+GSDTrajectory::~GSDTrajectory()
+    {
+    munmap((void *)m_data, m_size);
+    close(m_fd);
+    }
+
+/*! \param frame Frame to look in
+    \param name Name of the chunk
+*/
+bool GSDTrajectory::hasChunk(uint64_t frame, const std::string& name) const
+    {
+    std::map<std::string, uint16_t>::const_iterator id = m_names.find(name);
+    if (id == m_names.end())
+        return false;
+    return m_index.count(make_pair(frame, id->second)) > 0;
+    }
+
+/*! \param frame Frame to look in
+    \param name Name of the chunk
+    \returns The entry of the chunk in \a frame, or in frame 0 if \a frame does not have it, or NULL
+*/
+const GSDTrajectory::index_entry *GSDTrajectory::find(uint64_t frame, const std::string& name) const
+    {
+    if (frame >= m_n_frames)
+        throw runtime_error(m_filename + ": frame out of range");
+
+    std::map<std::string, uint16_t>::const_iterator id = m_names.find(name);
+    if (id == m_names.end())
+        return NULL;
+
+    std::map< std::pair<uint64_t, uint16_t>, index_entry >::const_iterator entry
+        = m_index.find(make_pair(frame, id->second));
+    if (entry == m_index.end())
+        entry = m_index.find(make_pair(uint64_t(0), id->second));
+    return entry == m_index.end() ? NULL : &entry->second;
+    }
+
+/*! \param frame Frame to read
+    \param name Name of the chunk
+    \param strings Returns one string per row, without the null padding
+    \returns False if neither \a frame nor frame 0 has the chunk
+*/
+bool GSDTrajectory::readStrings(uint64_t frame, const std::string& name, std::vector<std::string>& strings) const
+    {
+    const index_entry *entry = find(frame, name);
+    if (!entry)
+        return false;
+    if (entry->type != GSD_TYPE_INT8 && entry->type != GSD_TYPE_UINT8 && entry->type != GSD_TYPE_CHARACTER)
+        throw runtime_error(m_filename + ": " + name + " is not a chunk of strings");
+
+    const char *ptr = m_data + entry->location;
+    strings.resize(entry->N);
+    for (int64_t k = 0; k < entry->N; ++k)
+        strings[k] = string(ptr + k*entry->M, strnlen(ptr + k*entry->M, entry->M));
+    return true;
+    }
+
+/*! \param ptr Pointer to the element in the mapping, not necessarily aligned
+    \param type Data type of the chunk
+*/
+double GSDTrajectory::element(const char *ptr, uint8_t type)
+    {
+    switch (type)
+        {
+        case GSD_TYPE_UINT8: case GSD_TYPE_CHARACTER: { uint8_t v; memcpy(&v, ptr, sizeof(v)); return double(v); }
+        case GSD_TYPE_UINT16: { uint16_t v; memcpy(&v, ptr, sizeof(v)); return double(v); }
+        case GSD_TYPE_UINT32: { uint32_t v; memcpy(&v, ptr, sizeof(v)); return double(v); }
+        case GSD_TYPE_UINT64: { uint64_t v; memcpy(&v, ptr, sizeof(v)); return double(v); }
+        case GSD_TYPE_INT8: { int8_t v; memcpy(&v, ptr, sizeof(v)); return double(v); }
+        case GSD_TYPE_INT16: { int16_t v; memcpy(&v, ptr, sizeof(v)); return double(v); }
+        case GSD_TYPE_INT32: { int32_t v; memcpy(&v, ptr, sizeof(v)); return double(v); }
+        case GSD_TYPE_INT64: { int64_t v; memcpy(&v, ptr, sizeof(v)); return double(v); }
+        case GSD_TYPE_FLOAT: { float v; memcpy(&v, ptr, sizeof(v)); return double(v); }
+        case GSD_TYPE_DOUBLE: { double v; memcpy(&v, ptr, sizeof(v)); return v; }
+        default: return 0.0;
+        }
+    }
+
+/*! \param type Data type of a chunk
+    \returns The size of one element in bytes, or 0 for an unknown type
+*/
+unsigned int GSDTrajectory::typeSize(uint8_t type)
+    {
+    switch (type)
+        {
+        case GSD_TYPE_UINT8: case GSD_TYPE_INT8: case GSD_TYPE_CHARACTER: return 1;
+        case GSD_TYPE_UINT16: case GSD_TYPE_INT16: return 2;
+        case GSD_TYPE_UINT32: case GSD_TYPE_INT32: case GSD_TYPE_FLOAT: return 4;
+        case GSD_TYPE_UINT64: case GSD_TYPE_INT64: case GSD_TYPE_DOUBLE: return 8;
+        default: return 0;
+        }
+    }
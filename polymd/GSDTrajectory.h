@@ -0,0 +1,124 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __GSD_TRAJECTORY_H__
+#define __GSD_TRAJECTORY_H__
+
+/*! \file GSDTrajectory.h
+    \brief Declares the GSDTrajectory class
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+#include <map>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+//! Read only, memory mapped access to the chunks of a GSD file
+/*! GSDTrajectory maps the whole file and reads the header, the name list and the index once. Chunks are then read
+    directly from the mapping, so several threads can read different frames at the same time without locking or
+    seeking.
+
+    Both file layer versions written by HOOMD are supported: 1.x (fixed size names) and 2.x (packed names). read()
+    follows the HOOMD schema: a chunk missing from a frame is taken from frame 0, and read() returns false when frame 0
+    does not have it either, so that the caller can apply the schema default.
+
+    Only what the trajectory tools of polymd need is implemented: numeric chunks are converted to the requested type on
+    read, and files are never written.
+*/
+class GSDTrajectory
+    {
+    public:
+        //! Map a GSD file
+        GSDTrajectory(const std::string& filename);
+
+        //! Unmap the file
+        ~GSDTrajectory();
+
+        //! Get the number of frames in the file
+        uint64_t getNumFrames() const
+            {
+            return m_n_frames;
+            }
+
+        //! Get the schema name of the file, e.g. hoomd
+        const std::string& getSchema() const
+            {
+            return m_schema;
+            }
+
+        //! Test if a chunk is stored in a frame, without the fallback to frame 0
+        bool hasChunk(uint64_t frame, const std::string& name) const;
+
+        //! Read a numeric chunk, converted to T
+        template<class T>
+        bool read(uint64_t frame, const std::string& name, std::vector<T>& data, uint64_t& N, uint32_t& M) const;
+
+        //! Read a chunk of strings stored as int8 or uint8 rows, like particles/types
+        bool readStrings(uint64_t frame, const std::string& name, std::vector<std::string>& strings) const;
+
+    private:
+        //! An entry of the index
+        struct index_entry
+            {
+            int64_t frame;      //!< Frame of the chunk
+            int64_t N;          //!< Number of rows
+            int64_t location;   //!< Offset of the data in the file
+            uint32_t M;         //!< Number of columns
+            uint16_t id;        //!< Index of the name in the name list
+            uint8_t type;       //!< Data type, see gsd_type
+            uint8_t flags;      //!< Reserved
+            };
+
+        std::string m_filename;                     //!< Name of the file, for error messages
+        int m_fd;                                   //!< File descriptor
+        const char *m_data;                         //!< Start of the mapping
+        uint64_t m_size;                            //!< Size of the file in bytes
+        std::string m_schema;                       //!< Schema name from the header
+        uint64_t m_n_frames;                        //!< Number of frames
+        std::map<std::string, uint16_t> m_names;    //!< Name list, name to id
+        std::map< std::pair<uint64_t, uint16_t>, index_entry > m_index; //!< Index by frame and name id
+
+        //! Find the entry of a chunk, with the fallback to frame 0
+        const index_entry *find(uint64_t frame, const std::string& name) const;
+
+        //! Convert one element of a chunk to double
+        static double element(const char *ptr, uint8_t type);
+
+        //! Get the size of a data type in bytes
+        static unsigned int typeSize(uint8_t type);
+    };
+
+/*! \param frame Frame to read
+    \param name Name of the chunk, e.g. particles/position
+    \param data Returns N*M values in row major order
+    \param N Returns the number of rows
+    \param M Returns the number of columns
+    \returns False if neither \a frame nor frame 0 has the chunk
+*/
+template<class T>
+bool GSDTrajectory::read(uint64_t frame, const std::string& name, std::vector<T>& data, uint64_t& N, uint32_t& M) const
+    {
+    const index_entry *entry = find(frame, name);
+    if (!entry)
+        return false;
+
+    N = uint64_t(entry->N);
+    M = entry->M;
+    const unsigned int size = typeSize(entry->type);
+    const char *ptr = m_data + entry->location;
+    data.resize(N*M);
+    for (uint64_t k = 0; k < N*M; ++k)
+        data[k] = T(element(ptr + k*size, entry->type));
+    return true;
+    }
+
+#endif // __GSD_TRAJECTORY_H__
@@ -0,0 +1,339 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+/*! \file LoadBalancerPolydisperse.cc
+    \brief Defines LoadBalancerPolydisperse
+*/
+
+#include "LoadBalancerPolydisperse.h"
+#include "PolymdWorkQueue.h"
+
+#ifdef ENABLE_MPI
+#include "hoomd/Communicator.h"
+#include "hoomd/DomainDecomposition.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace py = pybind11;
+
+using namespace std;
+
+/*! \param sysdef System definition
+    \param nlist Neighbor list whose neighbor counts weigh the particles
+*/
+LoadBalancerPolydisperse::LoadBalancerPolydisperse(std::shared_ptr<SystemDefinition> sysdef,
+                                                   std::shared_ptr<NeighborList> nlist)
+    : Updater(sysdef), m_nlist(nlist), m_tolerance(Scalar(1.05)), m_max_shift(Scalar(0.25)),
+      m_imbalance(Scalar(1.0)), m_n_adjustments(0)
+    {
+    m_exec_conf->msg->notice(5) << "Constructing LoadBalancerPolydisperse" << endl;
+
+    m_enable[0] = m_enable[1] = m_enable[2] = true;
+    }
+
+LoadBalancerPolydisperse::~LoadBalancerPolydisperse()
+    {
+    m_exec_conf->msg->notice(5) << "Destroying LoadBalancerPolydisperse" << endl;
+    }
+
+/*! \param force A polymd force compute, see PolymdPairLoopTime
+*/
+void LoadBalancerPolydisperse::addForce(std::shared_ptr<ForceCompute> force)
+    {
+    PolymdPairLoopTime *timed = dynamic_cast<PolymdPairLoopTime *>(force.get());
+    if (!timed)
+        {
+        m_exec_conf->msg->error() << "update.balance: only the polymd pair forces on the CPU time their "
+                                  << "pair loop" << endl;
+        throw runtime_error("Error adding a force to the load balancer");
+        }
+    m_forces.push_back(force);
+    m_last_time.push_back(timed->getPairLoopTime());
+    }
+
+/*! \param max_shift Largest shift of a boundary in one update, relative to the width of the narrower of its domains,
+                     in (0, 0.5)
+*/
+void LoadBalancerPolydisperse::setMaxShift(Scalar max_shift)
+    {
+    if (!(max_shift > Scalar(0.0) && max_shift < Scalar(0.5)))
+        {
+        m_exec_conf->msg->error() << "update.balance: max_shift must be in (0, 0.5)" << endl;
+        throw runtime_error("Error setting the load balancer parameters");
+        }
+    m_max_shift = max_shift;
+    }
+
+/*! \param dim Direction, 0 to 2 for x to z
+    \param enable True to balance along \a dim
+*/
+void LoadBalancerPolydisperse::enableDimension(unsigned int dim, bool enable)
+    {
+    if (dim > 2)
+        {
+        m_exec_conf->msg->error() << "update.balance: direction " << dim << " does not exist" << endl;
+        throw runtime_error("Error setting the load balancer parameters");
+        }
+    m_enable[dim] = enable;
+    }
+
+/*! \returns The list of log quantities
+*/
+std::vector< std::string > LoadBalancerPolydisperse::getProvidedLogQuantities()
+    {
+    std::vector<std::string> list;
+    list.push_back("polydisperse_load_imbalance");
+    return list;
+    }
+
+/*! \param quantity Name of the log quantity to get
+    \param timestep Current time step of the simulation
+*/
+Scalar LoadBalancerPolydisperse::getLogValue(const std::string& quantity, unsigned int timestep)
+    {
+    if (quantity == "polydisperse_load_imbalance")
+        return m_imbalance;
+
+    m_exec_conf->msg->error() << "update.balance: " << quantity << " is not a valid log quantity"
+                              << endl;
+    throw runtime_error("Error getting log value");
+    }
+
+/*! \param cost Returns the cost of every local particle
+
+    The neighbor counts are those of the last neighbor list build. The balancer runs before the forces of the step, so
+    a particle sort since then may have reordered the particles, which only misplaces their weights by a few
+    neighbors until the next update.
+*/
+void LoadBalancerPolydisperse::computeCosts(std::vector<double>& cost)
+    {
+    const unsigned int N = m_pdata->getN();
+    cost.assign(N, double(POLYMD_PARTICLE_COST));
+
+    ArrayHandle<unsigned int> h_n_neigh(m_nlist->getNNeighArray(), access_location::host, access_mode::read);
+    const unsigned int n_counted = std::min(N, m_nlist->getNNeighArray().getNumElements());
+    for (unsigned int i = 0; i < n_counted; ++i)
+        cost[i] += double(h_n_neigh.data[i]);
+    }
+
+/*! \param profile Cost of POLYMD_BALANCE_BINS bins per domain along the direction, summed over the ranks
+    \param cum_frac Current cumulative fractions of the domains along the direction
+    \param width Width of the global box along the direction
+    \param min_width Narrowest domain that is allowed, unless it already was narrower
+    \param new_cum_frac Returns the new cumulative fractions
+    \returns True if the boundaries move
+*/
+bool LoadBalancerPolydisperse::adjust(const std::vector<double>& profile,
+                                      const std::vector<Scalar>& cum_frac,
+                                      Scalar width,
+                                      Scalar min_width,
+                                      std::vector<Scalar>& new_cum_frac)
+    {
+    const unsigned int n_domains = cum_frac.size() - 1;
+    const unsigned int n_bins = POLYMD_BALANCE_BINS;
+    new_cum_frac = cum_frac;
+
+    double total = 0.0, slab_max = 0.0;
+    for (unsigned int p = 0; p < n_domains; ++p)
+        {
+        double slab = 0.0;
+        for (unsigned int b = 0; b < n_bins; ++b)
+            slab += profile[p*n_bins+b];
+        slab_max = std::max(slab_max, slab);
+        total += slab;
+        }
+    if (total <= 0.0 || slab_max*n_domains <= double(m_tolerance)*total)
+        return false;
+
+    // boundaries where the cumulative cost crosses equal shares, linear inside a bin
+    double sum = 0.0;
+    unsigned int k = 1;
+    for (unsigned int p = 0; p < n_domains && k < n_domains; ++p)
+        {
+        const Scalar bin_width = (cum_frac[p+1] - cum_frac[p])/Scalar(n_bins);
+        for (unsigned int b = 0; b < n_bins && k < n_domains; ++b)
+            {
+            const double c = profile[p*n_bins+b];
+            while (k < n_domains && sum + c >= total*k/n_domains)
+                {
+                const double t = c > 0.0 ? (total*k/n_domains - sum)/c : 0.0;
+                new_cum_frac[k] = cum_frac[p] + bin_width*Scalar(b + t);
+                ++k;
+                }
+            sum += c;
+            }
+        }
+
+    // limit the shift of every boundary by the narrower of its domains, which keeps the boundaries in order
+    for (unsigned int b = 1; b < n_domains; ++b)
+        {
+        const Scalar limit = m_max_shift*std::min(cum_frac[b] - cum_frac[b-1], cum_frac[b+1] - cum_frac[b]);
+        new_cum_frac[b] = std::max(cum_frac[b] - limit, std::min(cum_frac[b] + limit, new_cum_frac[b]));
+        }
+
+    // the widths change linearly along the shift, so step back from the new boundaries until all domains are wide
+    // enough, the current ones are
+    std::vector<Scalar> target(new_cum_frac);
+    Scalar alpha = Scalar(1.0);
+    for (unsigned int attempt = 0; attempt <= 10; ++attempt)
+        {
+        bool wide_enough = true;
+        for (unsigned int p = 0; p < n_domains; ++p)
+            {
+            new_cum_frac[p] = cum_frac[p] + alpha*(target[p] - cum_frac[p]);
+            new_cum_frac[p+1] = cum_frac[p+1] + alpha*(target[p+1] - cum_frac[p+1]);
+            const Scalar old_w = (cum_frac[p+1] - cum_frac[p])*width;
+            if ((new_cum_frac[p+1] - new_cum_frac[p])*width < std::min(old_w, min_width))
+                wide_enough = false;
+            }
+        if (wide_enough)
+            break;
+        alpha = attempt < 10 ? alpha*Scalar(0.5) : Scalar(0.0);
+        }
+    // moves by less than a tenth of a bin are not worth a migration
+    bool moved = false;
+    for (unsigned int b = 1; b < n_domains; ++b)
+        {
+        const Scalar bin = std::min(cum_frac[b] - cum_frac[b-1], cum_frac[b+1] - cum_frac[b])/Scalar(n_bins);
+        if (std::abs(new_cum_frac[b] - cum_frac[b]) > Scalar(0.1)*bin)
+            moved = true;
+        }
+    if (alpha == Scalar(0.0) || !moved)
+        {
+        new_cum_frac = cum_frac;
+        return false;
+        }
+
+    new_cum_frac[0] = Scalar(0.0);
+    new_cum_frac[n_domains] = Scalar(1.0);
+    return true;
+    }
+
+/*! \param timestep Current time step of the simulation
+*/
+void LoadBalancerPolydisperse::update(unsigned int timestep)
+    {
+#ifdef ENABLE_MPI
+    std::shared_ptr<DomainDecomposition> decomposition = m_pdata->getDomainDecomposition();
+    if (!decomposition || !m_comm)
+        return;
+
+    if (m_prof) m_prof->push(m_exec_conf, "balance");
+
+    std::vector<double> cost;
+    computeCosts(cost);
+    const unsigned int N = m_pdata->getN();
+    double rank_cost = 0.0;
+    for (unsigned int i = 0; i < N; ++i)
+        rank_cost += cost[i];
+
+    // scale the costs of every rank to the time of its pair loops since the last update, when any were measured
+    if (!m_forces.empty())
+        {
+        unsigned long long elapsed = 0;
+        for (unsigned int f = 0; f < m_forces.size(); ++f)
+            {
+            const unsigned long long t = dynamic_cast<PolymdPairLoopTime *>(m_forces[f].get())->getPairLoopTime();
+            elapsed += t - m_last_time[f];
+            m_last_time[f] = t;
+            }
+        unsigned long long elapsed_all = elapsed;
+        MPI_Allreduce(MPI_IN_PLACE, &elapsed_all, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM,
+                      m_exec_conf->getMPICommunicator());
+        if (elapsed_all > 0 && rank_cost > 0.0)
+            {
+            const double scale = double(elapsed)/rank_cost;
+            for (unsigned int i = 0; i < N; ++i)
+                cost[i] *= scale;
+            rank_cost = double(elapsed);
+            }
+        }
+
+    // imbalance of the ranks before moving anything
+    const Index3D& di = decomposition->getDomainIndexer();
+    double cost_max = rank_cost, cost_sum = rank_cost;
+    MPI_Allreduce(MPI_IN_PLACE, &cost_max, 1, MPI_DOUBLE, MPI_MAX, m_exec_conf->getMPICommunicator());
+    MPI_Allreduce(MPI_IN_PLACE, &cost_sum, 1, MPI_DOUBLE, MPI_SUM, m_exec_conf->getMPICommunicator());
+    m_imbalance = cost_sum > 0.0 ? Scalar(cost_max*di.getNumElements()/cost_sum) : Scalar(1.0);
+
+    // cost profile along every decomposed direction, binned inside the current domains
+    const BoxDim& global_box = m_pdata->getGlobalBox();
+    const Scalar3 npd = global_box.getNearestPlaneDistance();
+    const uint3 grid_pos = decomposition->getGridPos();
+    const unsigned int grid[3] = {di.getW(), di.getH(), di.getD()};
+    const unsigned int pos[3] = {grid_pos.x, grid_pos.y, grid_pos.z};
+    const Scalar width[3] = {npd.x, npd.y, npd.z};
+    const unsigned int n_dims = m_sysdef->getNDimensions();
+    const Scalar min_width = m_comm->getGhostLayerMaxWidth();
+
+    bool moved = false;
+    std::vector<Scalar> new_cum_frac[3];
+    for (unsigned int dim = 0; dim < n_dims; ++dim)
+        {
+        if (!m_enable[dim] || grid[dim] < 2)
+            continue;
+
+        ArrayHandle<Scalar4> h_pos(m_pdata->getPositions(), access_location::host, access_mode::read);
+
+        const std::vector<Scalar> cum_frac = decomposition->getCumulativeFractions(dim);
+        const Scalar lo = cum_frac[pos[dim]];
+        const Scalar bins_per_frac = Scalar(POLYMD_BALANCE_BINS)/(cum_frac[pos[dim]+1] - lo);
+        std::vector<double> profile(grid[dim]*POLYMD_BALANCE_BINS, 0.0);
+        double *local_profile = &profile[pos[dim]*POLYMD_BALANCE_BINS];
+        for (unsigned int i = 0; i < N; ++i)
+            {
+            const Scalar3 f = global_box.makeFraction(make_scalar3(h_pos.data[i].x, h_pos.data[i].y, h_pos.data[i].z));
+            const Scalar s = dim == 0 ? f.x : (dim == 1 ? f.y : f.z);
+            const int bin = int((s - lo)*bins_per_frac);
+            local_profile[std::max(0, std::min(int(POLYMD_BALANCE_BINS) - 1, bin))] += cost[i];
+            }
+        MPI_Allreduce(MPI_IN_PLACE, profile.data(), (int)profile.size(), MPI_DOUBLE, MPI_SUM,
+                      m_exec_conf->getMPICommunicator());
+
+        if (adjust(profile, cum_frac, width[dim], min_width, new_cum_frac[dim]))
+            moved = true;
+        }
+
+    // all ranks computed the same boundaries from the same sums
+    if (moved)
+        {
+        for (unsigned int dim = 0; dim < n_dims; ++dim)
+            {
+            if (!new_cum_frac[dim].empty())
+                decomposition->setCumulativeFractions(dim, new_cum_frac[dim], 0);
+            }
+        m_exec_conf->msg->notice(6) << "update.balance: moved the domain boundaries, imbalance was "
+                                    << m_imbalance << endl;
+
+        // the local box is derived from the fractions, set the global box again to recompute it
+        m_pdata->setGlobalBox(m_pdata->getGlobalBox());
+
+        // the particles have to move to their new domains before the forces are computed
+        m_comm->forceMigrate();
+        m_comm->communicate(timestep);
+        m_nlist->forceUpdate();
+        ++m_n_adjustments;
+        }
+
+    if (m_prof) m_prof->pop(m_exec_conf);
+#endif
+    }
+
+void export_LoadBalancerPolydisperse(py::module& m)
+    {
+    py::class_<LoadBalancerPolydisperse, std::shared_ptr<LoadBalancerPolydisperse> >(m, "LoadBalancerPolydisperse", py::base<Updater>())
+        .def(py::init< std::shared_ptr<SystemDefinition>, std::shared_ptr<NeighborList> >())
+        .def("addForce", &LoadBalancerPolydisperse::addForce)
+        .def("setTolerance", &LoadBalancerPolydisperse::setTolerance)
+        .def("setMaxShift", &LoadBalancerPolydisperse::setMaxShift)
+        .def("enableDimension", &LoadBalancerPolydisperse::enableDimension)
+        .def("getImbalance", &LoadBalancerPolydisperse::getImbalance)
+        .def("getNumAdjustments", &LoadBalancerPolydisperse::getNumAdjustments)
+        ;
+    }
@@ -0,0 +1,127 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#include "hoomd/Updater.h"
+#include "hoomd/ForceCompute.h"
+#include "hoomd/md/NeighborList.h"
+#include "PolymdPairLoopTime.h"
+
+/*! \file LoadBalancerPolydisperse.h
+    \brief Declares the LoadBalancerPolydisperse class
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+#include <hoomd/extern/pybind/include/pybind11/pybind11.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef __LOADBALANCERPOLYDISPERSE_H__
+#define __LOADBALANCERPOLYDISPERSE_H__
+
+//! Number of bins per domain along every direction of the cost profiles
+const unsigned int POLYMD_BALANCE_BINS = 16;
+
+//! Moves the domain boundaries so that every rank gets the same share of the pair loop cost
+/*! The LoadBalancer of HOOMD gives every rank the same number of particles. In a polydisperse system the cost of a
+    particle grows with its number of neighbors, which is several times larger for the large particles than for the
+    small ones, so after segregation or partial crystallization the ranks holding the large particles take 2-3 times
+    longer per step and the others wait for them.
+
+    LoadBalancerPolydisperse weighs every particle by its neighbor list entries plus POLYMD_PARTICLE_COST, the same cost
+    model that PolymdWorkQueue splits the threads with, from the counts of the last neighbor list build. When forces
+    are added with addForce(), the weights of every rank are scaled so that they sum to the time the pair loops of the
+    forces took on that rank since the last update (see PolymdPairLoopTime). The neighbor counts then only set how the
+    cost is spread inside a domain, while the measured time also covers the differences the counts do not see, such as
+    the cutoff efficiency or slower nodes.
+
+    Along every decomposed direction, the costs are binned into POLYMD_BALANCE_BINS bins per domain and summed over
+    the ranks, which gives the cost profile along that direction. The new boundaries are placed where the cumulative
+    cost crosses equal shares, interpolating linearly inside the bins, so that one update moves the boundaries all the
+    way instead of iterating. A direction is only adjusted when its most expensive slab of domains costs more than the
+    tolerance times the mean. Every boundary moves by at most the max shift times the width of the narrower of its two
+    domains, and no domain gets narrower than the ghost layer unless it already was.
+
+    After the boundaries moved, the local box is recomputed, the particles are migrated and the neighbor list is
+    rebuilt. Without MPI, update() does nothing.
+
+    \ingroup updaters
+*/
+class PYBIND11_EXPORT LoadBalancerPolydisperse : public Updater
+    {
+    public:
+        //! Constructs the balancer
+        LoadBalancerPolydisperse(std::shared_ptr<SystemDefinition> sysdef,
+                                 std::shared_ptr<NeighborList> nlist);
+
+        //! Destructor
+        virtual ~LoadBalancerPolydisperse();
+
+        //! Add a force whose pair loop time weighs the ranks
+        void addForce(std::shared_ptr<ForceCompute> force);
+
+        //! Set the largest cost of a slab of domains over the mean that is left alone
+        void setTolerance(Scalar tolerance)
+            {
+            m_tolerance = tolerance;
+            }
+
+        //! Set the largest shift of a boundary in one update, relative to the width of the narrower domain
+        void setMaxShift(Scalar max_shift);
+
+        //! Enable or disable the balancing along a direction
+        void enableDimension(unsigned int dim, bool enable);
+
+        //! Get the largest cost of a rank over the mean, measured in the last update before moving the boundaries
+        Scalar getImbalance() const
+            {
+            return m_imbalance;
+            }
+
+        //! Get the number of updates that moved the boundaries
+        unsigned int getNumAdjustments() const
+            {
+            return m_n_adjustments;
+            }
+
+        //! Returns a list of log quantities this updater calculates
+        virtual std::vector< std::string > getProvidedLogQuantities();
+
+        //! Calculates the requested log value and returns it
+        virtual Scalar getLogValue(const std::string& quantity, unsigned int timestep);
+
+        //! Move the domain boundaries
+        virtual void update(unsigned int timestep);
+
+    protected:
+        std::shared_ptr<NeighborList> m_nlist;                      //!< Neighbor list with the neighbor counts
+        std::vector< std::shared_ptr<ForceCompute> > m_forces;      //!< Forces whose pair loop time is measured
+        std::vector<unsigned long long> m_last_time;                //!< Pair loop time of every force at the last update
+        Scalar m_tolerance;                                         //!< Largest cost of a slab over the mean left alone
+        Scalar m_max_shift;                                         //!< Largest shift of a boundary in one update
+        bool m_enable[3];                                           //!< True for the directions to balance
+        Scalar m_imbalance;                                         //!< Largest cost of a rank over the mean
+        unsigned int m_n_adjustments;                               //!< Number of updates that moved the boundaries
+
+        //! Compute the cost of every local particle
+        void computeCosts(std::vector<double>& cost);
+
+        //! Place the boundaries along one direction at equal shares of a cost profile
+        bool adjust(const std::vector<double>& profile,
+                    const std::vector<Scalar>& cum_frac,
+                    Scalar width,
+                    Scalar min_width,
+                    std::vector<Scalar>& new_cum_frac);
+    };
+
+//! Exports the LoadBalancerPolydisperse class to python
+void export_LoadBalancerPolydisperse(pybind11::module& m);
+
+#endif // __LOADBALANCERPOLYDISPERSE_H__
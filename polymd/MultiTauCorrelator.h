@@ -0,0 +1,169 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __MULTI_TAU_CORRELATOR_H__
+#define __MULTI_TAU_CORRELATOR_H__
+
+/*! \file MultiTauCorrelator.h
+    \brief Declares the MultiTauCorrelator class
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+#include <stdexcept>
+#include <vector>
+
+//! Multi-tau autocorrelation of a stream of samples
+/*! The correlator keeps a hierarchy of levels. Level 0 holds the last p samples and correlates every new sample with
+    them, giving the lags 0 to p-1. Every m samples of a level are averaged into one sample of the next level, which
+    correlates at the lags p/m*m^k to (p-1)*m^k, k being the level. The levels are added as the stream gets long
+    enough to fill them, so the memory grows with the logarithm of the number of samples, and adding a sample costs
+    O(p) on average.
+
+    Each sample has several channels, e.g. the off-diagonal components of the pressure tensor. The autocorrelations of
+    the channels are averaged, the channels are not cross correlated.
+
+    The lags are counted in samples. The correlation at the long lags is that of the block averages, the usual
+    approximation of the multi-tau scheme, accurate as long as the correlation varies slowly on the scale of a block.
+*/
+class MultiTauCorrelator
+    {
+    public:
+        //! Construct an empty correlator
+        /*! \param n_channels Number of channels of every sample
+            \param p Number of lags of each level, a multiple of \a m
+            \param m Number of samples of a level averaged into one sample of the next level
+            \param max_levels Largest number of levels, later samples are not passed beyond the last level
+        */
+        MultiTauCorrelator(unsigned int n_channels, unsigned int p=16, unsigned int m=2, unsigned int max_levels=64)
+            : m_n_channels(n_channels), m_p(p), m_m(m), m_max_levels(max_levels), m_n_samples(0)
+            {
+            if (n_channels == 0 || m < 2 || p < m || p % m != 0 || max_levels == 0)
+                throw std::runtime_error("Invalid multi-tau correlator parameters");
+
+            // the levels must not move, a level passes its accumulator to the next one in place
+            m_levels.reserve(max_levels);
+            }
+
+        //! Add a sample
+        /*! \param values n_channels values
+        */
+        void add(const double *values)
+            {
+            m_n_samples++;
+            add(0, values);
+            }
+
+        //! Forget all samples
+        void reset()
+            {
+            m_levels.clear();
+            m_n_samples = 0;
+            }
+
+        //! Get the number of samples added since the construction or the last reset()
+        unsigned long long getNumSamples() const
+            {
+            return m_n_samples;
+            }
+
+        //! Get the correlation function
+        /*! \param lag Returns the lags with at least one product, in samples, in increasing order
+            \param correlation Returns the correlation at each lag, averaged over the channels
+        */
+        void getCorrelation(std::vector<unsigned long long>& lag, std::vector<double>& correlation) const
+            {
+            lag.clear();
+            correlation.clear();
+            unsigned long long scale = 1;
+            for (unsigned int k = 0; k < m_levels.size(); ++k)
+                {
+                const level& lev = m_levels[k];
+                for (unsigned int j = (k == 0) ? 0 : m_p/m_m; j < m_p; ++j)
+                    {
+                    if (lev.count[j] == 0)
+                        continue;
+                    lag.push_back(scale*j);
+                    correlation.push_back(lev.correlation[j]/(double(lev.count[j])*m_n_channels));
+                    }
+                scale *= m_m;
+                }
+            }
+
+    private:
+        //! One level of the hierarchy
+        struct level
+            {
+            std::vector<double> buffer;                 //!< Last p samples, p*n_channels values, the newest at head
+            unsigned int head;                          //!< Position of the newest sample in the buffer
+            unsigned int n_stored;                      //!< Number of samples in the buffer
+            std::vector<double> accumulator;            //!< Sum of the samples not yet passed to the next level
+            unsigned int n_accumulated;                 //!< Number of samples in the accumulator
+            std::vector<double> correlation;            //!< Sum of the products at every lag
+            std::vector<unsigned long long> count;      //!< Number of products at every lag
+
+            level(unsigned int n_channels, unsigned int p)
+                : buffer(p*n_channels, 0.0), head(0), n_stored(0), accumulator(n_channels, 0.0), n_accumulated(0),
+                  correlation(p, 0.0), count(p, 0)
+                {
+                }
+            };
+
+        unsigned int m_n_channels;          //!< Number of channels of every sample
+        unsigned int m_p;                   //!< Number of lags of each level
+        unsigned int m_m;                   //!< Averaging factor between the levels
+        unsigned int m_max_levels;          //!< Largest number of levels
+        unsigned long long m_n_samples;     //!< Number of samples added
+        std::vector<level> m_levels;        //!< The levels allocated so far
+
+        //! Add a sample to level k
+        void add(unsigned int k, const double *values)
+            {
+            if (k == m_levels.size())
+                {
+                if (k == m_max_levels)
+                    return;
+                m_levels.push_back(level(m_n_channels, m_p));
+                }
+            level& lev = m_levels[k];
+
+            // store the sample as the newest of the buffer
+            lev.head = (lev.head + m_p - 1) % m_p;
+            double *newest = &lev.buffer[lev.head*m_n_channels];
+            for (unsigned int c = 0; c < m_n_channels; ++c)
+                newest[c] = values[c];
+            if (lev.n_stored < m_p)
+                lev.n_stored++;
+
+            // correlate it with the stored ones, the lags below p/m of the higher levels are covered by the lower ones
+            for (unsigned int j = (k == 0) ? 0 : m_p/m_m; j < lev.n_stored; ++j)
+                {
+                const double *old = &lev.buffer[((lev.head + j) % m_p)*m_n_channels];
+                double product = 0.0;
+                for (unsigned int c = 0; c < m_n_channels; ++c)
+                    product += newest[c]*old[c];
+                lev.correlation[j] += product;
+                lev.count[j]++;
+                }
+
+            // pass the average of every m samples on to the next level
+            for (unsigned int c = 0; c < m_n_channels; ++c)
+                lev.accumulator[c] += values[c];
+            if (++lev.n_accumulated == m_m)
+                {
+                for (unsigned int c = 0; c < m_n_channels; ++c)
+                    lev.accumulator[c] /= m_m;
+                add(k + 1, &lev.accumulator[0]);
+                for (unsigned int c = 0; c < m_n_channels; ++c)
+                    lev.accumulator[c] = 0.0;
+                lev.n_accumulated = 0;
+                }
+            }
+    };
+
+#endif // __MULTI_TAU_CORRELATOR_H__
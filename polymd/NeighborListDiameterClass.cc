@@ -0,0 +1,673 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+/*! \file NeighborListDiameterClass.cc
+    \brief Defines NeighborListDiameterClass
+*/
+
+#include "NeighborListDiameterClass.h"
+
+#include <limits>
+
+namespace py = pybind11;
+
+using namespace std;
+
+/*! \param sysdef System definition
+    \param r_cut Default cutoff radius
+    \param r_buff Neighbor list buffer width
+    \param cl Cell list to bin the particles with
+*/
+NeighborListDiameterClass::NeighborListDiameterClass(std::shared_ptr<SystemDefinition> sysdef,
+                                                     Scalar r_cut,
+                                                     Scalar r_buff,
+                                                     std::shared_ptr<CellList> cl)
+    : NeighborList(sysdef, r_cut, r_buff), m_cl(cl), m_n_classes(8), m_class_lo(Scalar(0.0)),
+      m_class_width(Scalar(1.0)), m_mean_stencil_size(Scalar(0.0)), m_buffer_used(Scalar(0.0))
+    {
+    m_exec_conf->msg->notice(5) << "Constructing NeighborListDiameterClass" << endl;
+
+    // create a default cell list if one was not specified
+    if (!m_cl)
+        m_cl = std::shared_ptr<CellList>(new CellList(sysdef));
+
+    // the stencils replace the 27 cell neighborhood, so the adjacency list is not needed beyond the minimum
+    m_cl->setRadius(1);
+    m_cl->setComputeTDB(false);
+    m_cl->setFlagIndex();
+
+    m_poly_params.resize(m_typpair_idx.getNumElements(), make_scalar2(0.0, 0.0));
+    m_plain_rcut.resize(m_typpair_idx.getNumElements(), Scalar(0.0));
+    }
+
+NeighborListDiameterClass::~NeighborListDiameterClass()
+    {
+    m_exec_conf->msg->notice(5) << "Destroying NeighborListDiameterClass" << endl;
+#ifdef ENABLE_MPI
+    if (m_comm)
+        m_comm->getGhostLayerWidthRequestSignal().disconnect<NeighborListDiameterClass,
+            &NeighborListDiameterClass::getPolydisperseGhostLayerWidth>(this);
+#endif
+    }
+
+/*! \param n_classes Number of diameter classes, at least 1
+*/
+void NeighborListDiameterClass::setNumClasses(unsigned int n_classes)
+    {
+    if (n_classes == 0)
+        {
+        m_exec_conf->msg->error() << "nlist.diameter_class: the number of classes must be positive" << endl;
+        throw runtime_error("Error setting the number of diameter classes");
+        }
+    m_n_classes = n_classes;
+    forceUpdate();
+    }
+
+/*! \param typ1 First type of the pair
+    \param typ2 Second type of the pair
+    \param scaledr_cut Cutoff radius in units of sigma_ij, 0 to use r_cut instead
+    \param eps Non-additivity of sigma_ij
+*/
+void NeighborListDiameterClass::setPolydisperseParams(unsigned int typ1, unsigned int typ2, Scalar scaledr_cut, Scalar eps)
+    {
+    if (typ1 >= m_pdata->getNTypes() || typ2 >= m_pdata->getNTypes())
+        {
+        m_exec_conf->msg->error() << "nlist.diameter_class: Trying to set params for a non existent type! "
+                                  << typ1 << "," << typ2 << endl;
+        throw runtime_error("Error setting parameters in NeighborListDiameterClass");
+        }
+
+    if (m_poly_params.size() != m_typpair_idx.getNumElements())
+        m_poly_params.assign(m_typpair_idx.getNumElements(), make_scalar2(0.0, 0.0));
+    if (m_plain_rcut.size() != m_typpair_idx.getNumElements())
+        m_plain_rcut.assign(m_typpair_idx.getNumElements(), Scalar(0.0));
+
+    m_poly_params[m_typpair_idx(typ1, typ2)] = make_scalar2(scaledr_cut, eps);
+    m_poly_params[m_typpair_idx(typ2, typ1)] = make_scalar2(scaledr_cut, eps);
+    forceUpdate();
+    }
+
+/*! \param typ1 First type of the pair
+    \param typ2 Second type of the pair
+    \param r_cut Largest cutoff of the forces on this list that have no polydisperse range, 0 if there are none
+
+    Only used for type pairs with polydisperse parameters, the others search out to r_cut + r_buff anyway.
+*/
+void NeighborListDiameterClass::setPlainRcut(unsigned int typ1, unsigned int typ2, Scalar r_cut)
+    {
+    if (typ1 >= m_pdata->getNTypes() || typ2 >= m_pdata->getNTypes())
+        {
+        m_exec_conf->msg->error() << "nlist.diameter_class: Trying to set params for a non existent type! "
+                                  << typ1 << "," << typ2 << endl;
+        throw runtime_error("Error setting parameters in NeighborListDiameterClass");
+        }
+
+    if (m_plain_rcut.size() != m_typpair_idx.getNumElements())
+        m_plain_rcut.assign(m_typpair_idx.getNumElements(), Scalar(0.0));
+
+    m_plain_rcut[m_typpair_idx(typ1, typ2)] = r_cut;
+    m_plain_rcut[m_typpair_idx(typ2, typ1)] = r_cut;
+    forceUpdate();
+    }
+
+/*! \param a First class
+    \param b Second class
+    \param eps Non-additivity of sigma_ij
+    \returns An upper bound of sigma_ij for any diameters d_i in class a and d_j in class b
+*/
+Scalar NeighborListDiameterClass::getMaxSigma(unsigned int a, unsigned int b, Scalar eps) const
+    {
+    const Scalar lo_a = m_class_lo + Scalar(a)*m_class_width;
+    const Scalar lo_b = m_class_lo + Scalar(b)*m_class_width;
+    return getMaxSigma(lo_a, lo_a + m_class_width, lo_b, lo_b + m_class_width, eps);
+    }
+
+/*! \param lo_a Smallest diameter of the first range
+    \param hi_a Largest diameter of the first range
+    \param lo_b Smallest diameter of the second range
+    \param hi_b Largest diameter of the second range
+    \param eps Non-additivity of sigma_ij
+    \returns An upper bound of sigma_ij for any diameters d_i in [lo_a, hi_a] and d_j in [lo_b, hi_b]
+*/
+Scalar NeighborListDiameterClass::getMaxSigma(Scalar lo_a, Scalar hi_a, Scalar lo_b, Scalar hi_b, Scalar eps)
+    {
+    // bound both factors of sigma_ij = (d_i + d_j)/2 (1 - eps |d_i - d_j|) separately
+    const Scalar gap = std::max(Scalar(0.0), std::max(lo_b - hi_a, lo_a - hi_b));
+    const Scalar spread = std::max(hi_b - lo_a, hi_a - lo_b);
+    const Scalar nonadditive = (eps >= Scalar(0.0)) ? Scalar(1.0) - eps*gap : Scalar(1.0) - eps*spread;
+    return Scalar(0.5)*(hi_a + hi_b)*std::max(nonadditive, Scalar(0.0));
+    }
+
+void NeighborListDiameterClass::updateClasses()
+    {
+    ArrayHandle<Scalar> h_diameter(m_pdata->getDiameters(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar> h_r_cut(m_r_cut, access_location::host, access_mode::read);
+
+    if (m_poly_params.size() != m_typpair_idx.getNumElements())
+        m_poly_params.assign(m_typpair_idx.getNumElements(), make_scalar2(0.0, 0.0));
+    if (m_plain_rcut.size() != m_typpair_idx.getNumElements())
+        m_plain_rcut.assign(m_typpair_idx.getNumElements(), Scalar(0.0));
+
+    // diameter range of the local and ghost particles
+    const unsigned int n_all = m_pdata->getN() + m_pdata->getNGhosts();
+    Scalar d_min = std::numeric_limits<Scalar>::max();
+    Scalar d_max = Scalar(0.0);
+    for (unsigned int i = 0; i < n_all; ++i)
+        {
+        d_min = std::min(d_min, h_diameter.data[i]);
+        d_max = std::max(d_max, h_diameter.data[i]);
+        }
+    if (n_all == 0)
+        {
+        d_min = Scalar(1.0);
+        d_max = Scalar(1.0);
+        }
+
+    // pad the width slightly so that the largest diameter falls inside the last class
+    m_class_lo = d_min;
+    m_class_width = std::max((d_max - d_min)/Scalar(m_n_classes), Scalar(1e-6)*std::max(d_max, Scalar(1.0)));
+    m_class_width *= Scalar(1.0001);
+
+    // search radius of each (type, class) over all partner types and classes
+    const unsigned int ntypes = m_pdata->getNTypes();
+    m_class_rlist.assign(ntypes*m_n_classes, Scalar(0.0));
+    for (unsigned int ti = 0; ti < ntypes; ++ti)
+        {
+        for (unsigned int a = 0; a < m_n_classes; ++a)
+            {
+            Scalar rlist = Scalar(0.0);
+            for (unsigned int tj = 0; tj < ntypes; ++tj)
+                {
+                const unsigned int typpair = m_typpair_idx(ti, tj);
+                const Scalar r_cut = h_r_cut.data[typpair];
+                if (r_cut <= Scalar(0.0))
+                    continue;
+
+                const Scalar2 poly = m_poly_params[typpair];
+                if (poly.x > Scalar(0.0))
+                    {
+                    for (unsigned int b = 0; b < m_n_classes; ++b)
+                        rlist = std::max(rlist, poly.x*getMaxSigma(a, b, poly.y) + m_r_buff);
+                    if (m_plain_rcut[typpair] > Scalar(0.0))
+                        rlist = std::max(rlist, m_plain_rcut[typpair] + m_r_buff);
+                    }
+                else
+                    {
+                    // same range as NeighborListBinned
+                    Scalar r = r_cut + m_r_buff;
+                    if (m_diameter_shift)
+                        r += Scalar(0.5)*(m_class_lo + Scalar(a+1)*m_class_width + d_max) - Scalar(1.0);
+                    rlist = std::max(rlist, r);
+                    }
+                }
+            m_class_rlist[ti*m_n_classes + a] = rlist;
+            }
+        }
+
+    // cells as wide as the shortest search radius, so that small particles only visit their nearest cells
+    Scalar r_min = std::numeric_limits<Scalar>::max();
+    for (unsigned int s = 0; s < m_class_rlist.size(); ++s)
+        {
+        if (m_class_rlist[s] > Scalar(0.0))
+            r_min = std::min(r_min, m_class_rlist[s]);
+        }
+    if (r_min != std::numeric_limits<Scalar>::max() && r_min != m_cl->getNominalWidth())
+        m_cl->setNominalWidth(r_min);
+    }
+
+void NeighborListDiameterClass::updateStencils()
+    {
+    const BoxDim& box = m_pdata->getBox();
+    const uchar3 periodic = box.getPeriodic();
+    const uint3 dim = m_cl->getDim();
+    const Scalar3 cell_width = m_cl->getCellWidth();
+    const int dims[3] = {int(dim.x), int(dim.y), int(dim.z)};
+    const bool periodics[3] = {bool(periodic.x), bool(periodic.y), bool(periodic.z)};
+    const Scalar widths[3] = {cell_width.x, cell_width.y, cell_width.z};
+
+    const unsigned int n_stencils = m_class_rlist.size();
+    m_stencil.clear();
+    m_stencil_start.assign(n_stencils + 1, 0);
+    unsigned int n_nonempty = 0;
+    for (unsigned int s = 0; s < n_stencils; ++s)
+        {
+        m_stencil_start[s] = m_stencil.size();
+        const Scalar rlist = m_class_rlist[s];
+        if (rlist <= Scalar(0.0))
+            continue;
+        ++n_nonempty;
+
+        // range of cell offsets in each direction, visiting every cell at most once
+        int lo[3], hi[3];
+        for (unsigned int d = 0; d < 3; ++d)
+            {
+            int n = int(ceil(rlist/widths[d]));
+            if (periodics[d] && 2*n + 1 >= dims[d])
+                {
+                lo[d] = -(dims[d]/2);
+                hi[d] = lo[d] + dims[d] - 1;
+                }
+            else
+                {
+                n = std::min(n, dims[d] - 1);
+                lo[d] = -n;
+                hi[d] = n;
+                }
+            }
+
+        // keep the offsets whose cells come within rlist of the home cell
+        const Scalar rlistsq = rlist*rlist;
+        for (int k = lo[2]; k <= hi[2]; ++k)
+            {
+            const Scalar dz = Scalar(std::max(std::abs(k) - 1, 0))*widths[2];
+            for (int j = lo[1]; j <= hi[1]; ++j)
+                {
+                const Scalar dy = Scalar(std::max(std::abs(j) - 1, 0))*widths[1];
+                for (int i = lo[0]; i <= hi[0]; ++i)
+                    {
+                    const Scalar dx = Scalar(std::max(std::abs(i) - 1, 0))*widths[0];
+                    if (dx*dx + dy*dy + dz*dz <= rlistsq)
+                        m_stencil.push_back(make_int3(i, j, k));
+                    }
+                }
+            }
+        }
+    m_stencil_start[n_stencils] = m_stencil.size();
+    m_mean_stencil_size = n_nonempty > 0 ? Scalar(m_stencil.size())/Scalar(n_nonempty) : Scalar(0.0);
+    }
+
+/*! \param timestep Current time step of the simulation
+    \returns True if a particle moved far enough to need a rebuild
+
+    NeighborList::distanceCheck() allows every particle to move by half of the buffer. Part of it may already be taken
+    by the growth of the cutoffs, see setBufferUsed(), so the check is made with the rest.
+*/
+bool NeighborListDiameterClass::distanceCheck(unsigned int timestep)
+    {
+    if (m_buffer_used <= Scalar(0.0))
+        return NeighborList::distanceCheck(timestep);
+
+    const Scalar r_buff = m_r_buff;
+    m_r_buff = std::max(r_buff - m_buffer_used, Scalar(0.0));
+    const bool result = NeighborList::distanceCheck(timestep);
+    m_r_buff = r_buff;
+    return result;
+    }
+
+/*! \param timestep Current time step of the simulation
+*/
+void NeighborListDiameterClass::buildNlist(unsigned int timestep)
+    {
+    // the classes set the cell width, so they go first
+    updateClasses();
+    m_cl->compute(timestep);
+    updateStencils();
+
+    uint3 dim = m_cl->getDim();
+    Scalar3 ghost_width = m_cl->getGhostWidth();
+
+    if (m_prof)
+        m_prof->push(m_exec_conf, "compute");
+
+    // acquire the particle data and box dimension
+    ArrayHandle<Scalar4> h_pos(m_pdata->getPositions(), access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_body(m_pdata->getBodies(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar> h_diameter(m_pdata->getDiameters(), access_location::host, access_mode::read);
+
+    const BoxDim& box = m_pdata->getBox();
+    Scalar3 nearest_plane_distance = box.getNearestPlaneDistance();
+
+    Scalar rmax = Scalar(0.0);
+    for (unsigned int s = 0; s < m_class_rlist.size(); ++s)
+        rmax = std::max(rmax, m_class_rlist[s]);
+
+    if ((box.getPeriodic().x && nearest_plane_distance.x <= rmax * 2.0) ||
+        (box.getPeriodic().y && nearest_plane_distance.y <= rmax * 2.0) ||
+        (m_sysdef->getNDimensions() == 3 && box.getPeriodic().z && nearest_plane_distance.z <= rmax * 2.0))
+        {
+        m_exec_conf->msg->error() << "nlist.diameter_class: Simulation box is too small! Particles would be interacting with themselves." << endl;
+        throw runtime_error("Error updating neighborlist bins");
+        }
+
+    ArrayHandle<Scalar> h_r_cut(m_r_cut, access_location::host, access_mode::read);
+    ArrayHandle<Scalar> h_r_listsq(m_r_listsq, access_location::host, access_mode::read);
+
+    // access the cell list data arrays
+    ArrayHandle<unsigned int> h_cell_size(m_cl->getCellSizeArray(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar4> h_cell_xyzf(m_cl->getXYZFArray(), access_location::host, access_mode::read);
+
+    // access the neighbor list data
+    ArrayHandle<unsigned int> h_head_list(m_head_list, access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_Nmax(m_Nmax, access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_conditions(m_conditions, access_location::host, access_mode::readwrite);
+    ArrayHandle<unsigned int> h_nlist(m_nlist, access_location::host, access_mode::overwrite);
+    ArrayHandle<unsigned int> h_n_neigh(m_n_neigh, access_location::host, access_mode::overwrite);
+
+    // the pair cache follows the allocation of the neighbor list
+    if (m_pair_cache.getNumElements() != m_nlist.getNumElements())
+        {
+        GPUArray<Scalar2> pair_cache(m_nlist.getNumElements(), m_exec_conf);
+        m_pair_cache.swap(pair_cache);
+        }
+    ArrayHandle<Scalar2> h_pair_cache(m_pair_cache, access_location::host, access_mode::overwrite);
+
+    // access indexers
+    Index3D ci = m_cl->getCellIndexer();
+    Index2D cli = m_cl->getCellListIndexer();
+
+    // get periodic flags
+    uchar3 periodic = box.getPeriodic();
+
+    // for each local particle
+    unsigned int nparticles = m_pdata->getN();
+
+    for (int i = 0; i < (int)nparticles; i++)
+        {
+        unsigned int cur_n_neigh = 0;
+
+        const Scalar3 my_pos = make_scalar3(h_pos.data[i].x, h_pos.data[i].y, h_pos.data[i].z);
+        const unsigned int my_type = __scalar_as_int(h_pos.data[i].w);
+        const unsigned int body_i = h_body.data[i];
+        const Scalar diam_i = h_diameter.data[i];
+
+        const unsigned int Nmax_i = h_Nmax.data[my_type];
+        const unsigned int nlist_head_i = h_head_list.data[i];
+
+        // find the bin each particle belongs in
+        Scalar3 f = box.makeFraction(my_pos,ghost_width);
+        int ib = (int)(f.x * dim.x);
+        int jb = (int)(f.y * dim.y);
+        int kb = (int)(f.z * dim.z);
+
+        // need to handle the case where the particle is exactly at the box hi
+        if (ib == (int)dim.x && periodic.x)
+            ib = 0;
+        if (jb == (int)dim.y && periodic.y)
+            jb = 0;
+        if (kb == (int)dim.z && periodic.z)
+            kb = 0;
+
+        // walk the stencil of this particle's type and diameter class
+        const unsigned int stencil = my_type*m_n_classes + getClass(diam_i);
+        for (unsigned int cur_offset = m_stencil_start[stencil]; cur_offset < m_stencil_start[stencil+1]; ++cur_offset)
+            {
+            const int3 offset = m_stencil[cur_offset];
+            int neigh_i = ib + offset.x;
+            int neigh_j = jb + offset.y;
+            int neigh_k = kb + offset.z;
+
+            // wrap through periodic boundaries, skip cells outside of the local domain and its ghost layer
+            if (periodic.x)
+                neigh_i = (neigh_i + (int)dim.x) % (int)dim.x;
+            else if (neigh_i < 0 || neigh_i >= (int)dim.x)
+                continue;
+            if (periodic.y)
+                neigh_j = (neigh_j + (int)dim.y) % (int)dim.y;
+            else if (neigh_j < 0 || neigh_j >= (int)dim.y)
+                continue;
+            if (periodic.z)
+                neigh_k = (neigh_k + (int)dim.z) % (int)dim.z;
+            else if (neigh_k < 0 || neigh_k >= (int)dim.z)
+                continue;
+
+            const unsigned int neigh_cell = ci(neigh_i, neigh_j, neigh_k);
+
+            // check against all the particles in that neighboring bin to see if it is a neighbor
+            unsigned int size = h_cell_size.data[neigh_cell];
+            for (unsigned int cur_p = 0; cur_p < size; cur_p++)
+                {
+                // read in the current neighbor's position
+                const Scalar4& cur_xyzf = h_cell_xyzf.data[cli(cur_p, neigh_cell)];
+                const Scalar3 neigh_pos = make_scalar3(cur_xyzf.x, cur_xyzf.y, cur_xyzf.z);
+                unsigned int cur_neigh = __scalar_as_int(cur_xyzf.w);
+
+                // get the current neighbor type from the position data
+                unsigned int cur_neigh_type = __scalar_as_int(h_pos.data[cur_neigh].w);
+                const unsigned int typpair = m_typpair_idx(my_type,cur_neigh_type);
+                Scalar r_cut = h_r_cut.data[typpair];
+
+                // automatically exclude particles without a distance check when:
+                // (1) they are the same particle, or
+                // (2) the r_cut(i,j) indicates to skip, or
+                // (3) they are in the same body
+                bool excluded = ((i == (int)cur_neigh) || (r_cut <= Scalar(0.0)));
+                if (m_filter_body && body_i != 0xffffffff)
+                    excluded = excluded | (body_i == h_body.data[cur_neigh]);
+                if (excluded)
+                    continue;
+
+                Scalar3 dx = my_pos - neigh_pos;
+                dx = box.minImage(dx);
+                Scalar dr_sq = dot(dx,dx);
+
+                // the true polydisperse range of this pair, or the binned range for type pairs without one
+                const Scalar diam_j = h_diameter.data[cur_neigh];
+                const Scalar2 poly = m_poly_params[typpair];
+                Scalar r_listsq;
+                // a zero cutoff keeps pairs without a polydisperse range out of the cached batches
+                Scalar2 pair_cache = make_scalar2(1.0, 0.0);
+                if (poly.x > Scalar(0.0))
+                    {
+                    const Scalar sigma = Scalar(0.5)*(diam_i + diam_j)*(Scalar(1.0) - poly.y*fabs(diam_i - diam_j));
+                    const Scalar r_list = std::max(poly.x*sigma, m_plain_rcut[typpair]) + m_r_buff;
+                    r_listsq = r_list*r_list;
+
+                    // same rounding as the cutoff test of the evaluators
+                    const Scalar sigmasq = sigma*sigma;
+                    if (sigmasq > Scalar(0.0))
+                        pair_cache = make_scalar2(Scalar(1.0)/sigmasq, (poly.x*poly.x)*sigmasq);
+                    }
+                else
+                    {
+                    r_listsq = h_r_listsq.data[typpair];
+                    if (m_diameter_shift)
+                        {
+                        const Scalar r_list = r_cut + m_r_buff;
+                        const Scalar delta = (diam_i + diam_j) * Scalar(0.5) - Scalar(1.0);
+                        r_listsq += (delta + Scalar(2.0) * r_list) * delta;
+                        }
+                    }
+
+                if (dr_sq <= r_listsq)
+                    {
+                    if (m_storage_mode == full || i < (int)cur_neigh)
+                        {
+                        // local neighbor
+                        if (cur_n_neigh < Nmax_i)
+                            {
+                            h_nlist.data[nlist_head_i + cur_n_neigh] = cur_neigh;
+                            h_pair_cache.data[nlist_head_i + cur_n_neigh] = pair_cache;
+                            }
+                        else
+                            h_conditions.data[my_type] = max(h_conditions.data[my_type], cur_n_neigh+1);
+
+                        ++cur_n_neigh;
+                        }
+                    }
+                }
+            }
+
+        h_n_neigh.data[i] = cur_n_neigh;
+        }
+
+    if (m_prof)
+        m_prof->pop(m_exec_conf);
+    }
+
+#ifdef ENABLE_MPI
+/*! \param comm MPI communication class
+
+    NeighborList connects its own ghost layer width request to the communicator, which uses the largest request of all
+    slots. Replace it with getPolydisperseGhostLayerWidth(), so that the width can shrink below the one of NeighborList.
+*/
+void NeighborListDiameterClass::setCommunicator(std::shared_ptr<Communicator> comm)
+    {
+    const bool connect = !m_comm;
+    NeighborList::setCommunicator(comm);
+    if (connect)
+        {
+        comm->getGhostLayerWidthRequestSignal().disconnect<NeighborList, &NeighborList::askGhostLayerWidth>(this);
+        comm->getGhostLayerWidthRequestSignal().connect<NeighborListDiameterClass,
+            &NeighborListDiameterClass::getPolydisperseGhostLayerWidth>(this);
+        }
+    }
+
+/*! \param type Type of the ghost particles
+    \returns The distance from the domain boundary within which particles of \a type are sent as ghosts
+
+    A particle j is needed as a ghost when a local particle i can come within scaledr_cut * sigma_ij + r_buff of it,
+    so the width is the largest of these distances over the partner types, with sigma_ij bounded over the diameters of
+    both types near the boundaries. The communicator asks for all types in order whenever it exchanges the ghosts, on
+    all ranks at once, so the diameter ranges are reduced over the ranks when it asks for the first type.
+*/
+Scalar NeighborListDiameterClass::getPolydisperseGhostLayerWidth(unsigned int type)
+    {
+    const unsigned int ntypes = m_pdata->getNTypes();
+    if (type == 0 || m_boundary_diameters.size() != 2*ntypes)
+        updateBoundaryDiameters();
+
+    ArrayHandle<Scalar> h_r_cut(m_r_cut, access_location::host, access_mode::read);
+    const Scalar hi_a = m_boundary_diameters[type];
+    const Scalar lo_a = -m_boundary_diameters[ntypes+type];
+
+    Scalar width = Scalar(0.0);
+    for (unsigned int b = 0; b < ntypes; ++b)
+        {
+        const unsigned int typpair = m_typpair_idx(type, b);
+        if (h_r_cut.data[typpair] <= Scalar(0.0))
+            continue;
+
+        // same width as NeighborList for type pairs without polydisperse parameters
+        const Scalar2 poly = m_poly_params.size() == m_typpair_idx.getNumElements() ? m_poly_params[typpair]
+                                                                                     : make_scalar2(0.0, 0.0);
+        if (poly.x <= Scalar(0.0))
+            {
+            width = std::max(width, askGhostLayerWidth(type));
+            continue;
+            }
+
+        // other forces on the pair do not depend on the diameters
+        const Scalar plain_rcut = m_plain_rcut.size() == m_typpair_idx.getNumElements() ? m_plain_rcut[typpair]
+                                                                                         : Scalar(0.0);
+        if (plain_rcut > Scalar(0.0))
+            width = std::max(width, plain_rcut + m_r_buff);
+
+        // no particles of one of the types near a boundary, so no pairs across it
+        const Scalar hi_b = m_boundary_diameters[b];
+        const Scalar lo_b = -m_boundary_diameters[ntypes+b];
+        if (hi_a < lo_a || hi_b < lo_b)
+            continue;
+
+        width = std::max(width, poly.x*getMaxSigma(lo_a, hi_a, lo_b, hi_b, poly.y) + m_r_buff);
+        }
+
+    if (m_ghost_width.size() != ntypes)
+        m_ghost_width.assign(ntypes, Scalar(0.0));
+    if (width != m_ghost_width[type])
+        m_exec_conf->msg->notice(7) << "nlist.diameter_class: ghost layer width of type " << type << " is " << width
+                                    << ", NeighborList would request " << askGhostLayerWidth(type) << endl;
+    m_ghost_width[type] = width;
+    return width;
+    }
+
+/*! A pair that interacts across a domain boundary has both particles within its search radius of the boundary, and
+    both stay there until the next ghost exchange, since the neighbor list rebuilds and the particles migrate before
+    any of them moves by more than r_buff/2. The width only needs the diameters of these particles, which are found in
+    two passes: the diameter range of every type over all particles bounds the search radius of the type, and the
+    diameter range of the particles within that radius of a face of their domain bounds the width. Both are reduced
+    over all ranks. Faces along directions that are not decomposed are left out, the communicator does not exchange
+    ghosts across them.
+*/
+void NeighborListDiameterClass::updateBoundaryDiameters()
+    {
+    const unsigned int N = m_pdata->getN();
+    const unsigned int ntypes = m_pdata->getNTypes();
+
+    ArrayHandle<Scalar4> h_pos(m_pdata->getPositions(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar> h_diameter(m_pdata->getDiameters(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar> h_r_cut(m_r_cut, access_location::host, access_mode::read);
+
+    if (m_poly_params.size() != m_typpair_idx.getNumElements())
+        m_poly_params.assign(m_typpair_idx.getNumElements(), make_scalar2(0.0, 0.0));
+    if (m_plain_rcut.size() != m_typpair_idx.getNumElements())
+        m_plain_rcut.assign(m_typpair_idx.getNumElements(), Scalar(0.0));
+
+    // per type: largest diameter, then minus the smallest diameter
+    std::vector<Scalar> range(2*ntypes, -std::numeric_limits<Scalar>::max());
+    for (unsigned int i = 0; i < N; ++i)
+        {
+        const unsigned int t = __scalar_as_int(h_pos.data[i].w);
+        range[t] = std::max(range[t], h_diameter.data[i]);
+        range[ntypes+t] = std::max(range[ntypes+t], -h_diameter.data[i]);
+        }
+    MPI_Allreduce(MPI_IN_PLACE, range.data(), (int)range.size(), MPI_HOOMD_SCALAR, MPI_MAX,
+                  m_exec_conf->getMPICommunicator());
+
+    // search radius of every type over all its partners, infinite when a type pair falls back to NeighborList
+    std::vector<Scalar> r_search(ntypes, Scalar(0.0));
+    for (unsigned int a = 0; a < ntypes; ++a)
+        {
+        for (unsigned int b = 0; b < ntypes; ++b)
+            {
+            const unsigned int typpair = m_typpair_idx(a, b);
+            if (h_r_cut.data[typpair] <= Scalar(0.0))
+                continue;
+            const Scalar2 poly = m_poly_params[typpair];
+            if (poly.x <= Scalar(0.0))
+                r_search[a] = std::numeric_limits<Scalar>::max();
+            else if (range[a] >= -range[ntypes+a] && range[b] >= -range[ntypes+b])
+                r_search[a] = std::max(r_search[a], poly.x*getMaxSigma(-range[ntypes+a], range[a], -range[ntypes+b],
+                                                                       range[b], poly.y) + m_r_buff);
+            if (poly.x > Scalar(0.0) && m_plain_rcut[typpair] > Scalar(0.0))
+                r_search[a] = std::max(r_search[a], m_plain_rcut[typpair] + m_r_buff);
+            }
+        }
+
+    // diameter ranges of the particles within their search radius of a face of the local domain, only along the
+    // directions with more than one domain, the others do not exchange ghosts
+    const BoxDim& box = m_pdata->getBox();
+    const Scalar3 npd = box.getNearestPlaneDistance();
+    const Index3D& di = m_pdata->getDomainDecomposition()->getDomainIndexer();
+    const Scalar far = std::numeric_limits<Scalar>::max();
+    const bool comm_x = di.getW() > 1;
+    const bool comm_y = di.getH() > 1;
+    const bool comm_z = di.getD() > 1 && m_sysdef->getNDimensions() == 3;
+    m_boundary_diameters.assign(2*ntypes, -std::numeric_limits<Scalar>::max());
+    for (unsigned int i = 0; i < N; ++i)
+        {
+        const Scalar4 postype = h_pos.data[i];
+        const unsigned int t = __scalar_as_int(postype.w);
+        const Scalar3 f = box.makeFraction(make_scalar3(postype.x, postype.y, postype.z));
+        Scalar dist = comm_x ? std::min(f.x, Scalar(1.0) - f.x)*npd.x : far;
+        if (comm_y)
+            dist = std::min(dist, std::min(f.y, Scalar(1.0) - f.y)*npd.y);
+        if (comm_z)
+            dist = std::min(dist, std::min(f.z, Scalar(1.0) - f.z)*npd.z);
+        if (dist < r_search[t])
+            {
+            m_boundary_diameters[t] = std::max(m_boundary_diameters[t], h_diameter.data[i]);
+            m_boundary_diameters[ntypes+t] = std::max(m_boundary_diameters[ntypes+t], -h_diameter.data[i]);
+            }
+        }
+    MPI_Allreduce(MPI_IN_PLACE, m_boundary_diameters.data(), (int)m_boundary_diameters.size(), MPI_HOOMD_SCALAR,
+                  MPI_MAX, m_exec_conf->getMPICommunicator());
+    }
+#endif
+
+void export_NeighborListDiameterClass(py::module& m)
+    {
+    py::class_<NeighborListDiameterClass, std::shared_ptr<NeighborListDiameterClass> >(m, "NeighborListDiameterClass", py::base<NeighborList>())
+        .def(py::init< std::shared_ptr<SystemDefinition>, Scalar, Scalar, std::shared_ptr<CellList> >())
+        .def("setNumClasses", &NeighborListDiameterClass::setNumClasses)
+        .def("getNumClasses", &NeighborListDiameterClass::getNumClasses)
+        .def("setPolydisperseParams", &NeighborListDiameterClass::setPolydisperseParams)
+        .def("setPlainRcut", &NeighborListDiameterClass::setPlainRcut)
+        .def("getMeanStencilSize", &NeighborListDiameterClass::getMeanStencilSize)
+        .def("getGhostLayerWidths", &NeighborListDiameterClass::getGhostLayerWidths)
+        .def("setBufferUsed", &NeighborListDiameterClass::setBufferUsed)
+        .def("getBufferUsed", &NeighborListDiameterClass::getBufferUsed)
+        ;
+    }
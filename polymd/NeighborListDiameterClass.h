@@ -0,0 +1,195 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#include "hoomd/md/NeighborList.h"
+#include "hoomd/CellList.h"
+
+/*! \file NeighborListDiameterClass.h
+    \brief Declares the NeighborListDiameterClass class
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+#include <hoomd/extern/pybind/include/pybind11/pybind11.h>
+#include <hoomd/extern/pybind/include/pybind11/stl.h>
+
+#include <vector>
+
+#ifndef __NEIGHBORLISTDIAMETERCLASS_H__
+#define __NEIGHBORLISTDIAMETERCLASS_H__
+
+//! Neighbor list build on the CPU that searches out to the true polydisperse cutoff
+/*! The polydisperse potentials interact out to scaledr_cut * sigma_ij, with sigma_ij the non-additive pair diameter.
+    With the standard cell list, every particle searches out to r_cut + d_max - 1 and most entries are rejected again in
+    the force loop. NeighborListDiameterClass instead
+
+    - sorts the particles into a configurable number of diameter classes, which act as virtual types,
+    - computes a per class pair search radius scaledr_cut * max(sigma_ij) + r_buff over the diameters in both classes,
+    - walks a per (type, class) stencil of cells that only covers the search radius of that class, and
+    - keeps a neighbor only when r < scaledr_cut * sigma_ij + r_buff for the actual diameters of the pair.
+
+    The list size, build cost and force loop length then scale with the true interaction range. The reduced cutoff and
+    the non-additivity eps of each type pair are set with setPolydisperseParams(). Type pairs without them fall back to
+    the behavior of NeighborListBinned (r_cut + r_buff, shifted by the diameters when diameter shifting is on). Other
+    forces that share the list on a type pair with polydisperse parameters set their cutoff with setPlainRcut(), and
+    the pair is then kept out to the larger of both ranges.
+
+    Classes are equal width in diameter between the smallest and largest diameter of the local and ghost particles, and
+    are recomputed at every build.
+
+    With MPI, the neighbor list replaces the ghost layer width it requests from the communicator. NeighborList asks for
+    r_cut + r_buff + d_max - 1 for every type, set by the single largest diameter. getPolydisperseGhostLayerWidth()
+    instead asks for scaledr_cut * sigma_ij + r_buff, with sigma_ij bounded over the diameters of the particles that are
+    close enough to a domain boundary to interact across it, see updateBoundaryDiameters(). Type pairs without
+    polydisperse parameters keep the width of NeighborList.
+
+    Next to every neighbor index, the build also stores the pair cache entry (1/sigma_ij^2, (scaledr_cut sigma_ij)^2)
+    of type pairs with polydisperse parameters. The diameters only change together with a rebuild (see forceUpdate()),
+    so PotentialPairPolymd reads these values from the same stream as the indices instead of gathering both diameters
+    and recomputing sigma_ij for every pair. Entries of type pairs without polydisperse parameters are zero. The cache
+    is not available when exclusions are set, since filtering the exclusions compacts the list after the build.
+
+    UpdaterInflate grows the diameters in the pair loop of the polymd forces without changing the particle data (see
+    PolymdDiameterScale), which moves the cutoffs out into the buffer. setBufferUsed() tells the neighbor list how far,
+    and the distance check then only allows the displacements that the rest of the buffer covers. The builds, the
+    stencils and the ghost layer keep working from the diameters of the particle data.
+
+    \ingroup computes
+*/
+class PYBIND11_EXPORT NeighborListDiameterClass : public NeighborList
+    {
+    public:
+        //! Constructs the compute
+        NeighborListDiameterClass(std::shared_ptr<SystemDefinition> sysdef,
+                                  Scalar r_cut,
+                                  Scalar r_buff,
+                                  std::shared_ptr<CellList> cl);
+
+        //! Destructor
+        virtual ~NeighborListDiameterClass();
+
+        //! Set the number of diameter classes
+        void setNumClasses(unsigned int n_classes);
+
+        //! Get the number of diameter classes
+        unsigned int getNumClasses() const
+            {
+            return m_n_classes;
+            }
+
+        //! Set the reduced cutoff and non-additivity of a type pair
+        void setPolydisperseParams(unsigned int typ1, unsigned int typ2, Scalar scaledr_cut, Scalar eps);
+
+        //! Set the cutoff of the forces without a polydisperse range on a type pair
+        void setPlainRcut(unsigned int typ1, unsigned int typ2, Scalar r_cut);
+
+        //! Get the reduced cutoff and non-additivity of a type pair, scaledr_cut = 0 if unset
+        Scalar2 getPolydisperseParams(unsigned int typ1, unsigned int typ2) const
+            {
+            if (m_poly_params.size() != m_typpair_idx.getNumElements())
+                return make_scalar2(0.0, 0.0);
+            return m_poly_params[m_typpair_idx(typ1, typ2)];
+            }
+
+        //! Check whether the pair cache matches the current neighbor list
+        bool hasPairCache() const
+            {
+            return !m_exclusions_set && m_pair_cache.getNumElements() == m_nlist.getNumElements();
+            }
+
+        //! Get the pair cache, (1/sigma_ij^2, cutoff^2) at the same index as every neighbor
+        const GPUArray<Scalar2>& getPairCacheArray() const
+            {
+            return m_pair_cache;
+            }
+
+        //! Get the mean number of cells in the stencils of the last build
+        Scalar getMeanStencilSize() const
+            {
+            return m_mean_stencil_size;
+            }
+
+        //! Set the part of the buffer taken by the growth of the cutoffs since the diameters were last written
+        void setBufferUsed(Scalar buffer_used)
+            {
+            m_buffer_used = buffer_used;
+            }
+
+        //! Get the part of the buffer taken by the growth of the cutoffs
+        Scalar getBufferUsed() const
+            {
+            return m_buffer_used;
+            }
+
+        //! Get the ghost layer width of every type requested at the last ghost exchange, empty without MPI
+        std::vector<Scalar> getGhostLayerWidths() const
+            {
+            return m_ghost_width;
+            }
+
+#ifdef ENABLE_MPI
+        //! Set the communicator to use
+        virtual void setCommunicator(std::shared_ptr<Communicator> comm);
+
+        //! Get the ghost layer width of a type from the diameters near the domain boundaries
+        Scalar getPolydisperseGhostLayerWidth(unsigned int type);
+#endif
+
+    protected:
+        std::shared_ptr<CellList> m_cl;         //!< The cell list
+        unsigned int m_n_classes;               //!< Number of diameter classes
+        std::vector<Scalar2> m_poly_params;     //!< (scaledr_cut, eps) per type pair, scaledr_cut = 0 if unset
+        std::vector<Scalar> m_plain_rcut;       //!< Cutoff of the forces without a polydisperse range per type pair
+
+        Scalar m_class_lo;                      //!< Lower diameter edge of the first class
+        Scalar m_class_width;                   //!< Diameter width of a class
+        std::vector<Scalar> m_class_rlist;      //!< Search radius per (type, class)
+        std::vector<int3> m_stencil;            //!< Cell offsets of all stencils
+        std::vector<unsigned int> m_stencil_start; //!< First entry in m_stencil per (type, class), plus one end entry
+        Scalar m_mean_stencil_size;             //!< Mean number of cells per stencil
+        GPUArray<Scalar2> m_pair_cache;         //!< (1/sigma_ij^2, cutoff^2) of every neighbor
+        std::vector<Scalar> m_boundary_diameters; //!< Largest and minus the smallest diameter per type near a boundary
+        std::vector<Scalar> m_ghost_width;      //!< Ghost layer width per type requested at the last exchange
+        Scalar m_buffer_used;                   //!< Part of the buffer taken by the growth of the cutoffs
+
+        //! Builds the neighbor list
+        virtual void buildNlist(unsigned int timestep);
+
+        //! Checks the displacements against the part of the buffer that is left
+        virtual bool distanceCheck(unsigned int timestep);
+
+        //! Get the class of a particle with diameter d
+        unsigned int getClass(Scalar d) const
+            {
+            int c = int((d - m_class_lo)/m_class_width);
+            return (unsigned int)std::max(0, std::min(int(m_n_classes) - 1, c));
+            }
+
+        //! Upper bound of sigma_ij for diameters in two classes
+        Scalar getMaxSigma(unsigned int a, unsigned int b, Scalar eps) const;
+
+        //! Upper bound of sigma_ij for diameters in two ranges
+        static Scalar getMaxSigma(Scalar lo_a, Scalar hi_a, Scalar lo_b, Scalar hi_b, Scalar eps);
+
+    private:
+        //! Recompute the diameter classes and search radii from the current diameters
+        void updateClasses();
+
+        //! Recompute the stencils from the search radii and the cell list geometry
+        void updateStencils();
+
+#ifdef ENABLE_MPI
+        //! Recompute the diameter ranges of the particles near the domain boundaries, over all ranks
+        void updateBoundaryDiameters();
+#endif
+    };
+
+//! Exports NeighborListDiameterClass to python
+void export_NeighborListDiameterClass(pybind11::module& m);
+
+#endif // __NEIGHBORLISTDIAMETERCLASS_H__
@@ -5,11 +5,11 @@
     \brief Defines the driver functions for computing all types of pair forces on the GPU
 */
 
-#include "EvaluatorPairPolydisperse18.h"
+#include "EvaluatorPairPolydisperseMNQ.h"
 #include "AllDriverPotentialPairPluginGPU.cuh"
 
 cudaError_t gpu_compute_polydisperse_18temp_forces(const pair_args_t& pair_args,
-                                      const Scalar3 *d_params)
+                                      const polydisperse_params *d_params)
     {
     return gpu_compute_pair_forces<EvaluatorPairPolydisperse18>(pair_args,
                                                     d_params);
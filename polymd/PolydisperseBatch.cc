@@ -0,0 +1,259 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+/*! \file PolydisperseBatch.cc
+    \brief Defines the instruction set specific builds of the polydisperse batch kernels
+*/
+
+#include "PolydisperseBatch.h"
+#include "PolydisperseTable.h"
+
+#include <cstdlib>
+#include <cstring>
+
+// function multiversioning needs the GCC/clang target attribute and the x86 cpu feature checks
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define POLYDISPERSE_BATCH_MULTIVERSION
+#endif
+
+namespace
+{
+//! Instruction sets with a build of the batch kernels
+enum batch_isa
+    {
+    isa_default = 0,
+    isa_avx2,
+    isa_avx512
+    };
+
+//! Baseline build of the batch kernel
+template<class evaluator, class Real, bool energy>
+unsigned int batch_default(const polydisperse_params& params, Scalar di, const Real *rsq, const Real *dj,
+                           unsigned int n_neigh, Real *force_divr, Real *pair_eng)
+    {
+    return evaluator::template evalBatch<Real, energy>(params, di, rsq, dj, n_neigh, force_divr, pair_eng);
+    }
+
+//! Baseline build of the cached batch kernel
+template<class evaluator, class Real, bool energy>
+unsigned int cached_default(const polydisperse_params& params, const Real *rsq,
+                            const typename polydisperse::pair_type<Real>::type *pair_cache, unsigned int n_neigh,
+                            Real *force_divr, Real *pair_eng)
+    {
+    return evaluator::template evalBatchCached<Real, energy>(params, rsq, pair_cache, n_neigh, force_divr, pair_eng);
+    }
+
+//! Baseline build of the energy only batch kernel
+template<class evaluator>
+Scalar energy_default(const polydisperse_params& params, Scalar di, const Scalar *rsq, const Scalar *dj,
+                      unsigned int n_neigh, Scalar *pair_eng)
+    {
+    return evaluator::evalEnergyBatch(params, di, rsq, dj, n_neigh, pair_eng);
+    }
+
+//! Baseline build of the table lookup
+unsigned int table_default(const polydisperse_table& table, const polydisperse_params& params, Scalar di,
+                           const Scalar *rsq, const Scalar *dj, unsigned int n_neigh, Scalar *force_divr,
+                           Scalar *pair_eng, unsigned int *n_below)
+    {
+    return polydisperse_table_lookup(table, params, di, rsq, dj, n_neigh, force_divr, pair_eng, n_below);
+    }
+
+#ifdef POLYDISPERSE_BATCH_MULTIVERSION
+//! AVX2 build of the batch kernel
+template<class evaluator, class Real, bool energy>
+__attribute__((target("avx2,fma")))
+unsigned int batch_avx2(const polydisperse_params& params, Scalar di, const Real *rsq, const Real *dj,
+                        unsigned int n_neigh, Real *force_divr, Real *pair_eng)
+    {
+    return evaluator::template evalBatch<Real, energy>(params, di, rsq, dj, n_neigh, force_divr, pair_eng);
+    }
+
+//! AVX-512 build of the batch kernel
+template<class evaluator, class Real, bool energy>
+__attribute__((target("avx512f,avx2,fma")))
+unsigned int batch_avx512(const polydisperse_params& params, Scalar di, const Real *rsq, const Real *dj,
+                          unsigned int n_neigh, Real *force_divr, Real *pair_eng)
+    {
+    return evaluator::template evalBatch<Real, energy>(params, di, rsq, dj, n_neigh, force_divr, pair_eng);
+    }
+
+//! AVX2 build of the cached batch kernel
+template<class evaluator, class Real, bool energy>
+__attribute__((target("avx2,fma")))
+unsigned int cached_avx2(const polydisperse_params& params, const Real *rsq,
+                         const typename polydisperse::pair_type<Real>::type *pair_cache, unsigned int n_neigh,
+                         Real *force_divr, Real *pair_eng)
+    {
+    return evaluator::template evalBatchCached<Real, energy>(params, rsq, pair_cache, n_neigh, force_divr, pair_eng);
+    }
+
+//! AVX-512 build of the cached batch kernel
+template<class evaluator, class Real, bool energy>
+__attribute__((target("avx512f,avx2,fma")))
+unsigned int cached_avx512(const polydisperse_params& params, const Real *rsq,
+                           const typename polydisperse::pair_type<Real>::type *pair_cache, unsigned int n_neigh,
+                           Real *force_divr, Real *pair_eng)
+    {
+    return evaluator::template evalBatchCached<Real, energy>(params, rsq, pair_cache, n_neigh, force_divr, pair_eng);
+    }
+
+//! AVX2 build of the energy only batch kernel
+template<class evaluator>
+__attribute__((target("avx2,fma")))
+Scalar energy_avx2(const polydisperse_params& params, Scalar di, const Scalar *rsq, const Scalar *dj,
+                   unsigned int n_neigh, Scalar *pair_eng)
+    {
+    return evaluator::evalEnergyBatch(params, di, rsq, dj, n_neigh, pair_eng);
+    }
+
+//! AVX-512 build of the energy only batch kernel
+template<class evaluator>
+__attribute__((target("avx512f,avx2,fma")))
+Scalar energy_avx512(const polydisperse_params& params, Scalar di, const Scalar *rsq, const Scalar *dj,
+                     unsigned int n_neigh, Scalar *pair_eng)
+    {
+    return evaluator::evalEnergyBatch(params, di, rsq, dj, n_neigh, pair_eng);
+    }
+
+//! AVX2 build of the table lookup
+__attribute__((target("avx2,fma")))
+unsigned int table_avx2(const polydisperse_table& table, const polydisperse_params& params, Scalar di,
+                        const Scalar *rsq, const Scalar *dj, unsigned int n_neigh, Scalar *force_divr,
+                        Scalar *pair_eng, unsigned int *n_below)
+    {
+    return polydisperse_table_lookup(table, params, di, rsq, dj, n_neigh, force_divr, pair_eng, n_below);
+    }
+
+//! AVX-512 build of the table lookup
+__attribute__((target("avx512f,avx2,fma")))
+unsigned int table_avx512(const polydisperse_table& table, const polydisperse_params& params, Scalar di,
+                          const Scalar *rsq, const Scalar *dj, unsigned int n_neigh, Scalar *force_divr,
+                          Scalar *pair_eng, unsigned int *n_below)
+    {
+    return polydisperse_table_lookup(table, params, di, rsq, dj, n_neigh, force_divr, pair_eng, n_below);
+    }
+#endif
+
+//! Widest instruction set supported by this CPU, capped by POLYMD_BATCH_ISA
+batch_isa selectISA()
+    {
+    batch_isa isa = isa_default;
+#ifdef POLYDISPERSE_BATCH_MULTIVERSION
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        isa = isa_avx512;
+    else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        isa = isa_avx2;
+#endif
+
+    const char *cap = getenv("POLYMD_BATCH_ISA");
+    if (cap)
+        {
+        if (!strcmp(cap, "default"))
+            isa = isa_default;
+        else if (!strcmp(cap, "avx2") && isa > isa_avx2)
+            isa = isa_avx2;
+        }
+    return isa;
+    }
+
+//! Build of the batch kernel for the selected instruction set
+template<class evaluator, class Real, bool energy>
+typename polydisperse_batch_types<Real>::batch_func selectBatch()
+    {
+    static const batch_isa isa = selectISA();
+#ifdef POLYDISPERSE_BATCH_MULTIVERSION
+    if (isa == isa_avx512)
+        return &batch_avx512<evaluator, Real, energy>;
+    if (isa == isa_avx2)
+        return &batch_avx2<evaluator, Real, energy>;
+#endif
+    return &batch_default<evaluator, Real, energy>;
+    }
+
+//! Build of the cached batch kernel for the selected instruction set
+template<class evaluator, class Real, bool energy>
+typename polydisperse_batch_types<Real>::cached_batch_func selectCached()
+    {
+    static const batch_isa isa = selectISA();
+#ifdef POLYDISPERSE_BATCH_MULTIVERSION
+    if (isa == isa_avx512)
+        return &cached_avx512<evaluator, Real, energy>;
+    if (isa == isa_avx2)
+        return &cached_avx2<evaluator, Real, energy>;
+#endif
+    return &cached_default<evaluator, Real, energy>;
+    }
+} // end anonymous namespace
+
+template<class evaluator>
+polydisperse_batch_func PolydisperseBatch<evaluator>::get(bool energy)
+    {
+    return energy ? selectBatch<evaluator, Scalar, true>() : selectBatch<evaluator, Scalar, false>();
+    }
+
+template<class evaluator>
+polydisperse_mixed_batch_func PolydisperseBatch<evaluator>::getMixed(bool energy)
+    {
+    return energy ? selectBatch<evaluator, float, true>() : selectBatch<evaluator, float, false>();
+    }
+
+template<class evaluator>
+polydisperse_cached_batch_func PolydisperseBatch<evaluator>::getCached(bool energy)
+    {
+    return energy ? selectCached<evaluator, Scalar, true>() : selectCached<evaluator, Scalar, false>();
+    }
+
+template<class evaluator>
+polydisperse_mixed_cached_batch_func PolydisperseBatch<evaluator>::getMixedCached(bool energy)
+    {
+    return energy ? selectCached<evaluator, float, true>() : selectCached<evaluator, float, false>();
+    }
+
+template<class evaluator>
+polydisperse_energy_batch_func PolydisperseBatch<evaluator>::getEnergy()
+    {
+    static const batch_isa isa = selectISA();
+#ifdef POLYDISPERSE_BATCH_MULTIVERSION
+    if (isa == isa_avx512)
+        return &energy_avx512<evaluator>;
+    if (isa == isa_avx2)
+        return &energy_avx2<evaluator>;
+#endif
+    return &energy_default<evaluator>;
+    }
+
+polydisperse_table_func getPolydisperseTableLookup()
+    {
+    static const batch_isa isa = selectISA();
+#ifdef POLYDISPERSE_BATCH_MULTIVERSION
+    if (isa == isa_avx512)
+        return &table_avx512;
+    if (isa == isa_avx2)
+        return &table_avx2;
+#endif
+    return &table_default;
+    }
+
+std::string getPolydisperseBatchISA()
+    {
+    switch (selectISA())
+        {
+        case isa_avx512:
+            return std::string("avx512");
+        case isa_avx2:
+            return std::string("avx2");
+        default:
+            return std::string("default");
+        }
+    }
+
+template struct PolydisperseBatch<EvaluatorPairPolydisperse>;
+template struct PolydisperseBatch<EvaluatorPairPolydisperse18>;
+template struct PolydisperseBatch<EvaluatorPairPolydisperse10>;
+template struct PolydisperseBatch<EvaluatorPairPolydisperseLJ>;
+template struct PolydisperseBatch<EvaluatorPairPolydisperseLJ106>;
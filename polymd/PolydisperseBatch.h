@@ -0,0 +1,113 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __POLYDISPERSE_BATCH_H__
+#define __POLYDISPERSE_BATCH_H__
+
+#include "EvaluatorPairPolydisperseMNQ.h"
+
+#include <string>
+
+/*! \file PolydisperseBatch.h
+    \brief Declares the runtime selection of the vectorized batch kernels of the polydisperse evaluators
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+//! Types of the batch kernels with the pair arithmetic and the arrays in Real
+template<class Real>
+struct polydisperse_batch_types
+    {
+    //! Cached (1/sigma_ij^2, cutoff^2) of a pair
+    typedef typename polydisperse::pair_type<Real>::type pair_type;
+
+    //! Batch kernel of one particle against its neighbors, see EvaluatorPairPolydisperseMNQ::evalBatch()
+    typedef unsigned int (*batch_func)(const polydisperse_params& params,
+                                       Scalar di,
+                                       const Real *rsq,
+                                       const Real *dj,
+                                       unsigned int n_neigh,
+                                       Real *force_divr,
+                                       Real *pair_eng);
+
+    //! Batch kernel from cached pair diameters, see EvaluatorPairPolydisperseMNQ::evalBatchCached()
+    typedef unsigned int (*cached_batch_func)(const polydisperse_params& params,
+                                              const Real *rsq,
+                                              const pair_type *pair_cache,
+                                              unsigned int n_neigh,
+                                              Real *force_divr,
+                                              Real *pair_eng);
+    };
+
+//! Batch kernel of one particle against its neighbors, in Scalar
+typedef polydisperse_batch_types<Scalar>::batch_func polydisperse_batch_func;
+
+//! Batch kernel from cached pair diameters, in Scalar
+typedef polydisperse_batch_types<Scalar>::cached_batch_func polydisperse_cached_batch_func;
+
+//! Mixed precision batch kernel, on neighbors gathered in float
+typedef polydisperse_batch_types<float>::batch_func polydisperse_mixed_batch_func;
+
+//! Mixed precision batch kernel from cached pair diameters, on neighbors gathered in float
+typedef polydisperse_batch_types<float>::cached_batch_func polydisperse_mixed_cached_batch_func;
+
+//! Energy only batch kernel, see EvaluatorPairPolydisperseMNQ::evalEnergyBatch()
+typedef Scalar (*polydisperse_energy_batch_func)(const polydisperse_params& params,
+                                                 Scalar di,
+                                                 const Scalar *rsq,
+                                                 const Scalar *dj,
+                                                 unsigned int n_neigh,
+                                                 Scalar *pair_eng);
+
+//! Runtime selection of the batch kernel of a polydisperse evaluator
+/*! PolydisperseBatch.cc compiles EvaluatorPairPolydisperseMNQ::evalBatch() once for the baseline instruction set and
+    once each for AVX2 (with FMA) and AVX-512, which process 4/8 lanes (double) or 8/16 lanes (float) per instruction.
+    get() checks the CPU and returns the widest build it supports. Callers should keep the returned pointer instead of
+    calling get() for every particle.
+
+    getMixed() returns a build of the same kernel that does the pair arithmetic in float, with twice as many lanes
+    per instruction. It takes and returns float arrays: the caller converts the distances and diameters once when it
+    gathers the neighbors and the results once before it accumulates the forces, energies and virials in Scalar.
+    Converting inside the vectorized loop instead would cost as much as the float arithmetic saves. In single
+    precision builds both are the same.
+
+    With energy = false, both return the force only build, which leaves pair_eng untouched.
+
+    getCached() returns the builds of EvaluatorPairPolydisperseMNQ::evalBatchCached(), which read 1/sigma_ij^2 and the
+    cutoff of every pair from the pair cache of NeighborListDiameterClass instead of the diameters, and
+    getMixedCached() their mixed precision builds, on a pair cache gathered in float.
+
+    getEnergy() returns the builds of EvaluatorPairPolydisperseMNQ::evalEnergyBatch(), for energy only queries.
+
+    The environment variable POLYMD_BATCH_ISA (default, avx2 or avx512) caps the selection, e.g. for benchmarking.
+
+    Only the evaluators typedef'd in EvaluatorPairPolydisperseMNQ.h are instantiated.
+*/
+template<class evaluator>
+struct PolydisperseBatch
+    {
+    //! Get the batch kernel for the best instruction set of this CPU
+    static polydisperse_batch_func get(bool energy = true);
+
+    //! Get the mixed precision batch kernel for the best instruction set of this CPU
+    static polydisperse_mixed_batch_func getMixed(bool energy = true);
+
+    //! Get the cached batch kernel for the best instruction set of this CPU
+    static polydisperse_cached_batch_func getCached(bool energy = true);
+
+    //! Get the mixed precision cached batch kernel for the best instruction set of this CPU
+    static polydisperse_mixed_cached_batch_func getMixedCached(bool energy = true);
+
+    //! Get the energy only batch kernel for the best instruction set of this CPU
+    static polydisperse_energy_batch_func getEnergy();
+    };
+
+//! Get the name of the instruction set that PolydisperseBatch::get() selects on this CPU
+std::string getPolydisperseBatchISA();
+
+#endif // __POLYDISPERSE_BATCH_H__
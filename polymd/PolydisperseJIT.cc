@@ -0,0 +1,151 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+/*! \file PolydisperseJIT.cc
+    \brief Defines PolydisperseJIT
+*/
+
+#include "PolydisperseJIT.h"
+#include "EvaluatorPairPolydisperseMNQ.h"
+
+#include <dlfcn.h>
+
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+//! Signature of polymd_jit_signature() in the compiled library
+typedef void (*polydisperse_jit_signature_func)(unsigned int *signature);
+
+/*! \param m Exponent of the repulsive term
+    \param n Exponent of the attractive term, 0 to disable it
+    \param q Order of the smoothing polynomial
+    \returns True if EvaluatorPairPolydisperseMNQ<m, n, q> passes its static assertions
+*/
+bool PolydisperseJIT::isValid(unsigned int m, unsigned int n, unsigned int q)
+    {
+    return q >= 1 && q < POLYDISPERSE_MAX_COEFFS && m > n && m <= 64;
+    }
+
+/*! \param m Exponent of the repulsive term
+    \param n Exponent of the attractive term, 0 to disable it
+    \param q Order of the smoothing polynomial
+    \returns The source of a translation unit that includes EvaluatorPairPolydisperseMNQ.h and exports the batch kernel
+             of the model, in the precision of this build
+*/
+std::string PolydisperseJIT::getSource(unsigned int m, unsigned int n, unsigned int q)
+    {
+    if (!isValid(m, n, q))
+        throw runtime_error("Invalid exponents of the polydisperse model");
+
+    ostringstream s;
+    s << "// polymd batch kernel of the (m, n, q) = (" << m << ", " << n << ", " << q << ") polydisperse model\n";
+#ifdef SINGLE_PRECISION
+    s << "#define SINGLE_PRECISION\n";
+#endif
+    s << "#include \"EvaluatorPairPolydisperseMNQ.h\"\n"
+      << "\n"
+      << "typedef EvaluatorPairPolydisperseMNQ<" << m << ", " << n << ", " << q << "> evaluator;\n"
+      << "\n"
+      << "extern \"C\" unsigned int polymd_jit_batch(const polydisperse_params& params, Scalar di, const Scalar *rsq,\n"
+      << "                                         const Scalar *dj, unsigned int n_neigh, Scalar *force_divr,\n"
+      << "                                         Scalar *pair_eng)\n"
+      << "    {\n"
+      << "    return evaluator::evalBatch<Scalar, true>(params, di, rsq, dj, n_neigh, force_divr, pair_eng);\n"
+      << "    }\n"
+      << "\n"
+      << "extern \"C\" void polymd_jit_signature(unsigned int *signature)\n"
+      << "    {\n"
+      << "    signature[0] = " << m << ";\n"
+      << "    signature[1] = " << n << ";\n"
+      << "    signature[2] = " << q << ";\n"
+      << "    signature[3] = sizeof(Scalar);\n"
+      << "    signature[4] = sizeof(polydisperse_params);\n"
+      << "    }\n";
+    return s.str();
+    }
+
+/*! \param filename Shared library compiled from getSource(m, n, q)
+    \param m Exponent of the repulsive term
+    \param n Exponent of the attractive term
+    \param q Order of the smoothing polynomial
+    \param handle Returns the handle of the library, which is closed when the last copy is destroyed
+    \returns The batch kernel of the library
+*/
+polydisperse_batch_func PolydisperseJIT::load(const std::string& filename,
+                                              unsigned int m,
+                                              unsigned int n,
+                                              unsigned int q,
+                                              std::shared_ptr<void>& handle)
+    {
+    void *library = dlopen(filename.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!library)
+        throw runtime_error("Cannot load " + filename + ": " + dlerror());
+    std::shared_ptr<void> library_handle(library, [](void *h) { dlclose(h); });
+
+    polydisperse_batch_func batch = (polydisperse_batch_func)dlsym(library, "polymd_jit_batch");
+    polydisperse_jit_signature_func signature_func
+        = (polydisperse_jit_signature_func)dlsym(library, "polymd_jit_signature");
+    if (!batch || !signature_func)
+        throw runtime_error(filename + " is not a polymd batch kernel");
+
+    unsigned int signature[5];
+    signature_func(signature);
+    if (signature[0] != m || signature[1] != n || signature[2] != q)
+        throw runtime_error(filename + " is the kernel of another polydisperse model");
+    if (signature[3] != sizeof(Scalar) || signature[4] != sizeof(polydisperse_params))
+        throw runtime_error(filename + " was compiled in another precision");
+
+    handle = library_handle;
+    return batch;
+    }
+
+/*! \param library Library path on the root rank, or an empty string if the compile failed
+    \param exec_conf Execution configuration of the ranks
+    \returns The library path of the root rank on every rank
+
+    Must be called by all ranks. Without MPI, \a library is returned as is.
+*/
+std::string PolydisperseJIT::broadcastLibrary(const std::string& library,
+                                              std::shared_ptr<ExecutionConfiguration> exec_conf)
+    {
+    std::string result = library;
+#ifdef ENABLE_MPI
+    unsigned int size = (unsigned int)result.size();
+    MPI_Bcast(&size, 1, MPI_UNSIGNED, 0, exec_conf->getMPICommunicator());
+    result.resize(size);
+    if (size > 0)
+        MPI_Bcast(&result[0], (int)size, MPI_CHAR, 0, exec_conf->getMPICommunicator());
+#endif
+    return result;
+    }
+
+/*! \param m Exponent of the repulsive term
+    \param n Exponent of the attractive term, 0 to disable it
+    \param q Order of the smoothing polynomial
+    \param v0 Energy scale of the potential
+    \param eps Non-additivity of the pair diameter
+    \param scaledr_cut Cutoff radius in units of sigma_ij
+    \returns Parameters with the smoothing coefficients evaluated for this cutoff
+
+    The coefficients are those of make_polydisperse_params<m, n, q>(), evaluated at runtime.
+*/
+polydisperse_params PolydisperseJIT::makeParams(unsigned int m, unsigned int n, unsigned int q,
+                                                Scalar v0, Scalar eps, Scalar scaledr_cut)
+    {
+    if (!isValid(m, n, q))
+        throw runtime_error("Invalid exponents of the polydisperse model");
+
+    polydisperse_params params = make_polydisperse_base_params(v0, eps, scaledr_cut);
+    for (unsigned int k = 0; k <= q; ++k)
+        {
+        params.c[k] = Scalar(polydisperse::smoothing_coeff(m, q, k))*v0/pow(scaledr_cut, Scalar(m + 2*k));
+        if (n > 0)
+            params.c[k] -= Scalar(polydisperse::smoothing_coeff(n, q, k))*v0/pow(scaledr_cut, Scalar(n + 2*k));
+        }
+    return params;
+    }
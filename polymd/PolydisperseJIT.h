@@ -0,0 +1,65 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __POLYDISPERSE_JIT_H__
+#define __POLYDISPERSE_JIT_H__
+
+#include "EvaluatorPairPolydisperseParams.h"
+#include "PolydisperseBatch.h"
+#include "hoomd/ExecutionConfiguration.h"
+
+#include <memory>
+#include <string>
+
+/*! \file PolydisperseJIT.h
+    \brief Declares the runtime compiled batch kernels of the (m, n, q) polydisperse models
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+//! Batch kernel of an (m, n, q) model compiled at runtime
+/*! The models of EvaluatorPairPolydisperseMNQ.h are instantiated at build time, so a new set of exponents needs a new
+    typedef, exports and a rebuild. For other exponents, polymd/pair.py writes the source of getSource()
+    to a file, compiles it with the system compiler into a shared library (-O3 -march=native by default), and caches
+    the library on disk by a hash of the source, the compiler and the flags. load() then opens the library and returns
+    its batch kernel, the same EvaluatorPairPolydisperseMNQ::evalBatch() as PolydisperseBatch::get() returns for the
+    built in models, compiled for the host CPU.
+
+    The library exports polymd_jit_batch() and polymd_jit_signature(), which reports m, n, q, sizeof(Scalar) and
+    sizeof(polydisperse_params). load() checks them, so a library of another model or another precision is rejected
+    instead of being called with the wrong layout.
+
+    The library stays loaded as long as a copy of the returned handle is alive.
+
+    With MPI, the root rank compiles first and broadcastLibrary() passes its result to the other ranks, so that a
+    failed compile stops every rank instead of leaving the others waiting for the root.
+*/
+struct PolydisperseJIT
+    {
+    //! Check that the exponents can be instantiated
+    static bool isValid(unsigned int m, unsigned int n, unsigned int q);
+
+    //! Get the source of the batch kernel of the (m, n, q) model
+    static std::string getSource(unsigned int m, unsigned int n, unsigned int q);
+
+    //! Load the batch kernel from a library compiled from getSource()
+    static polydisperse_batch_func load(const std::string& filename,
+                                        unsigned int m,
+                                        unsigned int n,
+                                        unsigned int q,
+                                        std::shared_ptr<void>& handle);
+
+    //! Broadcast the library path of the root rank, empty if its compile failed
+    static std::string broadcastLibrary(const std::string& library, std::shared_ptr<ExecutionConfiguration> exec_conf);
+
+    //! Compute the parameters of the (m, n, q) model, as make_polydisperse_params() does for the built in ones
+    static polydisperse_params makeParams(unsigned int m, unsigned int n, unsigned int q,
+                                          Scalar v0, Scalar eps, Scalar scaledr_cut);
+    };
+
+#endif // __POLYDISPERSE_JIT_H__
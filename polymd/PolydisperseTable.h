@@ -0,0 +1,317 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __POLYDISPERSE_TABLE_H__
+#define __POLYDISPERSE_TABLE_H__
+
+#include "PolydisperseBatch.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+/*! \file PolydisperseTable.h
+    \brief Defines the reduced distance spline tables of the polydisperse pair potentials
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+//! Cubic spline table of a polydisperse pair potential in the reduced distance x = (r/sigma_ij)^2
+/*! All models are functions of x alone: the energy is V(x) and the force divided by r is G(x)/sigma_ij^2. One table of
+    V and G over x therefore serves every particle pair of a type pair, whatever the diameters. The table spans
+    [xmin, scaledrcutsq] with \a width equal intervals, each holding the coefficients of a cubic Hermite spline in the
+    local coordinate t in [0, 1]: 4 for V followed by 4 for G. A constant interval at the cutoff pads the end.
+
+    Pairs closer than xmin are rare and evaluated exactly, see evalTableBatch().
+*/
+struct polydisperse_table
+    {
+    Scalar xmin;                //!< Smallest tabulated x
+    Scalar dx_inv;              //!< Inverse interval width in x
+    unsigned int width;         //!< Number of intervals
+    Scalar error;               //!< Largest error found when the table was built, relative to max(|value|, |v0|)
+    std::vector<Scalar> coeff;  //!< 8 spline coefficients per interval, and a padding interval
+
+    //! Default constructor, an empty table
+    polydisperse_table()
+        : xmin(0.0), dx_inv(0.0), width(0), error(0.0)
+        {
+        }
+    };
+
+//! Helpers to build the polydisperse tables
+namespace polydisperse
+{
+//! Evaluate a model at reduced distance x with sigma = 1
+/*! \param params Parameters with the cutoff removed, so that the smooth formula continues past it
+    \param x Squared reduced distance
+    \param energy Output V(x)
+    \param force Output G(x), the force divided by r at sigma = 1
+*/
+template<class evaluator>
+inline void eval_reduced(const polydisperse_params& params, Scalar x, Scalar& energy, Scalar& force)
+    {
+    evaluator eval(x, Scalar(0.0), params);
+    eval.setDiameter(Scalar(1.0), Scalar(1.0));
+    energy = Scalar(0.0);
+    force = Scalar(0.0);
+    eval.evalForceAndEnergy(force, energy, false);
+    }
+
+//! Fill the spline coefficients of a table with a given number of intervals
+template<class evaluator>
+inline void fill_table(polydisperse_table& table, const polydisperse_params& params, Scalar xmin, Scalar xmax,
+                       unsigned int width)
+    {
+    polydisperse_params uncut = params;
+    uncut.scaledrcutsq = std::numeric_limits<Scalar>::max();
+
+    const Scalar dx = (xmax - xmin)/Scalar(width);
+    const Scalar h = std::min(dx, xmin)*Scalar(0.25);
+
+    // values and x derivatives at the nodes, dV/dx = -G/2 exactly and dG/dx by a fourth order central difference
+    std::vector<Scalar> e(width+1), de(width+1), f(width+1), df(width+1);
+    for (unsigned int i = 0; i <= width; ++i)
+        {
+        const Scalar x = xmin + dx*Scalar(i);
+        Scalar e_m2, e_m1, e_p1, e_p2, f_m2, f_m1, f_p1, f_p2;
+        eval_reduced<evaluator>(uncut, x, e[i], f[i]);
+        eval_reduced<evaluator>(uncut, x - Scalar(2.0)*h, e_m2, f_m2);
+        eval_reduced<evaluator>(uncut, x - h, e_m1, f_m1);
+        eval_reduced<evaluator>(uncut, x + h, e_p1, f_p1);
+        eval_reduced<evaluator>(uncut, x + Scalar(2.0)*h, e_p2, f_p2);
+        de[i] = -Scalar(0.5)*f[i];
+        df[i] = (f_m2 - Scalar(8.0)*f_m1 + Scalar(8.0)*f_p1 - f_p2)/(Scalar(12.0)*h);
+        }
+
+    table.xmin = xmin;
+    table.dx_inv = Scalar(1.0)/dx;
+    table.width = width;
+    table.coeff.resize(8*(width+1));
+    for (unsigned int i = 0; i < width; ++i)
+        {
+        Scalar *c = &table.coeff[8*i];
+        // Hermite spline y0 + h s0 t + (3 (y1 - y0) - h (2 s0 + s1)) t^2 + (2 (y0 - y1) + h (s0 + s1)) t^3
+        c[0] = e[i];
+        c[1] = dx*de[i];
+        c[2] = Scalar(3.0)*(e[i+1] - e[i]) - dx*(Scalar(2.0)*de[i] + de[i+1]);
+        c[3] = Scalar(2.0)*(e[i] - e[i+1]) + dx*(de[i] + de[i+1]);
+        c[4] = f[i];
+        c[5] = dx*df[i];
+        c[6] = Scalar(3.0)*(f[i+1] - f[i]) - dx*(Scalar(2.0)*df[i] + df[i+1]);
+        c[7] = Scalar(2.0)*(f[i] - f[i+1]) + dx*(df[i] + df[i+1]);
+        }
+
+    // constant padding interval at the cutoff, so that lookups clamped to the end need no bounds check
+    Scalar *c = &table.coeff[8*width];
+    std::fill(c, c + 8, Scalar(0.0));
+    c[0] = e[width];
+    c[4] = f[width];
+    }
+
+//! Largest error of a table against the exact model, sampled at the quarter points of every interval
+template<class evaluator>
+inline Scalar table_error(const polydisperse_table& table, const polydisperse_params& params)
+    {
+    const Scalar dx = Scalar(1.0)/table.dx_inv;
+    const Scalar floor = std::max(fabs(params.v0), std::numeric_limits<Scalar>::min());
+    Scalar error = Scalar(0.0);
+    for (unsigned int i = 0; i < table.width; ++i)
+        {
+        const Scalar *c = &table.coeff[8*i];
+        for (unsigned int s = 1; s <= 3; ++s)
+            {
+            const Scalar t = Scalar(0.25)*Scalar(s);
+            Scalar e, f;
+            eval_reduced<evaluator>(params, table.xmin + dx*(Scalar(i) + t), e, f);
+            const Scalar e_table = c[0] + t*(c[1] + t*(c[2] + t*c[3]));
+            const Scalar f_table = c[4] + t*(c[5] + t*(c[6] + t*c[7]));
+            error = std::max(error, fabs(e_table - e)/std::max(fabs(e), floor));
+            error = std::max(error, fabs(f_table - f)/std::max(fabs(f), floor));
+            }
+        }
+    return error;
+    }
+} // end namespace polydisperse
+
+//! Build the spline table of a polydisperse evaluator for one type pair
+/*! \param params Parameters of the type pair
+    \param width Initial number of intervals
+    \param r_min Smallest tabulated distance, in units of sigma_ij
+    \param error_bound Tolerated error of the energy and force, relative to max(|value|, |v0|)
+    \param max_width Largest number of intervals to try
+
+    The number of intervals is doubled until the table meets \a error_bound, reaches \a max_width or stops improving,
+    which happens at the rounding error of single precision. The error that was reached is stored in the table, so that
+    the caller can warn when the bound could not be met.
+*/
+template<class evaluator>
+inline polydisperse_table build_polydisperse_table(const polydisperse_params& params,
+                                                   unsigned int width,
+                                                   Scalar r_min,
+                                                   Scalar error_bound,
+                                                   unsigned int max_width = 1u << 16)
+    {
+    const Scalar xmin = r_min*r_min;
+    const Scalar xmax = params.scaledrcutsq;
+    if (width == 0)
+        throw std::runtime_error("A polydisperse table needs at least one interval");
+    if (!(xmin > Scalar(0.0) && xmin < xmax))
+        throw std::runtime_error("The table r_min must be positive and below the reduced cutoff");
+
+    polydisperse_table table;
+    polydisperse::fill_table<evaluator>(table, params, xmin, xmax, width);
+    table.error = polydisperse::table_error<evaluator>(table, params);
+    while (table.error > error_bound && 2*width <= max_width)
+        {
+        // cubic splines gain a factor 16 per doubling until rounding takes over
+        polydisperse_table finer;
+        polydisperse::fill_table<evaluator>(finer, params, xmin, xmax, 2*width);
+        finer.error = polydisperse::table_error<evaluator>(finer, params);
+        if (finer.error > Scalar(0.5)*table.error)
+            break;
+        table.coeff.swap(finer.coeff);
+        table.xmin = finer.xmin;
+        table.dx_inv = finer.dx_inv;
+        table.width = finer.width;
+        table.error = finer.error;
+        width *= 2;
+        }
+    return table;
+    }
+
+//! Look up one particle against a contiguous batch of its neighbors in a spline table
+/*! \param table Table of the type pair
+    \param params Parameters of the type pair, only eps and scaledrcutsq are used
+    \param di Diameter of particle i
+    \param rsq Squared distances to the neighbors
+    \param dj Diameters of the neighbors
+    \param n_neigh Number of neighbors in the batch
+    \param force_divr Output force divided by r for each neighbor
+    \param pair_eng Output pair energy for each neighbor
+    \param n_below Output number of neighbors inside the cutoff but closer than table.xmin
+    \returns Number of neighbors inside the cutoff
+
+    Neighbors closer than table.xmin are looked up at xmin, evalTableBatch() replaces them with the exact values. As in
+    EvaluatorPairPolydisperseMNQ::evalBatch(), the cutoff is applied as an arithmetic mask so that the loop vectorizes,
+    with the spline coefficients gathered per lane. PolydisperseBatch.cc builds it for each instruction set.
+*/
+POLYDISPERSE_FORCEINLINE unsigned int polydisperse_table_lookup(const polydisperse_table& table,
+                                                                const polydisperse_params& params,
+                                                                Scalar di,
+                                                                const Scalar *__restrict__ rsq,
+                                                                const Scalar *__restrict__ dj,
+                                                                unsigned int n_neigh,
+                                                                Scalar *__restrict__ force_divr,
+                                                                Scalar *__restrict__ pair_eng,
+                                                                unsigned int *n_below)
+    {
+    const Scalar eps = params.eps;
+    const Scalar scaledrcutsq = params.scaledrcutsq;
+    const Scalar xmin = table.xmin;
+    const Scalar dx_inv = table.dx_inv;
+    // the padding interval past the cutoff takes t = width
+    const Scalar tmax = Scalar(table.width);
+    const Scalar *__restrict__ coeff = &table.coeff[0];
+    const Scalar sigma_sq_min = std::numeric_limits<Scalar>::min();
+
+    for (unsigned int k = 0; k < n_neigh; ++k)
+        {
+        const Scalar sigma = Scalar(0.5)*(di+dj[k])*(Scalar(1.0)-eps*fabs(di-dj[k]));
+        const Scalar sigma_sq = sigma*sigma;
+
+        // blends as in evalBatch(), a zero sigma_ij is looked up at sigma_ij = 1 and masked
+        const Scalar valid = Scalar(0.5) + copysign(Scalar(0.5), sigma_sq - sigma_sq_min);
+        const Scalar sigmasq = sigma_sq + (Scalar(1.0) - valid);
+        const Scalar mask = valid*(Scalar(0.5) - copysign(Scalar(0.5), rsq[k] - scaledrcutsq*sigmasq));
+
+        // clamp with selects, fmin and fmax do not vectorize without -ffinite-math-only
+        const Scalar sigmasq_inv = Scalar(1.0)/sigmasq;
+        const Scalar t0 = (rsq[k]*sigmasq_inv - xmin)*dx_inv;
+        const Scalar t1 = t0 > Scalar(0.0) ? t0 : Scalar(0.0);
+        const Scalar t = t1 < tmax ? t1 : tmax;
+        const int i = int(t);
+        const Scalar u = t - Scalar(i);
+        // plain indices rather than a pointer per lane, so that the compiler can emit gathers
+        const int c = 8*i;
+
+        const Scalar e = coeff[c] + u*(coeff[c+1] + u*(coeff[c+2] + u*coeff[c+3]));
+        const Scalar f = coeff[c+4] + u*(coeff[c+5] + u*(coeff[c+6] + u*coeff[c+7]));
+        force_divr[k] = mask*f*sigmasq_inv;
+        pair_eng[k] = mask*e;
+        }
+
+    // count in a separate loop, in integers as wide as Scalar so the counts do not halve the vector length
+    typedef polydisperse::count_type<Scalar>::type count_t;
+    count_t n_in = 0;
+    count_t below = 0;
+    for (unsigned int k = 0; k < n_neigh; ++k)
+        {
+        const Scalar sigma = Scalar(0.5)*(di+dj[k])*(Scalar(1.0)-eps*fabs(di-dj[k]));
+        const Scalar sigmasq = sigma*sigma;
+        const count_t in = (rsq[k] < scaledrcutsq*sigmasq) & (sigmasq >= sigma_sq_min);
+        n_in += in;
+        below += in & (rsq[k] < xmin*sigmasq);
+        }
+    *n_below = (unsigned int)below;
+    return (unsigned int)n_in;
+    }
+
+//! Table lookup of one particle against its neighbors, see polydisperse_table_lookup()
+typedef unsigned int (*polydisperse_table_func)(const polydisperse_table& table,
+                                                const polydisperse_params& params,
+                                                Scalar di,
+                                                const Scalar *rsq,
+                                                const Scalar *dj,
+                                                unsigned int n_neigh,
+                                                Scalar *force_divr,
+                                                Scalar *pair_eng,
+                                                unsigned int *n_below);
+
+//! Get the build of polydisperse_table_lookup() for the best instruction set of this CPU
+/*! Defined in PolydisperseBatch.cc, with the same selection as PolydisperseBatch::get().
+*/
+polydisperse_table_func getPolydisperseTableLookup();
+
+//! Evaluate one particle against a batch of neighbors with a spline table, exactly below the tabulated range
+/*! \param lookup Table lookup kernel from getPolydisperseTableLookup()
+
+    See polydisperse_table_lookup() for the other arguments.
+*/
+template<class evaluator>
+inline unsigned int evalTableBatch(polydisperse_table_func lookup,
+                                   const polydisperse_table& table,
+                                   const polydisperse_params& params,
+                                   Scalar di,
+                                   const Scalar *rsq,
+                                   const Scalar *dj,
+                                   unsigned int n_neigh,
+                                   Scalar *force_divr,
+                                   Scalar *pair_eng)
+    {
+    unsigned int n_below = 0;
+    unsigned int n_in = lookup(table, params, di, rsq, dj, n_neigh, force_divr, pair_eng, &n_below);
+    if (n_below == 0)
+        return n_in;
+
+    for (unsigned int k = 0; k < n_neigh; ++k)
+        {
+        const Scalar sigma = Scalar(0.5)*(di+dj[k])*(Scalar(1.0)-params.eps*fabs(di-dj[k]));
+        if (rsq[k] < table.xmin*sigma*sigma)
+            {
+            evaluator eval(rsq[k], Scalar(0.0), params);
+            eval.setDiameter(di, dj[k]);
+            force_divr[k] = Scalar(0.0);
+            pair_eng[k] = Scalar(0.0);
+            eval.evalForceAndEnergy(force_divr[k], pair_eng[k], false);
+            }
+        }
+    return n_in;
+    }
+
+#endif // __POLYDISPERSE_TABLE_H__
@@ -0,0 +1,180 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+/*! \file PolymdAutoRcut.cc
+    \brief Defines the PolymdAutoRcut class
+*/
+
+#include "PolymdAutoRcut.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+/*! \param sysdef System definition
+    \param nlist Neighbor list that gets the derived cutoffs
+    \param name Name of the force in the messages, e.g. pair.polydisperse-12
+*/
+PolymdAutoRcut::PolymdAutoRcut(std::shared_ptr<SystemDefinition> sysdef,
+                               std::shared_ptr<NeighborList> nlist,
+                               const std::string& name)
+    : m_sysdef(sysdef), m_pdata(sysdef->getParticleData()), m_exec_conf(sysdef->getParticleData()->getExecConf()),
+      m_nlist(nlist), m_name(name), m_enabled(false), m_dirty(true), m_d_max(0.0), m_expected_neighbors(0.0)
+    {
+    }
+
+/*! \param params Parameters of each type pair
+    \param typpair_idx Indexer of the type pairs
+    \returns True if the cutoffs changed and were passed to the neighbor list
+
+    The cutoff of the type pair (a, b) must cover scaledr_cut sigma_ij for all diameters of the two types. The neighbor
+    list shifts the cutoff by (d_i + d_j)/2 - 1, and sigma_ij is at most (d_i + d_j)/2 (1 + max(-eps, 0) |d_i - d_j|),
+    so the smallest safe cutoff is
+
+        r_cut = 1 + (scaledr_cut (1 + max(-eps, 0) delta) - 1) m
+
+    with the largest |d_i - d_j| delta of the two types, and the largest (or, if the bracket is negative, the smallest)
+    mean diameter m of a pair. Type pairs with v0 = 0 are left out of the neighbor list.
+
+    The expected number of neighbor list entries per particle (full list) is the number density times the mean volume
+    of the shifted list sphere, evaluated from the first three moments of the diameters of each type.
+
+    With MPI, the diameter ranges and moments are combined over all ranks, so that every rank derives the same cutoffs.
+    Every rank must call it, and all of them see the same dirty flag since it is only set collectively.
+*/
+bool PolymdAutoRcut::update(const polydisperse_params *params, const Index2D& typpair_idx)
+    {
+    if (!m_enabled || !m_dirty)
+        return false;
+    m_dirty = false;
+
+    const unsigned int N = m_pdata->getN();
+    const unsigned int ntypes = m_pdata->getNTypes();
+
+    // per type: largest diameter, minus the smallest diameter, then the count and the sums of d, d^2 and d^3
+    std::vector<Scalar> range(2*ntypes, -std::numeric_limits<Scalar>::max());
+    std::vector<Scalar> moments(4*ntypes, Scalar(0.0));
+        {
+        ArrayHandle<Scalar4> h_pos(m_pdata->getPositions(), access_location::host, access_mode::read);
+        ArrayHandle<Scalar> h_diameter(m_pdata->getDiameters(), access_location::host, access_mode::read);
+        for (unsigned int i = 0; i < N; ++i)
+            {
+            const unsigned int t = __scalar_as_int(h_pos.data[i].w);
+            const Scalar d = h_diameter.data[i];
+            range[t] = std::max(range[t], d);
+            range[ntypes+t] = std::max(range[ntypes+t], -d);
+            moments[4*t] += Scalar(1.0);
+            moments[4*t+1] += d;
+            moments[4*t+2] += d*d;
+            moments[4*t+3] += d*d*d;
+            }
+        }
+
+#ifdef ENABLE_MPI
+    if (m_pdata->getDomainDecomposition())
+        {
+        MPI_Allreduce(MPI_IN_PLACE, range.data(), (int)range.size(), MPI_HOOMD_SCALAR, MPI_MAX,
+                      m_exec_conf->getMPICommunicator());
+        MPI_Allreduce(MPI_IN_PLACE, moments.data(), (int)moments.size(), MPI_HOOMD_SCALAR, MPI_SUM,
+                      m_exec_conf->getMPICommunicator());
+        }
+#endif
+
+    // types without particles get the range of all particles, in case they are used later
+    Scalar d_max = Scalar(0.0);
+    Scalar d_min = std::numeric_limits<Scalar>::max();
+    for (unsigned int t = 0; t < ntypes; ++t)
+        {
+        if (moments[4*t] > Scalar(0.0))
+            {
+            d_max = std::max(d_max, range[t]);
+            d_min = std::min(d_min, -range[ntypes+t]);
+            }
+        }
+    if (d_max == Scalar(0.0))
+        return false;
+
+    std::vector<Scalar> r_cut(typpair_idx.getNumElements(), Scalar(-1.0));
+    for (unsigned int a = 0; a < ntypes; ++a)
+        {
+        for (unsigned int b = a; b < ntypes; ++b)
+            {
+            const polydisperse_params& param = params[typpair_idx(a, b)];
+            if (param.v0 == Scalar(0.0))
+                continue;
+
+            const bool a_set = moments[4*a] > Scalar(0.0);
+            const bool b_set = moments[4*b] > Scalar(0.0);
+            const Scalar max_a = a_set ? range[a] : d_max;
+            const Scalar min_a = a_set ? -range[ntypes+a] : d_min;
+            const Scalar max_b = b_set ? range[b] : d_max;
+            const Scalar min_b = b_set ? -range[ntypes+b] : d_min;
+
+            const Scalar delta = std::max(max_a - min_b, max_b - min_a);
+            const Scalar scale = sqrt(param.scaledrcutsq)*(Scalar(1.0) + std::max(-param.eps, Scalar(0.0))*delta)
+                                 - Scalar(1.0);
+            const Scalar m = scale > Scalar(0.0) ? Scalar(0.5)*(max_a + max_b) : Scalar(0.5)*(min_a + min_b);
+
+            // a cutoff of zero would drop the pair from the neighbor list
+            const Scalar rc = std::max(Scalar(1.0) + scale*m, Scalar(1e-6));
+            r_cut[typpair_idx(a, b)] = rc;
+            r_cut[typpair_idx(b, a)] = rc;
+            }
+        }
+
+    // expected entries per particle, from the moments of (A + d_i/2 + d_j/2)^dim with A = r_cut + r_buff - 1
+    const unsigned int dim = m_sysdef->getNDimensions();
+    const Scalar r_buff = m_nlist->getRBuff();
+    const Scalar volume = m_pdata->getGlobalBox().getVolume(dim == 2);
+    const Scalar prefactor = (dim == 2) ? Scalar(M_PI) : Scalar(4.0*M_PI/3.0);
+    const Scalar factorial[4] = {1.0, 1.0, 2.0, 6.0};
+    Scalar entries = Scalar(0.0);
+    Scalar n_total = Scalar(0.0);
+    for (unsigned int a = 0; a < ntypes; ++a)
+        {
+        n_total += moments[4*a];
+        for (unsigned int b = 0; b < ntypes; ++b)
+            {
+            const Scalar rc = r_cut[typpair_idx(a, b)];
+            if (rc < Scalar(0.0))
+                continue;
+            const Scalar A = rc + r_buff - Scalar(1.0);
+            Scalar sum = Scalar(0.0);
+            for (unsigned int q = 0; q <= dim; ++q)
+                {
+                for (unsigned int r = 0; q + r <= dim; ++r)
+                    {
+                    const unsigned int p = dim - q - r;
+                    sum += factorial[dim]/(factorial[p]*factorial[q]*factorial[r])*pow(A, Scalar(p))
+                           *moments[4*a+q]*pow(Scalar(0.5), Scalar(q))*moments[4*b+r]*pow(Scalar(0.5), Scalar(r));
+                    }
+                }
+            entries += prefactor*sum/volume;
+            }
+        }
+    m_expected_neighbors = n_total > Scalar(0.0) ? entries/n_total : Scalar(0.0);
+
+    // only tell the neighbor list when something changed, every change makes it rebuild
+    if (r_cut == m_r_cut && d_max == m_d_max)
+        return false;
+
+    for (unsigned int a = 0; a < ntypes; ++a)
+        for (unsigned int b = a; b < ntypes; ++b)
+            m_nlist->setRCutPair(a, b, r_cut[typpair_idx(a, b)]);
+    m_nlist->setMaximumDiameter(d_max);
+    m_nlist->setDiameterShift(true);
+
+    Scalar rc_max = Scalar(0.0);
+    for (unsigned int s = 0; s < r_cut.size(); ++s)
+        rc_max = std::max(rc_max, r_cut[s]);
+    m_exec_conf->msg->notice(3) << m_name << ": derived r_cut up to " << rc_max << " and d_max " << d_max
+                                << ", expecting " << m_expected_neighbors << " neighbors per particle" << endl;
+    m_r_cut = r_cut;
+    m_d_max = d_max;
+    return true;
+    }
@@ -0,0 +1,97 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __POLYMD_AUTO_RCUT_H__
+#define __POLYMD_AUTO_RCUT_H__
+
+#include "hoomd/SystemDefinition.h"
+#include "hoomd/md/NeighborList.h"
+#include "EvaluatorPairPolydisperseParams.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/*! \file PolymdAutoRcut.h
+    \brief Declares the PolymdAutoRcut class
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+//! Cutoffs of the neighbor list derived from the diameters of the particles
+/*! The cutoff of every type pair and the maximum diameter of the neighbor list follow from the diameters of the
+    particles and the pair parameters, see update(). They are only derived again when setDirty() marked them out of
+    date, after the parameters or the diameters changed, and the neighbor list is only told when they change. Every
+    change makes it rebuild.
+
+    The expected number of neighbor list entries per particle with the derived cutoffs is kept for the python class,
+    which reports it next to the cutoffs.
+*/
+class PolymdAutoRcut
+    {
+    public:
+        //! Construct with the derived cutoffs disabled
+        PolymdAutoRcut(std::shared_ptr<SystemDefinition> sysdef,
+                       std::shared_ptr<NeighborList> nlist,
+                       const std::string& name);
+
+        //! Derive the cutoffs of the neighbor list from the diameters
+        void setEnabled(bool enable)
+            {
+            m_enabled = enable;
+            m_dirty = true;
+            m_r_cut.clear();
+            }
+
+        //! Check whether the cutoffs are derived from the diameters
+        bool isEnabled() const
+            {
+            return m_enabled;
+            }
+
+        //! Derive the cutoffs again on the next update
+        void setDirty()
+            {
+            m_dirty = true;
+            }
+
+        //! Derive the cutoffs if they are out of date and pass them to the neighbor list
+        bool update(const polydisperse_params *params, const Index2D& typpair_idx);
+
+        //! Get the derived cutoff of every type pair, empty before the first update, -1 for pairs without neighbors
+        const std::vector<Scalar>& getRcut() const
+            {
+            return m_r_cut;
+            }
+
+        //! Get the derived maximum diameter
+        Scalar getDMax() const
+            {
+            return m_d_max;
+            }
+
+        //! Get the expected number of neighbor list entries per particle with the derived cutoffs
+        Scalar getExpectedNeighbors() const
+            {
+            return m_expected_neighbors;
+            }
+
+    private:
+        std::shared_ptr<SystemDefinition> m_sysdef;                //!< System definition
+        std::shared_ptr<ParticleData> m_pdata;                     //!< Diameters of the particles
+        std::shared_ptr<const ExecutionConfiguration> m_exec_conf; //!< Messages and MPI communicator
+        std::shared_ptr<NeighborList> m_nlist;                     //!< Neighbor list that gets the cutoffs
+        std::string m_name;                                        //!< Name of the force in the messages
+        bool m_enabled;                                            //!< True if the cutoffs follow the diameters
+        bool m_dirty;                                              //!< True if the derived cutoffs are out of date
+        std::vector<Scalar> m_r_cut;                               //!< Derived cutoff of every type pair
+        Scalar m_d_max;                                            //!< Derived maximum diameter
+        Scalar m_expected_neighbors;                               //!< Expected neighbor list entries per particle
+    };
+
+#endif // __POLYMD_AUTO_RCUT_H__
@@ -0,0 +1,64 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __POLYMD_DIAMETER_SCALE_H__
+#define __POLYMD_DIAMETER_SCALE_H__
+
+#include "hoomd/HOOMDMath.h"
+
+/*! \file PolymdDiameterScale.h
+    \brief Declares the PolymdDiameterScale interface
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+#include <cmath>
+
+//! Bound of the change of the cutoff of a pair when all diameters are scaled
+/*! \param scaledrcutsq Square of the cutoff radius in units of sigma_ij
+    \param eps Non-additivity of the pair diameter
+    \param scale Factor applied to all diameters
+    \param d_min Smallest diameter
+    \param d_max Largest diameter
+    \returns An upper bound of |r_c(s d_i, s d_j) - r_c(d_i, d_j)| for any d_i, d_j in [d_min, d_max]
+
+    With sigma_ij = (d_i + d_j)/2 (1 - eps |d_i - d_j|), the change is
+    scaledr_cut (d_i + d_j)/2 (s - 1) (1 - eps |d_i - d_j| (s + 1)), and every factor is bounded separately.
+*/
+inline Scalar polymd_cutoff_change(Scalar scaledrcutsq, Scalar eps, Scalar scale, Scalar d_min, Scalar d_max)
+    {
+    return sqrt(scaledrcutsq)*d_max*fabs(scale - Scalar(1.0))
+           *(Scalar(1.0) + fabs(eps)*(d_max - d_min)*(scale + Scalar(1.0)));
+    }
+
+//! Interface of the force computes that scale all diameters in their pair loop
+/*! Every polydisperse potential only depends on r/sigma_ij, so a uniform growth of all diameters does not need to
+    touch the particle data: the polymd force computes multiply d_i and d_j by one factor where they gather them.
+    UpdaterInflate sets the factor and only writes it into the diameters when the growth of the cutoffs uses up the
+    neighbor list buffer. Other forces and analyzers see the diameters of the particle data.
+*/
+class PolymdDiameterScale
+    {
+    public:
+        //! Destructor
+        virtual ~PolymdDiameterScale() { }
+
+        //! Set the factor applied to all diameters in the pair loop
+        virtual void setDiameterScale(Scalar scale) = 0;
+
+        //! Get the factor applied to all diameters in the pair loop
+        virtual Scalar getDiameterScale() const = 0;
+
+        //! Get the largest change of the cutoff of any pair when the diameters in [d_min, d_max] are scaled
+        virtual Scalar getCutoffChange(Scalar scale, Scalar d_min, Scalar d_max) = 0;
+
+        //! Tell the force that the diameters of the particle data changed, on all ranks and before the ghost exchange
+        virtual void notifyDiametersChange() = 0;
+    };
+
+#endif // __POLYMD_DIAMETER_SCALE_H__
@@ -0,0 +1,149 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+/*! \file PolymdDiscreteDiameters.cc
+    \brief Defines the PolymdDiscreteDiameters class
+*/
+
+#include "PolymdDiscreteDiameters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+/*! \param pdata Particle data of the force
+    \param name Name of the force in the messages, e.g. pair.polydisperse-12
+*/
+PolymdDiscreteDiameters::PolymdDiscreteDiameters(std::shared_ptr<ParticleData> pdata, const std::string& name)
+    : m_pdata(pdata), m_exec_conf(pdata->getExecConf()), m_name(name), m_enabled(false), m_detect(false),
+      m_dirty(true), m_index_dirty(true)
+    {
+    m_pdata->getParticleSortSignal().connect<PolymdDiscreteDiameters, &PolymdDiscreteDiameters::setIndexDirty>(this);
+    m_pdata->getGhostParticlesRemovedSignal()
+        .connect<PolymdDiscreteDiameters, &PolymdDiscreteDiameters::setIndexDirty>(this);
+    }
+
+PolymdDiscreteDiameters::~PolymdDiscreteDiameters()
+    {
+    m_pdata->getParticleSortSignal().disconnect<PolymdDiscreteDiameters, &PolymdDiscreteDiameters::setIndexDirty>(this);
+    m_pdata->getGhostParticlesRemovedSignal()
+        .disconnect<PolymdDiscreteDiameters, &PolymdDiscreteDiameters::setIndexDirty>(this);
+    }
+
+/*! \param diameters The discrete diameters, or an empty list to detect them from the particles
+
+    Given diameters are matched to the particles with a relative tolerance of 1e-6, so that values read from single
+    precision files still match, and sigma_ij is evaluated from the given values. Detected diameters match exactly.
+*/
+void PolymdDiscreteDiameters::set(const std::vector<Scalar>& diameters)
+    {
+    std::vector<Scalar> sorted(diameters);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    if (sorted.size() > 256 || (!sorted.empty() && !(sorted[0] > Scalar(0.0))))
+        {
+        m_exec_conf->msg->error() << m_name << ": expected at most 256 positive discrete diameters" << endl;
+        throw runtime_error("Error setting the discrete diameters");
+        }
+
+    m_enabled = true;
+    m_detect = sorted.empty();
+    m_dirty = true;
+    m_diameters = sorted;
+    }
+
+/*! \param diameter Diameters of the local and ghost particles
+    \param n_all Number of local and ghost particles
+*/
+void PolymdDiscreteDiameters::detect(const Scalar *diameter, unsigned int n_all)
+    {
+    std::vector<Scalar> sorted(diameter, diameter + n_all);
+    sorted.insert(sorted.end(), m_diameters.begin(), m_diameters.end());
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    if (sorted.size() > 256)
+        {
+        m_exec_conf->msg->error() << m_name << ": found more than 256 distinct diameters, the discrete mode needs a "
+                                  << "few discrete values" << endl;
+        throw runtime_error("Error detecting the discrete diameters");
+        }
+
+    m_exec_conf->msg->notice(2) << m_name << ": detected " << sorted.size() << " discrete diameters" << endl;
+    m_diameters = sorted;
+    m_dirty = true;
+    }
+
+/*! \param diameter Diameters of the local and ghost particles
+    \param n_all Number of local and ghost particles
+    \param params Parameters of each type pair
+    \param n_typpair Number of type pairs
+    \returns True if the discrete mode is enabled and the table and indices are ready
+
+    The indices are only assigned again when they were marked out of date or the number of particles changed, not by
+    comparing the diameters at every step. In detection mode, a diameter that was not seen before adds a new discrete
+    value.
+*/
+bool PolymdDiscreteDiameters::update(const Scalar *diameter, unsigned int n_all, const polydisperse_params *params,
+                                     unsigned int n_typpair)
+    {
+    if (!m_enabled)
+        return false;
+
+    if (!m_dirty && !m_index_dirty && m_index.size() == n_all)
+        return true;
+
+    const Scalar tol = m_detect ? Scalar(0.0) : Scalar(1e-6);
+    m_index.resize(n_all);
+    for (unsigned int i = 0; i < n_all; ++i)
+        {
+        const Scalar d = diameter[i];
+        std::vector<Scalar>::const_iterator it = std::lower_bound(m_diameters.begin(), m_diameters.end(),
+                                                                  d*(Scalar(1.0) - tol));
+        if (it == m_diameters.end() || fabs(*it - d) > tol*d)
+            {
+            if (m_detect)
+                {
+                detect(diameter, n_all);
+                return update(diameter, n_all, params, n_typpair);
+                }
+            m_exec_conf->msg->error() << m_name << ": the diameter " << d << " is not one of the discrete diameters"
+                                      << endl;
+            throw runtime_error("Error assigning the discrete diameters");
+            }
+        m_index[i] = (unsigned char)(it - m_diameters.begin());
+        }
+
+    // sigma_ij and the cutoff of every type pair and pair of diameters, rounded like the evaluators
+    const unsigned int n_discrete = m_diameters.size();
+    if (m_dirty || m_table.size() != n_typpair*n_discrete*n_discrete)
+        {
+        m_table.resize(n_typpair*n_discrete*n_discrete);
+        for (unsigned int ab = 0; ab < n_typpair; ++ab)
+            {
+            for (unsigned int a = 0; a < n_discrete; ++a)
+                {
+                for (unsigned int b = 0; b < n_discrete; ++b)
+                    {
+                    const Scalar d_a = m_diameters[a];
+                    const Scalar d_b = m_diameters[b];
+                    const Scalar sigma = Scalar(0.5)*(d_a + d_b)*(Scalar(1.0) - params[ab].eps*fabs(d_a - d_b));
+                    const Scalar sigmasq = sigma*sigma;
+                    Scalar2 entry = make_scalar2(1.0, 0.0);
+                    if (sigmasq > Scalar(0.0))
+                        entry = make_scalar2(Scalar(1.0)/sigmasq, params[ab].scaledrcutsq*sigmasq);
+                    m_table[(ab*n_discrete + a)*n_discrete + b] = entry;
+                    }
+                }
+            }
+        m_dirty = false;
+        }
+    m_index_dirty = false;
+    return true;
+    }
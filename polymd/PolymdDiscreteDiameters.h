@@ -0,0 +1,112 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __POLYMD_DISCRETE_DIAMETERS_H__
+#define __POLYMD_DISCRETE_DIAMETERS_H__
+
+#include "hoomd/ParticleData.h"
+#include "EvaluatorPairPolydisperseParams.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/*! \file PolymdDiscreteDiameters.h
+    \brief Declares the PolymdDiscreteDiameters class
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+//! Table of sigma_ij and the cutoff by type pair and pair of discrete diameters
+/*! When the diameters only take a few discrete values, given to set() or detected from the particles, update() gives
+    every local and ghost particle the index of its diameter and fills a table of (1/sigma_ij^2, cutoff^2) by type pair
+    and pair of discrete diameters, rounded like the evaluators. PotentialPairPolymd then looks the pairs up in the
+    table and evaluates them with the cached batch kernels, instead of gathering the neighbor diameters.
+
+    The indices are only assigned again when they may be out of date: after setDirty() or setIndexDirty(), which the
+    force calls when the parameters or the diameters change, and when the particle data reorders the local particles
+    (sorting, migration, snapshot restore) or removes the ghosts before a ghost exchange.
+
+    At most 256 discrete diameters are supported, so that the index of a particle fits in a byte.
+*/
+class PolymdDiscreteDiameters
+    {
+    public:
+        //! Construct with the discrete mode disabled
+        PolymdDiscreteDiameters(std::shared_ptr<ParticleData> pdata, const std::string& name);
+
+        //! Destructor
+        ~PolymdDiscreteDiameters();
+
+        //! Look up sigma_ij and the cutoff by pair of discrete diameters
+        void set(const std::vector<Scalar>& diameters);
+
+        //! Evaluate sigma_ij and the cutoff from the diameters again
+        void disable()
+            {
+            m_enabled = false;
+            m_table.clear();
+            }
+
+        //! Check whether the discrete mode is enabled
+        bool isEnabled() const
+            {
+            return m_enabled;
+            }
+
+        //! Rebuild the table on the next update, after the parameters changed
+        void setDirty()
+            {
+            m_dirty = true;
+            }
+
+        //! Assign the indices again on the next update, after the diameters or the order of the particles changed
+        void setIndexDirty()
+            {
+            m_index_dirty = true;
+            }
+
+        //! Get the discrete diameters, given or detected so far
+        const std::vector<Scalar>& getDiameters() const
+            {
+            return m_diameters;
+            }
+
+        //! Assign the discrete diameters to the particles and rebuild the table if needed
+        bool update(const Scalar *diameter, unsigned int n_all, const polydisperse_params *params,
+                    unsigned int n_typpair);
+
+        //! Get the index of the diameter of every local and ghost particle
+        const unsigned char *getIndex() const
+            {
+            return m_index.data();
+            }
+
+        //! Get the (1/sigma_ij^2, cutoff^2) of type pair ab and diameters a, b at (ab*n + a)*n + b
+        const Scalar2 *getTable() const
+            {
+            return m_table.data();
+            }
+
+    private:
+        std::shared_ptr<ParticleData> m_pdata;                     //!< Particle data, signals the reordering
+        std::shared_ptr<const ExecutionConfiguration> m_exec_conf; //!< Messages
+        std::string m_name;                                        //!< Name of the force in the messages
+        bool m_enabled;                                            //!< True if the diameters take discrete values
+        bool m_detect;                                             //!< True if the discrete diameters are detected
+        bool m_dirty;                                              //!< True if the table needs to be rebuilt
+        bool m_index_dirty;                                        //!< True if the indices need to be assigned
+        std::vector<Scalar> m_diameters;                           //!< Sorted discrete diameters
+        std::vector<unsigned char> m_index;                        //!< Index of the diameter of every particle
+        std::vector<Scalar2> m_table;                              //!< (1/sigma_ij^2, cutoff^2) by type, diameters
+
+        //! Detect the discrete diameters of the local and ghost particles
+        void detect(const Scalar *diameter, unsigned int n_all);
+    };
+
+#endif // __POLYMD_DISCRETE_DIAMETERS_H__
@@ -0,0 +1,107 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __POLYMD_FIXED_POINT_H__
+#define __POLYMD_FIXED_POINT_H__
+
+#include "hoomd/HOOMDMath.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <stdint.h>
+
+/*! \file PolymdFixedPoint.h
+    \brief Declares the fixed point accumulation of the polymd force computes
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+//! Smallest number of fraction bits of the fixed point accumulation
+const unsigned int POLYMD_FIXED_POINT_MIN_BITS = 16;
+
+//! Largest number of fraction bits of the fixed point accumulation
+const unsigned int POLYMD_FIXED_POINT_MAX_BITS = 48;
+
+//! Conversion of the pair contributions to 64 bit fixed point
+/*! Floating point sums depend on the order of the terms, so the forces of a multithreaded or domain decomposed run
+    change with the number of threads and ranks. In fixed point, every contribution is rounded once to a multiple of
+    2^-bits, and the sums are exact integer sums that do not depend on the order. The conversion of a contribution
+    only depends on its value, so the results are bitwise identical for any number of threads.
+
+    The sums are accumulated in uint64_t, so that they wrap instead of overflowing, and read as int64_t. With the
+    default of 32 bits, the resolution is 2.3e-10 and every contribution must be smaller than 2^(62-bits-10), i.e.
+    2^20 = 1.0e6, which leaves room for 1024 contributions of the largest size in one sum. Larger contributions set
+    the overflow flag, the caller then reports an error instead of returning wrapped sums. The force loops check every
+    pair once with pairInRange() and convert its contributions without further checks.
+*/
+struct polymd_fixed_point
+    {
+    Scalar scale;       //!< 2^bits
+    Scalar inv_scale;   //!< 2^-bits
+    Scalar limit;       //!< Largest magnitude of a single contribution
+
+    //! Set the number of fraction bits
+    explicit polymd_fixed_point(unsigned int bits=32)
+        {
+        if (bits < POLYMD_FIXED_POINT_MIN_BITS || bits > POLYMD_FIXED_POINT_MAX_BITS)
+            throw std::runtime_error("Invalid number of fixed point bits");
+        scale = std::ldexp(Scalar(1.0), int(bits));
+        inv_scale = std::ldexp(Scalar(1.0), -int(bits));
+        limit = std::ldexp(Scalar(1.0), 62 - int(bits) - 10);
+        }
+
+    //! Check that the contributions of a pair are in range, before they are converted with convertInRange()
+    /*! \param force_divr Force divided by r
+        \param rsq Squared distance
+        \param energy Pair energy, 0 if it is not summed
+        \param virial True if the virial of the pair is summed
+        \returns False if a contribution may reach the limit or is not finite
+
+        A force component |f/r dx_a| is at most |f/r| r and a virial component |f/r dx_a dx_b| / 2 at most
+        |f/r| r^2 / 2, reached for a pair along an axis. One check per pair replaces one per contribution.
+    */
+    bool pairInRange(Scalar force_divr, Scalar rsq, Scalar energy, bool virial) const
+        {
+        const Scalar f = std::fabs(force_divr);
+        return (f*f*rsq < limit*limit) & (Scalar(0.5)*std::fabs(energy) < limit)
+               & (!virial | (Scalar(0.5)*f*rsq < limit));
+        }
+
+    //! Convert a contribution known to be in range, rounded to the nearest multiple of 2^-bits
+    /*! \param x Contribution, |x| below the limit, see pairInRange()
+
+        Half way cases round away from zero, without a branch.
+    */
+    uint64_t convertInRange(Scalar x) const
+        {
+        const Scalar y = x*scale;
+        return uint64_t(int64_t(y + std::copysign(Scalar(0.5), y)));
+        }
+
+    //! Convert a contribution, rounded to the nearest multiple of 2^-bits
+    /*! \param x Contribution
+        \param overflow Set to true if |x| exceeds the limit or x is not finite
+    */
+    uint64_t convert(Scalar x, bool& overflow) const
+        {
+        if (!(std::fabs(x) < limit))
+            {
+            overflow = true;
+            return 0;
+            }
+        return convertInRange(x);
+        }
+
+    //! Convert a sum back to Scalar
+    Scalar toScalar(uint64_t q) const
+        {
+        return Scalar(int64_t(q))*inv_scale;
+        }
+    };
+
+#endif // __POLYMD_FIXED_POINT_H__
@@ -0,0 +1,33 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __POLYMD_PAIR_LOOP_TIME_H__
+#define __POLYMD_PAIR_LOOP_TIME_H__
+
+/*! \file PolymdPairLoopTime.h
+    \brief Declares the PolymdPairLoopTime interface
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+//! Interface of the force computes that time their pair loop
+/*! The polymd force computes time their pair loop in every compute. LoadBalancerPolydisperse reads the time spent
+    since its last update to weigh the ranks by the work they actually did, rather than by their neighbor counts alone.
+    Unlike the counters of the force computes, this time is never reset.
+*/
+class PolymdPairLoopTime
+    {
+    public:
+        //! Destructor
+        virtual ~PolymdPairLoopTime() { }
+
+        //! Get the wall time of the pair loop summed over all computes on this rank, in ns
+        virtual unsigned long long getPairLoopTime() const = 0;
+    };
+
+#endif // __POLYMD_PAIR_LOOP_TIME_H__
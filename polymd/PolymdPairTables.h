@@ -0,0 +1,185 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __POLYMD_PAIR_TABLES_H__
+#define __POLYMD_PAIR_TABLES_H__
+
+#include "hoomd/ExecutionConfiguration.h"
+#include "hoomd/Index1D.h"
+#include "hoomd/ParticleData.h"
+#include "PolydisperseTable.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+/*! \file PolymdPairTables.h
+    \brief Defines the PolymdPairTables class
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+//! Spline tables of every type pair of a PotentialPairPolymd
+/*! After set(), every type pair gets a reduced distance spline table (see PolydisperseTable.h), built by update() from
+    the parameters whenever they changed, and eval() looks a batch of neighbors up in the table of its type pair
+    instead of evaluating the model. The tables are symmetric in the type pair.
+
+    \tparam evaluator Evaluator whose model is tabulated
+*/
+template<class evaluator>
+class PolymdPairTables
+    {
+    public:
+        //! Construct with the tables disabled
+        PolymdPairTables(std::shared_ptr<const ExecutionConfiguration> exec_conf, std::shared_ptr<ParticleData> pdata)
+            : m_exec_conf(exec_conf), m_pdata(pdata), m_enabled(false), m_dirty(true), m_width(0), m_rmin(0.0),
+              m_error_bound(0.0), m_lookup(getPolydisperseTableLookup())
+            {
+            }
+
+        //! Evaluate the potential from spline tables
+        void set(unsigned int width, Scalar r_min, Scalar error_bound);
+
+        //! Evaluate the potential exactly
+        void disable()
+            {
+            m_enabled = false;
+            m_tables.clear();
+            }
+
+        //! Check whether the potential is looked up in the tables
+        bool isEnabled() const
+            {
+            return m_enabled;
+            }
+
+        //! Rebuild the tables on the next update, after the parameters changed
+        void setDirty()
+            {
+            m_dirty = true;
+            }
+
+        //! Rebuild the tables if needed
+        void update(const polydisperse_params *params, const Index2D& typpair_idx);
+
+        //! Get the largest error of the current tables, relative to max(|value|, |v0|)
+        Scalar getError() const
+            {
+            Scalar error = Scalar(0.0);
+            for (unsigned int i = 0; i < m_tables.size(); ++i)
+                error = std::max(error, m_tables[i].error);
+            return error;
+            }
+
+        //! Get the largest number of intervals of the current tables
+        unsigned int getWidth() const
+            {
+            unsigned int width = 0;
+            for (unsigned int i = 0; i < m_tables.size(); ++i)
+                width = std::max(width, m_tables[i].width);
+            return width;
+            }
+
+        //! Evaluate a batch of neighbors of one type from the table of the type pair, see evalTableBatch()
+        unsigned int eval(unsigned int typpair,
+                          const polydisperse_params& params,
+                          Scalar di,
+                          const Scalar *rsq,
+                          const Scalar *dj,
+                          unsigned int n_neigh,
+                          Scalar *force_divr,
+                          Scalar *pair_eng) const
+            {
+            return evalTableBatch<evaluator>(m_lookup, m_tables[typpair], params, di, rsq, dj, n_neigh, force_divr,
+                                             pair_eng);
+            }
+
+    private:
+        std::shared_ptr<const ExecutionConfiguration> m_exec_conf; //!< Messages
+        std::shared_ptr<ParticleData> m_pdata;                     //!< Type names
+        bool m_enabled;                                            //!< True if the potential is looked up in tables
+        bool m_dirty;                                              //!< True if the tables need to be rebuilt
+        unsigned int m_width;                                      //!< Initial number of intervals of the tables
+        Scalar m_rmin;                                             //!< Smallest tabulated r/sigma_ij
+        Scalar m_error_bound;                                      //!< Tolerated error of the tables
+        std::vector<polydisperse_table> m_tables;                  //!< Table of each type pair
+        polydisperse_table_func m_lookup;                          //!< Table lookup kernel for this CPU
+    };
+
+/*! \param width Initial number of intervals of each table
+    \param r_min Smallest tabulated distance, in units of sigma_ij
+    \param error_bound Tolerated error of the energy and force, relative to max(|value|, |v0|)
+
+    See build_polydisperse_table() for how the number of intervals is refined to meet \a error_bound.
+*/
+template<class evaluator>
+void PolymdPairTables<evaluator>::set(unsigned int width, Scalar r_min, Scalar error_bound)
+    {
+    if (width == 0 || !(r_min > Scalar(0.0)) || !(error_bound > Scalar(0.0)))
+        {
+        m_exec_conf->msg->error() << "pair." << evaluator::getName()
+                                  << ": table width, r_min and error bound must be positive" << std::endl;
+        throw std::runtime_error("Error setting the polydisperse table");
+        }
+
+    m_enabled = true;
+    m_dirty = true;
+    m_width = width;
+    m_rmin = r_min;
+    m_error_bound = error_bound;
+    }
+
+/*! \param params Parameters of each type pair
+    \param typpair_idx Indexer of the type pairs
+*/
+template<class evaluator>
+void PolymdPairTables<evaluator>::update(const polydisperse_params *params, const Index2D& typpair_idx)
+    {
+    const unsigned int ntypes = m_pdata->getNTypes();
+    if (!m_enabled || (!m_dirty && m_tables.size() == typpair_idx.getNumElements()))
+        return;
+
+    m_tables.resize(typpair_idx.getNumElements());
+    Scalar max_error = Scalar(0.0);
+    unsigned int max_width = 0;
+    for (unsigned int a = 0; a < ntypes; ++a)
+        {
+        for (unsigned int b = a; b < ntypes; ++b)
+            {
+            const unsigned int ab = typpair_idx(a, b);
+            const polydisperse_params& param = params[ab];
+            if (!(m_rmin*m_rmin < param.scaledrcutsq))
+                {
+                m_exec_conf->msg->error() << "pair." << evaluator::getName() << ": table r_min " << m_rmin
+                                          << " is not below the cutoff of the type pair " << m_pdata->getNameByType(a)
+                                          << "," << m_pdata->getNameByType(b) << std::endl;
+                throw std::runtime_error("Error building the polydisperse table");
+                }
+
+            m_tables[ab] = build_polydisperse_table<evaluator>(param, m_width, m_rmin, m_error_bound);
+            m_tables[typpair_idx(b, a)] = m_tables[ab];
+
+            if (m_tables[ab].error > m_error_bound)
+                {
+                m_exec_conf->msg->warning() << "pair." << evaluator::getName() << ": the table of "
+                                            << m_pdata->getNameByType(a) << "," << m_pdata->getNameByType(b)
+                                            << " reaches an error of " << m_tables[ab].error << ", above the bound of "
+                                            << m_error_bound << std::endl;
+                }
+            max_error = std::max(max_error, m_tables[ab].error);
+            max_width = std::max(max_width, m_tables[ab].width);
+            }
+        }
+
+    m_exec_conf->msg->notice(2) << "pair." << evaluator::getName() << ": built tables with up to " << max_width
+                                << " intervals, largest error " << max_error << std::endl;
+    m_dirty = false;
+    }
+
+#endif // __POLYMD_PAIR_TABLES_H__
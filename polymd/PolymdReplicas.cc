@@ -0,0 +1,775 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+/*! \file PolymdReplicas.cc
+    \brief Defines the PolymdReplicas class
+*/
+
+#include "PolymdReplicas.h"
+#include "EvaluatorPairPolydisperseMNQ.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+using namespace std;
+
+/*! \param model Polydisperse model: polydisperse12, polydisperse18, polydisperse10, lennardjones or polydisperse106
+    \param n_replicas Number of replicas
+    \param N Number of particles of every replica
+    \param ntypes Number of particle types
+    \param ndim Number of dimensions, 2 or 3
+
+    All replicas start in a unit cube with all particles at the origin, every slot at kT = 1 and replica r in slot r.
+    The type pairs do not interact until their coefficients are set.
+*/
+PolymdReplicas::PolymdReplicas(const std::string& model,
+                               unsigned int n_replicas,
+                               unsigned int N,
+                               unsigned int ntypes,
+                               unsigned int ndim)
+    : m_n_replicas(n_replicas), m_N(N), m_ntypes(ntypes), m_ndim(ndim), m_model(model), m_r_buff(Scalar(0.3)),
+      m_n_builds(0), m_valid(false), m_gamma(Scalar(0.0)), m_seed(0), m_timestep(0), m_n_exchanges(0)
+    {
+    if (model == "polydisperse12")
+        {
+        m_batch = PolydisperseBatch<EvaluatorPairPolydisperse>::get();
+        m_make_params = &make_polydisperse_params<12, 0, 2>;
+        }
+    else if (model == "polydisperse18")
+        {
+        m_batch = PolydisperseBatch<EvaluatorPairPolydisperse18>::get();
+        m_make_params = &make_polydisperse_params<18, 0, 2>;
+        }
+    else if (model == "polydisperse10")
+        {
+        m_batch = PolydisperseBatch<EvaluatorPairPolydisperse10>::get();
+        m_make_params = &make_polydisperse_params<10, 0, 3>;
+        }
+    else if (model == "lennardjones")
+        {
+        m_batch = PolydisperseBatch<EvaluatorPairPolydisperseLJ>::get();
+        m_make_params = &make_polydisperse_params<12, 6, 2>;
+        }
+    else if (model == "polydisperse106")
+        {
+        m_batch = PolydisperseBatch<EvaluatorPairPolydisperseLJ106>::get();
+        m_make_params = &make_polydisperse_params<10, 6, 2>;
+        }
+    else
+        throw runtime_error("replica: unknown model " + model);
+
+    if (n_replicas == 0 || N == 0 || ntypes == 0)
+        throw runtime_error("replica: the numbers of replicas, particles and types must be positive");
+    if (ndim != 2 && ndim != 3)
+        throw runtime_error("replica: the number of dimensions must be 2 or 3");
+    if ((uint64_t)n_replicas*N > 0xffffffffu)
+        throw runtime_error("replica: too many particles in all replicas");
+
+    m_params.assign(ntypes*ntypes, m_make_params(Scalar(0.0), Scalar(0.0), Scalar(1.0)));
+
+    const unsigned int n_all = n_replicas*N;
+    m_x.assign(n_all, Scalar(0.0)); m_y.assign(n_all, Scalar(0.0)); m_z.assign(n_all, Scalar(0.0));
+    m_image.assign(3*n_all, 0);
+    m_vx.assign(n_all, Scalar(0.0)); m_vy.assign(n_all, Scalar(0.0)); m_vz.assign(n_all, Scalar(0.0));
+    m_fx.assign(n_all, Scalar(0.0)); m_fy.assign(n_all, Scalar(0.0)); m_fz.assign(n_all, Scalar(0.0));
+    m_bx.assign(n_all, Scalar(0.0)); m_by.assign(n_all, Scalar(0.0)); m_bz.assign(n_all, Scalar(0.0));
+    m_energy.assign(n_all, Scalar(0.0));
+    m_virial.assign(6*n_all, Scalar(0.0));
+    m_diameter.assign(n_all, Scalar(1.0));
+    m_type.assign(n_all, 0);
+
+    m_box.assign(n_replicas, BoxDim(Scalar(1.0), Scalar(1.0), Scalar(1.0)));
+    m_r_search.assign(n_replicas, Scalar(0.0));
+    m_last_x.assign(n_all, Scalar(0.0)); m_last_y.assign(n_all, Scalar(0.0)); m_last_z.assign(n_all, Scalar(0.0));
+    m_head.assign(n_all, 0);
+    m_n_neigh.assign(n_all, 0);
+    m_nlist.resize(n_replicas);
+    m_dirty.assign(n_replicas, 1);
+    m_replica_energy.assign(n_replicas, 0.0);
+    m_replica_virial.assign(6*n_replicas, 0.0);
+
+    m_kT.assign(n_replicas, Scalar(1.0));
+    m_replica_of_slot.resize(n_replicas);
+    m_slot_of_replica.resize(n_replicas);
+    for (unsigned int r = 0; r < n_replicas; ++r)
+        m_replica_of_slot[r] = m_slot_of_replica[r] = r;
+
+    setNumThreads(1);
+    }
+
+/*! \param a First type of the pair
+    \param b Second type of the pair
+    \param v0 Energy scale of the potential, 0 to leave out the pair
+    \param eps Non-additivity of the pair diameter
+    \param scaledr_cut Cutoff radius in units of sigma_ij
+*/
+void PolymdReplicas::setParams(unsigned int a, unsigned int b, Scalar v0, Scalar eps, Scalar scaledr_cut)
+    {
+    if (a >= m_ntypes || b >= m_ntypes)
+        throw runtime_error("replica: type out of range");
+
+    const polydisperse_params params = m_make_params(v0, eps, scaledr_cut);
+    m_params[a*m_ntypes + b] = params;
+    m_params[b*m_ntypes + a] = params;
+    m_dirty.assign(m_n_replicas, 1);
+    m_valid = false;
+    }
+
+/*! \param r_buff Buffer of the Verlet lists, the lists are rebuilt when a particle moved by more than r_buff/2
+*/
+void PolymdReplicas::setBuffer(Scalar r_buff)
+    {
+    if (r_buff < Scalar(0.0))
+        throw runtime_error("replica: the buffer must not be negative");
+    m_r_buff = r_buff;
+    m_dirty.assign(m_n_replicas, 1);
+    }
+
+/*! \param n_threads Number of threads, including the calling thread
+*/
+void PolymdReplicas::setNumThreads(unsigned int n_threads)
+    {
+    if (n_threads == 0)
+        throw runtime_error("replica: the number of threads must be positive");
+
+    if (m_pool && m_pool->getNumThreads() == n_threads)
+        return;
+
+    m_pool.reset(new PolymdThreadPool(n_threads));
+    m_scratch.clear();
+    m_scratch.resize(n_threads);
+    }
+
+/*! \param r Replica index
+*/
+void PolymdReplicas::checkReplica(unsigned int r) const
+    {
+    if (r >= m_n_replicas)
+        throw runtime_error("replica: replica index out of range");
+    }
+
+/*! \param r Replica to set
+    \param box Lx, Ly, Lz and optionally the tilt factors xy, xz, yz
+    \param pos Positions, x, y, z of every particle
+    \param diameter Diameter of every particle
+    \param type Type of every particle
+
+    The positions are wrapped into the box and the images start at 0. The velocities are kept.
+*/
+void PolymdReplicas::setReplica(unsigned int r,
+                                const std::vector<Scalar>& box,
+                                const std::vector<Scalar>& pos,
+                                const std::vector<Scalar>& diameter,
+                                const std::vector<unsigned int>& type)
+    {
+    checkReplica(r);
+    if (box.size() != 3 && box.size() != 6)
+        throw runtime_error("replica: the box needs Lx, Ly, Lz and optionally xy, xz, yz");
+    if (pos.size() != 3*m_N || diameter.size() != m_N || type.size() != m_N)
+        throw runtime_error("replica: the particle data does not match the number of particles");
+
+    BoxDim new_box(box[0], box[1], box[2]);
+    if (box.size() == 6)
+        new_box.setTiltFactors(box[3], box[4], box[5]);
+    m_box[r] = new_box;
+
+    const unsigned int base = r*m_N;
+    for (unsigned int i = 0; i < m_N; ++i)
+        {
+        if (type[i] >= m_ntypes)
+            throw runtime_error("replica: type out of range");
+        if (!(diameter[i] > Scalar(0.0)))
+            throw runtime_error("replica: the diameters must be positive");
+
+        Scalar4 p = make_scalar4(pos[3*i], pos[3*i+1], m_ndim == 3 ? pos[3*i+2] : Scalar(0.0), Scalar(0.0));
+        int3 img = make_int3(0, 0, 0);
+        new_box.wrap(p, img);
+        m_x[base+i] = p.x;
+        m_y[base+i] = p.y;
+        m_z[base+i] = p.z;
+        m_image[3*(base+i)] = img.x;
+        m_image[3*(base+i)+1] = img.y;
+        m_image[3*(base+i)+2] = img.z;
+        m_diameter[base+i] = diameter[i];
+        m_type[base+i] = type[i];
+        }
+    m_dirty[r] = 1;
+    m_valid = false;
+    }
+
+/*! \param r Replica to set
+    \param vel Velocities, x, y, z of every particle
+*/
+void PolymdReplicas::setVelocities(unsigned int r, const std::vector<Scalar>& vel)
+    {
+    checkReplica(r);
+    if (vel.size() != 3*m_N)
+        throw runtime_error("replica: the velocities do not match the number of particles");
+
+    const unsigned int base = r*m_N;
+    for (unsigned int i = 0; i < m_N; ++i)
+        {
+        m_vx[base+i] = vel[3*i];
+        m_vy[base+i] = vel[3*i+1];
+        m_vz[base+i] = m_ndim == 3 ? vel[3*i+2] : Scalar(0.0);
+        }
+    }
+
+/*! \param r Replica to get
+    \returns x, y, z of every particle
+*/
+std::vector<Scalar> PolymdReplicas::getPositions(unsigned int r) const
+    {
+    checkReplica(r);
+    std::vector<Scalar> pos(3*m_N);
+    const unsigned int base = r*m_N;
+    for (unsigned int i = 0; i < m_N; ++i)
+        {
+        pos[3*i] = m_x[base+i];
+        pos[3*i+1] = m_y[base+i];
+        pos[3*i+2] = m_z[base+i];
+        }
+    return pos;
+    }
+
+/*! \param r Replica to get
+    \returns The image in x, y, z of every particle
+*/
+std::vector<int> PolymdReplicas::getImages(unsigned int r) const
+    {
+    checkReplica(r);
+    return std::vector<int>(m_image.begin() + 3*r*m_N, m_image.begin() + 3*(r+1)*m_N);
+    }
+
+/*! \param r Replica to get
+    \returns x, y, z of every particle
+*/
+std::vector<Scalar> PolymdReplicas::getVelocities(unsigned int r) const
+    {
+    checkReplica(r);
+    std::vector<Scalar> vel(3*m_N);
+    const unsigned int base = r*m_N;
+    for (unsigned int i = 0; i < m_N; ++i)
+        {
+        vel[3*i] = m_vx[base+i];
+        vel[3*i+1] = m_vy[base+i];
+        vel[3*i+2] = m_vz[base+i];
+        }
+    return vel;
+    }
+
+/*! \param r Replica to get
+    \returns x, y, z of every particle, from the last compute
+*/
+std::vector<Scalar> PolymdReplicas::getForces(unsigned int r) const
+    {
+    checkReplica(r);
+    std::vector<Scalar> force(3*m_N);
+    const unsigned int base = r*m_N;
+    for (unsigned int i = 0; i < m_N; ++i)
+        {
+        force[3*i] = m_fx[base+i];
+        force[3*i+1] = m_fy[base+i];
+        force[3*i+2] = m_fz[base+i];
+        }
+    return force;
+    }
+
+/*! \param kT Temperature of every slot, positive
+*/
+void PolymdReplicas::setTemperatures(const std::vector<Scalar>& kT)
+    {
+    if (kT.size() != m_n_replicas)
+        throw runtime_error("replica: one temperature per replica is needed");
+    for (unsigned int s = 0; s < kT.size(); ++s)
+        {
+        if (!(kT[s] > Scalar(0.0)))
+            throw runtime_error("replica: the temperatures must be positive");
+        }
+    m_kT = kT;
+    }
+
+/*! \param gamma Drag coefficient, 0 to integrate without a thermostat
+    \param seed Seed of the random numbers of the thermostat and of exchange()
+*/
+void PolymdReplicas::setLangevin(Scalar gamma, unsigned int seed)
+    {
+    if (gamma < Scalar(0.0))
+        throw runtime_error("replica: the drag must not be negative");
+    m_gamma = gamma;
+    m_seed = seed;
+    }
+
+/*! \param func Called with the thread and the replica, once for every replica
+*/
+void PolymdReplicas::forEachReplica(const std::function<void (unsigned int, unsigned int)>& func)
+    {
+    std::atomic<unsigned int> next(0);
+    m_pool->run([&](unsigned int thread)
+        {
+        for (unsigned int r = next++; r < m_n_replicas; r = next++)
+            func(thread, r);
+        });
+    }
+
+/*! \param r Replica to update
+
+    As in PolymdRerun, sigma_ij <= d_max (1 - eps (d_max - d_min)) for eps < 0 bounds the cutoff of every pair.
+*/
+void PolymdReplicas::updateSearchRadius(unsigned int r)
+    {
+    double eps_min = 0.0, rcut_max = 0.0;
+    for (unsigned int p = 0; p < m_params.size(); ++p)
+        {
+        if (m_params[p].v0 != Scalar(0.0))
+            {
+            eps_min = std::min(eps_min, double(m_params[p].eps));
+            rcut_max = std::max(rcut_max, std::sqrt(double(m_params[p].scaledrcutsq)));
+            }
+        }
+
+    const std::vector<Scalar>::const_iterator first = m_diameter.begin() + r*m_N;
+    const double d_min = *std::min_element(first, first + m_N);
+    const double d_max = *std::max_element(first, first + m_N);
+    m_r_search[r] = Scalar(rcut_max*d_max*(1.0 - eps_min*(d_max - d_min)));
+    }
+
+/*! A replica is rebuilt when it is dirty or one of its particles moved by more than half the buffer since its last
+    build. The replicas are checked and rebuilt in parallel, each by one thread.
+*/
+void PolymdReplicas::updateNeighborLists()
+    {
+    const Scalar max_dispsq = m_r_buff*m_r_buff/Scalar(4.0);
+    std::vector<char> built(m_n_replicas, 0);
+    forEachReplica([&](unsigned int thread, unsigned int r)
+        {
+        bool rebuild = m_dirty[r] != 0;
+        const unsigned int base = r*m_N;
+        for (unsigned int i = 0; i < m_N && !rebuild; ++i)
+            {
+            const Scalar3 d = m_box[r].minImage(make_scalar3(m_x[base+i] - m_last_x[base+i],
+                                                             m_y[base+i] - m_last_y[base+i],
+                                                             m_z[base+i] - m_last_z[base+i]));
+            if (dot(d, d) >= max_dispsq)
+                rebuild = true;
+            }
+        if (rebuild)
+            {
+            if (m_dirty[r])
+                updateSearchRadius(r);
+            buildNeighborList(r, m_scratch[thread]);
+            m_dirty[r] = 0;
+            built[r] = 1;
+            }
+        });
+    for (unsigned int r = 0; r < m_n_replicas; ++r)
+        m_n_builds += built[r];
+    }
+
+/*! \param r Replica to build the list of
+    \param scratch Scratch space of the calling thread
+
+    The particles are binned into cells at least as wide as the largest cutoff plus the buffer, as in
+    PolymdRerun::computeFrame(), and every particle stores its neighbors inside that radius.
+*/
+void PolymdReplicas::buildNeighborList(unsigned int r, polymd_replicas_scratch& scratch)
+    {
+    const unsigned int N = m_N;
+    const unsigned int base = r*N;
+    const BoxDim& box = m_box[r];
+    std::vector<unsigned int>& nlist = m_nlist[r];
+    nlist.clear();
+
+    for (unsigned int i = 0; i < N; ++i)
+        {
+        m_last_x[base+i] = m_x[base+i];
+        m_last_y[base+i] = m_y[base+i];
+        m_last_z[base+i] = m_z[base+i];
+        m_head[base+i] = 0;
+        m_n_neigh[base+i] = 0;
+        }
+    if (m_r_search[r] <= Scalar(0.0))
+        return;
+
+    const Scalar r_list = m_r_search[r] + m_r_buff;
+    const Scalar3 npd = box.getNearestPlaneDistance();
+    if (npd.x < Scalar(2.0)*r_list || npd.y < Scalar(2.0)*r_list || (m_ndim == 3 && npd.z < Scalar(2.0)*r_list))
+        throw runtime_error("replica: the box is smaller than twice the largest cutoff plus the buffer");
+
+    // bin the particles into cells at least r_list wide
+    uint3 dim = make_uint3((unsigned int)(npd.x/r_list), (unsigned int)(npd.y/r_list),
+                           m_ndim == 3 ? (unsigned int)(npd.z/r_list) : 1);
+    while ((uint64_t)dim.x*dim.y*dim.z > 4*(uint64_t)N + 64)
+        {
+        if (dim.x >= dim.y && dim.x >= dim.z) dim.x = std::max(1u, dim.x/2);
+        else if (dim.y >= dim.z) dim.y = std::max(1u, dim.y/2);
+        else dim.z = std::max(1u, dim.z/2);
+        }
+    const unsigned int n_cells = dim.x*dim.y*dim.z;
+
+    scratch.cell_of.resize(N);
+    scratch.cell_start.assign(n_cells + 1, 0);
+    for (unsigned int i = 0; i < N; ++i)
+        {
+        const Scalar3 f = box.makeFraction(make_scalar3(m_x[base+i], m_y[base+i], m_z[base+i]));
+        int cx = int(std::floor(f.x*dim.x)) % int(dim.x);
+        int cy = int(std::floor(f.y*dim.y)) % int(dim.y);
+        int cz = m_ndim == 3 ? int(std::floor(f.z*dim.z)) % int(dim.z) : 0;
+        if (cx < 0) cx += dim.x;
+        if (cy < 0) cy += dim.y;
+        if (cz < 0) cz += dim.z;
+        scratch.cell_of[i] = (cz*dim.y + cy)*dim.x + cx;
+        scratch.cell_start[scratch.cell_of[i] + 1]++;
+        }
+    for (unsigned int c = 0; c < n_cells; ++c)
+        scratch.cell_start[c + 1] += scratch.cell_start[c];
+    scratch.cell_particles.resize(N);
+    std::vector<unsigned int> fill(scratch.cell_start.begin(), scratch.cell_start.end() - 1);
+    for (unsigned int i = 0; i < N; ++i)
+        scratch.cell_particles[fill[scratch.cell_of[i]]++] = i;
+
+    const Scalar r_listsq = r_list*r_list;
+    for (unsigned int cell = 0; cell < n_cells; ++cell)
+        {
+        if (scratch.cell_start[cell] == scratch.cell_start[cell + 1])
+            continue;
+
+        // the distinct cells around this one, fewer than 27 when a dimension has less than three cells
+        const int cx = cell % dim.x, cy = (cell/dim.x) % dim.y, cz = cell/(dim.x*dim.y);
+        scratch.stencil.clear();
+        for (int oz = (m_ndim == 3 ? -1 : 0); oz <= (m_ndim == 3 ? 1 : 0); ++oz)
+            for (int oy = -1; oy <= 1; ++oy)
+                for (int ox = -1; ox <= 1; ++ox)
+                    {
+                    const unsigned int nx = (cx + ox + dim.x) % dim.x;
+                    const unsigned int ny = (cy + oy + dim.y) % dim.y;
+                    const unsigned int nz = (cz + oz + dim.z) % dim.z;
+                    scratch.stencil.push_back((nz*dim.y + ny)*dim.x + nx);
+                    }
+        std::sort(scratch.stencil.begin(), scratch.stencil.end());
+        scratch.stencil.erase(std::unique(scratch.stencil.begin(), scratch.stencil.end()), scratch.stencil.end());
+
+        for (unsigned int s = scratch.cell_start[cell]; s < scratch.cell_start[cell + 1]; ++s)
+            {
+            const unsigned int i = scratch.cell_particles[s];
+            const Scalar3 pi = make_scalar3(m_x[base+i], m_y[base+i], m_z[base+i]);
+            m_head[base+i] = nlist.size();
+            for (unsigned int c = 0; c < scratch.stencil.size(); ++c)
+                {
+                const unsigned int neigh = scratch.stencil[c];
+                for (unsigned int t = scratch.cell_start[neigh]; t < scratch.cell_start[neigh + 1]; ++t)
+                    {
+                    const unsigned int j = scratch.cell_particles[t];
+                    if (j == i)
+                        continue;
+                    const Scalar3 dx = box.minImage(pi - make_scalar3(m_x[base+j], m_y[base+j], m_z[base+j]));
+                    if (dot(dx, dx) < r_listsq)
+                        nlist.push_back(j);
+                    }
+                }
+            m_n_neigh[base+i] = nlist.size() - m_head[base+i];
+            }
+        }
+    }
+
+/*! \param first First particle, counted over all replicas
+    \param last One past the last particle
+    \param scratch Scratch space of the calling thread
+
+    The neighbors of every particle are evaluated with one batch per neighbor type, as in PolymdRerun. Every pair is
+    visited from both sides, each side takes half of the energy and virial.
+*/
+void PolymdReplicas::computeRange(unsigned int first, unsigned int last, polymd_replicas_scratch& scratch)
+    {
+    const unsigned int ntypes = m_ntypes;
+    for (unsigned int g = first; g < last; ++g)
+        {
+        const unsigned int r = g/m_N;
+        const unsigned int base = r*m_N;
+        const BoxDim& box = m_box[r];
+        const unsigned int size = m_n_neigh[g];
+        const unsigned int *neigh = size ? &m_nlist[r][m_head[g]] : NULL;
+
+        m_fx[g] = m_fy[g] = m_fz[g] = Scalar(0.0);
+        m_energy[g] = Scalar(0.0);
+        for (unsigned int l = 0; l < 6; ++l)
+            m_virial[l*m_n_replicas*m_N + g] = Scalar(0.0);
+        if (size == 0)
+            continue;
+
+        if (scratch.rsq.size() < size)
+            {
+            const unsigned int n = std::max(size, 64u);
+            scratch.typej.resize(n); scratch.dx.resize(n); scratch.rsq.resize(n); scratch.dj.resize(n);
+            scratch.order.resize(n); scratch.sorted_rsq.resize(n); scratch.sorted_dj.resize(n);
+            scratch.force_divr.resize(n); scratch.pair_eng.resize(n);
+            }
+
+        // gather the neighbors and sort them by type
+        const Scalar3 pi = make_scalar3(m_x[g], m_y[g], m_z[g]);
+        const unsigned int typei = m_type[g];
+        const Scalar di = m_diameter[g];
+        scratch.type_start.assign(ntypes + 1, 0);
+        for (unsigned int k = 0; k < size; ++k)
+            {
+            const unsigned int j = base + neigh[k];
+            const Scalar3 dx = box.minImage(pi - make_scalar3(m_x[j], m_y[j], m_z[j]));
+            scratch.dx[k] = dx;
+            scratch.rsq[k] = dot(dx, dx);
+            scratch.dj[k] = m_diameter[j];
+            scratch.typej[k] = m_type[j];
+            scratch.type_start[m_type[j] + 1]++;
+            }
+        for (unsigned int t = 0; t < ntypes; t++)
+            scratch.type_start[t + 1] += scratch.type_start[t];
+        for (unsigned int k = 0; k < size; k++)
+            {
+            const unsigned int p = scratch.type_start[scratch.typej[k]]++;
+            scratch.order[p] = k;
+            scratch.sorted_rsq[p] = scratch.rsq[k];
+            scratch.sorted_dj[p] = scratch.dj[k];
+            }
+
+        unsigned int start = 0;
+        for (unsigned int t = 0; t < ntypes; t++)
+            {
+            const unsigned int end = scratch.type_start[t];
+            if (end > start)
+                {
+                m_batch(m_params[typei*ntypes + t], di, &scratch.sorted_rsq[start], &scratch.sorted_dj[start],
+                        end - start, &scratch.force_divr[start], &scratch.pair_eng[start]);
+                }
+            start = end;
+            }
+
+        Scalar3 fi = make_scalar3(0.0, 0.0, 0.0);
+        Scalar ei = Scalar(0.0);
+        Scalar virial[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+        for (unsigned int p = 0; p < size; p++)
+            {
+            const Scalar3 dx = scratch.dx[scratch.order[p]];
+            const Scalar force_divr = scratch.force_divr[p];
+            const Scalar force_div2r = Scalar(0.5)*force_divr;
+            fi += dx*force_divr;
+            ei += Scalar(0.5)*scratch.pair_eng[p];
+            virial[0] += force_div2r*dx.x*dx.x;
+            virial[1] += force_div2r*dx.x*dx.y;
+            virial[2] += force_div2r*dx.x*dx.z;
+            virial[3] += force_div2r*dx.y*dx.y;
+            virial[4] += force_div2r*dx.y*dx.z;
+            virial[5] += force_div2r*dx.z*dx.z;
+            }
+        m_fx[g] = fi.x;
+        m_fy[g] = fi.y;
+        m_fz[g] = fi.z;
+        m_energy[g] = ei;
+        for (unsigned int l = 0; l < 6; ++l)
+            m_virial[l*m_n_replicas*m_N + g] = virial[l];
+        }
+    }
+
+/*! The Verlet lists are updated first. The particles of all replicas are then split into chunks of about equal
+    neighbor counts, and the energies and virials are summed per replica afterwards, in particle order.
+*/
+void PolymdReplicas::compute()
+    {
+    updateNeighborLists();
+
+    const unsigned int n_all = m_n_replicas*m_N;
+    const unsigned int n_threads = m_pool->getNumThreads();
+    m_queue.partition(&m_n_neigh[0], n_all, n_threads, true);
+    m_pool->run([&](unsigned int thread)
+        {
+        unsigned int first, last;
+        while (m_queue.next(thread, first, last))
+            computeRange(first, last, m_scratch[thread]);
+        });
+
+    forEachReplica([&](unsigned int thread, unsigned int r)
+        {
+        const unsigned int base = r*m_N;
+        double energy = 0.0;
+        for (unsigned int i = 0; i < m_N; ++i)
+            energy += m_energy[base+i];
+        m_replica_energy[r] = energy;
+        for (unsigned int l = 0; l < 6; ++l)
+            {
+            double virial = 0.0;
+            for (unsigned int i = 0; i < m_N; ++i)
+                virial += m_virial[l*n_all + base + i];
+            m_replica_virial[6*r + l] = virial;
+            }
+        });
+    m_valid = true;
+    }
+
+/*! \param n_steps Number of steps
+    \param dt Time step
+
+    Every step is a velocity Verlet step with unit masses. With a drag gamma > 0, the second half step draws the
+    Langevin force -gamma v + sqrt(6 gamma kT/dt) u, with u uniform in [-1, 1], at the temperature of the slot of the
+    replica, and both half kicks use it, as in TwoStepLangevin of HOOMD.
+*/
+void PolymdReplicas::run(unsigned int n_steps, Scalar dt)
+    {
+    if (!m_valid)
+        compute();
+
+    const bool three_d = m_ndim == 3;
+    for (unsigned int step = 0; step < n_steps; ++step)
+        {
+        forEachReplica([&](unsigned int thread, unsigned int r)
+            {
+            const unsigned int base = r*m_N;
+            const BoxDim& box = m_box[r];
+            for (unsigned int g = base; g < base + m_N; ++g)
+                {
+                m_vx[g] += Scalar(0.5)*dt*(m_fx[g] + m_bx[g]);
+                m_vy[g] += Scalar(0.5)*dt*(m_fy[g] + m_by[g]);
+                if (three_d)
+                    m_vz[g] += Scalar(0.5)*dt*(m_fz[g] + m_bz[g]);
+
+                Scalar4 p = make_scalar4(m_x[g] + dt*m_vx[g], m_y[g] + dt*m_vy[g], m_z[g] + dt*m_vz[g],
+                                         Scalar(0.0));
+                int3 img = make_int3(m_image[3*g], m_image[3*g+1], m_image[3*g+2]);
+                box.wrap(p, img);
+                m_x[g] = p.x;
+                m_y[g] = p.y;
+                m_z[g] = p.z;
+                m_image[3*g] = img.x;
+                m_image[3*g+1] = img.y;
+                m_image[3*g+2] = img.z;
+                }
+            });
+
+        compute();
+
+        forEachReplica([&](unsigned int thread, unsigned int r)
+            {
+            const unsigned int base = r*m_N;
+            if (m_gamma > Scalar(0.0))
+                {
+                const Scalar coeff = std::sqrt(Scalar(6.0)*m_gamma*m_kT[m_slot_of_replica[r]]/dt);
+                std::seed_seq seq{m_seed, r, (unsigned int)(m_timestep & 0xffffffffu),
+                                  (unsigned int)(m_timestep >> 32)};
+                std::mt19937 rng(seq);
+                std::uniform_real_distribution<Scalar> uniform(Scalar(-1.0), Scalar(1.0));
+                for (unsigned int g = base; g < base + m_N; ++g)
+                    {
+                    m_bx[g] = -m_gamma*m_vx[g] + coeff*uniform(rng);
+                    m_by[g] = -m_gamma*m_vy[g] + coeff*uniform(rng);
+                    if (three_d)
+                        m_bz[g] = -m_gamma*m_vz[g] + coeff*uniform(rng);
+                    }
+                }
+            else
+                {
+                for (unsigned int g = base; g < base + m_N; ++g)
+                    m_bx[g] = m_by[g] = m_bz[g] = Scalar(0.0);
+                }
+
+            for (unsigned int g = base; g < base + m_N; ++g)
+                {
+                m_vx[g] += Scalar(0.5)*dt*(m_fx[g] + m_bx[g]);
+                m_vy[g] += Scalar(0.5)*dt*(m_fy[g] + m_by[g]);
+                if (three_d)
+                    m_vz[g] += Scalar(0.5)*dt*(m_fz[g] + m_bz[g]);
+                }
+            });
+        ++m_timestep;
+        }
+    }
+
+/*! \param a First slot
+    \param b Second slot
+
+    The velocities of both replicas are rescaled to the temperatures of their new slots, and so are their Langevin
+    forces, whose drag and noise both scale the same way.
+*/
+void PolymdReplicas::swapSlots(unsigned int a, unsigned int b)
+    {
+    if (a >= m_n_replicas || b >= m_n_replicas)
+        throw runtime_error("replica: slot out of range");
+    if (a == b)
+        return;
+
+    const unsigned int ra = m_replica_of_slot[a];
+    const unsigned int rb = m_replica_of_slot[b];
+    m_replica_of_slot[a] = rb;
+    m_replica_of_slot[b] = ra;
+    m_slot_of_replica[ra] = b;
+    m_slot_of_replica[rb] = a;
+
+    const Scalar scale_a = std::sqrt(m_kT[b]/m_kT[a]);
+    const Scalar scale_b = Scalar(1.0)/scale_a;
+    for (unsigned int i = 0; i < m_N; ++i)
+        {
+        m_vx[ra*m_N+i] *= scale_a; m_vy[ra*m_N+i] *= scale_a; m_vz[ra*m_N+i] *= scale_a;
+        m_vx[rb*m_N+i] *= scale_b; m_vy[rb*m_N+i] *= scale_b; m_vz[rb*m_N+i] *= scale_b;
+        m_bx[ra*m_N+i] *= scale_a; m_by[ra*m_N+i] *= scale_a; m_bz[ra*m_N+i] *= scale_a;
+        m_bx[rb*m_N+i] *= scale_b; m_by[rb*m_N+i] *= scale_b; m_bz[rb*m_N+i] *= scale_b;
+        }
+    }
+
+/*! \returns The number of accepted swaps
+
+    The calls alternate between the slot pairs (0, 1), (2, 3), ... and (1, 2), (3, 4), ..., so that every pair of
+    neighboring slots is attempted every second call.
+*/
+unsigned int PolymdReplicas::exchange()
+    {
+    if (!m_valid)
+        compute();
+
+    std::seed_seq seq{m_seed, 0xffffffffu, (unsigned int)(m_n_exchanges & 0xffffffffu),
+                      (unsigned int)(m_n_exchanges >> 32)};
+    std::mt19937 rng(seq);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    unsigned int n_accepted = 0;
+    for (unsigned int s = m_n_exchanges % 2; s + 1 < m_n_replicas; s += 2)
+        {
+        const double energy_a = m_replica_energy[m_replica_of_slot[s]];
+        const double energy_b = m_replica_energy[m_replica_of_slot[s+1]];
+        const double delta = (1.0/m_kT[s] - 1.0/m_kT[s+1])*(energy_a - energy_b);
+        if (delta >= 0.0 || uniform(rng) < std::exp(delta))
+            {
+            swapSlots(s, s+1);
+            ++n_accepted;
+            }
+        }
+    ++m_n_exchanges;
+    return n_accepted;
+    }
+
+/*! \returns The potential energy of every replica, by replica index
+*/
+std::vector<double> PolymdReplicas::getEnergies()
+    {
+    if (!m_valid)
+        compute();
+    return m_replica_energy;
+    }
+
+/*! \returns xx, xy, xz, yy, yz, zz of W/V of every replica, by replica index
+*/
+std::vector<double> PolymdReplicas::getPressures()
+    {
+    if (!m_valid)
+        compute();
+
+    std::vector<double> pressure(6*m_n_replicas);
+    for (unsigned int r = 0; r < m_n_replicas; ++r)
+        {
+        const double volume = m_box[r].getVolume(m_ndim == 2);
+        for (unsigned int l = 0; l < 6; ++l)
+            pressure[6*r + l] = m_replica_virial[6*r + l]/volume;
+        }
+    return pressure;
+    }
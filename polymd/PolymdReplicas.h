@@ -0,0 +1,238 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __POLYMD_REPLICAS_H__
+#define __POLYMD_REPLICAS_H__
+
+#include "EvaluatorPairPolydisperseParams.h"
+#include "PolydisperseBatch.h"
+#include "PolymdThreadPool.h"
+#include "PolymdWorkQueue.h"
+#include "hoomd/BoxDim.h"
+
+/*! \file PolymdReplicas.h
+    \brief Declares the PolymdReplicas class
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+//! Scratch space of one thread of PolymdReplicas
+struct polymd_replicas_scratch
+    {
+    std::vector<unsigned int> cell_start;   //!< First particle of every cell in cell_particles
+    std::vector<unsigned int> cell_of;      //!< Cell of every particle
+    std::vector<unsigned int> cell_particles; //!< Particles sorted by cell
+    std::vector<unsigned int> stencil;      //!< Distinct neighbor cells of the current cell
+
+    std::vector<unsigned int> typej;        //!< Neighbor types
+    std::vector<Scalar3> dx;                //!< Minimum image separations
+    std::vector<Scalar> rsq;                //!< Squared distances
+    std::vector<Scalar> dj;                 //!< Neighbor diameters
+    std::vector<unsigned int> order;        //!< Neighbors sorted by type
+    std::vector<unsigned int> type_start;   //!< End of each type in the sorted arrays
+    std::vector<Scalar> sorted_rsq;         //!< rsq sorted by type
+    std::vector<Scalar> sorted_dj;          //!< dj sorted by type
+    std::vector<Scalar> force_divr;         //!< Batch results, in sorted order
+    std::vector<Scalar> pair_eng;           //!< Batch results, in sorted order
+    };
+
+//! Many replicas of a small polydisperse system, evaluated in one process
+/*! Parallel tempering and statistics over many independent glass samples of N = 1000-4000 particles need hundreds of
+    small systems. Run as separate HOOMD processes, each pays its own startup and neighbor list overhead and none of
+    them keeps a core busy. PolymdReplicas holds R replicas with the same N, the same types and the same model, without
+    a HOOMD runtime:
+
+    - all particle data is packed replica by replica in one structure of arrays, particle i of replica r at r*N + i,
+    - every replica has its own box and Verlet list, which is only rebuilt when a particle of that replica moved by more
+      than half the buffer, with the cell list of PolymdRerun,
+    - compute() evaluates all replicas in one sweep over the R*N particles, split over a PolymdThreadPool by neighbor
+      list entries with work stealing (PolymdWorkQueue), with the batch kernel of the model (PolydisperseBatch),
+    - run() integrates all replicas with velocity Verlet and unit masses, optionally with the Langevin thermostat of
+      HOOMD (uniform noise, drag gamma), at the temperature of the slot every replica is in.
+
+    The neighbor lists are full, so every particle only writes its own force and the results do not depend on the
+    number of threads or the order the chunks are taken in.
+
+    For replica exchange, the temperatures belong to slots and every replica sits in one slot. exchange() attempts
+    swaps between neighboring slots with the parallel tempering criterion min(1, exp((1/kT_a - 1/kT_b)(U_a - U_b)))
+    and swapSlots() swaps unconditionally; both only permute the slots and rescale the velocities of the two replicas
+    by sqrt(kT_new/kT_old), the particle data never moves. The random numbers depend on the seed, the replica and the
+    step only.
+*/
+class PolymdReplicas
+    {
+    public:
+        //! Construct R replicas of N particles
+        PolymdReplicas(const std::string& model,
+                       unsigned int n_replicas,
+                       unsigned int N,
+                       unsigned int ntypes,
+                       unsigned int ndim);
+
+        //! Get the number of replicas
+        unsigned int getNumReplicas() const
+            {
+            return m_n_replicas;
+            }
+
+        //! Get the number of particles per replica
+        unsigned int getN() const
+            {
+            return m_N;
+            }
+
+        //! Set the coefficients of a pair of types
+        void setParams(unsigned int a, unsigned int b, Scalar v0, Scalar eps, Scalar scaledr_cut);
+
+        //! Set the buffer of the Verlet lists
+        void setBuffer(Scalar r_buff);
+
+        //! Set the number of threads
+        void setNumThreads(unsigned int n_threads);
+
+        //! Get the number of threads
+        unsigned int getNumThreads() const
+            {
+            return m_pool->getNumThreads();
+            }
+
+        //! Set the box, positions, diameters and types of a replica
+        void setReplica(unsigned int r,
+                        const std::vector<Scalar>& box,
+                        const std::vector<Scalar>& pos,
+                        const std::vector<Scalar>& diameter,
+                        const std::vector<unsigned int>& type);
+
+        //! Set the velocities of a replica
+        void setVelocities(unsigned int r, const std::vector<Scalar>& vel);
+
+        //! Get the positions of a replica, wrapped into its box
+        std::vector<Scalar> getPositions(unsigned int r) const;
+
+        //! Get the images of a replica
+        std::vector<int> getImages(unsigned int r) const;
+
+        //! Get the velocities of a replica
+        std::vector<Scalar> getVelocities(unsigned int r) const;
+
+        //! Get the forces of a replica
+        std::vector<Scalar> getForces(unsigned int r) const;
+
+        //! Set the temperature of every slot
+        void setTemperatures(const std::vector<Scalar>& kT);
+
+        //! Set the drag of the Langevin thermostat, 0 for NVE, and the seed of the random numbers
+        void setLangevin(Scalar gamma, unsigned int seed);
+
+        //! Compute the forces, energies and virials of all replicas
+        void compute();
+
+        //! Integrate all replicas
+        void run(unsigned int n_steps, Scalar dt);
+
+        //! Attempt replica exchanges between neighboring slots
+        unsigned int exchange();
+
+        //! Swap the replicas of two slots
+        void swapSlots(unsigned int a, unsigned int b);
+
+        //! Get the replica in every slot
+        std::vector<unsigned int> getReplicaOfSlot() const
+            {
+            return m_replica_of_slot;
+            }
+
+        //! Get the potential energy of every replica
+        std::vector<double> getEnergies();
+
+        //! Get the configurational pressure tensor W/V of every replica, xx, xy, xz, yy, yz, zz
+        std::vector<double> getPressures();
+
+        //! Get the number of steps run
+        uint64_t getTimestep() const
+            {
+            return m_timestep;
+            }
+
+        //! Get the number of Verlet list builds of all replicas
+        uint64_t getNumBuilds() const
+            {
+            return m_n_builds;
+            }
+
+    private:
+        unsigned int m_n_replicas;              //!< Number of replicas
+        unsigned int m_N;                       //!< Number of particles per replica
+        unsigned int m_ntypes;                  //!< Number of types
+        unsigned int m_ndim;                    //!< Number of dimensions
+        std::string m_model;                    //!< Name of the model
+        polydisperse_batch_func m_batch;        //!< Batch kernel of the model
+        polydisperse_params (*m_make_params)(Scalar, Scalar, Scalar); //!< Parameter helper of the model
+        std::vector<polydisperse_params> m_params; //!< Parameters by type pair
+        Scalar m_r_buff;                        //!< Buffer of the Verlet lists
+
+        std::vector<Scalar> m_x, m_y, m_z;      //!< Positions of all replicas
+        std::vector<int> m_image;               //!< Images of all replicas, 3 per particle
+        std::vector<Scalar> m_vx, m_vy, m_vz;   //!< Velocities of all replicas
+        std::vector<Scalar> m_fx, m_fy, m_fz;   //!< Forces of all replicas
+        std::vector<Scalar> m_bx, m_by, m_bz;   //!< Langevin forces of the last step of all replicas
+        std::vector<Scalar> m_energy;           //!< Energy of every particle
+        std::vector<Scalar> m_virial;           //!< Virial of every particle, component by component
+        std::vector<Scalar> m_diameter;         //!< Diameters of all replicas
+        std::vector<unsigned int> m_type;       //!< Types of all replicas
+
+        std::vector<BoxDim> m_box;              //!< Box of every replica
+        std::vector<Scalar> m_r_search;         //!< Largest cutoff of any pair of every replica
+        std::vector<Scalar> m_last_x, m_last_y, m_last_z; //!< Positions at the last Verlet list build
+        std::vector<unsigned int> m_head;       //!< First neighbor of every particle in the list of its replica
+        std::vector<unsigned int> m_n_neigh;    //!< Number of neighbors of every particle
+        std::vector< std::vector<unsigned int> > m_nlist; //!< Verlet list of every replica, indices in the replica
+        std::vector<char> m_dirty;              //!< True for the replicas whose Verlet list must be rebuilt
+        uint64_t m_n_builds;                    //!< Number of Verlet list builds
+
+        std::vector<double> m_replica_energy;   //!< Potential energy of every replica
+        std::vector<double> m_replica_virial;   //!< Virial of every replica
+        bool m_valid;                           //!< True if the forces match the positions
+
+        std::vector<Scalar> m_kT;               //!< Temperature of every slot
+        std::vector<unsigned int> m_replica_of_slot; //!< Replica in every slot
+        std::vector<unsigned int> m_slot_of_replica; //!< Slot of every replica
+        Scalar m_gamma;                         //!< Drag of the Langevin thermostat
+        unsigned int m_seed;                    //!< Seed of the random numbers
+        uint64_t m_timestep;                    //!< Number of steps run
+        uint64_t m_n_exchanges;                 //!< Number of exchange() calls
+
+        std::unique_ptr<PolymdThreadPool> m_pool; //!< Worker threads
+        std::vector<polymd_replicas_scratch> m_scratch; //!< Scratch space per thread
+        PolymdWorkQueue m_queue;                //!< Chunks of the force sweep
+
+        //! Check a replica index
+        void checkReplica(unsigned int r) const;
+
+        //! Update the largest cutoff of a replica from its diameters
+        void updateSearchRadius(unsigned int r);
+
+        //! Rebuild the Verlet lists of the replicas that need it
+        void updateNeighborLists();
+
+        //! Build the Verlet list of one replica
+        void buildNeighborList(unsigned int r, polymd_replicas_scratch& scratch);
+
+        //! Evaluate the forces on a range of particles of all replicas
+        void computeRange(unsigned int first, unsigned int last, polymd_replicas_scratch& scratch);
+
+        //! Run func(thread, r) for every replica, with the threads taking whole replicas
+        void forEachReplica(const std::function<void (unsigned int, unsigned int)>& func);
+    };
+
+#endif // __POLYMD_REPLICAS_H__
@@ -0,0 +1,468 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+/*! \file PolymdRerun.cc
+    \brief Defines the PolymdRerun class
+*/
+
+#include "PolymdRerun.h"
+#include "EvaluatorPairPolydisperseMNQ.h"
+#include "hoomd/BoxDim.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+//! Streaming writer of a NumPy .npy file with a known shape
+/*! The header is written up front, rows are appended with write(). Data is written in the byte order of the host,
+    which is little endian on every platform HOOMD runs on.
+*/
+class npy_writer
+    {
+    public:
+        //! Open the file and write the header
+        npy_writer(const std::string& filename, const std::string& descr, uint64_t rows, uint64_t columns,
+                   bool matrix)
+            : m_filename(filename)
+            {
+            m_file = fopen(filename.c_str(), "wb");
+            if (!m_file)
+                throw runtime_error("Error opening " + filename + " for writing");
+
+            ostringstream dict;
+            dict << "{'descr': '" << descr << "', 'fortran_order': False, 'shape': (" << rows;
+            if (matrix)
+                dict << ", " << columns << "), }";
+            else
+                dict << ",), }";
+
+            // pad the header with spaces and a newline so that the data starts at a multiple of 64 bytes
+            string header = dict.str();
+            const size_t preamble = 10;
+            const size_t total = ((preamble + header.size() + 1 + 63)/64)*64;
+            header.append(total - preamble - header.size() - 1, ' ');
+            header.push_back('\n');
+
+            const unsigned short header_len = (unsigned short)header.size();
+            const char magic[8] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0};
+            fwrite(magic, 1, 8, m_file);
+            const unsigned char len[2] = {(unsigned char)(header_len & 0xff), (unsigned char)(header_len >> 8)};
+            fwrite(len, 1, 2, m_file);
+            fwrite(header.data(), 1, header.size(), m_file);
+            }
+
+        //! Close the file
+        ~npy_writer()
+            {
+            if (m_file)
+                fclose(m_file);
+            }
+
+        //! Append elements
+        template<class T>
+        void write(const T *data, size_t n)
+            {
+            if (fwrite(data, sizeof(T), n, m_file) != n)
+                throw runtime_error("Error writing " + m_filename);
+            }
+
+    private:
+        std::string m_filename;     //!< Name of the file
+        FILE *m_file;               //!< The file
+    };
+
+/*! \param filename Name of the GSD file
+    \param model Polydisperse model: polydisperse12, polydisperse18, polydisperse10, lennardjones or polydisperse106
+*/
+PolymdRerun::PolymdRerun(const std::string& filename, const std::string& model)
+    : m_gsd(filename), m_model(model)
+    {
+    if (model == "polydisperse12")
+        {
+        m_batch = PolydisperseBatch<EvaluatorPairPolydisperse>::get();
+        m_make_params = &make_polydisperse_params<12, 0, 2>;
+        }
+    else if (model == "polydisperse18")
+        {
+        m_batch = PolydisperseBatch<EvaluatorPairPolydisperse18>::get();
+        m_make_params = &make_polydisperse_params<18, 0, 2>;
+        }
+    else if (model == "polydisperse10")
+        {
+        m_batch = PolydisperseBatch<EvaluatorPairPolydisperse10>::get();
+        m_make_params = &make_polydisperse_params<10, 0, 3>;
+        }
+    else if (model == "lennardjones")
+        {
+        m_batch = PolydisperseBatch<EvaluatorPairPolydisperseLJ>::get();
+        m_make_params = &make_polydisperse_params<12, 6, 2>;
+        }
+    else if (model == "polydisperse106")
+        {
+        m_batch = PolydisperseBatch<EvaluatorPairPolydisperseLJ106>::get();
+        m_make_params = &make_polydisperse_params<10, 6, 2>;
+        }
+    else
+        throw runtime_error("rerun: unknown model " + model);
+
+    setNumThreads(1);
+    }
+
+/*! \param frame Frame to get the types of
+    \returns The type names of \a frame, A when the trajectory has none
+*/
+std::vector<std::string> PolymdRerun::getTypes(uint64_t frame) const
+    {
+    std::vector<std::string> types;
+    if (!m_gsd.readStrings(frame, "particles/types", types))
+        types.assign(1, "A");
+    return types;
+    }
+
+/*! \param a First type name of the pair
+    \param b Second type name of the pair
+    \param v0 Energy scale of the potential, 0 to leave out the pair
+    \param eps Non-additivity of the pair diameter
+    \param scaledr_cut Cutoff radius in units of sigma_ij
+*/
+void PolymdRerun::setParams(const std::string& a, const std::string& b, Scalar v0, Scalar eps, Scalar scaledr_cut)
+    {
+    const polydisperse_params params = m_make_params(v0, eps, scaledr_cut);
+    m_params[make_pair(a, b)] = params;
+    m_params[make_pair(b, a)] = params;
+    }
+
+/*! \param n_threads Number of threads, including the calling thread
+*/
+void PolymdRerun::setNumThreads(unsigned int n_threads)
+    {
+    if (n_threads == 0)
+        throw runtime_error("rerun: the number of threads must be positive");
+
+    if (m_pool && m_pool->getNumThreads() == n_threads)
+        return;
+
+    m_pool.reset(new PolymdThreadPool(n_threads));
+    m_scratch.clear();
+    m_scratch.resize(n_threads);
+    }
+
+/*! \param prefix Prefix of the output files, see the class documentation
+    \param first First frame to evaluate
+    \param last One past the last frame to evaluate, clamped to the number of frames
+    \param stride Evaluate every stride-th frame
+    \param per_particle Also write the energy of every particle, the number of particles must not change
+    \returns The number of frames written
+*/
+uint64_t PolymdRerun::run(const std::string& prefix, uint64_t first, uint64_t last, uint64_t stride,
+                          bool per_particle)
+    {
+    if (stride == 0)
+        throw runtime_error("rerun: the stride must be positive");
+
+    last = std::min(last, getNumFrames());
+    std::vector<uint64_t> frames;
+    for (uint64_t frame = first; frame < last; frame += stride)
+        frames.push_back(frame);
+    const uint64_t n_frames = frames.size();
+
+    // the number of particles sets the shape of the per particle output
+    uint64_t N = 0;
+    if (per_particle && n_frames > 0)
+        {
+        std::vector<unsigned int> n;
+        uint64_t rows;
+        uint32_t columns;
+        if (m_gsd.read(frames[0], "particles/N", n, rows, columns) && rows > 0)
+            N = n[0];
+        }
+
+    const string descr = sizeof(Scalar) == 8 ? "<f8" : "<f4";
+    npy_writer frame_file(prefix + "_frame.npy", "<u8", n_frames, 1, false);
+    npy_writer energy_file(prefix + "_energy.npy", descr, n_frames, 1, false);
+    npy_writer pressure_file(prefix + "_pressure.npy", descr, n_frames, 6, true);
+    std::unique_ptr<npy_writer> energies_file;
+    if (per_particle)
+        energies_file.reset(new npy_writer(prefix + "_energies.npy", descr, n_frames, N, true));
+
+    // evaluate blocks of frames in parallel, and write each block in frame order
+    const unsigned int n_threads = m_pool->getNumThreads();
+    const uint64_t block = 4*n_threads;
+    std::vector<polymd_rerun_result> results(block);
+    std::vector<Scalar> row;
+    for (uint64_t start = 0; start < n_frames; start += block)
+        {
+        const uint64_t count = std::min(block, n_frames - start);
+        std::atomic<uint64_t> next(0);
+        m_pool->run([&](unsigned int thread)
+            {
+            for (uint64_t k = next++; k < count; k = next++)
+                computeFrame(frames[start + k], m_scratch[thread], results[k], per_particle);
+            });
+
+        for (uint64_t k = 0; k < count; ++k)
+            {
+            const polymd_rerun_result& result = results[k];
+            frame_file.write(&frames[start + k], 1);
+            const Scalar energy = Scalar(result.energy);
+            energy_file.write(&energy, 1);
+            row.assign(result.pressure, result.pressure + 6);
+            pressure_file.write(&row[0], 6);
+            if (per_particle)
+                {
+                if (result.energies.size() != N)
+                    throw runtime_error("rerun: per particle energies need a constant number of particles");
+                row.assign(result.energies.begin(), result.energies.end());
+                if (N > 0)
+                    energies_file->write(&row[0], N);
+                }
+            }
+        }
+    return n_frames;
+    }
+
+/*! \param frame Frame to evaluate
+    \param scratch Scratch space of the calling thread
+    \param result Returns the energy, pressure tensor and optionally the per particle energies of the frame
+    \param per_particle True to fill result.energies
+
+    Missing chunks follow the HOOMD schema: they are taken from frame 0, or default to type 0, diameter 1 and a unit
+    cube box.
+*/
+void PolymdRerun::computeFrame(uint64_t frame, polymd_rerun_scratch& scratch, polymd_rerun_result& result,
+                               bool per_particle) const
+    {
+    uint64_t rows;
+    uint32_t columns;
+
+    // read the frame
+    unsigned int N = 0;
+    if (m_gsd.read(frame, "particles/N", scratch.chunk, rows, columns) && rows > 0)
+        N = (unsigned int)scratch.chunk[0];
+
+    unsigned int ndim = 3;
+    if (m_gsd.read(frame, "configuration/dimensions", scratch.chunk, rows, columns) && rows > 0)
+        ndim = (unsigned int)scratch.chunk[0];
+
+    double L[6] = {1.0, 1.0, 1.0, 0.0, 0.0, 0.0};
+    if (m_gsd.read(frame, "configuration/box", scratch.chunk, rows, columns) && rows*columns >= 6)
+        std::copy(scratch.chunk.begin(), scratch.chunk.begin() + 6, L);
+    BoxDim box((Scalar)L[0], (Scalar)L[1], (Scalar)L[2]);
+    box.setTiltFactors((Scalar)L[3], (Scalar)L[4], (Scalar)L[5]);
+
+    scratch.pos.assign(N, make_scalar3(0.0, 0.0, 0.0));
+    if (m_gsd.read(frame, "particles/position", scratch.chunk, rows, columns))
+        {
+        if (rows != N || columns != 3)
+            throw runtime_error("rerun: particles/position does not match particles/N");
+        for (unsigned int i = 0; i < N; ++i)
+            scratch.pos[i] = make_scalar3(scratch.chunk[3*i], scratch.chunk[3*i+1], scratch.chunk[3*i+2]);
+        }
+
+    scratch.type.assign(N, 0);
+    if (m_gsd.read(frame, "particles/typeid", scratch.type, rows, columns) && rows != N)
+        throw runtime_error("rerun: particles/typeid does not match particles/N");
+
+    scratch.diameter.assign(N, Scalar(1.0));
+    if (m_gsd.read(frame, "particles/diameter", scratch.diameter, rows, columns) && rows != N)
+        throw runtime_error("rerun: particles/diameter does not match particles/N");
+
+    // the parameters of every type pair of this frame
+    const std::vector<std::string> types = getTypes(frame);
+    const unsigned int ntypes = types.size();
+    std::vector<polydisperse_params> params(ntypes*ntypes);
+    double eps_min = 0.0, rcut_max = 0.0;
+    for (unsigned int a = 0; a < ntypes; ++a)
+        {
+        for (unsigned int b = 0; b < ntypes; ++b)
+            {
+            std::map< std::pair<std::string, std::string>, polydisperse_params >::const_iterator p
+                = m_params.find(make_pair(types[a], types[b]));
+            if (p == m_params.end())
+                throw runtime_error("rerun: no coefficients for the type pair " + types[a] + ", " + types[b]);
+            params[a*ntypes + b] = p->second;
+            if (p->second.v0 != Scalar(0.0))
+                {
+                eps_min = std::min(eps_min, double(p->second.eps));
+                rcut_max = std::max(rcut_max, std::sqrt(double(p->second.scaledrcutsq)));
+                }
+            }
+        }
+    for (unsigned int i = 0; i < N; ++i)
+        {
+        if (scratch.type[i] >= ntypes)
+            throw runtime_error("rerun: particles/typeid out of range");
+        }
+
+    // the largest cutoff of any pair, sigma_ij <= d_max (1 - eps (d_max - d_min)) for eps < 0
+    double d_min = 0.0, d_max = 0.0;
+    if (N > 0)
+        {
+        d_min = *std::min_element(scratch.diameter.begin(), scratch.diameter.end());
+        d_max = *std::max_element(scratch.diameter.begin(), scratch.diameter.end());
+        }
+    const double r_search = rcut_max*d_max*(1.0 - eps_min*(d_max - d_min));
+
+    result.energy = 0.0;
+    std::fill(result.pressure, result.pressure + 6, 0.0);
+    if (per_particle)
+        result.energies.assign(N, 0.0);
+    if (N == 0 || r_search <= 0.0)
+        return;
+
+    const Scalar3 npd = box.getNearestPlaneDistance();
+    if (npd.x < 2.0*r_search || npd.y < 2.0*r_search || (ndim == 3 && npd.z < 2.0*r_search))
+        throw runtime_error("rerun: the box is smaller than twice the largest cutoff");
+
+    // bin the particles into cells at least r_search wide
+    uint3 dim = make_uint3((unsigned int)(npd.x/r_search), (unsigned int)(npd.y/r_search),
+                           ndim == 3 ? (unsigned int)(npd.z/r_search) : 1);
+    while ((uint64_t)dim.x*dim.y*dim.z > 4*(uint64_t)N + 64)
+        {
+        if (dim.x >= dim.y && dim.x >= dim.z) dim.x = std::max(1u, dim.x/2);
+        else if (dim.y >= dim.z) dim.y = std::max(1u, dim.y/2);
+        else dim.z = std::max(1u, dim.z/2);
+        }
+    const unsigned int n_cells = dim.x*dim.y*dim.z;
+
+    scratch.cell_of.resize(N);
+    scratch.cell_start.assign(n_cells + 1, 0);
+    for (unsigned int i = 0; i < N; ++i)
+        {
+        const Scalar3 f = box.makeFraction(scratch.pos[i]);
+        int cx = int(std::floor(f.x*dim.x)) % int(dim.x);
+        int cy = int(std::floor(f.y*dim.y)) % int(dim.y);
+        int cz = ndim == 3 ? int(std::floor(f.z*dim.z)) % int(dim.z) : 0;
+        if (cx < 0) cx += dim.x;
+        if (cy < 0) cy += dim.y;
+        if (cz < 0) cz += dim.z;
+        scratch.cell_of[i] = (cz*dim.y + cy)*dim.x + cx;
+        scratch.cell_start[scratch.cell_of[i] + 1]++;
+        }
+    for (unsigned int c = 0; c < n_cells; ++c)
+        scratch.cell_start[c + 1] += scratch.cell_start[c];
+    scratch.cell_particles.resize(N);
+    std::vector<unsigned int> fill(scratch.cell_start.begin(), scratch.cell_start.end() - 1);
+    for (unsigned int i = 0; i < N; ++i)
+        scratch.cell_particles[fill[scratch.cell_of[i]]++] = i;
+
+    const Scalar r_searchsq = Scalar(r_search*r_search);
+    const double volume = box.getVolume(ndim == 2);
+    double virial[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+
+    for (unsigned int cell = 0; cell < n_cells; ++cell)
+        {
+        if (scratch.cell_start[cell] == scratch.cell_start[cell + 1])
+            continue;
+
+        // the distinct cells around this one, fewer than 27 when a dimension has less than three cells
+        const int cx = cell % dim.x, cy = (cell/dim.x) % dim.y, cz = cell/(dim.x*dim.y);
+        scratch.stencil.clear();
+        for (int oz = (ndim == 3 ? -1 : 0); oz <= (ndim == 3 ? 1 : 0); ++oz)
+            for (int oy = -1; oy <= 1; ++oy)
+                for (int ox = -1; ox <= 1; ++ox)
+                    {
+                    const unsigned int nx = (cx + ox + dim.x) % dim.x;
+                    const unsigned int ny = (cy + oy + dim.y) % dim.y;
+                    const unsigned int nz = (cz + oz + dim.z) % dim.z;
+                    scratch.stencil.push_back((nz*dim.y + ny)*dim.x + nx);
+                    }
+        std::sort(scratch.stencil.begin(), scratch.stencil.end());
+        scratch.stencil.erase(std::unique(scratch.stencil.begin(), scratch.stencil.end()), scratch.stencil.end());
+
+        for (unsigned int s = scratch.cell_start[cell]; s < scratch.cell_start[cell + 1]; ++s)
+            {
+            const unsigned int i = scratch.cell_particles[s];
+            const Scalar3 pi = scratch.pos[i];
+            const unsigned int typei = scratch.type[i];
+            const Scalar di = scratch.diameter[i];
+
+            // gather the neighbors inside the largest cutoff
+            unsigned int size = 0;
+            for (unsigned int c = 0; c < scratch.stencil.size(); ++c)
+                {
+                const unsigned int neigh = scratch.stencil[c];
+                for (unsigned int t = scratch.cell_start[neigh]; t < scratch.cell_start[neigh + 1]; ++t)
+                    {
+                    const unsigned int j = scratch.cell_particles[t];
+                    if (j == i)
+                        continue;
+                    const Scalar3 dx = box.minImage(pi - scratch.pos[j]);
+                    const Scalar rsq = dot(dx, dx);
+                    if (rsq >= r_searchsq)
+                        continue;
+                    if (size == scratch.rsq.size())
+                        {
+                        const unsigned int n = std::max(2*size, 64u);
+                        scratch.j.resize(n); scratch.typej.resize(n); scratch.dx.resize(n); scratch.rsq.resize(n);
+                        scratch.dj.resize(n); scratch.order.resize(n); scratch.sorted_rsq.resize(n);
+                        scratch.sorted_dj.resize(n); scratch.force_divr.resize(n); scratch.pair_eng.resize(n);
+                        }
+                    scratch.j[size] = j;
+                    scratch.typej[size] = scratch.type[j];
+                    scratch.dx[size] = dx;
+                    scratch.rsq[size] = rsq;
+                    scratch.dj[size] = scratch.diameter[j];
+                    size++;
+                    }
+                }
+            if (size == 0)
+                continue;
+
+            // evaluate them with one batch per neighbor type
+            scratch.type_start.assign(ntypes + 1, 0);
+            for (unsigned int k = 0; k < size; k++)
+                scratch.type_start[scratch.typej[k] + 1]++;
+            for (unsigned int t = 0; t < ntypes; t++)
+                scratch.type_start[t + 1] += scratch.type_start[t];
+            for (unsigned int k = 0; k < size; k++)
+                {
+                const unsigned int p = scratch.type_start[scratch.typej[k]]++;
+                scratch.order[p] = k;
+                scratch.sorted_rsq[p] = scratch.rsq[k];
+                scratch.sorted_dj[p] = scratch.dj[k];
+                }
+
+            double ei = 0.0;
+            unsigned int start = 0;
+            for (unsigned int t = 0; t < ntypes; t++)
+                {
+                const unsigned int end = scratch.type_start[t];
+                if (end > start)
+                    {
+                    m_batch(params[typei*ntypes + t], di, &scratch.sorted_rsq[start], &scratch.sorted_dj[start],
+                            end - start, &scratch.force_divr[start], &scratch.pair_eng[start]);
+                    }
+                start = end;
+                }
+
+            // every pair is visited from both sides, each side takes half of the energy and virial
+            for (unsigned int p = 0; p < size; p++)
+                {
+                const Scalar3 dx = scratch.dx[scratch.order[p]];
+                const double force_div2r = 0.5*double(scratch.force_divr[p]);
+                ei += 0.5*double(scratch.pair_eng[p]);
+                virial[0] += force_div2r*dx.x*dx.x;
+                virial[1] += force_div2r*dx.x*dx.y;
+                virial[2] += force_div2r*dx.x*dx.z;
+                virial[3] += force_div2r*dx.y*dx.y;
+                virial[4] += force_div2r*dx.y*dx.z;
+                virial[5] += force_div2r*dx.z*dx.z;
+                }
+            result.energy += ei;
+            if (per_particle)
+                result.energies[i] = ei;
+            }
+        }
+
+    for (unsigned int l = 0; l < 6; ++l)
+        result.pressure[l] = virial[l]/volume;
+    }
@@ -0,0 +1,128 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __POLYMD_RERUN_H__
+#define __POLYMD_RERUN_H__
+
+#include "EvaluatorPairPolydisperseParams.h"
+#include "GSDTrajectory.h"
+#include "PolydisperseBatch.h"
+#include "PolymdThreadPool.h"
+
+/*! \file PolymdRerun.h
+    \brief Declares the PolymdRerun class
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+//! Scratch space of one thread of PolymdRerun
+struct polymd_rerun_scratch
+    {
+    std::vector<Scalar3> pos;               //!< Positions of the frame
+    std::vector<Scalar> diameter;           //!< Diameters of the frame
+    std::vector<unsigned int> type;         //!< Types of the frame
+    std::vector<double> chunk;              //!< Chunk read buffer
+    std::vector<unsigned int> cell_start;   //!< First particle of every cell in cell_particles
+    std::vector<unsigned int> cell_of;      //!< Cell of every particle
+    std::vector<unsigned int> cell_particles; //!< Particles sorted by cell
+    std::vector<unsigned int> stencil;      //!< Distinct neighbor cells of the current cell
+
+    std::vector<unsigned int> j;            //!< Neighbors of the current particle inside the search radius
+    std::vector<unsigned int> typej;        //!< Neighbor types
+    std::vector<Scalar3> dx;                //!< Minimum image separations
+    std::vector<Scalar> rsq;                //!< Squared distances
+    std::vector<Scalar> dj;                 //!< Neighbor diameters
+    std::vector<unsigned int> order;        //!< Neighbors sorted by type
+    std::vector<unsigned int> type_start;   //!< End of each type in the sorted arrays
+    std::vector<Scalar> sorted_rsq;         //!< rsq sorted by type
+    std::vector<Scalar> sorted_dj;          //!< dj sorted by type
+    std::vector<Scalar> force_divr;         //!< Batch results, in sorted order
+    std::vector<Scalar> pair_eng;           //!< Batch results, in sorted order
+    };
+
+//! Results of one frame of PolymdRerun
+struct polymd_rerun_result
+    {
+    double energy;                  //!< Potential energy
+    double pressure[6];             //!< Configurational pressure tensor W/V: xx, xy, xz, yy, yz, zz
+    std::vector<double> energies;   //!< Energy of every particle, when requested
+    };
+
+//! Re-evaluates a polydisperse model over the frames of a GSD trajectory
+/*! Analyses of a finished run often need the potential energy, the per particle energies or the stress of every
+    frame, possibly under a different model or coefficients than the ones of the run. Replaying the frames through a
+    HOOMD context costs a full system setup per frame. PolymdRerun instead reads the frames directly from a memory
+    mapped GSD file (GSDTrajectory) and evaluates them with the batch kernels of the evaluators (PolydisperseBatch),
+    without a HOOMD runtime:
+
+    - for every frame, a cell list with cells at least as wide as the largest cutoff of any pair of the frame is
+      built, with the tilt and periodicity of the box,
+    - every particle visits the distinct cells of its 27 (9 in 2D) cell neighborhood and the neighbors inside the
+      largest cutoff are evaluated by type pair, like a full neighbor list in PotentialPairPolymd,
+    - the frames are distributed over a PolymdThreadPool, each thread evaluating whole frames, and the results are
+      written in frame order in blocks, so the memory use does not grow with the length of the trajectory.
+
+    run() writes NumPy .npy files: <prefix>_frame.npy (the frame indices), <prefix>_energy.npy (the potential energy),
+    <prefix>_pressure.npy (the configurational part W/V of the pressure tensor, i.e. pressure_xx etc. of HOOMD without
+    the kinetic part, in the order xx, xy, xz, yy, yz, zz) and optionally <prefix>_energies.npy (the energy of every
+    particle, one row per frame). The files are little endian and in the precision of the build.
+
+    The coefficients are set per pair of type names with setParams(), every pair of types in the evaluated frames must
+    have them. The box must be at least twice the largest cutoff wide, as for HOOMD.
+*/
+class PolymdRerun
+    {
+    public:
+        //! Open a trajectory
+        PolymdRerun(const std::string& filename, const std::string& model);
+
+        //! Get the number of frames of the trajectory
+        uint64_t getNumFrames() const
+            {
+            return m_gsd.getNumFrames();
+            }
+
+        //! Get the type names of a frame
+        std::vector<std::string> getTypes(uint64_t frame) const;
+
+        //! Set the coefficients of a pair of types
+        void setParams(const std::string& a, const std::string& b, Scalar v0, Scalar eps, Scalar scaledr_cut);
+
+        //! Set the number of threads
+        void setNumThreads(unsigned int n_threads);
+
+        //! Get the number of threads
+        unsigned int getNumThreads() const
+            {
+            return m_pool->getNumThreads();
+            }
+
+        //! Evaluate a range of frames and write the results
+        uint64_t run(const std::string& prefix, uint64_t first, uint64_t last, uint64_t stride, bool per_particle);
+
+        //! Evaluate a single frame
+        void computeFrame(uint64_t frame, polymd_rerun_scratch& scratch, polymd_rerun_result& result,
+                          bool per_particle) const;
+
+    private:
+        GSDTrajectory m_gsd;                    //!< The trajectory
+        std::string m_model;                    //!< Name of the model
+        polydisperse_batch_func m_batch;        //!< Batch kernel of the model
+        polydisperse_params (*m_make_params)(Scalar, Scalar, Scalar); //!< Parameter helper of the model
+        std::map< std::pair<std::string, std::string>, polydisperse_params > m_params; //!< Parameters by type names
+        std::unique_ptr<PolymdThreadPool> m_pool; //!< Worker threads
+        std::vector<polymd_rerun_scratch> m_scratch; //!< Scratch space per thread
+    };
+
+#endif // __POLYMD_RERUN_H__
@@ -0,0 +1,115 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+/*! \file PolymdThreadPool.cc
+    \brief Defines the PolymdThreadPool class
+*/
+
+#include "PolymdThreadPool.h"
+
+#include <stdexcept>
+
+/*! \param n_threads Number of threads, including the calling thread
+*/
+PolymdThreadPool::PolymdThreadPool(unsigned int n_threads)
+    : m_n_threads(n_threads), m_func(NULL), m_generation(0), m_n_busy(0), m_shutdown(false)
+    {
+    if (m_n_threads == 0)
+        throw std::runtime_error("PolymdThreadPool: the number of threads must be positive");
+
+    for (unsigned int t = 1; t < m_n_threads; ++t)
+        m_workers.push_back(std::thread(&PolymdThreadPool::work, this, t));
+    }
+
+PolymdThreadPool::~PolymdThreadPool()
+    {
+        {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_shutdown = true;
+        }
+    m_start.notify_all();
+
+    for (unsigned int t = 0; t < m_workers.size(); ++t)
+        m_workers[t].join();
+    }
+
+/*! \param func Function to call with the index of each thread
+*/
+void PolymdThreadPool::run(const std::function<void (unsigned int)>& func)
+    {
+    if (m_n_threads == 1)
+        {
+        func(0);
+        return;
+        }
+
+        {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_func = &func;
+        m_n_busy = m_n_threads - 1;
+        m_error = std::exception_ptr();
+        ++m_generation;
+        }
+    m_start.notify_all();
+
+    // the calling thread takes its share, but still waits for the workers before rethrowing
+    std::exception_ptr error;
+    try
+        {
+        func(0);
+        }
+    catch (...)
+        {
+        error = std::current_exception();
+        }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_n_busy == 0; });
+    m_func = NULL;
+    if (!error)
+        error = m_error;
+    lock.unlock();
+
+    if (error)
+        std::rethrow_exception(error);
+    }
+
+/*! \param thread Index of this worker
+*/
+void PolymdThreadPool::work(unsigned int thread)
+    {
+    unsigned long generation = 0;
+    while (true)
+        {
+        const std::function<void (unsigned int)> *func;
+            {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [this, generation] { return m_shutdown || m_generation != generation; });
+            if (m_shutdown)
+                return;
+            generation = m_generation;
+            func = m_func;
+            }
+
+        std::exception_ptr error;
+        try
+            {
+            (*func)(thread);
+            }
+        catch (...)
+            {
+            error = std::current_exception();
+            }
+
+            {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (error && !m_error)
+                m_error = error;
+            if (--m_n_busy == 0)
+                m_done.notify_one();
+            }
+        }
+    }
@@ -0,0 +1,66 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __POLYMD_THREAD_POOL_H__
+#define __POLYMD_THREAD_POOL_H__
+
+/*! \file PolymdThreadPool.h
+    \brief Declares the PolymdThreadPool class
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! Persistent pool of worker threads for the CPU force computes of polymd
+/*! The workers are started once and sleep between calls, so a force evaluation only pays for waking them up.
+    run() executes a function on every thread of the pool, with the calling thread acting as thread 0, and returns
+    once all of them are done. An exception thrown on any thread is rethrown by run().
+
+    A pool with a single thread starts no workers and run() calls the function directly.
+*/
+class PolymdThreadPool
+    {
+    public:
+        //! Start the worker threads
+        PolymdThreadPool(unsigned int n_threads);
+
+        //! Stop the worker threads
+        ~PolymdThreadPool();
+
+        //! Get the number of threads, including the calling thread
+        unsigned int getNumThreads() const
+            {
+            return m_n_threads;
+            }
+
+        //! Run func(thread) on every thread and wait for all of them
+        void run(const std::function<void (unsigned int)>& func);
+
+    private:
+        unsigned int m_n_threads;                           //!< Number of threads, including the calling thread
+        std::vector<std::thread> m_workers;                 //!< Worker threads 1 to m_n_threads-1
+        std::mutex m_mutex;                                 //!< Protects the state below
+        std::condition_variable m_start;                    //!< Signals a new task to the workers
+        std::condition_variable m_done;                     //!< Signals the completion of a worker
+        const std::function<void (unsigned int)> *m_func;   //!< Current task
+        unsigned long m_generation;                         //!< Incremented for every task
+        unsigned int m_n_busy;                              //!< Number of workers still running the current task
+        bool m_shutdown;                                    //!< Set to stop the workers
+        std::exception_ptr m_error;                         //!< First exception thrown by a worker
+
+        //! Main loop of a worker thread
+        void work(unsigned int thread);
+    };
+
+#endif // __POLYMD_THREAD_POOL_H__
@@ -0,0 +1,39 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __POLYMD_VIRIAL_SUM_H__
+#define __POLYMD_VIRIAL_SUM_H__
+
+#include "hoomd/HOOMDMath.h"
+
+/*! \file PolymdVirialSum.h
+    \brief Declares the PolymdVirialSum interface
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+//! Interface of the force computes that sum their virial tensor in the pair loop
+/*! The per particle virials of a ForceCompute have to be summed over all particles to get the pressure tensor. The
+    polymd force computes already have the virial of every pair in registers in their pair loop, so they also sum it
+    there, per thread, at the cost of a few additions per particle. Consumers that need the total every step, like
+    StressCorrelationAnalyzer, get it from here instead of reading the per particle virials again.
+*/
+class PolymdVirialSum
+    {
+    public:
+        //! Destructor
+        virtual ~PolymdVirialSum() { }
+
+        //! Get the virial of the local particles summed in the last compute
+        /*! \param virial Returns xx, xy, xz, yy, yz, zz, not summed over the ranks
+            \returns False if the last compute did not compute the virial
+        */
+        virtual bool getVirialSum(Scalar *virial) const = 0;
+    };
+
+#endif // __POLYMD_VIRIAL_SUM_H__
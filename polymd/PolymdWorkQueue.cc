@@ -0,0 +1,67 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+/*! \file PolymdWorkQueue.cc
+    \brief Defines the PolymdWorkQueue class
+*/
+
+#include "PolymdWorkQueue.h"
+
+#include <algorithm>
+
+PolymdWorkQueue::PolymdWorkQueue()
+    : m_n_alloc(0), m_n_threads(0), m_steal(true)
+    {
+    }
+
+/*! \param n_neigh Number of neighbors of each particle
+    \param N Number of particles
+    \param n_threads Number of threads of the loop
+    \param steal True if the threads may steal chunks from each other
+
+    The chunk boundaries are placed where the running sum of the costs crosses multiples of the total cost divided by
+    the number of chunks, in one pass over the neighbor counts.
+*/
+void PolymdWorkQueue::partition(const unsigned int *n_neigh, unsigned int N, unsigned int n_threads, bool steal)
+    {
+    if (n_threads > m_n_alloc)
+        {
+        m_threads.reset(new thread_state[n_threads]);
+        m_n_alloc = n_threads;
+        }
+    m_n_threads = n_threads;
+    m_steal = steal;
+
+    unsigned long long total = 0;
+    for (unsigned int i = 0; i < N; ++i)
+        total += n_neigh[i] + POLYMD_PARTICLE_COST;
+
+    // chunks of equal cost, so that equal numbers of chunks per thread are balanced
+    const unsigned int chunks_per_thread = std::max(1u, std::min(POLYMD_CHUNKS_PER_THREAD, N/n_threads));
+    const unsigned int n_chunks = chunks_per_thread*n_threads;
+    m_chunk_start.resize(n_chunks + 1);
+    m_chunk_start[0] = 0;
+    unsigned long long sum = 0;
+    unsigned int chunk = 1;
+    for (unsigned int i = 0; i < N && chunk < n_chunks; ++i)
+        {
+        sum += n_neigh[i] + POLYMD_PARTICLE_COST;
+        while (chunk < n_chunks && sum*n_chunks >= total*chunk)
+            m_chunk_start[chunk++] = i + 1;
+        }
+    while (chunk <= n_chunks)
+        m_chunk_start[chunk++] = N;
+
+    for (unsigned int t = 0; t < n_threads; ++t)
+        {
+        const uint64_t begin = t*chunks_per_thread;
+        const uint64_t end = (t+1)*chunks_per_thread;
+        m_threads[t].range.store((begin << 32) | end, std::memory_order_relaxed);
+        m_threads[t].started = false;
+        m_threads[t].busy_ns = 0;
+        m_threads[t].steals = 0;
+        }
+    }
@@ -0,0 +1,155 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __POLYMD_WORK_QUEUE_H__
+#define __POLYMD_WORK_QUEUE_H__
+
+/*! \file PolymdWorkQueue.h
+    \brief Declares the PolymdWorkQueue class
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+//! Number of chunks of particles per thread in the pair loops
+const unsigned int POLYMD_CHUNKS_PER_THREAD = 16;
+
+//! Cost of a particle in a pair loop besides its neighbors, in neighbor list entries
+const unsigned int POLYMD_PARTICLE_COST = 2;
+
+//! Work of the threaded pair loops, split by neighbor list entries, with work stealing between the threads
+/*! The cost of a particle in the pair loops grows with its number of neighbors, which under continuous
+    polydispersity is several times larger for the large particles than for the small ones, and the large particles
+    are not spread evenly over the particle order. A split into equal ranges of particles then leaves some threads
+    waiting for the others.
+
+    partition() splits the local particles into POLYMD_CHUNKS_PER_THREAD contiguous chunks per thread with about the
+    same number of neighbor list entries each (plus POLYMD_PARTICLE_COST per particle), and gives every thread a
+    contiguous range of the chunks. In the pair loop, every thread takes the chunks from the front of its own range
+    with next(). A thread that runs out steals them from the back of the range of another thread, so the chunks of a
+    thread stay contiguous as long as nobody steals from it. The front and back of each range are packed into one 64 bit
+    atomic, so taking a chunk is a single compare and swap.
+
+    Without stealing, every thread only processes its own range, which is already balanced by the neighbor counts but
+    cannot react to the actual cost of the particles. The assignment of the particles to the threads then only depends
+    on the neighbor list, while with stealing it changes from run to run.
+
+    Every thread measures the time from its first to its last call of next(), which is its busy time in the loop.
+*/
+class PolymdWorkQueue
+    {
+    public:
+        //! Construct an empty queue
+        PolymdWorkQueue();
+
+        //! Split the particles into chunks by their neighbor counts and assign them to the threads
+        void partition(const unsigned int *n_neigh, unsigned int N, unsigned int n_threads, bool steal);
+
+        //! Get the next chunk of a thread
+        /*! \param thread Index of the calling thread
+            \param first Returns the first particle of the chunk
+            \param last Returns the particle after the last one of the chunk
+            \returns False when no chunks are left for this thread
+        */
+        bool next(unsigned int thread, unsigned int& first, unsigned int& last)
+            {
+            thread_state& state = m_threads[thread];
+            if (!state.started)
+                {
+                state.started = true;
+                state.start = std::chrono::steady_clock::now();
+                }
+
+            unsigned int chunk;
+            if (take(state.range, true, chunk))
+                {
+                first = m_chunk_start[chunk];
+                last = m_chunk_start[chunk+1];
+                return true;
+                }
+
+            // visit the other threads once, their ranges only shrink
+            for (unsigned int v = 1; m_steal && v < m_n_threads; ++v)
+                {
+                const unsigned int victim = (thread + v) % m_n_threads;
+                if (take(m_threads[victim].range, false, chunk))
+                    {
+                    ++state.steals;
+                    first = m_chunk_start[chunk];
+                    last = m_chunk_start[chunk+1];
+                    return true;
+                    }
+                }
+
+            state.busy_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - state.start).count();
+            return false;
+            }
+
+        //! Get the number of threads of the last partition
+        unsigned int getNumThreads() const
+            {
+            return m_n_threads;
+            }
+
+        //! Get the busy time of a thread in the last loop, in ns
+        unsigned long long getBusyTime(unsigned int thread) const
+            {
+            return m_threads[thread].busy_ns;
+            }
+
+        //! Get the number of chunks a thread stole in the last loop
+        unsigned int getSteals(unsigned int thread) const
+            {
+            return m_threads[thread].steals;
+            }
+
+    private:
+        //! State of one thread, padded so that the ranges of two threads never share a cache line
+        struct thread_state
+            {
+            std::atomic<uint64_t> range;    //!< First chunk in the upper 32 bits, end of the range in the lower ones
+            bool started;                   //!< True after the first call of next() in this loop
+            std::chrono::steady_clock::time_point start; //!< Time of the first call of next()
+            unsigned long long busy_ns;     //!< Time from the first to the last call of next()
+            unsigned int steals;            //!< Chunks taken from other threads
+            char padding[64];               //!< Keeps the next range out of this cache line
+            };
+
+        std::vector<unsigned int> m_chunk_start;        //!< First particle of every chunk, plus the end
+        std::unique_ptr<thread_state[]> m_threads;      //!< State per thread
+        unsigned int m_n_alloc;                         //!< Number of allocated thread states
+        unsigned int m_n_threads;                       //!< Number of threads of the last partition
+        bool m_steal;                                   //!< True if the threads steal chunks
+
+        //! Take a chunk from the front (owner) or the back (thief) of a range
+        static bool take(std::atomic<uint64_t>& range, bool front, unsigned int& chunk)
+            {
+            uint64_t cur = range.load(std::memory_order_relaxed);
+            while (true)
+                {
+                const uint64_t begin = cur >> 32;
+                const uint64_t end = cur & 0xffffffffu;
+                if (begin >= end)
+                    return false;
+                const uint64_t desired = front ? (((begin + 1) << 32) | end) : ((begin << 32) | (end - 1));
+                if (range.compare_exchange_weak(cur, desired, std::memory_order_relaxed))
+                    {
+                    chunk = (unsigned int)(front ? begin : end - 1);
+                    return true;
+                    }
+                }
+            }
+    };
+
+#endif // __POLYMD_WORK_QUEUE_H__
@@ -0,0 +1,2018 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __POTENTIAL_PAIR_POLYMD_H__
+#define __POTENTIAL_PAIR_POLYMD_H__
+
+#include "hoomd/md/PotentialPair.h"
+#include "PolydisperseBatch.h"
+#include "PolymdAutoRcut.h"
+#include "PolymdDiameterScale.h"
+#include "PolymdDiscreteDiameters.h"
+#include "PolymdFixedPoint.h"
+#include "PolymdPairLoopTime.h"
+#include "PolymdPairTables.h"
+#include "PolymdThreadPool.h"
+#include "PolymdVirialSum.h"
+#include "PolymdWorkQueue.h"
+#include "NeighborListDiameterClass.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <vector>
+
+/*! \file PotentialPairPolymd.h
+    \brief Defines the template class for the multithreaded CPU force compute of the polydisperse potentials
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+#include <hoomd/extern/pybind/include/pybind11/pybind11.h>
+#include <hoomd/extern/pybind/include/pybind11/stl.h>
+
+//! Scratch space of one thread of PotentialPairPolymd
+struct polymd_pair_scratch
+    {
+    std::vector<unsigned int> j;        //!< Neighbor indices of the current particle
+    std::vector<unsigned int> typej;    //!< Neighbor types
+    std::vector<Scalar3> dx;            //!< Minimum image separations
+    std::vector<Scalar> rsq;            //!< Squared distances
+    std::vector<Scalar> dj;             //!< Neighbor diameters
+    std::vector<Scalar2> pair_cache;    //!< Cached (1/sigma_ij^2, cutoff^2) of the neighbors, instead of dj
+    std::vector<const Scalar2*> discrete_row; //!< Row of the discrete table of the current particle, per type
+    std::vector<Scalar> force_divr;     //!< Batch results, force divided by r
+    std::vector<Scalar> pair_eng;       //!< Batch results, pair energy
+
+    std::vector<float> rsq_mixed;       //!< rsq gathered in float for the mixed precision kernels
+    std::vector<float> dj_mixed;        //!< dj gathered in float
+    std::vector<float2> cache_mixed;    //!< pair_cache gathered in float
+    std::vector<float> force_mixed;     //!< Mixed precision batch results, in sorted order when sorted
+    std::vector<float> eng_mixed;       //!< Mixed precision batch results, in sorted order when sorted
+
+    std::vector<unsigned int> order;    //!< Neighbors sorted by type, when there are several
+    std::vector<unsigned int> type_start; //!< First sorted neighbor of each type
+    std::vector<Scalar> sorted_rsq;     //!< rsq sorted by type
+    std::vector<Scalar> sorted_dj;      //!< dj sorted by type
+    std::vector<Scalar2> sorted_cache;  //!< pair_cache sorted by type
+    std::vector<Scalar> sorted_force;   //!< Batch results in sorted order
+    std::vector<Scalar> sorted_eng;     //!< Batch results in sorted order
+    std::vector<float> sorted_rsq_mixed; //!< rsq_mixed sorted by type
+    std::vector<float> sorted_dj_mixed; //!< dj_mixed sorted by type
+    std::vector<float2> sorted_cache_mixed; //!< cache_mixed sorted by type
+
+    std::vector<Scalar4> force;         //!< Private force and energy buffer for half neighbor lists
+    std::vector<Scalar> virial;         //!< Private virial buffer for half neighbor lists
+    std::vector<Scalar> energy;         //!< Private energy buffer of the energy queries with half neighbor lists
+
+    unsigned long long n_visited;       //!< Neighbor list entries visited by this thread in the current compute
+    unsigned long long n_evaluated;     //!< Pairs inside the cutoff found by this thread in the current compute
+    Scalar virial_sum[6];               //!< Virial of the local particles summed by this thread in the current compute
+
+    std::vector<uint64_t> fixed;        //!< Fixed point force, energy and virial buffer for half neighbor lists
+    uint64_t fixed_virial_sum[6];       //!< Fixed point virial summed by this thread
+    uint64_t fixed_energy;              //!< Fixed point energy summed by this thread in the energy queries
+    bool fixed_overflow;                //!< True if a contribution exceeded the fixed point range
+
+    polymd_pair_scratch() : n_visited(0), n_evaluated(0), fixed_energy(0), fixed_overflow(false) { }
+
+    //! Make room for n neighbors
+    void reserve(unsigned int n)
+        {
+        if (rsq.size() >= n)
+            return;
+        j.resize(n); typej.resize(n); dx.resize(n); rsq.resize(n); dj.resize(n); pair_cache.resize(n);
+        force_divr.resize(n); pair_eng.resize(n);
+        order.resize(n); sorted_rsq.resize(n); sorted_dj.resize(n); sorted_cache.resize(n);
+        sorted_force.resize(n); sorted_eng.resize(n);
+        rsq_mixed.resize(n); dj_mixed.resize(n); cache_mixed.resize(n); force_mixed.resize(n); eng_mixed.resize(n);
+        sorted_rsq_mixed.resize(n); sorted_dj_mixed.resize(n); sorted_cache_mixed.resize(n);
+        }
+    };
+
+//! Counters of the pair loop of PotentialPairPolymd
+struct polymd_pair_counters
+    {
+    unsigned long long visited;     //!< Neighbor list entries visited
+    unsigned long long evaluated;   //!< Pairs inside the polydisperse cutoff
+    unsigned long long time_ns;     //!< Wall time of the pair loop, in ns
+    unsigned long long computes;    //!< Number of force computes
+    unsigned long long steals;      //!< Chunks of particles stolen by the threads
+    Scalar imbalance;               //!< Busy time of the slowest thread over the mean busy time of the threads
+
+    //! Start from zero
+    polymd_pair_counters() : visited(0), evaluated(0), time_ns(0), computes(0), steals(0), imbalance(0) { }
+    };
+
+//! Host pointers to the arrays read by the force loop of PotentialPairPolymd
+/*! The arrays are acquired once by the calling thread, since GPUArray does not allow several concurrent handles.
+*/
+template<class param_type>
+struct polymd_pair_args
+    {
+    const unsigned int *n_neigh;    //!< Number of neighbors of each particle
+    const unsigned int *nlist;      //!< Neighbor list
+    const unsigned int *head_list;  //!< First neighbor of each particle
+    const Scalar4 *pos;             //!< Positions and types
+    const Scalar *diameter;         //!< Diameters
+    Scalar diameter_scale;          //!< Factor applied to all diameters, see setDiameterScale()
+    const param_type *params;       //!< Parameters per type pair
+    const Scalar2 *pair_cache;      //!< Pair cache of NeighborListDiameterClass, NULL to evaluate from the diameters
+    const unsigned char *discrete_index; //!< Discrete diameter of each particle, NULL outside of the discrete mode
+    const Scalar2 *discrete_table;  //!< (1/sigma_ij^2, cutoff^2) by type pair and discrete diameters
+    unsigned int n_discrete;        //!< Number of discrete diameters
+    };
+
+//! Multithreaded CPU force compute for the polydisperse pair potentials
+/*! PotentialPairPolymd computes the same forces, energies and virials as PotentialPair<evaluator>, with two
+    differences in how it walks the neighbor list:
+
+    - The local particles are split into chunks of about equal numbers of neighbor list entries, which are processed
+      concurrently by a persistent PolymdThreadPool, see PolymdWorkQueue. Every thread starts on its own contiguous
+      range of chunks and steals chunks from the others when it is done, unless setWorkStealing(false). With a full
+      neighbor list every thread only writes the particles of its own chunks, so no synchronization is needed. With a
+      half neighbor list, the forces on j go to a private buffer per thread, and the buffers are summed in parallel at
+      the end.
+    - The neighbors of each particle are gathered into contiguous arrays and evaluated by the vectorized batch kernel of
+      the evaluator (see PolydisperseBatch.h), one call per neighbor type.
+
+    Full neighbor lists are preferred with several threads, since they avoid the extra buffers and the reduction. The
+    xplor shift mode falls back to the single threaded PotentialPair code path. The other shift modes do not change
+    the polydisperse potentials, which already vanish smoothly at the cutoff.
+
+    After setTable(), the batches are looked up in reduced distance spline tables instead of evaluating the model, see
+    PolymdPairTables.
+
+    With setMixedPrecision(true), the pair arithmetic (sigma_ij, the inverse powers and the smoothing polynomial) is
+    done in float by PolydisperseBatch::getMixed(), while the distances are computed and the per particle force,
+    energy and virial are accumulated in Scalar. The distances and diameters (or pair cache entries) are converted to
+    float once when the neighbors are gathered, and the results once after the batch. Mixed precision does not apply
+    to the tables.
+
+    With setSkipEnergy(true), the pair energies are only computed on the time steps where the potential energy is
+    requested through the particle data flags, like the virial already is. On the other steps the force only builds of
+    the batch kernels skip the energy, and the energies in the force array are zero. The log quantity of this force is
+    then computed on demand with computeEnergy(). This is off by default, since some consumers of the per particle
+    energies, like the FIRE minimizer, read them without requesting the flag.
+
+    When the neighbor list is a NeighborListDiameterClass with the same reduced cutoff and non-additivity for every
+    type pair, the batches read 1/sigma_ij^2 and the cutoff of each pair from its pair cache (see
+    PolydisperseBatch::getCached()) instead of gathering the neighbor diameters. The tables and the energy queries
+    still work from the diameters.
+
+    After setDiscrete(), the diameters are expected to take a few discrete values, and the batches look up 1/sigma_ij^2
+    and the cutoff by pair of discrete diameters (see PolymdDiscreteDiameters), with the same cached kernels. The
+    discrete mode takes precedence over the pair cache of the neighbor list, and is ignored in table mode.
+
+    setDiameterScale() multiplies the diameters of all particles by one factor where the pair loop gathers them (see
+    PolymdDiameterScale), for UpdaterInflate. While the factor is not 1, the pair cache of the neighbor list, which
+    holds sigma_ij of the diameters of the particle data, is not used. The discrete mode and the xplor fallback, which
+    gathers the diameters in the base class, cannot follow the growth.
+
+    Every compute counts the neighbor list entries visited and the pairs found inside the polydisperse cutoff, and
+    measures the wall time of the pair loop (without the neighbor list build). The counts come from the return values
+    of the batch kernels, which cost no more than an addition per batch. They are available as log quantities and
+    from getCounters(), summed over the ranks (the time is the largest of the ranks). Every thread also measures its
+    busy time in the pair loop, see getThreadBusyTimes(), and the counters report the busy time of the slowest thread
+    over the mean of the threads (the largest of the ranks) and the number of stolen chunks. The xplor fallback does not
+    count. The time of the pair loop is also summed without resets for LoadBalancerPolydisperse, see
+    PolymdPairLoopTime.
+
+    With work stealing and a half neighbor list, the forces on j are spread over the private buffers of the threads
+    differently in every compute, so the floating point sums change in the last bits from run to run. Full neighbor
+    lists, setWorkStealing(false) or setFixedPoint(true) give reproducible results.
+
+    When the virial is computed, the pair loop also sums it over the local particles, see PolymdVirialSum. The xplor
+    fallback sums the per particle virials instead.
+
+    After setFixedPoint(true), the force, energy and virial contributions of every pair are converted to 64 bit fixed
+    point (see polymd_fixed_point) and summed as integers, in computeForces() and in the energy queries. The sums then
+    do not depend on the order of the pairs, and the results are bitwise identical for any number of threads and any
+    order of the neighbor list. With a half neighbor list, every thread needs a fixed point buffer of 4, or 10 with the
+    virial, sums per local particle for the particles j, zeroed at every compute, also with a single thread. A half
+    list is still faster than a full one, which evaluates every pair twice. A pair beyond the fixed point range is an
+    error. The xplor fallback is single threaded and does not use fixed point.
+
+    After setAutoRcut(true), the cutoff of every type pair and the maximum diameter of the neighbor list are derived
+    from the diameters of the particles and the parameters, see PolymdAutoRcut. They are only derived again when
+    setParams() or notifyDiametersChange() marked them out of date, and never inside a compute: the communicator has
+    already exchanged the ghosts of the step for the old cutoffs by then. The python class derives them at the start of
+    every run, and the polymd updaters that change the diameters call notifyDiametersChange() before the integrator
+    step. The neighbor list is only told when they change.
+
+    computeEnergy() and computeEnergies() walk the neighbor list like computeForces(), but only evaluate the pair
+    energies with PolydisperseBatch::getEnergy() and leave the force and virial arrays untouched. They are meant for
+    line searches and Monte Carlo tests that only need the energy of the current configuration. The energies are
+    always evaluated exactly, also in table and mixed precision mode.
+
+    \tparam evaluator One of the EvaluatorPairPolydisperseMNQ instantiations
+*/
+template < class evaluator >
+class PotentialPairPolymd : public PotentialPair<evaluator>, public PolymdVirialSum, public PolymdPairLoopTime,
+                            public PolymdDiameterScale
+    {
+    public:
+        //! Param type from evaluator
+        typedef typename evaluator::param_type param_type;
+
+        //! Construct the pair potential
+        PotentialPairPolymd(std::shared_ptr<SystemDefinition> sysdef,
+                            std::shared_ptr<NeighborList> nlist,
+                            const std::string& log_suffix="");
+        //! Destructor
+        virtual ~PotentialPairPolymd() { };
+
+        //! Set the number of threads
+        void setNumThreads(unsigned int n_threads);
+
+        //! Get the number of threads
+        unsigned int getNumThreads() const
+            {
+            return m_pool->getNumThreads();
+            }
+
+        //! Set the parameters for a single type pair
+        virtual void setParams(unsigned int typ1, unsigned int typ2, const param_type& param)
+            {
+            PotentialPair<evaluator>::setParams(typ1, typ2, param);
+            m_tables.setDirty();
+            m_discrete.setDirty();
+            m_auto_rcut.setDirty();
+            }
+
+        //! Evaluate the potential from spline tables
+        void setTable(unsigned int width, Scalar r_min, Scalar error_bound)
+            {
+            m_tables.set(width, r_min, error_bound);
+            }
+
+        //! Evaluate the potential exactly
+        void disableTable()
+            {
+            m_tables.disable();
+            }
+
+        //! Get the largest error of the tables, relative to max(|value|, |v0|)
+        Scalar getTableError();
+
+        //! Get the largest number of intervals of the tables
+        unsigned int getTableWidth();
+
+        //! Look up sigma_ij and the cutoff by pair of discrete diameters
+        void setDiscrete(const std::vector<Scalar>& diameters)
+            {
+            m_discrete.set(diameters);
+            }
+
+        //! Evaluate sigma_ij and the cutoff from the diameters again
+        void disableDiscrete()
+            {
+            m_discrete.disable();
+            }
+
+        //! Get the discrete diameters, given or detected so far
+        std::vector<Scalar> getDiscreteDiameters() const
+            {
+            return m_discrete.getDiameters();
+            }
+
+        //! Do the pair arithmetic in float
+        void setMixedPrecision(bool mixed)
+            {
+            m_mixed = mixed;
+            }
+
+        //! Check whether the pair arithmetic is done in float
+        bool getMixedPrecision() const
+            {
+            return m_mixed;
+            }
+
+        //! Sum the pair contributions in fixed point with the given number of fraction bits
+        void setFixedPoint(bool enable, unsigned int bits);
+
+        //! Check whether the pair contributions are summed in fixed point
+        bool getFixedPoint() const
+            {
+            return m_fixed_point;
+            }
+
+        //! Skip the energies on steps where they are not requested
+        void setSkipEnergy(bool skip)
+            {
+            m_skip_energy = skip;
+            }
+
+        //! Check whether the energies are skipped on steps where they are not requested
+        bool getSkipEnergy() const
+            {
+            return m_skip_energy;
+            }
+
+        //! Returns a list of log quantities this compute calculates
+        virtual std::vector< std::string > getProvidedLogQuantities();
+
+        //! Calculates the requested log value and returns it
+        virtual Scalar getLogValue(const std::string& quantity, unsigned int timestep);
+
+        //! Get the counters of the last compute and the totals since the last reset
+        std::map<std::string, Scalar> getCounters();
+
+        //! Reset the total counters
+        void resetCounters()
+            {
+            m_counters_total = polymd_pair_counters();
+            m_thread_busy_total.assign(m_pool->getNumThreads(), 0);
+            }
+
+        //! Get the busy time of every thread in the pair loops since the last reset, in ns
+        std::vector<unsigned long long> getThreadBusyTimes() const
+            {
+            return m_thread_busy_total;
+            }
+
+        //! Let the threads steal work from each other
+        void setWorkStealing(bool enable)
+            {
+            m_work_stealing = enable;
+            }
+
+        //! Check whether the threads steal work from each other
+        bool getWorkStealing() const
+            {
+            return m_work_stealing;
+            }
+
+        //! Get the virial of the local particles summed in the last compute
+        virtual bool getVirialSum(Scalar *virial) const
+            {
+            for (unsigned int l = 0; l < 6; ++l)
+                virial[l] = m_virial_sum[l];
+            return m_virial_sum_valid;
+            }
+
+        //! Get the wall time of the pair loop summed over all computes on this rank, in ns
+        virtual unsigned long long getPairLoopTime() const
+            {
+            return m_pair_loop_time;
+            }
+
+        //! Set the factor applied to all diameters in the pair loop
+        virtual void setDiameterScale(Scalar scale);
+
+        //! Get the factor applied to all diameters in the pair loop
+        virtual Scalar getDiameterScale() const
+            {
+            return m_diameter_scale;
+            }
+
+        //! Get the largest change of the cutoff of any pair when the diameters in [d_min, d_max] are scaled
+        virtual Scalar getCutoffChange(Scalar scale, Scalar d_min, Scalar d_max);
+
+        //! Assign the discrete diameters and derive the cutoffs again after the diameters of the particle data changed
+        virtual void notifyDiametersChange()
+            {
+            m_discrete.setIndexDirty();
+            m_auto_rcut.setDirty();
+            updateAutoRcut();
+            }
+
+        //! Compute the total potential energy without the forces
+        Scalar computeEnergy(unsigned int timestep);
+
+        //! Compute the potential energy of every particle without the forces
+        std::vector<Scalar> computeEnergies(unsigned int timestep);
+
+        //! Derive the cutoffs of the neighbor list from the diameters
+        void setAutoRcut(bool enable)
+            {
+            m_auto_rcut.setEnabled(enable);
+            }
+
+        //! Check whether the cutoffs are derived from the diameters
+        bool getAutoRcut() const
+            {
+            return m_auto_rcut.isEnabled();
+            }
+
+        //! Derive the cutoffs and the maximum diameter if they are out of date and pass them to the neighbor list
+        void updateAutoRcut();
+
+        //! Get the derived cutoff of a type pair
+        Scalar getAutoRcutPair(unsigned int typ1, unsigned int typ2)
+            {
+            const std::vector<Scalar>& r_cut = m_auto_rcut.getRcut();
+            return r_cut.empty() ? Scalar(0.0) : r_cut[this->m_typpair_idx(typ1, typ2)];
+            }
+
+        //! Get the derived maximum diameter
+        Scalar getAutoDMax() const
+            {
+            return m_auto_rcut.getDMax();
+            }
+
+        //! Get the expected number of neighbor list entries per particle with the derived cutoffs
+        Scalar getExpectedNeighbors() const
+            {
+            return m_auto_rcut.getExpectedNeighbors();
+            }
+
+        //! Get the parameters of all type pairs, e.g. for UpdaterSwapMC
+        const GPUArray<param_type>& getParamsArray() const
+            {
+            return this->m_params;
+            }
+
+    protected:
+        std::unique_ptr<PolymdThreadPool> m_pool;       //!< Worker threads
+        std::vector<polymd_pair_scratch> m_scratch;     //!< Scratch space per thread
+        PolymdWorkQueue m_queue;                        //!< Chunks of the pair loops
+        bool m_work_stealing;                           //!< True if the threads steal chunks from each other
+        std::vector<unsigned long long> m_thread_busy_total; //!< Busy time per thread since the last reset, in ns
+        polydisperse_batch_func m_batch;                //!< Batch kernel for this CPU
+        polydisperse_mixed_batch_func m_batch_mixed;    //!< Mixed precision batch kernel for this CPU
+        polydisperse_batch_func m_batch_force;          //!< Force only batch kernel for this CPU
+        polydisperse_mixed_batch_func m_batch_mixed_force; //!< Force only mixed precision batch kernel for this CPU
+        polydisperse_energy_batch_func m_energy_batch;  //!< Energy only batch kernel for this CPU
+        polydisperse_cached_batch_func m_batch_cached[2]; //!< Cached batch kernels for this CPU, by energy
+        polydisperse_mixed_cached_batch_func m_batch_mixed_cached[2]; //!< Mixed precision cached kernels, by energy
+        std::shared_ptr<NeighborListDiameterClass> m_nlist_class; //!< The neighbor list, if it has a pair cache
+        bool m_mixed;                                   //!< True if the pair arithmetic is done in float
+        bool m_skip_energy;                             //!< True if the energies are only computed when requested
+        bool m_energy_valid;                            //!< True if the last computeForces() computed the energies
+        bool m_virial_sum_valid;                        //!< True if the last computeForces() computed the virial
+        bool m_fixed_point;                             //!< True if the pair contributions are summed in fixed point
+        polymd_fixed_point m_fixed;                     //!< Fixed point conversion
+        Scalar m_virial_sum[6];                         //!< Virial of the local particles summed in the last compute
+
+        PolymdPairTables<evaluator> m_tables;           //!< Spline tables of the type pairs
+        PolymdDiscreteDiameters m_discrete;             //!< Table of sigma_ij by pair of discrete diameters
+        PolymdAutoRcut m_auto_rcut;                     //!< Cutoffs derived from the diameters
+        Scalar m_diameter_scale;                        //!< Factor applied to all diameters in the pair loop
+
+        std::string m_log_suffix;                       //!< Suffix of the counter log quantities
+        polymd_pair_counters m_counters_last;           //!< Counters of the last compute
+        polymd_pair_counters m_counters_total;          //!< Counters since the last reset
+        unsigned long long m_pair_loop_time;            //!< Time of the pair loop since construction, in ns
+
+        //! Sum the counters over the ranks
+        polymd_pair_counters reduceCounters(const polymd_pair_counters& local);
+
+        //! Check whether the pair cache of the neighbor list matches the parameters
+        bool usePairCache(const param_type *params);
+
+        //! Evaluate a batch of neighbors of one type, the energies only if \a energy is true
+        unsigned int evalNeighbors(unsigned int typpair,
+                                   const param_type& params,
+                                   Scalar di,
+                                   const Scalar *rsq,
+                                   const Scalar *dj,
+                                   const Scalar2 *pair_cache,
+                                   unsigned int n_neigh,
+                                   Scalar *force_divr,
+                                   Scalar *pair_eng,
+                                   bool energy)
+            {
+            if (pair_cache)
+                return m_batch_cached[energy](params, rsq, pair_cache, n_neigh, force_divr, pair_eng);
+            if (m_tables.isEnabled())
+                return m_tables.eval(typpair, params, di, rsq, dj, n_neigh, force_divr, pair_eng);
+            return (energy ? m_batch : m_batch_force)(params, di, rsq, dj, n_neigh, force_divr, pair_eng);
+            }
+
+        //! Evaluate a batch of neighbors of one type gathered in float with the mixed precision kernels
+        unsigned int evalNeighborsMixed(const param_type& params,
+                                        Scalar di,
+                                        const float *rsq,
+                                        const float *dj,
+                                        const float2 *pair_cache,
+                                        unsigned int n_neigh,
+                                        float *force_divr,
+                                        float *pair_eng,
+                                        bool energy)
+            {
+            if (pair_cache)
+                return m_batch_mixed_cached[energy](params, rsq, pair_cache, n_neigh, force_divr, pair_eng);
+            return (energy ? m_batch_mixed : m_batch_mixed_force)(params, di, rsq, dj, n_neigh, force_divr, pair_eng);
+            }
+
+        //! Actually compute the forces
+        virtual void computeForces(unsigned int timestep);
+
+        //! Gather the separations and diameters of the neighbors of particle i
+        unsigned int gatherNeighbors(polymd_pair_scratch& scratch,
+                                     const polymd_pair_args<param_type>& args,
+                                     unsigned int i,
+                                     bool& mixed,
+                                     bool in_float);
+
+        //! Sort the gathered neighbors by type
+        void sortNeighbors(polymd_pair_scratch& scratch, unsigned int size, bool cached, bool in_float);
+
+        //! Gather and evaluate the neighbors of particle i
+        unsigned int evalParticle(polymd_pair_scratch& scratch,
+                                  const polymd_pair_args<param_type>& args,
+                                  unsigned int i,
+                                  bool compute_energy);
+
+        //! Gather the neighbors of particle i and evaluate their energies
+        unsigned int evalParticleEnergy(polymd_pair_scratch& scratch,
+                                        const polymd_pair_args<param_type>& args,
+                                        unsigned int i,
+                                        bool unsort,
+                                        Scalar& sum);
+
+        //! Compute the local pair energies, per particle if \a energy is not NULL
+        Scalar computeLocalEnergy(unsigned int timestep, Scalar *energy);
+
+        //! Compute the pair forces of a range of particles
+        template<bool compute_energy, bool compute_virial>
+        void computeRange(polymd_pair_scratch& scratch,
+                          const polymd_pair_args<param_type>& args,
+                          unsigned int first,
+                          unsigned int last,
+                          bool third_law,
+                          Scalar4 *force,
+                          Scalar *virial,
+                          unsigned int virial_pitch);
+
+        //! Compute the pair forces of a range of particles with the specialization of computeRange() for the flags
+        void computeRange(polymd_pair_scratch& scratch,
+                          const polymd_pair_args<param_type>& args,
+                          unsigned int first,
+                          unsigned int last,
+                          bool third_law,
+                          bool compute_energy,
+                          bool compute_virial,
+                          Scalar4 *force,
+                          Scalar *virial,
+                          unsigned int virial_pitch)
+            {
+            if (compute_energy && compute_virial)
+                computeRange<true, true>(scratch, args, first, last, third_law, force, virial, virial_pitch);
+            else if (compute_energy)
+                computeRange<true, false>(scratch, args, first, last, third_law, force, virial, virial_pitch);
+            else if (compute_virial)
+                computeRange<false, true>(scratch, args, first, last, third_law, force, virial, virial_pitch);
+            else
+                computeRange<false, false>(scratch, args, first, last, third_law, force, virial, virial_pitch);
+            }
+
+        //! Compute the pair forces of a range of particles in fixed point
+        template<bool compute_energy, bool compute_virial>
+        void computeRangeFixed(polymd_pair_scratch& scratch,
+                               const polymd_pair_args<param_type>& args,
+                               unsigned int first,
+                               unsigned int last,
+                               bool third_law,
+                               Scalar4 *force,
+                               Scalar *virial,
+                               unsigned int virial_pitch);
+
+        //! Compute the pair forces of a range of particles in fixed point, specialized for the flags
+        void computeRangeFixed(polymd_pair_scratch& scratch,
+                               const polymd_pair_args<param_type>& args,
+                               unsigned int first,
+                               unsigned int last,
+                               bool third_law,
+                               bool compute_energy,
+                               bool compute_virial,
+                               Scalar4 *force,
+                               Scalar *virial,
+                               unsigned int virial_pitch)
+            {
+            if (compute_energy && compute_virial)
+                computeRangeFixed<true, true>(scratch, args, first, last, third_law, force, virial, virial_pitch);
+            else if (compute_energy)
+                computeRangeFixed<true, false>(scratch, args, first, last, third_law, force, virial, virial_pitch);
+            else if (compute_virial)
+                computeRangeFixed<false, true>(scratch, args, first, last, third_law, force, virial, virial_pitch);
+            else
+                computeRangeFixed<false, false>(scratch, args, first, last, third_law, force, virial, virial_pitch);
+            }
+
+        //! Compute the pair energies of a range of particles in fixed point
+        void computeEnergyRangeFixed(polymd_pair_scratch& scratch,
+                                     const polymd_pair_args<param_type>& args,
+                                     unsigned int first,
+                                     unsigned int last,
+                                     bool third_law,
+                                     Scalar *energy);
+
+        //! Report an error if a contribution exceeded the fixed point range in the last compute
+        void checkFixedOverflow();
+
+        //! Report an error if the diameters are scaled in the xplor fallback
+        void checkXplorDiameterScale();
+
+        //! Compute the pair energies of a range of particles
+        Scalar computeEnergyRange(polymd_pair_scratch& scratch,
+                                  const polymd_pair_args<param_type>& args,
+                                  unsigned int first,
+                                  unsigned int last,
+                                  bool third_law,
+                                  Scalar *energy);
+    };
+
+/*! \param sysdef System to compute forces on
+    \param nlist Neighborlist to use for computing the forces
+    \param log_suffix Name given to this instance of the force
+*/
+template < class evaluator >
+PotentialPairPolymd< evaluator >::PotentialPairPolymd(std::shared_ptr<SystemDefinition> sysdef,
+                                                      std::shared_ptr<NeighborList> nlist,
+                                                      const std::string& log_suffix)
+    : PotentialPair<evaluator>(sysdef, nlist, log_suffix), m_work_stealing(true),
+      m_batch(PolydisperseBatch<evaluator>::get()),
+      m_batch_mixed(PolydisperseBatch<evaluator>::getMixed()),
+      m_batch_force(PolydisperseBatch<evaluator>::get(false)),
+      m_batch_mixed_force(PolydisperseBatch<evaluator>::getMixed(false)),
+      m_energy_batch(PolydisperseBatch<evaluator>::getEnergy()), m_mixed(false), m_skip_energy(false),
+      m_energy_valid(true), m_virial_sum_valid(false), m_fixed_point(false),
+      m_tables(this->m_exec_conf, this->m_pdata), m_discrete(this->m_pdata, "pair." + evaluator::getName()),
+      m_auto_rcut(sysdef, nlist, "pair." + evaluator::getName()), m_diameter_scale(1.0), m_log_suffix(log_suffix),
+      m_pair_loop_time(0)
+    {
+    this->m_exec_conf->msg->notice(5) << "Constructing PotentialPairPolymd<" << evaluator::getName() << ">" << std::endl;
+    for (unsigned int energy = 0; energy < 2; ++energy)
+        {
+        m_batch_cached[energy] = PolydisperseBatch<evaluator>::getCached(energy);
+        m_batch_mixed_cached[energy] = PolydisperseBatch<evaluator>::getMixedCached(energy);
+        }
+    m_nlist_class = std::dynamic_pointer_cast<NeighborListDiameterClass>(nlist);
+    std::fill(m_virial_sum, m_virial_sum + 6, Scalar(0.0));
+    setNumThreads(1);
+    }
+
+/*! \param n_threads Number of threads to compute the forces with
+*/
+template < class evaluator >
+void PotentialPairPolymd< evaluator >::setNumThreads(unsigned int n_threads)
+    {
+    if (n_threads == 0)
+        {
+        this->m_exec_conf->msg->error() << "pair." << evaluator::getName() << ": the number of threads must be positive"
+                                        << std::endl;
+        throw std::runtime_error("Error setting the number of threads");
+        }
+
+    if (m_pool && m_pool->getNumThreads() == n_threads)
+        return;
+
+    m_pool.reset(new PolymdThreadPool(n_threads));
+    m_scratch.clear();
+    m_scratch.resize(n_threads);
+    m_thread_busy_total.assign(n_threads, 0);
+    }
+
+/*! \param enable True to sum the pair contributions in fixed point
+    \param bits Number of fraction bits, between POLYMD_FIXED_POINT_MIN_BITS and POLYMD_FIXED_POINT_MAX_BITS
+*/
+template < class evaluator >
+void PotentialPairPolymd< evaluator >::setFixedPoint(bool enable, unsigned int bits)
+    {
+    if (bits < POLYMD_FIXED_POINT_MIN_BITS || bits > POLYMD_FIXED_POINT_MAX_BITS)
+        {
+        this->m_exec_conf->msg->error() << "pair." << evaluator::getName() << ": the number of fixed point bits must be "
+                                        << "between " << POLYMD_FIXED_POINT_MIN_BITS << " and "
+                                        << POLYMD_FIXED_POINT_MAX_BITS << std::endl;
+        throw std::runtime_error("Error setting the fixed point accumulation");
+        }
+    m_fixed_point = enable;
+    m_fixed = polymd_fixed_point(bits);
+    }
+
+/*! The shift mode can be changed after setDiameterScale(), so the xplor fallback checks the factor again.
+*/
+template < class evaluator >
+void PotentialPairPolymd< evaluator >::checkXplorDiameterScale()
+    {
+    if (m_diameter_scale != Scalar(1.0))
+        {
+        this->m_exec_conf->msg->error() << "pair." << evaluator::getName() << ": the diameters cannot be scaled in "
+                                        << "the xplor shift mode" << std::endl;
+        throw std::runtime_error("Error computing pair forces");
+        }
+    }
+
+template < class evaluator >
+void PotentialPairPolymd< evaluator >::checkFixedOverflow()
+    {
+    for (unsigned int t = 0; t < m_scratch.size(); ++t)
+        {
+        if (m_scratch[t].fixed_overflow)
+            {
+            this->m_exec_conf->msg->error() << "pair." << evaluator::getName() << ": a pair contribution exceeds the "
+                                            << "fixed point range of " << m_fixed.limit << ", use fewer fixed point bits"
+                                            << std::endl;
+            throw std::runtime_error("Error computing pair forces");
+            }
+        }
+    }
+
+/*! \returns The largest error of the current tables, 0 when they are not used
+*/
+template < class evaluator >
+Scalar PotentialPairPolymd< evaluator >::getTableError()
+    {
+    if (m_tables.isEnabled())
+        {
+        ArrayHandle<param_type> h_params(this->m_params, access_location::host, access_mode::read);
+        m_tables.update(h_params.data, this->m_typpair_idx);
+        }
+    return m_tables.getError();
+    }
+
+/*! \returns The largest number of intervals of the current tables, 0 when they are not used
+*/
+template < class evaluator >
+unsigned int PotentialPairPolymd< evaluator >::getTableWidth()
+    {
+    if (m_tables.isEnabled())
+        {
+        ArrayHandle<param_type> h_params(this->m_params, access_location::host, access_mode::read);
+        m_tables.update(h_params.data, this->m_typpair_idx);
+        }
+    return m_tables.getWidth();
+    }
+
+/*! See PolymdAutoRcut::update() for how the cutoffs are derived. The neighbor list gets them from PolymdAutoRcut, and
+    this force keeps the same cutoffs for the pair loop. Every rank must call it.
+*/
+template< class evaluator >
+void PotentialPairPolymd< evaluator >::updateAutoRcut()
+    {
+    bool changed;
+        {
+        ArrayHandle<param_type> h_params(this->m_params, access_location::host, access_mode::read);
+        changed = m_auto_rcut.update(h_params.data, this->m_typpair_idx);
+        }
+    if (!changed)
+        return;
+
+    const std::vector<Scalar>& r_cut = m_auto_rcut.getRcut();
+    const unsigned int ntypes = this->m_pdata->getNTypes();
+    for (unsigned int a = 0; a < ntypes; ++a)
+        for (unsigned int b = a; b < ntypes; ++b)
+            PotentialPair<evaluator>::setRcut(a, b, std::max(r_cut[this->m_typpair_idx(a, b)], Scalar(0.0)));
+    }
+
+/*! \param scale Factor applied to all diameters in the pair loop, positive
+*/
+template< class evaluator >
+void PotentialPairPolymd< evaluator >::setDiameterScale(Scalar scale)
+    {
+    if (!(scale > Scalar(0.0)))
+        {
+        this->m_exec_conf->msg->error() << "pair." << evaluator::getName() << ": the diameter scale must be positive"
+                                        << std::endl;
+        throw std::runtime_error("Error setting the diameter scale");
+        }
+    if (m_discrete.isEnabled() && scale != Scalar(1.0))
+        {
+        this->m_exec_conf->msg->error() << "pair." << evaluator::getName() << ": the diameters cannot be scaled in "
+                                        << "discrete mode" << std::endl;
+        throw std::runtime_error("Error setting the diameter scale");
+        }
+    if (this->m_shift_mode == PotentialPair<evaluator>::xplor && scale != Scalar(1.0))
+        {
+        this->m_exec_conf->msg->error() << "pair." << evaluator::getName() << ": the diameters cannot be scaled in "
+                                        << "the xplor shift mode" << std::endl;
+        throw std::runtime_error("Error setting the diameter scale");
+        }
+    m_diameter_scale = scale;
+    }
+
+/*! \param scale Factor applied to all diameters
+    \param d_min Smallest diameter
+    \param d_max Largest diameter
+    \returns A bound of the change of the cutoff of any type pair, see polymd_cutoff_change()
+*/
+template< class evaluator >
+Scalar PotentialPairPolymd< evaluator >::getCutoffChange(Scalar scale, Scalar d_min, Scalar d_max)
+    {
+    ArrayHandle<param_type> h_params(this->m_params, access_location::host, access_mode::read);
+    Scalar change = Scalar(0.0);
+    for (unsigned int s = 0; s < this->m_typpair_idx.getNumElements(); ++s)
+        {
+        const param_type& param = h_params.data[s];
+        if (param.v0 != Scalar(0.0))
+            change = std::max(change, polymd_cutoff_change(param.scaledrcutsq, param.eps, scale, d_min, d_max));
+        }
+    return change;
+    }
+
+/*! \returns The energy of the base class and the counters of the pair loop
+*/
+template< class evaluator >
+std::vector< std::string > PotentialPairPolymd< evaluator >::getProvidedLogQuantities()
+    {
+    std::vector<std::string> list = PotentialPair<evaluator>::getProvidedLogQuantities();
+    list.push_back("polydisperse_pairs_visited" + m_log_suffix);
+    list.push_back("polydisperse_pairs_evaluated" + m_log_suffix);
+    list.push_back("polydisperse_pairs_rejected" + m_log_suffix);
+    list.push_back("polydisperse_cutoff_efficiency" + m_log_suffix);
+    list.push_back("polydisperse_time_ns" + m_log_suffix);
+    list.push_back("polydisperse_thread_imbalance" + m_log_suffix);
+    return list;
+    }
+
+/*! \param quantity Name of the log quantity to get
+    \param timestep Current time step of the simulation
+
+    The counters are those of the force compute of \a timestep.
+*/
+template< class evaluator >
+Scalar PotentialPairPolymd< evaluator >::getLogValue(const std::string& quantity, unsigned int timestep)
+    {
+    if (quantity == this->m_log_name)
+        {
+        this->compute(timestep);
+        return m_energy_valid ? this->calcEnergySum() : computeEnergy(timestep);
+        }
+
+    const std::string prefix("polydisperse_");
+    if (quantity.compare(0, prefix.size(), prefix) == 0)
+        {
+        this->compute(timestep);
+        const polymd_pair_counters last = reduceCounters(m_counters_last);
+        if (quantity == "polydisperse_pairs_visited" + m_log_suffix)
+            return Scalar(last.visited);
+        if (quantity == "polydisperse_pairs_evaluated" + m_log_suffix)
+            return Scalar(last.evaluated);
+        if (quantity == "polydisperse_pairs_rejected" + m_log_suffix)
+            return Scalar(last.visited - last.evaluated);
+        if (quantity == "polydisperse_cutoff_efficiency" + m_log_suffix)
+            return last.visited ? Scalar(last.evaluated)/Scalar(last.visited) : Scalar(0.0);
+        if (quantity == "polydisperse_time_ns" + m_log_suffix)
+            return Scalar(last.time_ns);
+        if (quantity == "polydisperse_thread_imbalance" + m_log_suffix)
+            return last.imbalance;
+        }
+    return PotentialPair<evaluator>::getLogValue(quantity, timestep);
+    }
+
+/*! \returns The counters of the last compute (visited, evaluated, rejected, cutoff_efficiency, time_ns,
+              thread_imbalance, steals) and since the last resetCounters() (total_visited, total_evaluated,
+              total_rejected, total_time_ns, total_thread_imbalance, total_steals, computes)
+*/
+template< class evaluator >
+std::map<std::string, Scalar> PotentialPairPolymd< evaluator >::getCounters()
+    {
+    const polymd_pair_counters last = reduceCounters(m_counters_last);
+    const polymd_pair_counters total = reduceCounters(m_counters_total);
+
+    std::map<std::string, Scalar> counters;
+    counters["visited"] = Scalar(last.visited);
+    counters["evaluated"] = Scalar(last.evaluated);
+    counters["rejected"] = Scalar(last.visited - last.evaluated);
+    counters["cutoff_efficiency"] = last.visited ? Scalar(last.evaluated)/Scalar(last.visited) : Scalar(0.0);
+    counters["time_ns"] = Scalar(last.time_ns);
+    counters["thread_imbalance"] = last.imbalance;
+    counters["steals"] = Scalar(last.steals);
+    counters["total_visited"] = Scalar(total.visited);
+    counters["total_evaluated"] = Scalar(total.evaluated);
+    counters["total_rejected"] = Scalar(total.visited - total.evaluated);
+    counters["total_time_ns"] = Scalar(total.time_ns);
+    counters["total_thread_imbalance"] = total.imbalance;
+    counters["total_steals"] = Scalar(total.steals);
+    counters["computes"] = Scalar(total.computes);
+    return counters;
+    }
+
+/*! \param local Counters of this rank
+    \returns The counts summed over all ranks, and the largest time and thread imbalance of the ranks
+*/
+template< class evaluator >
+polymd_pair_counters PotentialPairPolymd< evaluator >::reduceCounters(const polymd_pair_counters& local)
+    {
+    polymd_pair_counters counters = local;
+#ifdef ENABLE_MPI
+    if (this->m_pdata->getDomainDecomposition())
+        {
+        unsigned long long counts[3] = {local.visited, local.evaluated, local.steals};
+        MPI_Allreduce(MPI_IN_PLACE, counts, 3, MPI_UNSIGNED_LONG_LONG, MPI_SUM,
+                      this->m_exec_conf->getMPICommunicator());
+        MPI_Allreduce(MPI_IN_PLACE, &counters.time_ns, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX,
+                      this->m_exec_conf->getMPICommunicator());
+        MPI_Allreduce(MPI_IN_PLACE, &counters.imbalance, 1, MPI_HOOMD_SCALAR, MPI_MAX,
+                      this->m_exec_conf->getMPICommunicator());
+        counters.visited = counts[0];
+        counters.evaluated = counts[1];
+        counters.steals = counts[2];
+        }
+#endif
+    return counters;
+    }
+
+/*! \param timestep specifies the current time step of the simulation
+
+    See the class documentation for how the work is split between the threads.
+*/
+template< class evaluator >
+void PotentialPairPolymd< evaluator >::computeForces(unsigned int timestep)
+    {
+    // xplor smoothing is evaluated per pair by the base class
+    if (this->m_shift_mode == PotentialPair<evaluator>::xplor)
+        {
+        checkXplorDiameterScale();
+        PotentialPair<evaluator>::computeForces(timestep);
+        m_energy_valid = true;
+
+        PDataFlags flags = this->m_pdata->getFlags();
+        m_virial_sum_valid = flags[pdata_flag::pressure_tensor] || flags[pdata_flag::isotropic_virial];
+        std::fill(m_virial_sum, m_virial_sum + 6, Scalar(0.0));
+        if (m_virial_sum_valid)
+            {
+            ArrayHandle<Scalar> h_virial(this->m_virial, access_location::host, access_mode::read);
+            for (unsigned int l = 0; l < 6; ++l)
+                for (unsigned int i = 0; i < this->m_pdata->getN(); ++i)
+                    m_virial_sum[l] += h_virial.data[l*this->m_virial_pitch+i];
+            }
+        return;
+        }
+
+    // start by updating the neighborlist
+    this->m_nlist->compute(timestep);
+
+    // start the profile for this compute
+    if (this->m_prof) this->m_prof->push(this->m_prof_name);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    const bool third_law = this->m_nlist->getStorageMode() == NeighborList::half;
+    const unsigned int N = this->m_pdata->getN();
+    const unsigned int n_threads = m_pool->getNumThreads();
+    const bool private_buffers = third_law && n_threads > 1;
+
+    PDataFlags flags = this->m_pdata->getFlags();
+    const bool compute_virial = flags[pdata_flag::pressure_tensor] || flags[pdata_flag::isotropic_virial];
+    const bool compute_energy = !m_skip_energy || flags[pdata_flag::potential_energy];
+    m_energy_valid = compute_energy;
+    m_virial_sum_valid = compute_virial;
+
+    // access the neighbor list and particle data, the threads only see the raw pointers
+    ArrayHandle<unsigned int> h_n_neigh(this->m_nlist->getNNeighArray(), access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_nlist(this->m_nlist->getNListArray(), access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_head_list(this->m_nlist->getHeadList(), access_location::host, access_mode::read);
+
+    ArrayHandle<Scalar4> h_pos(this->m_pdata->getPositions(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar> h_diameter(this->m_pdata->getDiameters(), access_location::host, access_mode::read);
+    ArrayHandle<param_type> h_params(this->m_params, access_location::host, access_mode::read);
+
+    polymd_pair_args<param_type> args;
+    args.n_neigh = h_n_neigh.data;
+    args.nlist = h_nlist.data;
+    args.head_list = h_head_list.data;
+    args.pos = h_pos.data;
+    args.diameter = h_diameter.data;
+    args.diameter_scale = m_diameter_scale;
+    args.params = h_params.data;
+    args.pair_cache = NULL;
+    args.discrete_index = NULL;
+    args.discrete_table = NULL;
+    args.n_discrete = 0;
+
+    m_tables.update(h_params.data, this->m_typpair_idx);
+
+    // look up sigma_ij and the cutoff by discrete diameters, or read them from the neighbor list when it has them
+    std::unique_ptr< ArrayHandle<Scalar2> > h_pair_cache;
+    if (!m_tables.isEnabled() && m_discrete.update(h_diameter.data, N + this->m_pdata->getNGhosts(), h_params.data,
+                                                   this->m_typpair_idx.getNumElements()))
+        {
+        args.discrete_index = m_discrete.getIndex();
+        args.discrete_table = m_discrete.getTable();
+        args.n_discrete = m_discrete.getDiameters().size();
+        }
+    else if (usePairCache(h_params.data))
+        {
+        h_pair_cache.reset(new ArrayHandle<Scalar2>(m_nlist_class->getPairCacheArray(), access_location::host,
+                                                    access_mode::read));
+        args.pair_cache = h_pair_cache->data;
+        }
+
+    ArrayHandle<Scalar4> h_force(this->m_force, access_location::host, access_mode::overwrite);
+    ArrayHandle<Scalar> h_virial(this->m_virial, access_location::host, access_mode::overwrite);
+    const unsigned int virial_pitch = this->m_virial_pitch;
+
+    // need to start from a zero force, energy and virial
+    memset((void*)h_force.data, 0, sizeof(Scalar4)*this->m_force.getNumElements());
+    memset((void*)h_virial.data, 0, sizeof(Scalar)*this->m_virial.getNumElements());
+
+    m_queue.partition(h_n_neigh.data, N, n_threads, m_work_stealing);
+    m_pool->run([&](unsigned int thread)
+        {
+        polymd_pair_scratch& scratch = m_scratch[thread];
+        scratch.n_visited = 0;
+        scratch.n_evaluated = 0;
+        std::fill(scratch.virial_sum, scratch.virial_sum + 6, Scalar(0.0));
+
+        unsigned int first, last;
+        if (m_fixed_point)
+            {
+            scratch.fixed_overflow = false;
+            std::fill(scratch.fixed_virial_sum, scratch.fixed_virial_sum + 6, uint64_t(0));
+            if (third_law)
+                scratch.fixed.assign((compute_virial ? 10 : 4)*N, uint64_t(0));
+            while (m_queue.next(thread, first, last))
+                computeRangeFixed(scratch, args, first, last, third_law, compute_energy, compute_virial, h_force.data,
+                                  h_virial.data, virial_pitch);
+            }
+        else if (private_buffers)
+            {
+            scratch.force.assign(N, make_scalar4(0.0, 0.0, 0.0, 0.0));
+            scratch.virial.assign(compute_virial ? 6*N : 0, Scalar(0.0));
+            while (m_queue.next(thread, first, last))
+                computeRange(scratch, args, first, last, third_law, compute_energy, compute_virial, &scratch.force[0],
+                             compute_virial ? &scratch.virial[0] : NULL, N);
+            }
+        else
+            {
+            while (m_queue.next(thread, first, last))
+                computeRange(scratch, args, first, last, third_law, compute_energy, compute_virial, h_force.data,
+                             h_virial.data, virial_pitch);
+            }
+        });
+
+    if (m_fixed_point)
+        checkFixedOverflow();
+
+    // sum the fixed point buffers in any order and convert them, each thread over its own range of particles
+    if (m_fixed_point && third_law)
+        {
+        const unsigned int n_fields = compute_virial ? 10 : 4;
+        m_pool->run([&](unsigned int thread)
+            {
+            const unsigned int first = (unsigned int)((unsigned long)N*thread/n_threads);
+            const unsigned int last = (unsigned int)((unsigned long)N*(thread+1)/n_threads);
+            for (unsigned int i = first; i < last; ++i)
+                {
+                uint64_t q[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+                for (unsigned int t = 0; t < n_threads; ++t)
+                    for (unsigned int c = 0; c < n_fields; ++c)
+                        q[c] += m_scratch[t].fixed[i*n_fields+c];
+                h_force.data[i] = make_scalar4(m_fixed.toScalar(q[0]), m_fixed.toScalar(q[1]),
+                                               m_fixed.toScalar(q[2]), m_fixed.toScalar(q[3]));
+                if (compute_virial)
+                    {
+                    for (unsigned int l = 0; l < 6; ++l)
+                        h_virial.data[l*virial_pitch+i] = m_fixed.toScalar(q[4+l]);
+                    }
+                }
+            });
+        }
+
+    // sum the private buffers, each thread over its own range of particles
+    else if (private_buffers)
+        {
+        m_pool->run([&](unsigned int thread)
+            {
+            const unsigned int first = (unsigned int)((unsigned long)N*thread/n_threads);
+            const unsigned int last = (unsigned int)((unsigned long)N*(thread+1)/n_threads);
+            for (unsigned int t = 0; t < n_threads; ++t)
+                {
+                const polymd_pair_scratch& scratch = m_scratch[t];
+                for (unsigned int i = first; i < last; ++i)
+                    {
+                    h_force.data[i].x += scratch.force[i].x;
+                    h_force.data[i].y += scratch.force[i].y;
+                    h_force.data[i].z += scratch.force[i].z;
+                    h_force.data[i].w += scratch.force[i].w;
+                    }
+                if (compute_virial)
+                    {
+                    for (unsigned int l = 0; l < 6; ++l)
+                        for (unsigned int i = first; i < last; ++i)
+                            h_virial.data[l*virial_pitch+i] += scratch.virial[l*N+i];
+                    }
+                }
+            });
+        }
+
+    // update the counters and the virial sum
+    m_counters_last = polymd_pair_counters();
+    std::fill(m_virial_sum, m_virial_sum + 6, Scalar(0.0));
+    unsigned long long busy_max = 0, busy_sum = 0, busy_total_max = 0, busy_total_sum = 0;
+    for (unsigned int t = 0; t < n_threads; ++t)
+        {
+        m_counters_last.visited += m_scratch[t].n_visited;
+        m_counters_last.evaluated += m_scratch[t].n_evaluated;
+        m_counters_last.steals += m_queue.getSteals(t);
+        for (unsigned int l = 0; l < 6; ++l)
+            m_virial_sum[l] += m_scratch[t].virial_sum[l];
+
+        const unsigned long long busy = m_queue.getBusyTime(t);
+        m_thread_busy_total[t] += busy;
+        busy_max = std::max(busy_max, busy);
+        busy_sum += busy;
+        busy_total_max = std::max(busy_total_max, m_thread_busy_total[t]);
+        busy_total_sum += m_thread_busy_total[t];
+        }
+    m_counters_last.imbalance = busy_sum ? Scalar(busy_max)*Scalar(n_threads)/Scalar(busy_sum) : Scalar(1.0);
+    if (m_fixed_point)
+        {
+        for (unsigned int l = 0; l < 6; ++l)
+            {
+            uint64_t q = 0;
+            for (unsigned int t = 0; t < n_threads; ++t)
+                q += m_scratch[t].fixed_virial_sum[l];
+            m_virial_sum[l] = m_fixed.toScalar(q);
+            }
+        }
+    m_counters_last.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    m_counters_last.computes = 1;
+    m_counters_total.visited += m_counters_last.visited;
+    m_counters_total.evaluated += m_counters_last.evaluated;
+    m_counters_total.time_ns += m_counters_last.time_ns;
+    m_pair_loop_time += m_counters_last.time_ns;
+    m_counters_total.computes += 1;
+    m_counters_total.steals += m_counters_last.steals;
+    m_counters_total.imbalance = busy_total_sum ? Scalar(busy_total_max)*Scalar(n_threads)/Scalar(busy_total_sum)
+                                                : Scalar(1.0);
+
+    if (this->m_prof) this->m_prof->pop();
+    }
+
+/*! \param scratch Scratch space of the calling thread
+    \param args Particle data and neighbor list
+    \param i Particle whose neighbors are evaluated
+    \param compute_energy True if the pair energies are needed
+    \returns The number of neighbors. Their separations, forces divided by r and pair energies are left in scratch.dx,
+             scratch.force_divr and scratch.pair_eng, in the order of the neighbor list.
+*/
+template< class evaluator >
+unsigned int PotentialPairPolymd< evaluator >::evalParticle(polymd_pair_scratch& scratch,
+                                                            const polymd_pair_args<param_type>& args,
+                                                            unsigned int i,
+                                                            bool compute_energy)
+    {
+    const unsigned int ntypes = this->m_pdata->getNTypes();
+    const bool cached = args.pair_cache || args.discrete_table;
+    const unsigned int typei = __scalar_as_int(args.pos[i].w);
+    const Scalar di = args.diameter[i]*args.diameter_scale;
+    const bool in_float = m_mixed && !m_tables.isEnabled();
+
+    bool mixed = false;
+    const unsigned int size = gatherNeighbors(scratch, args, i, mixed, in_float);
+    if (size == 0)
+        return 0;
+
+    // evaluate them with one batch per neighbor type
+    scratch.n_visited += size;
+    if (!mixed && in_float)
+        {
+        const unsigned int typpair = this->m_typpair_idx(typei, scratch.typej[0]);
+        scratch.n_evaluated += evalNeighborsMixed(args.params[typpair], di, &scratch.rsq_mixed[0],
+                                                  &scratch.dj_mixed[0], cached ? &scratch.cache_mixed[0] : NULL,
+                                                  size, &scratch.force_mixed[0], &scratch.eng_mixed[0],
+                                                  compute_energy);
+        for (unsigned int k = 0; k < size; k++)
+            scratch.force_divr[k] = scratch.force_mixed[k];
+        if (compute_energy)
+            for (unsigned int k = 0; k < size; k++)
+                scratch.pair_eng[k] = scratch.eng_mixed[k];
+        }
+    else if (!mixed)
+        {
+        const unsigned int typpair = this->m_typpair_idx(typei, scratch.typej[0]);
+        scratch.n_evaluated += evalNeighbors(typpair, args.params[typpair], di, &scratch.rsq[0], &scratch.dj[0],
+                                             cached ? &scratch.pair_cache[0] : NULL, size,
+                                             &scratch.force_divr[0], &scratch.pair_eng[0], compute_energy);
+        }
+    else if (in_float)
+        {
+        sortNeighbors(scratch, size, cached, true);
+        unsigned int start = 0;
+        for (unsigned int t = 0; t < ntypes; t++)
+            {
+            const unsigned int end = scratch.type_start[t];
+            if (end > start)
+                {
+                const unsigned int typpair = this->m_typpair_idx(typei, t);
+                scratch.n_evaluated += evalNeighborsMixed(args.params[typpair], di, &scratch.sorted_rsq_mixed[start],
+                                                          &scratch.sorted_dj_mixed[start],
+                                                          cached ? &scratch.sorted_cache_mixed[start] : NULL,
+                                                          end - start, &scratch.force_mixed[start],
+                                                          &scratch.eng_mixed[start], compute_energy);
+                }
+            start = end;
+            }
+        for (unsigned int s = 0; s < size; s++)
+            {
+            scratch.force_divr[scratch.order[s]] = scratch.force_mixed[s];
+            if (compute_energy)
+                scratch.pair_eng[scratch.order[s]] = scratch.eng_mixed[s];
+            }
+        }
+    else
+        {
+        sortNeighbors(scratch, size, cached, false);
+        unsigned int start = 0;
+        for (unsigned int t = 0; t < ntypes; t++)
+            {
+            const unsigned int end = scratch.type_start[t];
+            if (end > start)
+                {
+                const unsigned int typpair = this->m_typpair_idx(typei, t);
+                scratch.n_evaluated += evalNeighbors(typpair, args.params[typpair], di,
+                                                     &scratch.sorted_rsq[start], &scratch.sorted_dj[start],
+                                                     cached ? &scratch.sorted_cache[start] : NULL, end - start,
+                                                     &scratch.sorted_force[start], &scratch.sorted_eng[start],
+                                                     compute_energy);
+                }
+            start = end;
+            }
+        for (unsigned int s = 0; s < size; s++)
+            {
+            scratch.force_divr[scratch.order[s]] = scratch.sorted_force[s];
+            if (compute_energy)
+                scratch.pair_eng[scratch.order[s]] = scratch.sorted_eng[s];
+            }
+        }
+    return size;
+    }
+
+/*! \param scratch Scratch space of the calling thread
+    \param args Particle data and neighbor list
+    \param first First particle of the range
+    \param last One past the last particle of the range
+    \param third_law True if the neighbor list is half and the forces on j must be added too
+    \param force Force and energy array to accumulate into
+    \param virial Virial array to accumulate into
+    \param virial_pitch Pitch of the virial array
+    \tparam compute_energy True if the energies are needed, the force only kernels are used otherwise
+    \tparam compute_virial True if the virial is needed
+*/
+template< class evaluator >
+template< bool compute_energy, bool compute_virial >
+void PotentialPairPolymd< evaluator >::computeRange(polymd_pair_scratch& scratch,
+                                                    const polymd_pair_args<param_type>& args,
+                                                    unsigned int first,
+                                                    unsigned int last,
+                                                    bool third_law,
+                                                    Scalar4 *force,
+                                                    Scalar *virial,
+                                                    unsigned int virial_pitch)
+    {
+    const unsigned int N = this->m_pdata->getN();
+
+    for (unsigned int i = first; i < last; i++)
+        {
+        const unsigned int size = evalParticle(scratch, args, i, compute_energy);
+        if (size == 0)
+            continue;
+
+        // accumulate the force, energy and virial, neighbors beyond the cutoff contribute zeros
+        Scalar3 fi = make_scalar3(0, 0, 0);
+        Scalar pei = 0.0;
+        Scalar virialxxi = 0.0;
+        Scalar virialxyi = 0.0;
+        Scalar virialxzi = 0.0;
+        Scalar virialyyi = 0.0;
+        Scalar virialyzi = 0.0;
+        Scalar virialzzi = 0.0;
+        Scalar virialj[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+
+        for (unsigned int k = 0; k < size; k++)
+            {
+            const Scalar force_divr = scratch.force_divr[k];
+            const Scalar pair_eng = compute_energy ? scratch.pair_eng[k] : Scalar(0.0);
+            const Scalar3 dx = scratch.dx[k];
+            const Scalar force_div2r = force_divr * Scalar(0.5);
+
+            fi += dx*force_divr;
+            if (compute_energy)
+                pei += pair_eng * Scalar(0.5);
+            if (compute_virial)
+                {
+                virialxxi += force_div2r*dx.x*dx.x;
+                virialxyi += force_div2r*dx.x*dx.y;
+                virialxzi += force_div2r*dx.x*dx.z;
+                virialyyi += force_div2r*dx.y*dx.y;
+                virialyzi += force_div2r*dx.y*dx.z;
+                virialzzi += force_div2r*dx.z*dx.z;
+                }
+
+            // add the force to particle j if we are using the third law, only for local particles
+            const unsigned int j = scratch.j[k];
+            if (third_law && j < N)
+                {
+                force[j].x -= dx.x*force_divr;
+                force[j].y -= dx.y*force_divr;
+                force[j].z -= dx.z*force_divr;
+                if (compute_energy)
+                    force[j].w += pair_eng * Scalar(0.5);
+                if (compute_virial)
+                    {
+                    virial[0*virial_pitch+j] += force_div2r*dx.x*dx.x;
+                    virial[1*virial_pitch+j] += force_div2r*dx.x*dx.y;
+                    virial[2*virial_pitch+j] += force_div2r*dx.x*dx.z;
+                    virial[3*virial_pitch+j] += force_div2r*dx.y*dx.y;
+                    virial[4*virial_pitch+j] += force_div2r*dx.y*dx.z;
+                    virial[5*virial_pitch+j] += force_div2r*dx.z*dx.z;
+                    virialj[0] += force_div2r*dx.x*dx.x;
+                    virialj[1] += force_div2r*dx.x*dx.y;
+                    virialj[2] += force_div2r*dx.x*dx.z;
+                    virialj[3] += force_div2r*dx.y*dx.y;
+                    virialj[4] += force_div2r*dx.y*dx.z;
+                    virialj[5] += force_div2r*dx.z*dx.z;
+                    }
+                }
+            }
+
+        // finally, increment the force, potential energy and virial for particle i
+        force[i].x += fi.x;
+        force[i].y += fi.y;
+        force[i].z += fi.z;
+        if (compute_energy)
+            force[i].w += pei;
+        if (compute_virial)
+            {
+            virial[0*virial_pitch+i] += virialxxi;
+            virial[1*virial_pitch+i] += virialxyi;
+            virial[2*virial_pitch+i] += virialxzi;
+            virial[3*virial_pitch+i] += virialyyi;
+            virial[4*virial_pitch+i] += virialyzi;
+            virial[5*virial_pitch+i] += virialzzi;
+
+            scratch.virial_sum[0] += virialxxi + virialj[0];
+            scratch.virial_sum[1] += virialxyi + virialj[1];
+            scratch.virial_sum[2] += virialxzi + virialj[2];
+            scratch.virial_sum[3] += virialyyi + virialj[3];
+            scratch.virial_sum[4] += virialyzi + virialj[4];
+            scratch.virial_sum[5] += virialzzi + virialj[5];
+            }
+        }
+    }
+
+/*! \param scratch Scratch space of the calling thread
+    \param args Particle data and neighbor list
+    \param first First particle of the range
+    \param last One past the last particle of the range
+    \param third_law True if the neighbor list is half and the forces on j must be added too
+    \param force Force and energy array to write the forces of a full neighbor list to
+    \param virial Virial array to write the virials of a full neighbor list to
+    \param virial_pitch Pitch of the virial array
+    \tparam compute_energy True if the energies are needed, the force only kernels are used otherwise
+    \tparam compute_virial True if the virial is needed
+
+    Every contribution is converted to fixed point before it is summed. With a full neighbor list, the sums of
+    particle i are complete at the end of its loop and written to \a force and \a virial. With a half list, they are
+    added to scratch.fixed together with the contributions to j, and computeForces() adds the buffers of all threads.
+    The buffer holds the 4, or 10 with the virial, sums of each particle next to each other, so that the contributions
+    to j touch one or two cache lines.
+
+    The virial sums are only converted when \a compute_virial is set and the energy sums only when \a compute_energy is
+    set.
+*/
+template< class evaluator >
+template< bool compute_energy, bool compute_virial >
+void PotentialPairPolymd< evaluator >::computeRangeFixed(polymd_pair_scratch& scratch,
+                                                         const polymd_pair_args<param_type>& args,
+                                                         unsigned int first,
+                                                         unsigned int last,
+                                                         bool third_law,
+                                                         Scalar4 *force,
+                                                         Scalar *virial,
+                                                         unsigned int virial_pitch)
+    {
+    const unsigned int N = this->m_pdata->getN();
+    const polymd_fixed_point fixed = m_fixed;
+    const unsigned int n_fields = compute_virial ? 10 : 4;
+    uint64_t *buffer = third_law ? &scratch.fixed[0] : NULL;
+    bool overflow = false;
+
+    for (unsigned int i = first; i < last; i++)
+        {
+        const unsigned int size = evalParticle(scratch, args, i, compute_energy);
+        if (size == 0)
+            continue;
+
+        // force, energy and virial of i, and the virial of the j in the same order as computeRange()
+        uint64_t qi[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+        uint64_t virialj[6] = {0, 0, 0, 0, 0, 0};
+
+        for (unsigned int k = 0; k < size; k++)
+            {
+            const Scalar force_divr = scratch.force_divr[k];
+            const Scalar3 dx = scratch.dx[k];
+            const Scalar force_div2r = force_divr * Scalar(0.5);
+
+            // a pair out of range is skipped, the compute then stops with an error
+            if (!fixed.pairInRange(force_divr, scratch.rsq[k], compute_energy ? scratch.pair_eng[k] : Scalar(0.0),
+                                   compute_virial))
+                {
+                overflow = true;
+                continue;
+                }
+
+            uint64_t q[10];
+            q[0] = fixed.convertInRange(dx.x*force_divr);
+            q[1] = fixed.convertInRange(dx.y*force_divr);
+            q[2] = fixed.convertInRange(dx.z*force_divr);
+            q[3] = compute_energy ? fixed.convertInRange(scratch.pair_eng[k] * Scalar(0.5)) : 0;
+            if (compute_virial)
+                {
+                q[4] = fixed.convertInRange(force_div2r*dx.x*dx.x);
+                q[5] = fixed.convertInRange(force_div2r*dx.x*dx.y);
+                q[6] = fixed.convertInRange(force_div2r*dx.x*dx.z);
+                q[7] = fixed.convertInRange(force_div2r*dx.y*dx.y);
+                q[8] = fixed.convertInRange(force_div2r*dx.y*dx.z);
+                q[9] = fixed.convertInRange(force_div2r*dx.z*dx.z);
+                }
+
+            for (unsigned int c = 0; c < 4; c++)
+                qi[c] += q[c];
+            if (compute_virial)
+                {
+                for (unsigned int c = 4; c < 10; c++)
+                    qi[c] += q[c];
+                }
+
+            // add the force to particle j if we are using the third law, only for local particles
+            const unsigned int j = scratch.j[k];
+            if (third_law && j < N)
+                {
+                uint64_t *qj = buffer + j*n_fields;
+                qj[0] -= q[0];
+                qj[1] -= q[1];
+                qj[2] -= q[2];
+                if (compute_energy)
+                    qj[3] += q[3];
+                if (compute_virial)
+                    {
+                    for (unsigned int l = 0; l < 6; l++)
+                        {
+                        qj[4+l] += q[4+l];
+                        virialj[l] += q[4+l];
+                        }
+                    }
+                }
+            }
+
+        if (third_law)
+            {
+            for (unsigned int c = 0; c < n_fields; c++)
+                buffer[i*n_fields+c] += qi[c];
+            }
+        else
+            {
+            force[i] = make_scalar4(fixed.toScalar(qi[0]), fixed.toScalar(qi[1]), fixed.toScalar(qi[2]),
+                                    fixed.toScalar(qi[3]));
+            if (compute_virial)
+                {
+                for (unsigned int l = 0; l < 6; l++)
+                    virial[l*virial_pitch+i] = fixed.toScalar(qi[4+l]);
+                }
+            }
+        if (compute_virial)
+            {
+            for (unsigned int l = 0; l < 6; l++)
+                scratch.fixed_virial_sum[l] += qi[4+l] + virialj[l];
+            }
+        }
+
+    if (overflow)
+        scratch.fixed_overflow = true;
+    }
+
+/*! \param params Parameters of each type pair
+    \returns True if the pair cache of the neighbor list can replace the diameters in computeForces()
+
+    The cache is used when the neighbor list is a NeighborListDiameterClass whose reduced cutoff and non-additivity
+    are the ones of this force for every type pair, so that it holds the same sigma_ij and cutoffs as the evaluator,
+    and the diameters are not scaled.
+*/
+template< class evaluator >
+bool PotentialPairPolymd< evaluator >::usePairCache(const param_type *params)
+    {
+    if (!m_nlist_class || m_tables.isEnabled() || !m_nlist_class->hasPairCache() || m_diameter_scale != Scalar(1.0))
+        return false;
+
+    const unsigned int ntypes = this->m_pdata->getNTypes();
+    for (unsigned int a = 0; a < ntypes; ++a)
+        {
+        for (unsigned int b = a; b < ntypes; ++b)
+            {
+            const param_type& param = params[this->m_typpair_idx(a, b)];
+            const Scalar2 poly = m_nlist_class->getPolydisperseParams(a, b);
+            if (param.v0 == Scalar(0.0))
+                continue;
+            if (poly.x*poly.x != param.scaledrcutsq || poly.y != param.eps)
+                return false;
+            }
+        }
+    return true;
+    }
+
+/*! \param scratch Scratch space of the calling thread
+    \param args Particle data and neighbor list
+    \param i Particle whose neighbors are gathered
+    \param mixed Set to true if the neighbors have more than one type
+    \param in_float True to gather the diameters or pair cache entries, and a copy of the distances, in float for the
+                    mixed precision kernels
+    \returns Number of neighbors of particle i
+*/
+template< class evaluator >
+unsigned int PotentialPairPolymd< evaluator >::gatherNeighbors(polymd_pair_scratch& scratch,
+                                                               const polymd_pair_args<param_type>& args,
+                                                               unsigned int i,
+                                                               bool& mixed,
+                                                               bool in_float)
+    {
+    const BoxDim& box = this->m_pdata->getBox();
+    const Scalar3 pi = make_scalar3(args.pos[i].x, args.pos[i].y, args.pos[i].z);
+    const unsigned int myHead = args.head_list[i];
+    const unsigned int size = (unsigned int)args.n_neigh[i];
+    if (size == 0)
+        return 0;
+    scratch.reserve(size);
+
+    // gather the separations and diameters of all neighbors
+    for (unsigned int k = 0; k < size; k++)
+        {
+        const unsigned int j = args.nlist[myHead + k];
+        Scalar3 pj = make_scalar3(args.pos[j].x, args.pos[j].y, args.pos[j].z);
+        Scalar3 dx = box.minImage(pi - pj);
+
+        scratch.j[k] = j;
+        scratch.typej[k] = __scalar_as_int(args.pos[j].w);
+        scratch.dx[k] = dx;
+        scratch.rsq[k] = dot(dx, dx);
+        if (in_float)
+            {
+            scratch.rsq_mixed[k] = float(scratch.rsq[k]);
+            if (args.pair_cache)
+                {
+                const Scalar2 cache = args.pair_cache[myHead + k];
+                scratch.cache_mixed[k] = make_float2(float(cache.x), float(cache.y));
+                }
+            else if (!args.discrete_table)
+                scratch.dj_mixed[k] = float(args.diameter[j]*args.diameter_scale);
+            }
+        else if (args.pair_cache)
+            scratch.pair_cache[k] = args.pair_cache[myHead + k];
+        else if (!args.discrete_table)
+            scratch.dj[k] = args.diameter[j]*args.diameter_scale;
+        mixed |= (scratch.typej[k] != scratch.typej[0]);
+        }
+
+    // look up the pairs in the rows of the discrete table of particle i
+    if (args.discrete_table)
+        {
+        const unsigned int typei = __scalar_as_int(args.pos[i].w);
+        const unsigned int n_discrete = args.n_discrete;
+        const unsigned int ntypes = this->m_pdata->getNTypes();
+        scratch.discrete_row.resize(ntypes);
+        for (unsigned int t = 0; t < ntypes; ++t)
+            scratch.discrete_row[t] = args.discrete_table
+                                      + (this->m_typpair_idx(typei, t)*n_discrete + args.discrete_index[i])*n_discrete;
+        for (unsigned int k = 0; k < size; k++)
+            {
+            const Scalar2 cache = scratch.discrete_row[scratch.typej[k]][args.discrete_index[scratch.j[k]]];
+            if (in_float)
+                scratch.cache_mixed[k] = make_float2(float(cache.x), float(cache.y));
+            else
+                scratch.pair_cache[k] = cache;
+            }
+        }
+    return size;
+    }
+
+/*! \param scratch Scratch space of the calling thread, with the neighbors gathered by gatherNeighbors()
+    \param size Number of gathered neighbors
+    \param cached True to sort the pair cache entries instead of the diameters
+    \param in_float True to sort the arrays gathered in float
+
+    Fills order, sorted_rsq and sorted_dj (or sorted_cache), or their float versions, with a counting sort by type.
+    Afterwards type_start[t] holds the end of type t in the sorted arrays.
+*/
+template< class evaluator >
+void PotentialPairPolymd< evaluator >::sortNeighbors(polymd_pair_scratch& scratch, unsigned int size, bool cached,
+                                                     bool in_float)
+    {
+    const unsigned int ntypes = this->m_pdata->getNTypes();
+    scratch.type_start.assign(ntypes+1, 0);
+    for (unsigned int k = 0; k < size; k++)
+        scratch.type_start[scratch.typej[k]+1]++;
+    for (unsigned int t = 0; t < ntypes; t++)
+        scratch.type_start[t+1] += scratch.type_start[t];
+    for (unsigned int k = 0; k < size; k++)
+        {
+        const unsigned int s = scratch.type_start[scratch.typej[k]]++;
+        scratch.order[s] = k;
+        if (in_float)
+            {
+            scratch.sorted_rsq_mixed[s] = scratch.rsq_mixed[k];
+            if (cached)
+                scratch.sorted_cache_mixed[s] = scratch.cache_mixed[k];
+            else
+                scratch.sorted_dj_mixed[s] = scratch.dj_mixed[k];
+            }
+        else
+            {
+            scratch.sorted_rsq[s] = scratch.rsq[k];
+            if (cached)
+                scratch.sorted_cache[s] = scratch.pair_cache[k];
+            else
+                scratch.sorted_dj[s] = scratch.dj[k];
+            }
+        }
+    }
+
+/*! \param timestep specifies the current time step of the simulation
+    \returns The total potential energy of this force, summed over all ranks
+*/
+template< class evaluator >
+Scalar PotentialPairPolymd< evaluator >::computeEnergy(unsigned int timestep)
+    {
+    Scalar energy = computeLocalEnergy(timestep, NULL);
+
+#ifdef ENABLE_MPI
+    if (this->m_pdata->getDomainDecomposition())
+        {
+        MPI_Allreduce(MPI_IN_PLACE, &energy, 1, MPI_HOOMD_SCALAR, MPI_SUM,
+                      this->m_exec_conf->getMPICommunicator());
+        }
+#endif
+    return energy;
+    }
+
+/*! \param timestep specifies the current time step of the simulation
+    \returns The potential energy of every particle, indexed by tag. With domain decomposition, the energies of all
+              ranks are combined, so every rank gets the full array.
+*/
+template< class evaluator >
+std::vector<Scalar> PotentialPairPolymd< evaluator >::computeEnergies(unsigned int timestep)
+    {
+    const unsigned int N = this->m_pdata->getN();
+    std::vector<Scalar> local(N);
+    computeLocalEnergy(timestep, local.data());
+
+    std::vector<Scalar> energies(this->m_pdata->getNGlobal(), Scalar(0.0));
+        {
+        ArrayHandle<unsigned int> h_tag(this->m_pdata->getTags(), access_location::host, access_mode::read);
+        for (unsigned int i = 0; i < N; ++i)
+            energies[h_tag.data[i]] = local[i];
+        }
+
+#ifdef ENABLE_MPI
+    if (this->m_pdata->getDomainDecomposition())
+        {
+        MPI_Allreduce(MPI_IN_PLACE, energies.data(), (int)energies.size(), MPI_HOOMD_SCALAR, MPI_SUM,
+                      this->m_exec_conf->getMPICommunicator());
+        }
+#endif
+    return energies;
+    }
+
+/*! \param timestep specifies the current time step of the simulation
+    \param energy Array of getN() energies to write the energy of every local particle to, or NULL for the total only
+    \returns The potential energy of the local particles
+
+    Pairs with a ghost particle count half, like the energies of computeForces(). The xplor shift mode falls back to
+    computing the forces.
+*/
+template< class evaluator >
+Scalar PotentialPairPolymd< evaluator >::computeLocalEnergy(unsigned int timestep, Scalar *energy)
+    {
+    const unsigned int N = this->m_pdata->getN();
+
+    if (this->m_shift_mode == PotentialPair<evaluator>::xplor)
+        {
+        checkXplorDiameterScale();
+        PotentialPair<evaluator>::computeForces(timestep);
+        ArrayHandle<Scalar4> h_force(this->m_force, access_location::host, access_mode::read);
+        Scalar total = Scalar(0.0);
+        for (unsigned int i = 0; i < N; ++i)
+            {
+            if (energy)
+                energy[i] = h_force.data[i].w;
+            total += h_force.data[i].w;
+            }
+        return total;
+        }
+
+    this->m_nlist->compute(timestep);
+
+    if (this->m_prof) this->m_prof->push(this->m_prof_name + " energy");
+
+    const bool third_law = this->m_nlist->getStorageMode() == NeighborList::half;
+    const unsigned int n_threads = m_pool->getNumThreads();
+    const bool private_buffers = energy && third_law && n_threads > 1;
+
+    ArrayHandle<unsigned int> h_n_neigh(this->m_nlist->getNNeighArray(), access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_nlist(this->m_nlist->getNListArray(), access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_head_list(this->m_nlist->getHeadList(), access_location::host, access_mode::read);
+
+    ArrayHandle<Scalar4> h_pos(this->m_pdata->getPositions(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar> h_diameter(this->m_pdata->getDiameters(), access_location::host, access_mode::read);
+    ArrayHandle<param_type> h_params(this->m_params, access_location::host, access_mode::read);
+
+    polymd_pair_args<param_type> args;
+    args.n_neigh = h_n_neigh.data;
+    args.nlist = h_nlist.data;
+    args.head_list = h_head_list.data;
+    args.pos = h_pos.data;
+    args.diameter = h_diameter.data;
+    args.diameter_scale = m_diameter_scale;
+    args.params = h_params.data;
+    args.pair_cache = NULL;
+    args.discrete_index = NULL;
+    args.discrete_table = NULL;
+    args.n_discrete = 0;
+
+    if (energy)
+        memset((void*)energy, 0, sizeof(Scalar)*N);
+
+    std::vector<Scalar> partial(n_threads, Scalar(0.0));
+    m_queue.partition(h_n_neigh.data, N, n_threads, m_work_stealing);
+    m_pool->run([&](unsigned int thread)
+        {
+        polymd_pair_scratch& scratch = m_scratch[thread];
+
+        unsigned int first, last;
+        if (m_fixed_point)
+            {
+            scratch.fixed_overflow = false;
+            scratch.fixed_energy = 0;
+            if (energy && third_law)
+                scratch.fixed.assign(N, uint64_t(0));
+            while (m_queue.next(thread, first, last))
+                computeEnergyRangeFixed(scratch, args, first, last, third_law, energy);
+            }
+        else if (private_buffers)
+            {
+            scratch.energy.assign(N, Scalar(0.0));
+            while (m_queue.next(thread, first, last))
+                partial[thread] += computeEnergyRange(scratch, args, first, last, third_law, &scratch.energy[0]);
+            }
+        else
+            {
+            while (m_queue.next(thread, first, last))
+                partial[thread] += computeEnergyRange(scratch, args, first, last, third_law, energy);
+            }
+        });
+
+    if (m_fixed_point)
+        {
+        checkFixedOverflow();
+
+        if (energy && third_law)
+            {
+            m_pool->run([&](unsigned int thread)
+                {
+                const unsigned int first = (unsigned int)((unsigned long)N*thread/n_threads);
+                const unsigned int last = (unsigned int)((unsigned long)N*(thread+1)/n_threads);
+                for (unsigned int i = first; i < last; ++i)
+                    {
+                    uint64_t q = 0;
+                    for (unsigned int t = 0; t < n_threads; ++t)
+                        q += m_scratch[t].fixed[i];
+                    energy[i] = m_fixed.toScalar(q);
+                    }
+                });
+            }
+
+        uint64_t q = 0;
+        for (unsigned int t = 0; t < n_threads; ++t)
+            q += m_scratch[t].fixed_energy;
+
+        if (this->m_prof) this->m_prof->pop();
+        return m_fixed.toScalar(q);
+        }
+
+    // sum the private buffers, each thread over its own range of particles
+    if (private_buffers)
+        {
+        m_pool->run([&](unsigned int thread)
+            {
+            const unsigned int first = (unsigned int)((unsigned long)N*thread/n_threads);
+            const unsigned int last = (unsigned int)((unsigned long)N*(thread+1)/n_threads);
+            for (unsigned int t = 0; t < n_threads; ++t)
+                for (unsigned int i = first; i < last; ++i)
+                    energy[i] += m_scratch[t].energy[i];
+            });
+        }
+
+    Scalar total = Scalar(0.0);
+    for (unsigned int t = 0; t < n_threads; ++t)
+        total += partial[t];
+
+    if (this->m_prof) this->m_prof->pop();
+    return total;
+    }
+
+/*! \param scratch Scratch space of the calling thread
+    \param args Particle data and neighbor list
+    \param i Particle whose neighbors are evaluated
+    \param unsort True if the pair energies are needed in the order of the neighbor list
+    \param sum Returns the sum of the pair energies
+    \returns The number of neighbors. With \a unsort, their pair energies are left in scratch.pair_eng.
+*/
+template< class evaluator >
+unsigned int PotentialPairPolymd< evaluator >::evalParticleEnergy(polymd_pair_scratch& scratch,
+                                                                  const polymd_pair_args<param_type>& args,
+                                                                  unsigned int i,
+                                                                  bool unsort,
+                                                                  Scalar& sum)
+    {
+    const unsigned int ntypes = this->m_pdata->getNTypes();
+    const unsigned int typei = __scalar_as_int(args.pos[i].w);
+    const Scalar di = args.diameter[i]*args.diameter_scale;
+
+    sum = Scalar(0.0);
+    bool mixed = false;
+    const unsigned int size = gatherNeighbors(scratch, args, i, mixed, false);
+    if (size == 0)
+        return 0;
+
+    // sum the pair energies with one batch per neighbor type
+    if (!mixed)
+        {
+        const unsigned int typpair = this->m_typpair_idx(typei, scratch.typej[0]);
+        sum = m_energy_batch(args.params[typpair], di, &scratch.rsq[0], &scratch.dj[0], size, &scratch.pair_eng[0]);
+        }
+    else
+        {
+        sortNeighbors(scratch, size, false, false);
+        unsigned int start = 0;
+        for (unsigned int t = 0; t < ntypes; t++)
+            {
+            const unsigned int end = scratch.type_start[t];
+            if (end > start)
+                {
+                const unsigned int typpair = this->m_typpair_idx(typei, t);
+                sum += m_energy_batch(args.params[typpair], di, &scratch.sorted_rsq[start],
+                                      &scratch.sorted_dj[start], end - start, &scratch.sorted_eng[start]);
+                }
+            start = end;
+            }
+        if (unsort)
+            {
+            for (unsigned int s = 0; s < size; s++)
+                scratch.pair_eng[scratch.order[s]] = scratch.sorted_eng[s];
+            }
+        }
+    return size;
+    }
+
+/*! \param scratch Scratch space of the calling thread
+    \param args Particle data and neighbor list
+    \param first First particle of the range
+    \param last One past the last particle of the range
+    \param third_law True if the neighbor list is half and the energies of j must be added too
+    \param energy Per particle energies to accumulate into, or NULL
+    \returns The energy of the pairs of this range, half of each pair for every local particle of it
+*/
+template< class evaluator >
+Scalar PotentialPairPolymd< evaluator >::computeEnergyRange(polymd_pair_scratch& scratch,
+                                                            const polymd_pair_args<param_type>& args,
+                                                            unsigned int first,
+                                                            unsigned int last,
+                                                            bool third_law,
+                                                            Scalar *energy)
+    {
+    const unsigned int N = this->m_pdata->getN();
+    Scalar total = Scalar(0.0);
+
+    for (unsigned int i = first; i < last; i++)
+        {
+        Scalar sum;
+        const unsigned int size = evalParticleEnergy(scratch, args, i, third_law, sum);
+        if (size == 0)
+            continue;
+
+        const Scalar pei = sum * Scalar(0.5);
+        total += pei;
+        if (energy)
+            energy[i] += pei;
+
+        // the other half of the pairs with local particles j
+        if (third_law)
+            {
+            for (unsigned int k = 0; k < size; k++)
+                {
+                const unsigned int j = scratch.j[k];
+                if (j < N)
+                    {
+                    const Scalar pej = scratch.pair_eng[k] * Scalar(0.5);
+                    total += pej;
+                    if (energy)
+                        energy[j] += pej;
+                    }
+                }
+            }
+        }
+    return total;
+    }
+
+/*! \param scratch Scratch space of the calling thread
+    \param args Particle data and neighbor list
+    \param first First particle of the range
+    \param last One past the last particle of the range
+    \param third_law True if the neighbor list is half and the energies of j must be added too
+    \param energy Per particle energies to write to with a full neighbor list, or NULL
+
+    The total goes to scratch.fixed_energy. With a half list and \a energy set, the per particle sums go to
+    scratch.fixed, which computeLocalEnergy() adds over the threads.
+*/
+template< class evaluator >
+void PotentialPairPolymd< evaluator >::computeEnergyRangeFixed(polymd_pair_scratch& scratch,
+                                                               const polymd_pair_args<param_type>& args,
+                                                               unsigned int first,
+                                                               unsigned int last,
+                                                               bool third_law,
+                                                               Scalar *energy)
+    {
+    const unsigned int N = this->m_pdata->getN();
+    const polymd_fixed_point fixed = m_fixed;
+    uint64_t *buffer = (energy && third_law) ? &scratch.fixed[0] : NULL;
+    bool overflow = false;
+
+    for (unsigned int i = first; i < last; i++)
+        {
+        // the pair energies are converted one by one, so they are needed in the order of the neighbor list
+        Scalar sum;
+        const unsigned int size = evalParticleEnergy(scratch, args, i, true, sum);
+        if (size == 0)
+            continue;
+
+        uint64_t qi = 0;
+        for (unsigned int k = 0; k < size; k++)
+            {
+            const uint64_t q = fixed.convert(scratch.pair_eng[k] * Scalar(0.5), overflow);
+            qi += q;
+
+            // the other half of the pairs with local particles j
+            const unsigned int j = scratch.j[k];
+            if (third_law && j < N)
+                {
+                scratch.fixed_energy += q;
+                if (buffer)
+                    buffer[j] += q;
+                }
+            }
+
+        scratch.fixed_energy += qi;
+        if (buffer)
+            buffer[i] += qi;
+        else if (energy)
+            energy[i] = fixed.toScalar(qi);
+        }
+
+    if (overflow)
+        scratch.fixed_overflow = true;
+    }
+
+//! Export this pair potential to python
+/*! \param name Name of the class in the exported python module
+    \tparam T Class type to export. \b Must be an instantiated PotentialPairPolymd class template.
+    \tparam Base Base class of \a T. \b Must be PotentialPair<evaluator> with the same evaluator as used in \a T.
+*/
+template < class T, class Base > void export_PotentialPairPolymd(pybind11::module& m, const std::string& name)
+    {
+    pybind11::class_<T, std::shared_ptr<T> >(m, name.c_str(), pybind11::base<Base>())
+        .def(pybind11::init< std::shared_ptr<SystemDefinition>, std::shared_ptr<NeighborList>, const std::string& >())
+        .def("setNumThreads", &T::setNumThreads)
+        .def("getNumThreads", &T::getNumThreads)
+        .def("setFixedPoint", &T::setFixedPoint)
+        .def("getFixedPoint", &T::getFixedPoint)
+        .def("setTable", &T::setTable)
+        .def("disableTable", &T::disableTable)
+        .def("getTableError", &T::getTableError)
+        .def("getTableWidth", &T::getTableWidth)
+        .def("setMixedPrecision", &T::setMixedPrecision)
+        .def("getMixedPrecision", &T::getMixedPrecision)
+        .def("setDiscrete", &T::setDiscrete)
+        .def("disableDiscrete", &T::disableDiscrete)
+        .def("getDiscreteDiameters", &T::getDiscreteDiameters)
+        .def("setSkipEnergy", &T::setSkipEnergy)
+        .def("getSkipEnergy", &T::getSkipEnergy)
+        .def("computeEnergy", &T::computeEnergy)
+        .def("computeEnergies", &T::computeEnergies)
+        .def("getCounters", &T::getCounters)
+        .def("setAutoRcut", &T::setAutoRcut)
+        .def("getAutoRcut", &T::getAutoRcut)
+        .def("updateAutoRcut", &T::updateAutoRcut)
+        .def("getAutoRcutPair", &T::getAutoRcutPair)
+        .def("getAutoDMax", &T::getAutoDMax)
+        .def("getExpectedNeighbors", &T::getExpectedNeighbors)
+        .def("resetCounters", &T::resetCounters)
+        .def("getThreadBusyTimes", &T::getThreadBusyTimes)
+        .def("setWorkStealing", &T::setWorkStealing)
+        .def("getWorkStealing", &T::getWorkStealing)
+        .def("setDiameterScale", &T::setDiameterScale)
+        .def("getDiameterScale", &T::getDiameterScale)
+        ;
+    }
+
+#endif // __POTENTIAL_PAIR_POLYMD_H__
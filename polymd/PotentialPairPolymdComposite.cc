@@ -0,0 +1,831 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+/*! \file PotentialPairPolymdComposite.cc
+    \brief Defines PotentialPairPolymdComposite
+*/
+
+#include "PotentialPairPolymdComposite.h"
+
+#include <hoomd/extern/pybind/include/pybind11/stl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace py = pybind11;
+
+using namespace std;
+
+/*! \param sysdef System definition
+    \param nlist Neighbor list to compute the forces with
+    \param log_suffix Suffix of the log quantities
+*/
+PotentialPairPolymdComposite::PotentialPairPolymdComposite(std::shared_ptr<SystemDefinition> sysdef,
+                                                           std::shared_ptr<NeighborList> nlist,
+                                                           const std::string& log_suffix)
+    : ForceCompute(sysdef), m_nlist(nlist), m_typpair_idx(m_pdata->getNTypes()), m_log_suffix(log_suffix),
+      m_work_stealing(true), m_virial_sum_valid(false), m_fixed_point(false), m_pair_loop_time(0),
+      m_diameter_scale(1.0)
+    {
+    m_exec_conf->msg->notice(5) << "Constructing PotentialPairPolymdComposite" << endl;
+
+    assert(m_pdata);
+    assert(m_nlist);
+
+    std::fill(m_virial_sum, m_virial_sum + 6, Scalar(0.0));
+    setNumThreads(1);
+    }
+
+PotentialPairPolymdComposite::~PotentialPairPolymdComposite()
+    {
+    m_exec_conf->msg->notice(5) << "Destroying PotentialPairPolymdComposite" << endl;
+    }
+
+/*! \param name Name of the component, unique within this force
+    \param model Polydisperse model of the component: polydisperse12, polydisperse18, polydisperse10, lennardjones
+                 or polydisperse106
+    \returns Index of the new component
+
+    All type pairs of the new component start with v0 = 0, i.e. without interaction.
+*/
+unsigned int PotentialPairPolymdComposite::addComponent(const std::string& name, const std::string& model)
+    {
+    polymd_composite_component component;
+    component.name = name;
+    component.model = model;
+    if (model == "polydisperse12")
+        component.batch = PolydisperseBatch<EvaluatorPairPolydisperse>::get();
+    else if (model == "polydisperse18")
+        component.batch = PolydisperseBatch<EvaluatorPairPolydisperse18>::get();
+    else if (model == "polydisperse10")
+        component.batch = PolydisperseBatch<EvaluatorPairPolydisperse10>::get();
+    else if (model == "lennardjones")
+        component.batch = PolydisperseBatch<EvaluatorPairPolydisperseLJ>::get();
+    else if (model == "polydisperse106")
+        component.batch = PolydisperseBatch<EvaluatorPairPolydisperseLJ106>::get();
+    else
+        {
+        m_exec_conf->msg->error() << "pair.composite: unknown model " << model << endl;
+        throw runtime_error("Error adding a component to pair.composite");
+        }
+    return pushComponent(component);
+    }
+
+/*! \param name Name of the component, unique within this force
+    \param filename Shared library compiled from PolydisperseJIT::getSource(m, n, q)
+    \param m Exponent of the repulsive term
+    \param n Exponent of the attractive term, 0 to disable it
+    \param q Order of the smoothing polynomial
+    \returns Index of the new component
+
+    The parameters of the component are those of PolydisperseJIT::makeParams(). All type pairs start with v0 = 0.
+*/
+unsigned int PotentialPairPolymdComposite::addJITComponent(const std::string& name,
+                                                           const std::string& filename,
+                                                           unsigned int m,
+                                                           unsigned int n,
+                                                           unsigned int q)
+    {
+    polymd_composite_component component;
+    component.name = name;
+    component.model = "polydisperse_" + to_string(m) + "_" + to_string(n) + "_" + to_string(q);
+    try
+        {
+        component.batch = PolydisperseJIT::load(filename, m, n, q, component.library);
+        }
+    catch (const runtime_error& e)
+        {
+        m_exec_conf->msg->error() << "pair.composite: " << e.what() << endl;
+        throw runtime_error("Error adding a component to pair.composite");
+        }
+    return pushComponent(component);
+    }
+
+/*! \param component Component with its name, model and batch kernel
+    \returns Index of the new component
+*/
+unsigned int PotentialPairPolymdComposite::pushComponent(polymd_composite_component& component)
+    {
+    for (unsigned int c = 0; c < m_components.size(); ++c)
+        {
+        if (m_components[c].name == component.name)
+            {
+            m_exec_conf->msg->error() << "pair.composite: duplicate component name " << component.name << endl;
+            throw runtime_error("Error adding a component to pair.composite");
+            }
+        }
+
+    component.params.resize(m_typpair_idx.getNumElements(), make_polydisperse_base_params(0.0, 0.0, 0.0));
+    component.energy = Scalar(0.0);
+
+    m_components.push_back(component);
+    return m_components.size() - 1;
+    }
+
+/*! \param component Index of the component, as returned by addComponent()
+    \param typ1 First type of the pair
+    \param typ2 Second type of the pair
+    \param param Parameters of the pair, from the make_polydisperse_params() of the model of the component
+*/
+void PotentialPairPolymdComposite::setParams(unsigned int component,
+                                             unsigned int typ1,
+                                             unsigned int typ2,
+                                             const polydisperse_params& param)
+    {
+    if (component >= m_components.size())
+        {
+        m_exec_conf->msg->error() << "pair.composite: trying to set the parameters of a non existent component ("
+                                  << component << ")" << endl;
+        throw runtime_error("Error setting parameters in pair.composite");
+        }
+    if (typ1 >= m_pdata->getNTypes() || typ2 >= m_pdata->getNTypes())
+        {
+        m_exec_conf->msg->error() << "pair.composite: trying to set pair params for a non existent type! "
+                                  << typ1 << "," << typ2 << endl;
+        throw runtime_error("Error setting parameters in pair.composite");
+        }
+
+    std::vector<polydisperse_params>& params = m_components[component].params;
+    params[m_typpair_idx(typ1, typ2)] = param;
+    params[m_typpair_idx(typ2, typ1)] = param;
+    }
+
+/*! \param n_threads Number of threads to compute the forces with, including the calling thread
+*/
+void PotentialPairPolymdComposite::setNumThreads(unsigned int n_threads)
+    {
+    if (n_threads == 0)
+        {
+        m_exec_conf->msg->error() << "pair.composite: the number of threads must be positive" << endl;
+        throw runtime_error("Error setting the number of threads");
+        }
+
+    if (m_pool && m_pool->getNumThreads() == n_threads)
+        return;
+
+    m_pool.reset(new PolymdThreadPool(n_threads));
+    m_scratch.clear();
+    m_scratch.resize(n_threads);
+    m_thread_busy_total.assign(n_threads, 0);
+    }
+
+/*! \param enable True to sum the pair contributions in fixed point
+    \param bits Number of fraction bits, between POLYMD_FIXED_POINT_MIN_BITS and POLYMD_FIXED_POINT_MAX_BITS
+*/
+void PotentialPairPolymdComposite::setFixedPoint(bool enable, unsigned int bits)
+    {
+    if (bits < POLYMD_FIXED_POINT_MIN_BITS || bits > POLYMD_FIXED_POINT_MAX_BITS)
+        {
+        m_exec_conf->msg->error() << "pair.composite: the number of fixed point bits must be between "
+                                  << POLYMD_FIXED_POINT_MIN_BITS << " and " << POLYMD_FIXED_POINT_MAX_BITS << endl;
+        throw runtime_error("Error setting the fixed point accumulation");
+        }
+    m_fixed_point = enable;
+    m_fixed = polymd_fixed_point(bits);
+    }
+
+/*! \param scale Factor applied to all diameters in the pair loop, positive
+*/
+void PotentialPairPolymdComposite::setDiameterScale(Scalar scale)
+    {
+    if (!(scale > Scalar(0.0)))
+        {
+        m_exec_conf->msg->error() << "pair.composite: the diameter scale must be positive" << endl;
+        throw runtime_error("Error setting the diameter scale");
+        }
+    m_diameter_scale = scale;
+    }
+
+/*! \param scale Factor applied to all diameters
+    \param d_min Smallest diameter
+    \param d_max Largest diameter
+    \returns A bound of the change of the cutoff of any type pair of any component, see polymd_cutoff_change()
+*/
+Scalar PotentialPairPolymdComposite::getCutoffChange(Scalar scale, Scalar d_min, Scalar d_max)
+    {
+    Scalar change = Scalar(0.0);
+    for (unsigned int c = 0; c < m_components.size(); ++c)
+        {
+        const std::vector<polydisperse_params>& params = m_components[c].params;
+        for (unsigned int s = 0; s < params.size(); ++s)
+            {
+            if (params[s].v0 != Scalar(0.0))
+                change = std::max(change, polymd_cutoff_change(params[s].scaledrcutsq, params[s].eps, scale, d_min,
+                                                               d_max));
+            }
+        }
+    return change;
+    }
+
+/*! \returns The total energy pair_composite_energy and the energy of every component,
+             pair_composite_<name>_energy, each with the log suffix
+*/
+std::vector< std::string > PotentialPairPolymdComposite::getProvidedLogQuantities()
+    {
+    std::vector<std::string> list;
+    list.push_back("pair_composite_energy" + m_log_suffix);
+    for (unsigned int c = 0; c < m_components.size(); ++c)
+        list.push_back("pair_composite_" + m_components[c].name + "_energy" + m_log_suffix);
+    return list;
+    }
+
+/*! \param quantity Name of the log quantity to get
+    \param timestep Current time step of the simulation
+*/
+Scalar PotentialPairPolymdComposite::getLogValue(const std::string& quantity, unsigned int timestep)
+    {
+    if (quantity == "pair_composite_energy" + m_log_suffix)
+        {
+        compute(timestep);
+        return calcEnergySum();
+        }
+
+    for (unsigned int c = 0; c < m_components.size(); ++c)
+        {
+        if (quantity == "pair_composite_" + m_components[c].name + "_energy" + m_log_suffix)
+            {
+            compute(timestep);
+            Scalar energy = m_components[c].energy;
+#ifdef ENABLE_MPI
+            if (m_pdata->getDomainDecomposition())
+                {
+                MPI_Allreduce(MPI_IN_PLACE, &energy, 1, MPI_HOOMD_SCALAR, MPI_SUM,
+                              m_exec_conf->getMPICommunicator());
+                }
+#endif
+            return energy;
+            }
+        }
+
+    m_exec_conf->msg->error() << "pair.composite: " << quantity << " is not a valid log quantity" << endl;
+    throw runtime_error("Error getting log value");
+    }
+
+/*! \param timestep specifies the current time step of the simulation
+
+    The particles are split into chunks by PolymdWorkQueue. With a half neighbor list, the forces on j of one thread
+    can land in the chunks of another, so every thread then accumulates into a private buffer that is summed at
+    the end, as in PotentialPairPolymd::computeForces().
+*/
+void PotentialPairPolymdComposite::computeForces(unsigned int timestep)
+    {
+    // start by updating the neighborlist
+    m_nlist->compute(timestep);
+
+    // start the profile for this compute
+    if (m_prof) m_prof->push("pair.composite");
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    const bool third_law = m_nlist->getStorageMode() == NeighborList::half;
+    const unsigned int N = m_pdata->getN();
+    const unsigned int n_threads = m_pool->getNumThreads();
+    const unsigned int n_components = m_components.size();
+    const bool private_buffers = third_law && n_threads > 1;
+
+    PDataFlags flags = m_pdata->getFlags();
+    const bool compute_virial = flags[pdata_flag::pressure_tensor] || flags[pdata_flag::isotropic_virial];
+    m_virial_sum_valid = compute_virial;
+
+    // access the neighbor list and particle data, the threads only see the raw pointers
+    ArrayHandle<unsigned int> h_n_neigh(m_nlist->getNNeighArray(), access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_nlist(m_nlist->getNListArray(), access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_head_list(m_nlist->getHeadList(), access_location::host, access_mode::read);
+
+    ArrayHandle<Scalar4> h_pos(m_pdata->getPositions(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar> h_diameter(m_pdata->getDiameters(), access_location::host, access_mode::read);
+
+    ArrayHandle<Scalar4> h_force(m_force, access_location::host, access_mode::overwrite);
+    ArrayHandle<Scalar> h_virial(m_virial, access_location::host, access_mode::overwrite);
+    const unsigned int virial_pitch = m_virial_pitch;
+
+    // need to start from a zero force, energy and virial
+    memset((void*)h_force.data, 0, sizeof(Scalar4)*m_force.getNumElements());
+    memset((void*)h_virial.data, 0, sizeof(Scalar)*m_virial.getNumElements());
+
+    m_queue.partition(h_n_neigh.data, N, n_threads, m_work_stealing);
+    m_pool->run([&](unsigned int thread)
+        {
+        polymd_composite_scratch& scratch = m_scratch[thread];
+        scratch.energy.assign(n_components, Scalar(0.0));
+        std::fill(scratch.virial_sum, scratch.virial_sum + 6, Scalar(0.0));
+
+        unsigned int first, last;
+        if (m_fixed_point)
+            {
+            scratch.fixed_overflow = false;
+            scratch.fixed_energy.assign(n_components, uint64_t(0));
+            std::fill(scratch.fixed_virial_sum, scratch.fixed_virial_sum + 6, uint64_t(0));
+            if (third_law)
+                scratch.fixed.assign((compute_virial ? 10 : 4)*N, uint64_t(0));
+            while (m_queue.next(thread, first, last))
+                computeRangeFixed(scratch, h_pos.data, h_diameter.data, h_n_neigh.data, h_nlist.data,
+                                  h_head_list.data, first, last, third_law, compute_virial, h_force.data,
+                                  h_virial.data, virial_pitch);
+            }
+        else if (private_buffers)
+            {
+            scratch.force.assign(N, make_scalar4(0.0, 0.0, 0.0, 0.0));
+            scratch.virial.assign(compute_virial ? 6*N : 0, Scalar(0.0));
+            while (m_queue.next(thread, first, last))
+                computeRange(scratch, h_pos.data, h_diameter.data, h_n_neigh.data, h_nlist.data, h_head_list.data,
+                             first, last, third_law, compute_virial, &scratch.force[0],
+                             compute_virial ? &scratch.virial[0] : NULL, N);
+            }
+        else
+            {
+            while (m_queue.next(thread, first, last))
+                computeRange(scratch, h_pos.data, h_diameter.data, h_n_neigh.data, h_nlist.data, h_head_list.data,
+                             first, last, third_law, compute_virial, h_force.data, h_virial.data, virial_pitch);
+            }
+        });
+    for (unsigned int t = 0; t < n_threads; ++t)
+        m_thread_busy_total[t] += m_queue.getBusyTime(t);
+
+    if (m_fixed_point)
+        {
+        for (unsigned int t = 0; t < n_threads; ++t)
+            {
+            if (m_scratch[t].fixed_overflow)
+                {
+                m_exec_conf->msg->error() << "pair.composite: a pair contribution exceeds the fixed point range of "
+                                          << m_fixed.limit << ", use fewer fixed point bits" << endl;
+                throw runtime_error("Error computing pair forces");
+                }
+            }
+        }
+
+    // sum the fixed point buffers in any order and convert them, each thread over its own range of particles
+    if (m_fixed_point && third_law)
+        {
+        const unsigned int n_fields = compute_virial ? 10 : 4;
+        m_pool->run([&](unsigned int thread)
+            {
+            const unsigned int first = (unsigned int)((unsigned long)N*thread/n_threads);
+            const unsigned int last = (unsigned int)((unsigned long)N*(thread+1)/n_threads);
+            for (unsigned int i = first; i < last; ++i)
+                {
+                uint64_t q[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+                for (unsigned int t = 0; t < n_threads; ++t)
+                    for (unsigned int c = 0; c < n_fields; ++c)
+                        q[c] += m_scratch[t].fixed[i*n_fields+c];
+                h_force.data[i] = make_scalar4(m_fixed.toScalar(q[0]), m_fixed.toScalar(q[1]),
+                                               m_fixed.toScalar(q[2]), m_fixed.toScalar(q[3]));
+                if (compute_virial)
+                    {
+                    for (unsigned int l = 0; l < 6; ++l)
+                        h_virial.data[l*virial_pitch+i] = m_fixed.toScalar(q[4+l]);
+                    }
+                }
+            });
+        }
+
+    // sum the private buffers, each thread over its own range of particles
+    else if (private_buffers)
+        {
+        m_pool->run([&](unsigned int thread)
+            {
+            const unsigned int first = (unsigned int)((unsigned long)N*thread/n_threads);
+            const unsigned int last = (unsigned int)((unsigned long)N*(thread+1)/n_threads);
+            for (unsigned int t = 0; t < n_threads; ++t)
+                {
+                const polymd_composite_scratch& scratch = m_scratch[t];
+                for (unsigned int i = first; i < last; ++i)
+                    {
+                    h_force.data[i].x += scratch.force[i].x;
+                    h_force.data[i].y += scratch.force[i].y;
+                    h_force.data[i].z += scratch.force[i].z;
+                    h_force.data[i].w += scratch.force[i].w;
+                    }
+                if (compute_virial)
+                    {
+                    for (unsigned int l = 0; l < 6; ++l)
+                        for (unsigned int i = first; i < last; ++i)
+                            h_virial.data[l*virial_pitch+i] += scratch.virial[l*N+i];
+                    }
+                }
+            });
+        }
+
+    // the energy of every component on this rank
+    for (unsigned int c = 0; c < n_components; ++c)
+        {
+        m_components[c].energy = Scalar(0.0);
+        uint64_t q = 0;
+        for (unsigned int t = 0; t < n_threads; ++t)
+            {
+            m_components[c].energy += m_scratch[t].energy[c];
+            if (m_fixed_point)
+                q += m_scratch[t].fixed_energy[c];
+            }
+        if (m_fixed_point)
+            m_components[c].energy = m_fixed.toScalar(q);
+        }
+
+    // and the virial
+    std::fill(m_virial_sum, m_virial_sum + 6, Scalar(0.0));
+    for (unsigned int t = 0; t < n_threads; ++t)
+        for (unsigned int l = 0; l < 6; ++l)
+            m_virial_sum[l] += m_scratch[t].virial_sum[l];
+    if (m_fixed_point)
+        {
+        for (unsigned int l = 0; l < 6; ++l)
+            {
+            uint64_t q = 0;
+            for (unsigned int t = 0; t < n_threads; ++t)
+                q += m_scratch[t].fixed_virial_sum[l];
+            m_virial_sum[l] = m_fixed.toScalar(q);
+            }
+        }
+
+    m_pair_loop_time += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    if (m_prof) m_prof->pop();
+    }
+
+/*! \param scratch Scratch space of the calling thread
+    \param pos Particle positions
+    \param diameter Particle diameters
+    \param n_neigh Number of neighbors of every particle
+    \param nlist Neighbor list
+    \param head_list Start of the neighbors of every particle in \a nlist
+    \param i Particle whose neighbors are evaluated
+    \param third_law True if the neighbor list is half, for the share of the pair energies of the components
+    \param mixed Returns true if the neighbors have more than one type
+    \returns The number of neighbors
+
+    The neighbors of a particle are gathered once and, when they have more than one type, sorted by type with a
+    counting sort. Every component then runs its batch kernel on each type segment, and the results of all components
+    are summed into scratch.sum_force and scratch.sum_eng. The arrays stay in the sorted order, scratch.order maps them
+    back to the gathered separations and neighbor indices when \a mixed.
+*/
+unsigned int PotentialPairPolymdComposite::evalParticle(polymd_composite_scratch& scratch,
+                                                        const Scalar4 *pos,
+                                                        const Scalar *diameter,
+                                                        const unsigned int *n_neigh,
+                                                        const unsigned int *nlist,
+                                                        const unsigned int *head_list,
+                                                        unsigned int i,
+                                                        bool third_law,
+                                                        bool& mixed)
+    {
+    const BoxDim& box = m_pdata->getBox();
+    const unsigned int N = m_pdata->getN();
+    const unsigned int ntypes = m_pdata->getNTypes();
+    const unsigned int n_components = m_components.size();
+
+    const Scalar3 pi = make_scalar3(pos[i].x, pos[i].y, pos[i].z);
+    const unsigned int typei = __scalar_as_int(pos[i].w);
+    const Scalar di = diameter[i]*m_diameter_scale;
+    const unsigned int myHead = head_list[i];
+    const unsigned int size = n_neigh[i];
+    if (size == 0)
+        return 0;
+    scratch.reserve(size);
+
+    // gather the separations and diameters of all neighbors once for all components
+    mixed = false;
+    for (unsigned int k = 0; k < size; k++)
+        {
+        const unsigned int j = nlist[myHead + k];
+        Scalar3 pj = make_scalar3(pos[j].x, pos[j].y, pos[j].z);
+        Scalar3 dx = box.minImage(pi - pj);
+
+        scratch.j[k] = j;
+        scratch.typej[k] = __scalar_as_int(pos[j].w);
+        scratch.dx[k] = dx;
+        scratch.rsq[k] = dot(dx, dx);
+        scratch.dj[k] = diameter[j]*m_diameter_scale;
+        mixed |= (scratch.typej[k] != scratch.typej[0]);
+        }
+
+    // sort them by type, so that every type pair is a contiguous batch
+    const Scalar *rsq = &scratch.rsq[0];
+    const Scalar *dj = &scratch.dj[0];
+    if (mixed)
+        {
+        scratch.type_start.assign(ntypes+1, 0);
+        for (unsigned int k = 0; k < size; k++)
+            scratch.type_start[scratch.typej[k]+1]++;
+        for (unsigned int t = 0; t < ntypes; t++)
+            scratch.type_start[t+1] += scratch.type_start[t];
+        for (unsigned int k = 0; k < size; k++)
+            {
+            const unsigned int s = scratch.type_start[scratch.typej[k]]++;
+            scratch.order[s] = k;
+            scratch.sorted_rsq[s] = scratch.rsq[k];
+            scratch.sorted_dj[s] = scratch.dj[k];
+            }
+        rsq = &scratch.sorted_rsq[0];
+        dj = &scratch.sorted_dj[0];
+        }
+
+    // pairs with a local j count fully with the third law, pairs seen from both sides or with a ghost count half
+    for (unsigned int s = 0; s < size; s++)
+        {
+        const unsigned int k = mixed ? scratch.order[s] : s;
+        scratch.weight[s] = (third_law && scratch.j[k] < N) ? Scalar(1.0) : Scalar(0.5);
+        scratch.sum_force[s] = Scalar(0.0);
+        scratch.sum_eng[s] = Scalar(0.0);
+        }
+
+    // evaluate every component with one batch per neighbor type
+    for (unsigned int c = 0; c < n_components; ++c)
+        {
+        const polymd_composite_component& component = m_components[c];
+        Scalar energy = Scalar(0.0);
+        unsigned int start = 0;
+        for (unsigned int t = 0; t < ntypes && start < size; t++)
+            {
+            const unsigned int end = mixed ? scratch.type_start[t] : size;
+            const polydisperse_params& params = component.params[m_typpair_idx(typei,
+                                                                               mixed ? t : scratch.typej[0])];
+            if (end > start && params.v0 != Scalar(0.0))
+                {
+                component.batch(params, di, rsq + start, dj + start, end - start,
+                                &scratch.force_divr[start], &scratch.pair_eng[start]);
+                for (unsigned int s = start; s < end; s++)
+                    {
+                    scratch.sum_force[s] += scratch.force_divr[s];
+                    scratch.sum_eng[s] += scratch.pair_eng[s];
+                    if (m_fixed_point)
+                        scratch.fixed_energy[c] += m_fixed.convert(scratch.weight[s]*scratch.pair_eng[s],
+                                                                   scratch.fixed_overflow);
+                    else
+                        energy += scratch.weight[s]*scratch.pair_eng[s];
+                    }
+                }
+            start = end;
+            }
+        scratch.energy[c] += energy;
+        }
+    return size;
+    }
+
+/*! \param scratch Scratch space of the calling thread
+    \param pos Particle positions
+    \param diameter Particle diameters
+    \param n_neigh Number of neighbors of every particle
+    \param nlist Neighbor list
+    \param head_list Start of the neighbors of every particle in \a nlist
+    \param first First particle of the range
+    \param last One past the last particle of the range
+    \param third_law True if the neighbor list is half and the forces on j must be added too
+    \param compute_virial True if the virial is needed
+    \param force Force and energy array to accumulate into
+    \param virial Virial array to accumulate into
+    \param virial_pitch Pitch of the virial array
+*/
+void PotentialPairPolymdComposite::computeRange(polymd_composite_scratch& scratch,
+                                                const Scalar4 *pos,
+                                                const Scalar *diameter,
+                                                const unsigned int *n_neigh,
+                                                const unsigned int *nlist,
+                                                const unsigned int *head_list,
+                                                unsigned int first,
+                                                unsigned int last,
+                                                bool third_law,
+                                                bool compute_virial,
+                                                Scalar4 *force,
+                                                Scalar *virial,
+                                                unsigned int virial_pitch)
+    {
+    const unsigned int N = m_pdata->getN();
+
+    for (unsigned int i = first; i < last; i++)
+        {
+        bool mixed = false;
+        const unsigned int size = evalParticle(scratch, pos, diameter, n_neigh, nlist, head_list, i, third_law, mixed);
+        if (size == 0)
+            continue;
+
+        // accumulate the force, energy and virial, neighbors beyond all cutoffs contribute zeros
+        Scalar3 fi = make_scalar3(0, 0, 0);
+        Scalar pei = 0.0;
+        Scalar virialxxi = 0.0;
+        Scalar virialxyi = 0.0;
+        Scalar virialxzi = 0.0;
+        Scalar virialyyi = 0.0;
+        Scalar virialyzi = 0.0;
+        Scalar virialzzi = 0.0;
+        Scalar virialj[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+
+        for (unsigned int s = 0; s < size; s++)
+            {
+            const unsigned int k = mixed ? scratch.order[s] : s;
+            const Scalar force_divr = scratch.sum_force[s];
+            const Scalar pair_eng = scratch.sum_eng[s];
+            const Scalar3 dx = scratch.dx[k];
+            const Scalar force_div2r = force_divr * Scalar(0.5);
+
+            fi += dx*force_divr;
+            pei += pair_eng * Scalar(0.5);
+            if (compute_virial)
+                {
+                virialxxi += force_div2r*dx.x*dx.x;
+                virialxyi += force_div2r*dx.x*dx.y;
+                virialxzi += force_div2r*dx.x*dx.z;
+                virialyyi += force_div2r*dx.y*dx.y;
+                virialyzi += force_div2r*dx.y*dx.z;
+                virialzzi += force_div2r*dx.z*dx.z;
+                }
+
+            // add the force to particle j if we are using the third law, only for local particles
+            const unsigned int j = scratch.j[k];
+            if (third_law && j < N)
+                {
+                force[j].x -= dx.x*force_divr;
+                force[j].y -= dx.y*force_divr;
+                force[j].z -= dx.z*force_divr;
+                force[j].w += pair_eng * Scalar(0.5);
+                if (compute_virial)
+                    {
+                    virial[0*virial_pitch+j] += force_div2r*dx.x*dx.x;
+                    virial[1*virial_pitch+j] += force_div2r*dx.x*dx.y;
+                    virial[2*virial_pitch+j] += force_div2r*dx.x*dx.z;
+                    virial[3*virial_pitch+j] += force_div2r*dx.y*dx.y;
+                    virial[4*virial_pitch+j] += force_div2r*dx.y*dx.z;
+                    virial[5*virial_pitch+j] += force_div2r*dx.z*dx.z;
+                    virialj[0] += force_div2r*dx.x*dx.x;
+                    virialj[1] += force_div2r*dx.x*dx.y;
+                    virialj[2] += force_div2r*dx.x*dx.z;
+                    virialj[3] += force_div2r*dx.y*dx.y;
+                    virialj[4] += force_div2r*dx.y*dx.z;
+                    virialj[5] += force_div2r*dx.z*dx.z;
+                    }
+                }
+            }
+
+        // finally, increment the force, potential energy and virial for particle i
+        force[i].x += fi.x;
+        force[i].y += fi.y;
+        force[i].z += fi.z;
+        force[i].w += pei;
+        if (compute_virial)
+            {
+            virial[0*virial_pitch+i] += virialxxi;
+            virial[1*virial_pitch+i] += virialxyi;
+            virial[2*virial_pitch+i] += virialxzi;
+            virial[3*virial_pitch+i] += virialyyi;
+            virial[4*virial_pitch+i] += virialyzi;
+            virial[5*virial_pitch+i] += virialzzi;
+
+            scratch.virial_sum[0] += virialxxi + virialj[0];
+            scratch.virial_sum[1] += virialxyi + virialj[1];
+            scratch.virial_sum[2] += virialxzi + virialj[2];
+            scratch.virial_sum[3] += virialyyi + virialj[3];
+            scratch.virial_sum[4] += virialyzi + virialj[4];
+            scratch.virial_sum[5] += virialzzi + virialj[5];
+            }
+        }
+    }
+
+/*! \param scratch Scratch space of the calling thread
+    \param pos Particle positions
+    \param diameter Particle diameters
+    \param n_neigh Number of neighbors of every particle
+    \param nlist Neighbor list
+    \param head_list Start of the neighbors of every particle in \a nlist
+    \param first First particle of the range
+    \param last One past the last particle of the range
+    \param third_law True if the neighbor list is half and the forces on j must be added too
+    \param compute_virial True if the virial is needed
+    \param force Force and energy array to write the forces of a full neighbor list to
+    \param virial Virial array to write the virials of a full neighbor list to
+    \param virial_pitch Pitch of the virial array
+
+    The fixed point counterpart of computeRange(), see PotentialPairPolymd::computeRangeFixed(). With a half neighbor
+    list, the sums go to scratch.fixed, with the sums of each particle next to each other, and computeForces() adds the
+    buffers of all threads.
+*/
+void PotentialPairPolymdComposite::computeRangeFixed(polymd_composite_scratch& scratch,
+                                                     const Scalar4 *pos,
+                                                     const Scalar *diameter,
+                                                     const unsigned int *n_neigh,
+                                                     const unsigned int *nlist,
+                                                     const unsigned int *head_list,
+                                                     unsigned int first,
+                                                     unsigned int last,
+                                                     bool third_law,
+                                                     bool compute_virial,
+                                                     Scalar4 *force,
+                                                     Scalar *virial,
+                                                     unsigned int virial_pitch)
+    {
+    const unsigned int N = m_pdata->getN();
+    const polymd_fixed_point fixed = m_fixed;
+    uint64_t *buffer = third_law ? &scratch.fixed[0] : NULL;
+    const unsigned int n_fields = compute_virial ? 10 : 4;
+    bool overflow = false;
+
+    for (unsigned int i = first; i < last; i++)
+        {
+        bool mixed = false;
+        const unsigned int size = evalParticle(scratch, pos, diameter, n_neigh, nlist, head_list, i, third_law, mixed);
+        if (size == 0)
+            continue;
+
+        uint64_t qi[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+        uint64_t virialj[6] = {0, 0, 0, 0, 0, 0};
+
+        for (unsigned int s = 0; s < size; s++)
+            {
+            const unsigned int k = mixed ? scratch.order[s] : s;
+            const Scalar force_divr = scratch.sum_force[s];
+            const Scalar3 dx = scratch.dx[k];
+            const Scalar force_div2r = force_divr * Scalar(0.5);
+
+            // a pair out of range is skipped, the compute then stops with an error
+            if (!fixed.pairInRange(force_divr, scratch.rsq[k], scratch.sum_eng[s], compute_virial))
+                {
+                overflow = true;
+                continue;
+                }
+
+            uint64_t q[10];
+            q[0] = fixed.convertInRange(dx.x*force_divr);
+            q[1] = fixed.convertInRange(dx.y*force_divr);
+            q[2] = fixed.convertInRange(dx.z*force_divr);
+            q[3] = fixed.convertInRange(scratch.sum_eng[s] * Scalar(0.5));
+            if (compute_virial)
+                {
+                q[4] = fixed.convertInRange(force_div2r*dx.x*dx.x);
+                q[5] = fixed.convertInRange(force_div2r*dx.x*dx.y);
+                q[6] = fixed.convertInRange(force_div2r*dx.x*dx.z);
+                q[7] = fixed.convertInRange(force_div2r*dx.y*dx.y);
+                q[8] = fixed.convertInRange(force_div2r*dx.y*dx.z);
+                q[9] = fixed.convertInRange(force_div2r*dx.z*dx.z);
+                }
+            for (unsigned int c = 0; c < n_fields; c++)
+                qi[c] += q[c];
+
+            // add the force to particle j if we are using the third law, only for local particles
+            const unsigned int j = scratch.j[k];
+            if (third_law && j < N)
+                {
+                uint64_t *qj = buffer + j*n_fields;
+                qj[0] -= q[0];
+                qj[1] -= q[1];
+                qj[2] -= q[2];
+                qj[3] += q[3];
+                if (compute_virial)
+                    {
+                    for (unsigned int l = 0; l < 6; l++)
+                        {
+                        qj[4+l] += q[4+l];
+                        virialj[l] += q[4+l];
+                        }
+                    }
+                }
+            }
+
+        if (third_law)
+            {
+            for (unsigned int c = 0; c < n_fields; c++)
+                buffer[i*n_fields+c] += qi[c];
+            }
+        else
+            {
+            force[i] = make_scalar4(fixed.toScalar(qi[0]), fixed.toScalar(qi[1]), fixed.toScalar(qi[2]),
+                                    fixed.toScalar(qi[3]));
+            if (compute_virial)
+                {
+                for (unsigned int l = 0; l < 6; l++)
+                    virial[l*virial_pitch+i] = fixed.toScalar(qi[4+l]);
+                }
+            }
+        if (compute_virial)
+            {
+            for (unsigned int l = 0; l < 6; l++)
+                scratch.fixed_virial_sum[l] += qi[4+l] + virialj[l];
+            }
+        }
+
+    if (overflow)
+        scratch.fixed_overflow = true;
+    }
+
+void export_PotentialPairPolymdComposite(py::module& m)
+    {
+    py::class_<PotentialPairPolymdComposite, std::shared_ptr<PotentialPairPolymdComposite> >(m, "PotentialPairPolymdComposite", py::base<ForceCompute>())
+        .def(py::init< std::shared_ptr<SystemDefinition>, std::shared_ptr<NeighborList>, const std::string& >())
+        .def("addComponent", &PotentialPairPolymdComposite::addComponent)
+        .def("addJITComponent", &PotentialPairPolymdComposite::addJITComponent)
+        .def("getNumComponents", &PotentialPairPolymdComposite::getNumComponents)
+        .def("setParams", &PotentialPairPolymdComposite::setParams)
+        .def("setNumThreads", &PotentialPairPolymdComposite::setNumThreads)
+        .def("getNumThreads", &PotentialPairPolymdComposite::getNumThreads)
+        .def("setFixedPoint", &PotentialPairPolymdComposite::setFixedPoint)
+        .def("getFixedPoint", &PotentialPairPolymdComposite::getFixedPoint)
+        .def("setWorkStealing", &PotentialPairPolymdComposite::setWorkStealing)
+        .def("getWorkStealing", &PotentialPairPolymdComposite::getWorkStealing)
+        .def("getThreadBusyTimes", &PotentialPairPolymdComposite::getThreadBusyTimes)
+        .def("setDiameterScale", &PotentialPairPolymdComposite::setDiameterScale)
+        .def("getDiameterScale", &PotentialPairPolymdComposite::getDiameterScale)
+        ;
+    }
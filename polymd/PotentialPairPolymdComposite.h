@@ -0,0 +1,293 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#include "hoomd/ForceCompute.h"
+#include "hoomd/md/NeighborList.h"
+#include "EvaluatorPairPolydisperseParams.h"
+#include "PolydisperseBatch.h"
+#include "PolydisperseJIT.h"
+#include "PolymdDiameterScale.h"
+#include "PolymdFixedPoint.h"
+#include "PolymdPairLoopTime.h"
+#include "PolymdThreadPool.h"
+#include "PolymdVirialSum.h"
+#include "PolymdWorkQueue.h"
+
+/*! \file PotentialPairPolymdComposite.h
+    \brief Declares the PotentialPairPolymdComposite class
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+#include <hoomd/extern/pybind/include/pybind11/pybind11.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef __POTENTIALPAIRPOLYMDCOMPOSITE_H__
+#define __POTENTIALPAIRPOLYMDCOMPOSITE_H__
+
+//! One polydisperse model of a PotentialPairPolymdComposite
+struct polymd_composite_component
+    {
+    std::string name;                           //!< Name of the component, used in the log quantities
+    std::string model;                          //!< Name of the model, e.g. polydisperse12
+    polydisperse_batch_func batch;              //!< Batch kernel of the model for this CPU
+    std::vector<polydisperse_params> params;    //!< Parameters per type pair
+    Scalar energy;                              //!< Local energy of the last compute
+    std::shared_ptr<void> library;              //!< Keeps the library of a runtime compiled batch kernel loaded
+    };
+
+//! Scratch space of one thread of PotentialPairPolymdComposite
+struct polymd_composite_scratch
+    {
+    std::vector<unsigned int> j;        //!< Neighbor indices of the current particle
+    std::vector<unsigned int> typej;    //!< Neighbor types
+    std::vector<Scalar3> dx;            //!< Minimum image separations
+    std::vector<Scalar> rsq;            //!< Squared distances
+    std::vector<Scalar> dj;             //!< Neighbor diameters
+
+    std::vector<unsigned int> order;    //!< Neighbors sorted by type
+    std::vector<unsigned int> type_start; //!< End of each type in the sorted arrays
+    std::vector<Scalar> sorted_rsq;     //!< rsq sorted by type
+    std::vector<Scalar> sorted_dj;      //!< dj sorted by type
+
+    std::vector<Scalar> force_divr;     //!< Batch results of one component, in sorted order
+    std::vector<Scalar> pair_eng;       //!< Batch results of one component, in sorted order
+    std::vector<Scalar> sum_force;      //!< Force divided by r summed over the components, in sorted order
+    std::vector<Scalar> sum_eng;        //!< Pair energy summed over the components, in sorted order
+    std::vector<Scalar> weight;         //!< Share of each pair energy that belongs to the local particles
+
+    std::vector<Scalar4> force;         //!< Private force and energy buffer for half neighbor lists
+    std::vector<Scalar> virial;         //!< Private virial buffer for half neighbor lists
+    std::vector<Scalar> energy;         //!< Energy of each component from this thread
+    Scalar virial_sum[6];               //!< Virial of the local particles summed by this thread
+
+    std::vector<uint64_t> fixed;        //!< Fixed point force, energy and virial buffer for half neighbor lists
+    std::vector<uint64_t> fixed_energy; //!< Fixed point energy of each component from this thread
+    uint64_t fixed_virial_sum[6];       //!< Fixed point virial of the local particles summed by this thread
+    bool fixed_overflow;                //!< True if a contribution exceeded the fixed point range
+
+    //! Default constructor
+    polymd_composite_scratch() : fixed_overflow(false)
+        {
+        }
+
+    //! Make room for n neighbors
+    void reserve(unsigned int n)
+        {
+        if (rsq.size() >= n)
+            return;
+        j.resize(n); typej.resize(n); dx.resize(n); rsq.resize(n); dj.resize(n);
+        order.resize(n); sorted_rsq.resize(n); sorted_dj.resize(n);
+        force_divr.resize(n); pair_eng.resize(n); sum_force.resize(n); sum_eng.resize(n); weight.resize(n);
+        }
+    };
+
+//! Several polydisperse pair potentials evaluated in one pass over the neighbor list
+/*! Stacking two polymd forces, e.g. a polydisperse12 core and a lennardjones attraction on some type pairs, makes
+    each of them walk the neighbor list and gather the positions and diameters of the neighbors. The composite force
+    holds any number of components, each a polydisperse model (see addComponent()) with its own parameters per type
+    pair, and walks the neighbor list once:
+
+    - the separations, distances and diameters of the neighbors of a particle are gathered and sorted by type once,
+    - the batch kernel of every component is run on the same arrays (see PolydisperseBatch.h),
+    - the forces and energies of all components are summed per pair and accumulated into one force and virial array,
+      like PotentialPairPolymd does for a single model.
+
+    addJITComponent() adds a component whose batch kernel was compiled at runtime for any (m, n, q), see
+    PolydisperseJIT. It is called like the built in kernels.
+
+    Components with v0 = 0 for a type pair return right away, so a component can act on a subset of the type pairs.
+    The parameters of the components differ in eps and scaledr_cut, so every component evaluates its own sigma_ij and
+    cutoff from the shared diameters.
+
+    The energy of every component is kept for the log quantities pair_composite_<name>_energy, next to the total
+    pair_composite_energy. The work is split over a PolymdThreadPool by neighbor list entries, with work stealing, in
+    the same way as in PotentialPairPolymd (see PolymdWorkQueue), and the virial is summed over the local particles in
+    the same way too (see PolymdVirialSum). The pair loop is timed for LoadBalancerPolydisperse (see
+    PolymdPairLoopTime), and the diameters can be scaled in the pair loop like in PotentialPairPolymd (see
+    PolymdDiameterScale). setFixedPoint() sums the forces, virials and component energies in fixed point like
+    PotentialPairPolymd::setFixedPoint(), so that they do not depend on the number of threads.
+
+    \ingroup computes
+*/
+class PYBIND11_EXPORT PotentialPairPolymdComposite : public ForceCompute, public PolymdVirialSum,
+                                                     public PolymdPairLoopTime, public PolymdDiameterScale
+    {
+    public:
+        //! Constructs the compute
+        PotentialPairPolymdComposite(std::shared_ptr<SystemDefinition> sysdef,
+                                     std::shared_ptr<NeighborList> nlist,
+                                     const std::string& log_suffix="");
+
+        //! Destructor
+        virtual ~PotentialPairPolymdComposite();
+
+        //! Add a component with one of the polydisperse models
+        unsigned int addComponent(const std::string& name, const std::string& model);
+
+        //! Add a component with a runtime compiled (m, n, q) model
+        unsigned int addJITComponent(const std::string& name,
+                                     const std::string& filename,
+                                     unsigned int m,
+                                     unsigned int n,
+                                     unsigned int q);
+
+        //! Get the number of components
+        unsigned int getNumComponents() const
+            {
+            return m_components.size();
+            }
+
+        //! Set the parameters of a component for a single type pair
+        void setParams(unsigned int component, unsigned int typ1, unsigned int typ2, const polydisperse_params& param);
+
+        //! Set the number of threads
+        void setNumThreads(unsigned int n_threads);
+
+        //! Get the number of threads
+        unsigned int getNumThreads() const
+            {
+            return m_pool->getNumThreads();
+            }
+
+        //! Let the threads steal work from each other
+        void setWorkStealing(bool enable)
+            {
+            m_work_stealing = enable;
+            }
+
+        //! Check whether the threads steal work from each other
+        bool getWorkStealing() const
+            {
+            return m_work_stealing;
+            }
+
+        //! Get the busy time of every thread in the pair loop since the threads were set, in ns
+        std::vector<unsigned long long> getThreadBusyTimes() const
+            {
+            return m_thread_busy_total;
+            }
+
+        //! Sum the pair contributions in fixed point
+        void setFixedPoint(bool enable, unsigned int bits);
+
+        //! Get whether the pair contributions are summed in fixed point
+        bool getFixedPoint() const
+            {
+            return m_fixed_point;
+            }
+
+        //! Get the virial of the local particles summed in the last compute
+        virtual bool getVirialSum(Scalar *virial) const
+            {
+            for (unsigned int l = 0; l < 6; ++l)
+                virial[l] = m_virial_sum[l];
+            return m_virial_sum_valid;
+            }
+
+        //! Get the wall time of the pair loop summed over all computes on this rank, in ns
+        virtual unsigned long long getPairLoopTime() const
+            {
+            return m_pair_loop_time;
+            }
+
+        //! Set the factor applied to all diameters in the pair loop
+        virtual void setDiameterScale(Scalar scale);
+
+        //! Get the factor applied to all diameters in the pair loop
+        virtual Scalar getDiameterScale() const
+            {
+            return m_diameter_scale;
+            }
+
+        //! Get the largest change of the cutoff of any pair of any component when the diameters are scaled
+        virtual Scalar getCutoffChange(Scalar scale, Scalar d_min, Scalar d_max);
+
+        //! The cutoffs of the components are set by hand, nothing to derive when the diameters change
+        virtual void notifyDiametersChange()
+            {
+            }
+
+        //! Returns a list of log quantities this compute calculates
+        virtual std::vector< std::string > getProvidedLogQuantities();
+
+        //! Calculates the requested log value and returns it
+        virtual Scalar getLogValue(const std::string& quantity, unsigned int timestep);
+
+    protected:
+        std::shared_ptr<NeighborList> m_nlist;              //!< The neighbor list
+        Index2D m_typpair_idx;                              //!< Indexes the parameters of each type pair
+        std::vector<polymd_composite_component> m_components; //!< The models
+        std::string m_log_suffix;                           //!< Suffix of the log quantities
+        std::unique_ptr<PolymdThreadPool> m_pool;           //!< Worker threads
+        std::vector<polymd_composite_scratch> m_scratch;    //!< Scratch space per thread
+        PolymdWorkQueue m_queue;                            //!< Chunks of the pair loop
+        bool m_work_stealing;                               //!< True if the threads steal chunks from each other
+        std::vector<unsigned long long> m_thread_busy_total; //!< Busy time per thread, in ns
+        bool m_virial_sum_valid;                            //!< True if the last compute computed the virial
+        Scalar m_virial_sum[6];                             //!< Virial of the local particles summed in the last compute
+        bool m_fixed_point;                                 //!< True if the pair contributions are summed in fixed point
+        polymd_fixed_point m_fixed;                         //!< Resolution and range of the fixed point sums
+        unsigned long long m_pair_loop_time;                //!< Time of the pair loop since construction, in ns
+        Scalar m_diameter_scale;                            //!< Factor applied to all diameters in the pair loop
+
+        //! Actually compute the forces
+        virtual void computeForces(unsigned int timestep);
+
+        //! Add a component after checking its name
+        unsigned int pushComponent(polymd_composite_component& component);
+
+        //! Gather the neighbors of particle i and sum the forces and energies of all components per pair
+        unsigned int evalParticle(polymd_composite_scratch& scratch,
+                                  const Scalar4 *pos,
+                                  const Scalar *diameter,
+                                  const unsigned int *n_neigh,
+                                  const unsigned int *nlist,
+                                  const unsigned int *head_list,
+                                  unsigned int i,
+                                  bool third_law,
+                                  bool& mixed);
+
+        //! Compute the pair forces of a range of particles
+        void computeRange(polymd_composite_scratch& scratch,
+                          const Scalar4 *pos,
+                          const Scalar *diameter,
+                          const unsigned int *n_neigh,
+                          const unsigned int *nlist,
+                          const unsigned int *head_list,
+                          unsigned int first,
+                          unsigned int last,
+                          bool third_law,
+                          bool compute_virial,
+                          Scalar4 *force,
+                          Scalar *virial,
+                          unsigned int virial_pitch);
+
+        //! Compute the pair forces of a range of particles in fixed point
+        void computeRangeFixed(polymd_composite_scratch& scratch,
+                               const Scalar4 *pos,
+                               const Scalar *diameter,
+                               const unsigned int *n_neigh,
+                               const unsigned int *nlist,
+                               const unsigned int *head_list,
+                               unsigned int first,
+                               unsigned int last,
+                               bool third_law,
+                               bool compute_virial,
+                               Scalar4 *force,
+                               Scalar *virial,
+                               unsigned int virial_pitch);
+    };
+
+//! Exports PotentialPairPolymdComposite to python
+void export_PotentialPairPolymdComposite(pybind11::module& m);
+
+#endif // __POTENTIALPAIRPOLYMDCOMPOSITE_H__
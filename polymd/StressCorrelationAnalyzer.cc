@@ -0,0 +1,217 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+/*! \file StressCorrelationAnalyzer.cc
+    \brief Defines StressCorrelationAnalyzer
+*/
+
+#include "StressCorrelationAnalyzer.h"
+
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+namespace py = pybind11;
+
+using namespace std;
+
+/*! \param sysdef System definition
+    \param p Number of lags of each level of the correlator
+    \param m Averaging factor between the levels of the correlator
+    \param kinetic True to include the kinetic part of the pressure tensor
+*/
+StressCorrelationAnalyzer::StressCorrelationAnalyzer(std::shared_ptr<SystemDefinition> sysdef,
+                                                     unsigned int p,
+                                                     unsigned int m,
+                                                     bool kinetic)
+    : Analyzer(sysdef), m_kinetic(kinetic), m_correlator(sysdef->getNDimensions() == 2 ? 1 : 3, p, m),
+      m_volume_sum(0.0), m_deltaT(1.0), m_kT(0.0), m_write_period(0)
+    {
+    m_exec_conf->msg->notice(5) << "Constructing StressCorrelationAnalyzer" << endl;
+    }
+
+StressCorrelationAnalyzer::~StressCorrelationAnalyzer()
+    {
+    m_exec_conf->msg->notice(5) << "Destroying StressCorrelationAnalyzer" << endl;
+    }
+
+/*! \param force Force compute to add
+*/
+void StressCorrelationAnalyzer::addForce(std::shared_ptr<ForceCompute> force)
+    {
+    m_forces.push_back(force);
+    }
+
+/*! \returns The pressure tensor flag
+*/
+PDataFlags StressCorrelationAnalyzer::getRequestedPDataFlags()
+    {
+    PDataFlags flags(0);
+    flags[pdata_flag::pressure_tensor] = 1;
+    return flags;
+    }
+
+/*! \param timestep Current time step of the simulation
+
+    The off-diagonal components of the pressure tensor of \a timestep are added to the correlator.
+*/
+void StressCorrelationAnalyzer::analyze(unsigned int timestep)
+    {
+    if (m_prof) m_prof->push("analyze.stress_correlation");
+
+    // xy, xz, yz of the virial and the kinetic part, summed over the local particles
+    double sum[3] = {0.0, 0.0, 0.0};
+    const unsigned int N = m_pdata->getN();
+    for (unsigned int f = 0; f < m_forces.size(); ++f)
+        {
+        m_forces[f]->compute(timestep);
+
+        Scalar virial[6];
+        PolymdVirialSum *polymd = dynamic_cast<PolymdVirialSum *>(m_forces[f].get());
+        if (polymd && polymd->getVirialSum(virial))
+            {
+            sum[0] += virial[1];
+            sum[1] += virial[2];
+            sum[2] += virial[4];
+            }
+        else
+            {
+            ArrayHandle<Scalar> h_virial(m_forces[f]->getVirialArray(), access_location::host, access_mode::read);
+            const unsigned int pitch = m_forces[f]->getVirialArray().getPitch();
+            for (unsigned int i = 0; i < N; ++i)
+                {
+                sum[0] += h_virial.data[1*pitch+i];
+                sum[1] += h_virial.data[2*pitch+i];
+                sum[2] += h_virial.data[4*pitch+i];
+                }
+            }
+        }
+
+    if (m_kinetic)
+        {
+        ArrayHandle<Scalar4> h_vel(m_pdata->getVelocities(), access_location::host, access_mode::read);
+        for (unsigned int i = 0; i < N; ++i)
+            {
+            const Scalar4 v = h_vel.data[i];
+            sum[0] += v.w*v.x*v.y;
+            sum[1] += v.w*v.x*v.z;
+            sum[2] += v.w*v.y*v.z;
+            }
+        }
+
+#ifdef ENABLE_MPI
+    if (m_pdata->getDomainDecomposition())
+        MPI_Allreduce(MPI_IN_PLACE, sum, 3, MPI_DOUBLE, MPI_SUM, m_exec_conf->getMPICommunicator());
+#endif
+
+    const bool twod = m_sysdef->getNDimensions() == 2;
+    const double volume = m_pdata->getGlobalBox().getVolume(twod);
+    const double pressure[3] = {sum[0]/volume, sum[1]/volume, sum[2]/volume};
+    m_correlator.add(pressure);
+    m_volume_sum += volume;
+
+    if (m_write_period && !m_filename.empty() && m_correlator.getNumSamples() % m_write_period == 0)
+        writeFile(m_filename);
+
+    if (m_prof) m_prof->pop();
+    }
+
+/*! \returns The lags of the correlation function times the time between two samples
+*/
+std::vector<Scalar> StressCorrelationAnalyzer::getTimes() const
+    {
+    std::vector<unsigned long long> lag;
+    std::vector<double> correlation;
+    m_correlator.getCorrelation(lag, correlation);
+
+    std::vector<Scalar> times(lag.size());
+    for (unsigned int k = 0; k < lag.size(); ++k)
+        times[k] = Scalar(lag[k])*m_deltaT;
+    return times;
+    }
+
+/*! \returns The autocorrelation of the off-diagonal pressure, averaged over the components
+*/
+std::vector<Scalar> StressCorrelationAnalyzer::getCorrelation() const
+    {
+    std::vector<unsigned long long> lag;
+    std::vector<double> correlation;
+    m_correlator.getCorrelation(lag, correlation);
+    return std::vector<Scalar>(correlation.begin(), correlation.end());
+    }
+
+/*! \returns The integral of the correlation from 0 to every time of getTimes(), with the trapezoidal rule
+*/
+std::vector<Scalar> StressCorrelationAnalyzer::getIntegral() const
+    {
+    std::vector<unsigned long long> lag;
+    std::vector<double> correlation;
+    m_correlator.getCorrelation(lag, correlation);
+
+    std::vector<Scalar> integral(lag.size());
+    double running = 0.0;
+    for (unsigned int k = 0; k < lag.size(); ++k)
+        {
+        if (k > 0)
+            running += 0.5*(correlation[k] + correlation[k-1])*double(lag[k] - lag[k-1])*m_deltaT;
+        integral[k] = Scalar(running);
+        }
+    return integral;
+    }
+
+/*! \param filename File to write, overwritten
+
+    Only the root rank writes. The columns are time, correlation, integral and, with a temperature, viscosity.
+*/
+void StressCorrelationAnalyzer::writeFile(const std::string& filename)
+    {
+    if (m_exec_conf->getRank() != 0)
+        return;
+
+    const std::vector<Scalar> times = getTimes();
+    const std::vector<Scalar> correlation = getCorrelation();
+    const std::vector<Scalar> integral = getIntegral();
+    const Scalar prefactor = m_kT > Scalar(0.0) ? getAverageVolume()/m_kT : Scalar(0.0);
+
+    ofstream file(filename.c_str());
+    if (!file.good())
+        {
+        m_exec_conf->msg->error() << "analyze.stress_correlation: unable to open file " << filename << endl;
+        throw runtime_error("Error writing the stress correlation");
+        }
+
+    file << "# samples " << m_correlator.getNumSamples() << ", volume " << setprecision(10) << getAverageVolume() << "\n";
+    file << "time\tcorrelation\tintegral";
+    if (prefactor > Scalar(0.0))
+        file << "\tviscosity";
+    file << "\n";
+    file << setprecision(10);
+    for (unsigned int k = 0; k < times.size(); ++k)
+        {
+        file << times[k] << "\t" << correlation[k] << "\t" << integral[k];
+        if (prefactor > Scalar(0.0))
+            file << "\t" << prefactor*integral[k];
+        file << "\n";
+        }
+    }
+
+void export_StressCorrelationAnalyzer(py::module& m)
+    {
+    py::class_<StressCorrelationAnalyzer, std::shared_ptr<StressCorrelationAnalyzer> >(m, "StressCorrelationAnalyzer", py::base<Analyzer>())
+        .def(py::init< std::shared_ptr<SystemDefinition>, unsigned int, unsigned int, bool >())
+        .def("addForce", &StressCorrelationAnalyzer::addForce)
+        .def("setDeltaT", &StressCorrelationAnalyzer::setDeltaT)
+        .def("setTemperature", &StressCorrelationAnalyzer::setTemperature)
+        .def("setOutput", &StressCorrelationAnalyzer::setOutput)
+        .def("getNumSamples", &StressCorrelationAnalyzer::getNumSamples)
+        .def("getAverageVolume", &StressCorrelationAnalyzer::getAverageVolume)
+        .def("getTimes", &StressCorrelationAnalyzer::getTimes)
+        .def("getCorrelation", &StressCorrelationAnalyzer::getCorrelation)
+        .def("getIntegral", &StressCorrelationAnalyzer::getIntegral)
+        .def("reset", &StressCorrelationAnalyzer::reset)
+        .def("writeFile", &StressCorrelationAnalyzer::writeFile)
+        ;
+    }
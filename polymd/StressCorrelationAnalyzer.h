@@ -0,0 +1,137 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#include "hoomd/Analyzer.h"
+#include "hoomd/ForceCompute.h"
+#include "MultiTauCorrelator.h"
+#include "PolymdVirialSum.h"
+
+/*! \file StressCorrelationAnalyzer.h
+    \brief Declares the StressCorrelationAnalyzer class
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+#include <hoomd/extern/pybind/include/pybind11/pybind11.h>
+#include <hoomd/extern/pybind/include/pybind11/stl.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef __STRESSCORRELATIONANALYZER_H__
+#define __STRESSCORRELATIONANALYZER_H__
+
+//! Green-Kubo stress autocorrelation computed during the run
+/*! The shear viscosity follows from the autocorrelation of the off-diagonal pressure tensor,
+    eta = V/kT int_0^inf <P_xy(0) P_xy(t)> dt. Logging P_xy every step and correlating afterwards needs files that grow
+    with the length of the run. StressCorrelationAnalyzer instead feeds the off-diagonal components of every sample
+    into a MultiTauCorrelator, whose memory grows with the logarithm of the number of samples, and writes only the
+    correlation function and its running integral.
+
+    Every sample sums the virial of the given forces over the local particles and over the ranks:
+
+    - the polymd force computes sum it in their pair loop (see PolymdVirialSum), so this costs nothing per particle,
+    - other forces are summed from their per particle virials,
+    - the kinetic part sum m v_a v_b is added unless disabled.
+
+    In 3D, the xy, xz and yz components are correlated as three channels and their autocorrelations averaged, in 2D
+    only xy. The analyzer requests the pressure tensor flag, so the forces compute the virial on every sampled step.
+
+    writeFile() writes the time, the correlation, its running integral (trapezoidal on the multi-tau lags) and, when a
+    temperature is set, the viscosity V/kT times the integral, with V averaged over the samples. With a file name set,
+    the file is also rewritten every write period samples, so that an interrupted run keeps its correlation.
+
+    \ingroup analyzers
+*/
+class PYBIND11_EXPORT StressCorrelationAnalyzer : public Analyzer
+    {
+    public:
+        //! Constructs the analyzer
+        StressCorrelationAnalyzer(std::shared_ptr<SystemDefinition> sysdef,
+                                  unsigned int p,
+                                  unsigned int m,
+                                  bool kinetic);
+
+        //! Destructor
+        virtual ~StressCorrelationAnalyzer();
+
+        //! Add a force whose virial is part of the pressure tensor
+        void addForce(std::shared_ptr<ForceCompute> force);
+
+        //! Set the time between two samples, the unit of the lags
+        void setDeltaT(Scalar deltaT)
+            {
+            m_deltaT = deltaT;
+            }
+
+        //! Set the temperature of the viscosity, 0 to leave it out
+        void setTemperature(Scalar kT)
+            {
+            m_kT = kT;
+            }
+
+        //! Rewrite a file every write_period samples, 0 for never
+        void setOutput(const std::string& filename, unsigned int write_period)
+            {
+            m_filename = filename;
+            m_write_period = write_period;
+            }
+
+        //! Get the number of samples
+        unsigned long long getNumSamples() const
+            {
+            return m_correlator.getNumSamples();
+            }
+
+        //! Get the volume averaged over the samples
+        Scalar getAverageVolume() const
+            {
+            return m_correlator.getNumSamples() ? Scalar(m_volume_sum/m_correlator.getNumSamples()) : Scalar(0.0);
+            }
+
+        //! Get the times of the correlation function
+        std::vector<Scalar> getTimes() const;
+
+        //! Get the correlation function
+        std::vector<Scalar> getCorrelation() const;
+
+        //! Get the running integral of the correlation function
+        std::vector<Scalar> getIntegral() const;
+
+        //! Forget all samples
+        void reset()
+            {
+            m_correlator.reset();
+            m_volume_sum = 0.0;
+            }
+
+        //! Write the correlation function and its integral
+        void writeFile(const std::string& filename);
+
+        //! Request the pressure tensor
+        virtual PDataFlags getRequestedPDataFlags();
+
+        //! Take a sample
+        virtual void analyze(unsigned int timestep);
+
+    protected:
+        std::vector< std::shared_ptr<ForceCompute> > m_forces; //!< Forces of the virial
+        bool m_kinetic;                     //!< True if the kinetic part is included
+        MultiTauCorrelator m_correlator;    //!< Correlator of the off-diagonal components
+        double m_volume_sum;                //!< Sum of the volume over the samples
+        Scalar m_deltaT;                    //!< Time between two samples
+        Scalar m_kT;                        //!< Temperature of the viscosity
+        std::string m_filename;             //!< File rewritten every m_write_period samples
+        unsigned int m_write_period;        //!< Samples between two writes, 0 for never
+    };
+
+//! Exports StressCorrelationAnalyzer to python
+void export_StressCorrelationAnalyzer(pybind11::module& m);
+
+#endif // __STRESSCORRELATIONANALYZER_H__
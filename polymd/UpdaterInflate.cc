@@ -0,0 +1,213 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+/*! \file UpdaterInflate.cc
+    \brief Defines UpdaterInflate
+*/
+
+#include "UpdaterInflate.h"
+#include "NeighborListDiameterClass.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace py = pybind11;
+
+using namespace std;
+
+/*! \param sysdef System definition
+    \param nlist Neighbor list of the forces
+    \param scale Total factor relative to the diameters at construction
+*/
+UpdaterInflate::UpdaterInflate(std::shared_ptr<SystemDefinition> sysdef,
+                               std::shared_ptr<NeighborList> nlist,
+                               std::shared_ptr<Variant> scale)
+    : Updater(sysdef), m_nlist(nlist), m_scale(scale), m_buffer_fraction(Scalar(0.5)), m_folded(Scalar(1.0)),
+      m_pending(Scalar(1.0)), m_n_folds(0)
+    {
+    m_exec_conf->msg->notice(5) << "Constructing UpdaterInflate" << endl;
+    }
+
+UpdaterInflate::~UpdaterInflate()
+    {
+    m_exec_conf->msg->notice(5) << "Destroying UpdaterInflate" << endl;
+    }
+
+/*! \param force A polymd force compute, see PolymdDiameterScale
+*/
+void UpdaterInflate::addForce(std::shared_ptr<ForceCompute> force)
+    {
+    PolymdDiameterScale *scaled = dynamic_cast<PolymdDiameterScale *>(force.get());
+    if (!scaled)
+        {
+        m_exec_conf->msg->error() << "update.inflate: only the polymd pair forces on the CPU can scale the "
+                                  << "diameters" << endl;
+        throw runtime_error("Error adding a force to the inflate updater");
+        }
+    scaled->setDiameterScale(m_pending);
+    m_forces.push_back(force);
+    }
+
+/*! \param buffer_fraction Fraction of the neighbor list buffer in (0, 1]
+*/
+void UpdaterInflate::setBufferFraction(Scalar buffer_fraction)
+    {
+    if (!(buffer_fraction > Scalar(0.0) && buffer_fraction <= Scalar(1.0)))
+        {
+        m_exec_conf->msg->error() << "update.inflate: buffer_fraction must be in (0, 1]" << endl;
+        throw runtime_error("Error setting the inflate parameters");
+        }
+    m_buffer_fraction = buffer_fraction;
+    }
+
+/*! After apply(), the diameters of the particle data include the whole factor.
+*/
+void UpdaterInflate::apply()
+    {
+    if (m_pending != Scalar(1.0))
+        fold(m_pending);
+    }
+
+/*! \returns The list of log quantities
+*/
+std::vector< std::string > UpdaterInflate::getProvidedLogQuantities()
+    {
+    std::vector<std::string> list;
+    list.push_back("polydisperse_diameter_scale");
+    list.push_back("polydisperse_diameter_folds");
+    return list;
+    }
+
+/*! \param quantity Name of the log quantity to get
+    \param timestep Current time step of the simulation
+*/
+Scalar UpdaterInflate::getLogValue(const std::string& quantity, unsigned int timestep)
+    {
+    if (quantity == "polydisperse_diameter_scale")
+        return getScale();
+    else if (quantity == "polydisperse_diameter_folds")
+        return Scalar(m_n_folds);
+
+    m_exec_conf->msg->error() << "update.inflate: " << quantity << " is not a valid log quantity" << endl;
+    throw runtime_error("Error getting log value");
+    }
+
+/*! \param d_min Returns the smallest diameter of the particle data
+    \param d_max Returns the largest diameter of the particle data
+*/
+void UpdaterInflate::getDiameterRange(Scalar& d_min, Scalar& d_max)
+    {
+    // largest diameter, then minus the smallest diameter
+    Scalar range[2] = {-std::numeric_limits<Scalar>::max(), -std::numeric_limits<Scalar>::max()};
+        {
+        ArrayHandle<Scalar> h_diameter(m_pdata->getDiameters(), access_location::host, access_mode::read);
+        for (unsigned int i = 0; i < m_pdata->getN(); ++i)
+            {
+            range[0] = std::max(range[0], h_diameter.data[i]);
+            range[1] = std::max(range[1], -h_diameter.data[i]);
+            }
+        }
+
+#ifdef ENABLE_MPI
+    if (m_pdata->getDomainDecomposition())
+        MPI_Allreduce(MPI_IN_PLACE, range, 2, MPI_HOOMD_SCALAR, MPI_MAX, m_exec_conf->getMPICommunicator());
+#endif
+
+    d_max = std::max(range[0], Scalar(0.0));
+    d_min = std::min(std::max(-range[1], Scalar(0.0)), d_max);
+    }
+
+/*! \param pending Factor the forces apply to the diameters
+    \param buffer_used Part of the neighbor list buffer taken by the growth of the cutoffs
+*/
+void UpdaterInflate::setPending(Scalar pending, Scalar buffer_used)
+    {
+    for (unsigned int f = 0; f < m_forces.size(); ++f)
+        dynamic_cast<PolymdDiameterScale *>(m_forces[f].get())->setDiameterScale(pending);
+    m_pending = pending;
+
+    std::shared_ptr<NeighborListDiameterClass> nlist_class =
+        std::dynamic_pointer_cast<NeighborListDiameterClass>(m_nlist);
+    if (nlist_class)
+        nlist_class->setBufferUsed(buffer_used);
+    }
+
+/*! \param scale Factor to write into the diameters
+
+    Only the local particles are changed. The rebuild of the neighbor list makes the communicator exchange the ghosts
+    again, which brings their new diameters along.
+*/
+void UpdaterInflate::fold(Scalar scale)
+    {
+        {
+        ArrayHandle<Scalar> h_diameter(m_pdata->getDiameters(), access_location::host, access_mode::readwrite);
+        for (unsigned int i = 0; i < m_pdata->getN(); ++i)
+            h_diameter.data[i] *= scale;
+        }
+    m_folded *= scale;
+    setPending(Scalar(1.0), Scalar(0.0));
+
+    // a d_max given by hand keeps its margin over the largest diameter
+    m_nlist->setMaximumDiameter(m_nlist->getMaximumDiameter()*scale);
+    m_nlist->forceUpdate();
+    ++m_n_folds;
+
+    // forces with derived cutoffs replace them, and d_max, from the new diameters
+    for (unsigned int f = 0; f < m_forces.size(); ++f)
+        dynamic_cast<PolymdDiameterScale *>(m_forces[f].get())->notifyDiametersChange();
+
+    m_exec_conf->msg->notice(6) << "update.inflate: wrote a factor " << scale << " into the diameters, total "
+                                << m_folded << endl;
+    }
+
+/*! \param timestep Current time step of the simulation
+*/
+void UpdaterInflate::update(unsigned int timestep)
+    {
+    const Scalar pending = m_scale->getValue(timestep)/m_folded;
+    if (!(pending > Scalar(0.0)))
+        {
+        m_exec_conf->msg->error() << "update.inflate: the scale must be positive" << endl;
+        throw runtime_error("Error updating the diameters");
+        }
+    if (pending == m_pending)
+        return;
+
+    if (m_prof) m_prof->push(m_exec_conf, "inflate");
+
+    Scalar d_min, d_max;
+    getDiameterRange(d_min, d_max);
+    Scalar change = Scalar(0.0);
+    for (unsigned int f = 0; f < m_forces.size(); ++f)
+        {
+        PolymdDiameterScale *scaled = dynamic_cast<PolymdDiameterScale *>(m_forces[f].get());
+        change = std::max(change, scaled->getCutoffChange(pending, d_min, d_max));
+        }
+
+    // only the neighbor list that searches out to the true cutoffs can take the change out of its buffer
+    if (std::dynamic_pointer_cast<NeighborListDiameterClass>(m_nlist)
+        && change < m_buffer_fraction*m_nlist->getRBuff())
+        setPending(pending, change);
+    else
+        fold(pending);
+
+    if (m_prof) m_prof->pop(m_exec_conf);
+    }
+
+void export_UpdaterInflate(py::module& m)
+    {
+    py::class_<UpdaterInflate, std::shared_ptr<UpdaterInflate> >(m, "UpdaterInflate", py::base<Updater>())
+        .def(py::init< std::shared_ptr<SystemDefinition>, std::shared_ptr<NeighborList>, std::shared_ptr<Variant> >())
+        .def("addForce", &UpdaterInflate::addForce)
+        .def("setScale", &UpdaterInflate::setScale)
+        .def("setBufferFraction", &UpdaterInflate::setBufferFraction)
+        .def("getScale", &UpdaterInflate::getScale)
+        .def("getPendingScale", &UpdaterInflate::getPendingScale)
+        .def("getNumFolds", &UpdaterInflate::getNumFolds)
+        .def("apply", &UpdaterInflate::apply)
+        ;
+    }
@@ -0,0 +1,125 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#include "hoomd/Updater.h"
+#include "hoomd/Variant.h"
+#include "hoomd/ForceCompute.h"
+#include "hoomd/md/NeighborList.h"
+#include "PolymdDiameterScale.h"
+
+/*! \file UpdaterInflate.h
+    \brief Declares the UpdaterInflate class
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+#include <hoomd/extern/pybind/include/pybind11/pybind11.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef __UPDATERINFLATE_H__
+#define __UPDATERINFLATE_H__
+
+//! Grows all diameters by a common factor without rebuilding the neighbor list at every step
+/*! Compression protocols in the style of Lubachevsky and Stillinger scale all diameters by a small factor many times.
+    Writing the diameters every time changes the maximum diameter and the cutoffs, and the neighbor list has to be
+    rebuilt after every rescale.
+
+    UpdaterInflate follows a variant that gives the total factor relative to the diameters at construction. The part
+    that is not yet written into the particle data is passed to the forces as one scalar (see PolymdDiameterScale),
+    so the diameters of the particle data only change in a fold. The cutoffs of the forces grow by at most
+    getCutoffChange(), which the neighbor list buffer covers as long as the particles do not move too far. With a
+    NeighborListDiameterClass, the change is reported with setBufferUsed() and the distance check only allows what is
+    left of the buffer, so the list is rebuilt when it has to be and not at every update. A fold happens once the
+    change reaches the buffer fraction times the buffer: the diameters of the local particles are multiplied by the
+    pending factor, the factor of the forces goes back to 1 and the neighbor list is rebuilt. Any other neighbor list
+    cannot account for the change, so then every update folds.
+
+    Other forces, analyzers and updaters see the diameters of the particle data, which lag behind by the pending
+    factor until the next fold or apply().
+
+    \ingroup updaters
+*/
+class PYBIND11_EXPORT UpdaterInflate : public Updater
+    {
+    public:
+        //! Constructs the updater
+        UpdaterInflate(std::shared_ptr<SystemDefinition> sysdef,
+                       std::shared_ptr<NeighborList> nlist,
+                       std::shared_ptr<Variant> scale);
+
+        //! Destructor
+        virtual ~UpdaterInflate();
+
+        //! Add a force that scales the diameters in its pair loop
+        void addForce(std::shared_ptr<ForceCompute> force);
+
+        //! Set the total factor relative to the diameters at construction
+        void setScale(std::shared_ptr<Variant> scale)
+            {
+            m_scale = scale;
+            }
+
+        //! Set the fraction of the buffer that the growth of the cutoffs may use before a fold
+        void setBufferFraction(Scalar buffer_fraction);
+
+        //! Get the total factor applied to the diameters, written or pending
+        Scalar getScale() const
+            {
+            return m_folded*m_pending;
+            }
+
+        //! Get the factor that is not yet written into the diameters
+        Scalar getPendingScale() const
+            {
+            return m_pending;
+            }
+
+        //! Get the number of folds
+        unsigned int getNumFolds() const
+            {
+            return m_n_folds;
+            }
+
+        //! Write the pending factor into the diameters
+        void apply();
+
+        //! Returns a list of log quantities this updater calculates
+        virtual std::vector< std::string > getProvidedLogQuantities();
+
+        //! Calculates the requested log value and returns it
+        virtual Scalar getLogValue(const std::string& quantity, unsigned int timestep);
+
+        //! Grow the diameters
+        virtual void update(unsigned int timestep);
+
+    protected:
+        std::shared_ptr<NeighborList> m_nlist;                      //!< Neighbor list of the forces
+        std::shared_ptr<Variant> m_scale;                           //!< Total factor relative to the initial diameters
+        std::vector< std::shared_ptr<ForceCompute> > m_forces;      //!< Forces that scale the diameters
+        Scalar m_buffer_fraction;                                   //!< Fraction of the buffer used before a fold
+        Scalar m_folded;                                            //!< Factor written into the diameters
+        Scalar m_pending;                                           //!< Factor applied by the forces only
+        unsigned int m_n_folds;                                     //!< Number of folds
+
+        //! Get the smallest and the largest diameter of all particles
+        void getDiameterRange(Scalar& d_min, Scalar& d_max);
+
+        //! Pass a pending factor to the forces and the neighbor list
+        void setPending(Scalar pending, Scalar buffer_used);
+
+        //! Multiply the diameters by a factor and rebuild the neighbor list
+        void fold(Scalar scale);
+    };
+
+//! Exports the UpdaterInflate class to python
+void export_UpdaterInflate(pybind11::module& m);
+
+#endif // __UPDATERINFLATE_H__
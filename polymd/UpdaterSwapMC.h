@@ -0,0 +1,465 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+#ifndef __UPDATER_SWAP_MC_H__
+#define __UPDATER_SWAP_MC_H__
+
+#include "PotentialPairPolymd.h"
+#include "hoomd/Updater.h"
+#include "hoomd/Variant.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+/*! \file UpdaterSwapMC.h
+    \brief Declares the UpdaterSwapMC class
+*/
+
+#ifdef NVCC
+#error This header cannot be compiled by nvcc
+#endif
+
+#include <hoomd/extern/pybind/include/pybind11/pybind11.h>
+
+//! Diameter swap Monte Carlo for the polydisperse pair potentials
+/*! Every update attempts sweeps * N swaps of the diameters of two random particles and accepts each with the Metropolis
+    criterion at the temperature kT. The energy change only involves the pairs of the two particles with their
+    neighbors, so it is computed locally: the particles are binned once per update into a grid of cells at least as
+    wide as the largest interaction range, and every attempt visits the cells around the two particles. The cost of an
+    attempt does not depend on N. The pair of the two particles itself is symmetric in the diameters and drops out.
+
+    Swaps keep the set of diameters, so the largest range and the grid stay valid over the whole update. Accepted swaps
+    change the pair ranges of the neighbor list, which is forced to rebuild before the next force computation.
+
+    Attempts that pick two particles with the same diameter change nothing. They are counted separately by
+    getIdentical() and left out of getAttempted() and getAccepted(), otherwise a discrete or binned distribution of
+    diameters would push the acceptance ratio towards 1.
+
+    The energy comes from the evaluator and the parameters of the pair force, so it is the same potential the forces
+    are integrated with. The diameters are multiplied by the pending factor of the pair force (see
+    PolymdDiameterScale) in the energies and in the interaction range, like in its pair loop. Swapping the stored
+    diameters swaps the scaled ones, so the factor stays pending. Positions are not changed. Only single rank runs are
+    supported.
+
+    \tparam evaluator One of the EvaluatorPairPolydisperseMNQ instantiations
+    \ingroup updaters
+*/
+template < class evaluator >
+class UpdaterSwapMC : public Updater
+    {
+    public:
+        //! Param type from evaluator
+        typedef typename evaluator::param_type param_type;
+        //! Evaluator of the pair force
+        typedef evaluator evaluator_type;
+
+        //! Constructs the updater
+        UpdaterSwapMC(std::shared_ptr<SystemDefinition> sysdef,
+                      std::shared_ptr< PotentialPairPolymd<evaluator> > pair,
+                      std::shared_ptr<NeighborList> nlist,
+                      std::shared_ptr<Variant> kT,
+                      unsigned int seed);
+
+        //! Destructor
+        virtual ~UpdaterSwapMC();
+
+        //! Set the temperature
+        void setT(std::shared_ptr<Variant> kT)
+            {
+            m_kT = kT;
+            }
+
+        //! Set the number of swap attempts per particle and update
+        void setSweeps(Scalar sweeps);
+
+        //! Get the number of swap attempts since the last reset
+        unsigned long long getAttempted() const
+            {
+            return m_attempted;
+            }
+
+        //! Get the number of accepted swaps since the last reset
+        unsigned long long getAccepted() const
+            {
+            return m_accepted;
+            }
+
+        //! Get the number of attempts between two equal diameters since the last reset, not counted as attempts
+        unsigned long long getIdentical() const
+            {
+            return m_identical;
+            }
+
+        //! Get the fraction of accepted swaps since the last reset
+        Scalar getAcceptanceRatio() const
+            {
+            return m_attempted > 0 ? Scalar(m_accepted)/Scalar(m_attempted) : Scalar(0.0);
+            }
+
+        //! Reset the swap counters
+        void resetCounters()
+            {
+            m_attempted = 0;
+            m_accepted = 0;
+            m_identical = 0;
+            }
+
+        //! Take one timestep forward
+        virtual void update(unsigned int timestep);
+
+    protected:
+        std::shared_ptr< PotentialPairPolymd<evaluator> > m_pair;  //!< Pair force providing the parameters
+        std::shared_ptr<NeighborList> m_nlist;  //!< Neighbor list to rebuild after accepted swaps
+        std::shared_ptr<Variant> m_kT;          //!< Temperature
+        unsigned int m_seed;                    //!< Seed of the random number generator
+        Scalar m_rcutsq;                        //!< Square of the largest interaction range of the current update
+        Scalar m_diameter_scale;                //!< Factor of the pair force on the diameters in the current update
+        Scalar m_sweeps;                        //!< Swap attempts per particle and update
+
+        unsigned long long m_attempted;         //!< Swap attempts since the last reset
+        unsigned long long m_accepted;          //!< Accepted swaps since the last reset
+        unsigned long long m_identical;         //!< Attempts between equal diameters since the last reset
+
+        int m_dim[3];                           //!< Number of cells in each direction
+        std::vector<unsigned int> m_cell_start; //!< First entry of each cell in m_cell_idx, plus one end entry
+        std::vector<unsigned int> m_cell_idx;   //!< Particle indices sorted by cell
+        std::vector<unsigned int> m_cell_of;    //!< Cell of each particle
+        std::vector<unsigned int> m_neigh_cells;    //!< Scratch list of the cells around a particle
+
+        //! Bin the particles into cells at least r_max wide
+        void buildCells(const Scalar4 *pos, unsigned int N, Scalar r_max);
+
+        //! Change of the energy of particle i with its neighbors when its diameter changes, leaving out particle skip
+        Scalar computeEnergyChange(unsigned int i,
+                                   Scalar d_new,
+                                   unsigned int skip,
+                                   const Scalar4 *pos,
+                                   const Scalar *diameter,
+                                   const param_type *params);
+    };
+
+/*! \param sysdef System definition
+    \param pair Pair force whose energy drives the swaps
+    \param nlist Neighbor list of the pair force
+    \param kT Temperature of the Metropolis criterion
+    \param seed Seed of the random number generator
+*/
+template < class evaluator >
+UpdaterSwapMC< evaluator >::UpdaterSwapMC(std::shared_ptr<SystemDefinition> sysdef,
+                                          std::shared_ptr< PotentialPairPolymd<evaluator> > pair,
+                                          std::shared_ptr<NeighborList> nlist,
+                                          std::shared_ptr<Variant> kT,
+                                          unsigned int seed)
+    : Updater(sysdef), m_pair(pair), m_nlist(nlist), m_kT(kT), m_seed(seed), m_rcutsq(Scalar(0.0)),
+      m_diameter_scale(Scalar(1.0)),
+      m_sweeps(Scalar(1.0)), m_attempted(0), m_accepted(0), m_identical(0)
+    {
+    m_exec_conf->msg->notice(5) << "Constructing UpdaterSwapMC" << std::endl;
+
+#ifdef ENABLE_MPI
+    if (m_pdata->getDomainDecomposition())
+        {
+        m_exec_conf->msg->error() << "update.swap: swap Monte Carlo is not supported with domain decomposition" << std::endl;
+        throw std::runtime_error("Error initializing UpdaterSwapMC");
+        }
+#endif
+
+    m_dim[0] = m_dim[1] = m_dim[2] = 1;
+    }
+
+template < class evaluator >
+UpdaterSwapMC< evaluator >::~UpdaterSwapMC()
+    {
+    m_exec_conf->msg->notice(5) << "Destroying UpdaterSwapMC" << std::endl;
+    }
+
+/*! \param sweeps Swap attempts per particle and update, the attempts per update are rounded to the nearest integer
+*/
+template < class evaluator >
+void UpdaterSwapMC< evaluator >::setSweeps(Scalar sweeps)
+    {
+    if (!(sweeps >= Scalar(0.0)))
+        {
+        m_exec_conf->msg->error() << "update.swap: the number of sweeps must not be negative" << std::endl;
+        throw std::runtime_error("Error setting the swap sweeps");
+        }
+    m_sweeps = sweeps;
+    }
+
+/*! \param pos Particle positions
+    \param N Number of particles
+    \param r_max Largest interaction range
+
+    Cells are equal width in fractional coordinates and at least r_max wide perpendicular to each face of the box.
+    Directions with fewer than 3 cells are searched completely, so no cell is visited twice.
+*/
+template < class evaluator >
+void UpdaterSwapMC< evaluator >::buildCells(const Scalar4 *pos, unsigned int N, Scalar r_max)
+    {
+    const BoxDim& box = m_pdata->getBox();
+    const Scalar3 npd = box.getNearestPlaneDistance();
+    const Scalar widths[3] = {npd.x, npd.y, npd.z};
+    for (unsigned int d = 0; d < 3; ++d)
+        {
+        m_dim[d] = 1;
+        if (d < m_sysdef->getNDimensions() && r_max > Scalar(0.0))
+            m_dim[d] = std::max(1, int(widths[d]/r_max));
+        }
+    if (m_sysdef->getNDimensions() == 2)
+        m_dim[2] = 1;
+
+    const unsigned int n_cells = m_dim[0]*m_dim[1]*m_dim[2];
+    m_cell_start.assign(n_cells + 1, 0);
+    m_cell_idx.resize(N);
+    m_cell_of.resize(N);
+
+    // counting sort of the particles by cell
+    for (unsigned int i = 0; i < N; ++i)
+        {
+        const Scalar3 f = box.makeFraction(make_scalar3(pos[i].x, pos[i].y, pos[i].z));
+        const Scalar fs[3] = {f.x, f.y, f.z};
+        int c[3];
+        for (unsigned int d = 0; d < 3; ++d)
+            {
+            const Scalar wrapped = fs[d] - floor(fs[d]);
+            c[d] = std::min(m_dim[d] - 1, std::max(0, int(wrapped*Scalar(m_dim[d]))));
+            }
+        m_cell_of[i] = (c[2]*m_dim[1] + c[1])*m_dim[0] + c[0];
+        ++m_cell_start[m_cell_of[i] + 1];
+        }
+    for (unsigned int c = 0; c < n_cells; ++c)
+        m_cell_start[c + 1] += m_cell_start[c];
+
+    std::vector<unsigned int> fill(m_cell_start.begin(), m_cell_start.end() - 1);
+    for (unsigned int i = 0; i < N; ++i)
+        m_cell_idx[fill[m_cell_of[i]]++] = i;
+    }
+
+/*! \param i Particle index
+    \param d_new New diameter of particle i
+    \param skip Particle left out of the sum
+    \param pos Particle positions
+    \param diameter Particle diameters, with the current diameter of i
+    \param params Pair parameters per type pair
+    \returns The sum of the pair energies of i with diameter d_new minus the sum with its current diameter, over all
+              particles within the cutoff of either
+
+    All diameters, including \a d_new, are stored ones and multiplied by m_diameter_scale here. Type pairs with v0 = 0
+    or no cutoff add nothing, as in the force.
+*/
+template < class evaluator >
+Scalar UpdaterSwapMC< evaluator >::computeEnergyChange(unsigned int i,
+                                                       Scalar d_new,
+                                                       unsigned int skip,
+                                                       const Scalar4 *pos,
+                                                       const Scalar *diameter,
+                                                       const param_type *params)
+    {
+    const Scalar scale = m_diameter_scale;
+    const Scalar d_old = scale*diameter[i];
+    const Scalar d_try = scale*d_new;
+    const BoxDim& box = m_pdata->getBox();
+    const Index2D typpair_idx(m_pdata->getNTypes());
+    const Scalar3 pi = make_scalar3(pos[i].x, pos[i].y, pos[i].z);
+    const unsigned int typei = __scalar_as_int(pos[i].w);
+
+    // cells within one cell of the home cell in every direction, or all of them in short directions
+    const unsigned int home = m_cell_of[i];
+    const int c[3] = {int(home % m_dim[0]), int((home / m_dim[0]) % m_dim[1]), int(home / (m_dim[0]*m_dim[1]))};
+    int lo[3], hi[3];
+    for (unsigned int d = 0; d < 3; ++d)
+        {
+        lo[d] = (m_dim[d] < 3) ? 0 : c[d] - 1;
+        hi[d] = (m_dim[d] < 3) ? m_dim[d] - 1 : c[d] + 1;
+        }
+    m_neigh_cells.clear();
+    for (int z = lo[2]; z <= hi[2]; ++z)
+        for (int y = lo[1]; y <= hi[1]; ++y)
+            for (int x = lo[0]; x <= hi[0]; ++x)
+                {
+                const int wx = (x + m_dim[0]) % m_dim[0];
+                const int wy = (y + m_dim[1]) % m_dim[1];
+                const int wz = (z + m_dim[2]) % m_dim[2];
+                m_neigh_cells.push_back((wz*m_dim[1] + wy)*m_dim[0] + wx);
+                }
+
+    Scalar energy = Scalar(0.0);
+    for (unsigned int k = 0; k < m_neigh_cells.size(); ++k)
+        {
+        const unsigned int cell = m_neigh_cells[k];
+        for (unsigned int e = m_cell_start[cell]; e < m_cell_start[cell + 1]; ++e)
+            {
+            const unsigned int j = m_cell_idx[e];
+            if (j == i || j == skip)
+                continue;
+
+            const Scalar3 pj = make_scalar3(pos[j].x, pos[j].y, pos[j].z);
+            const Scalar3 dx = box.minImage(pi - pj);
+            const Scalar rsq = dot(dx, dx);
+            const unsigned int typej = __scalar_as_int(pos[j].w);
+            const param_type& param = params[typpair_idx(typei, typej)];
+
+            // type pairs without interaction are skipped as in the force, their smoothing terms need not vanish
+            if (rsq >= m_rcutsq || param.v0 == Scalar(0.0) || !(param.scaledrcutsq > Scalar(0.0)))
+                continue;
+
+            // the polydisperse evaluators cut off at scaledr_cut * sigma_ij on their own
+            Scalar pair_eng = Scalar(0.0);
+            evaluator eval_new(rsq, m_rcutsq, param);
+            eval_new.setDiameter(d_try, scale*diameter[j]);
+            if (eval_new.evalEnergy(pair_eng, false))
+                energy += pair_eng;
+            evaluator eval_old(rsq, m_rcutsq, param);
+            eval_old.setDiameter(d_old, scale*diameter[j]);
+            if (eval_old.evalEnergy(pair_eng, false))
+                energy -= pair_eng;
+            }
+        }
+    return energy;
+    }
+
+/*! \param timestep Current time step of the simulation
+
+    The random number generator is seeded from the seed and the time step, so a restarted run repeats the same swaps.
+*/
+template < class evaluator >
+void UpdaterSwapMC< evaluator >::update(unsigned int timestep)
+    {
+    if (m_prof) m_prof->push("Swap MC");
+
+    const unsigned int N = m_pdata->getN();
+    const unsigned int n_attempts = (unsigned int)std::lround(double(m_sweeps)*double(N));
+    if (N < 2 || n_attempts == 0)
+        {
+        if (m_prof) m_prof->pop();
+        return;
+        }
+
+    const Scalar kT = m_kT->getValue(timestep);
+    if (!(kT > Scalar(0.0)))
+        {
+        m_exec_conf->msg->error() << "update.swap: kT must be positive" << std::endl;
+        throw std::runtime_error("Error in UpdaterSwapMC");
+        }
+
+    unsigned int n_accepted = 0;
+        {
+        ArrayHandle<Scalar4> h_pos(m_pdata->getPositions(), access_location::host, access_mode::read);
+        ArrayHandle<Scalar> h_diameter(m_pdata->getDiameters(), access_location::host, access_mode::readwrite);
+        ArrayHandle<param_type> h_params(m_pair->getParamsArray(), access_location::host, access_mode::read);
+
+        // largest interaction range over all type pairs, from a bound of sigma_ij over the current diameters as the
+        // pair force sees them, with its pending factor
+        m_diameter_scale = m_pair->getDiameterScale();
+        Scalar d_min = std::numeric_limits<Scalar>::max();
+        Scalar d_max = Scalar(0.0);
+        for (unsigned int i = 0; i < N; ++i)
+            {
+            d_min = std::min(d_min, h_diameter.data[i]);
+            d_max = std::max(d_max, h_diameter.data[i]);
+            }
+        d_min *= m_diameter_scale;
+        d_max *= m_diameter_scale;
+        const unsigned int ntypes = m_pdata->getNTypes();
+        Scalar r_max = Scalar(0.0);
+        for (unsigned int ab = 0; ab < ntypes*ntypes; ++ab)
+            {
+            const param_type& param = h_params.data[ab];
+            if (param.v0 == Scalar(0.0) || !(param.scaledrcutsq > Scalar(0.0)))
+                continue;
+            const Scalar nonadditive = (param.eps >= Scalar(0.0)) ? Scalar(1.0)
+                                                                  : Scalar(1.0) - param.eps*(d_max - d_min);
+            r_max = std::max(r_max, sqrt(param.scaledrcutsq)*d_max*nonadditive);
+            }
+
+        const BoxDim& box = m_pdata->getBox();
+        const Scalar3 npd = box.getNearestPlaneDistance();
+        if (npd.x <= r_max*Scalar(2.0) || npd.y <= r_max*Scalar(2.0) ||
+            (m_sysdef->getNDimensions() == 3 && npd.z <= r_max*Scalar(2.0)))
+            {
+            m_exec_conf->msg->error() << "update.swap: Simulation box is too small! Particles would be interacting with themselves." << std::endl;
+            throw std::runtime_error("Error in UpdaterSwapMC");
+            }
+
+        m_rcutsq = r_max*r_max;
+        buildCells(h_pos.data, N, r_max);
+
+        std::seed_seq seq{m_seed, timestep};
+        std::mt19937 rng(seq);
+        std::uniform_int_distribution<unsigned int> pick(0, N - 1);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+        unsigned int n_identical = 0;
+        for (unsigned int attempt = 0; attempt < n_attempts; ++attempt)
+            {
+            const unsigned int i = pick(rng);
+            unsigned int j = pick(rng);
+            while (j == i)
+                j = pick(rng);
+            const double u = uniform(rng);
+
+            const Scalar d_i = h_diameter.data[i];
+            const Scalar d_j = h_diameter.data[j];
+            if (d_i == d_j)
+                {
+                ++n_identical;
+                continue;
+                }
+
+            const Scalar delta = computeEnergyChange(i, d_j, j, h_pos.data, h_diameter.data, h_params.data)
+                               + computeEnergyChange(j, d_i, i, h_pos.data, h_diameter.data, h_params.data);
+
+            if (delta <= Scalar(0.0) || u < exp(-double(delta/kT)))
+                {
+                h_diameter.data[i] = d_j;
+                h_diameter.data[j] = d_i;
+                ++n_accepted;
+                }
+            }
+
+        m_attempted += n_attempts - n_identical;
+        m_accepted += n_accepted;
+        m_identical += n_identical;
+        }
+
+    // the pair ranges of the neighbor list depend on the diameters, and derived cutoffs on their range per type
+    if (n_accepted > 0)
+        {
+        if (m_nlist)
+            m_nlist->forceUpdate();
+        m_pair->notifyDiametersChange();
+        }
+
+    if (m_prof) m_prof->pop();
+    }
+
+//! Export this updater to python
+/*! \param name Name of the class in the exported python module
+    \tparam T Class type to export. \b Must be an instantiated UpdaterSwapMC class template.
+*/
+template < class T > void export_UpdaterSwapMC(pybind11::module& m, const std::string& name)
+    {
+    pybind11::class_<T, std::shared_ptr<T> >(m, name.c_str(), pybind11::base<Updater>())
+        .def(pybind11::init< std::shared_ptr<SystemDefinition>,
+                             std::shared_ptr< PotentialPairPolymd<typename T::evaluator_type> >,
+                             std::shared_ptr<NeighborList>,
+                             std::shared_ptr<Variant>,
+                             unsigned int >())
+        .def("setT", &T::setT)
+        .def("setSweeps", &T::setSweeps)
+        .def("getAttempted", &T::getAttempted)
+        .def("getAccepted", &T::getAccepted)
+        .def("getIdentical", &T::getIdentical)
+        .def("getAcceptanceRatio", &T::getAcceptanceRatio)
+        .def("resetCounters", &T::resetCounters)
+        ;
+    }
+
+#endif // __UPDATER_SWAP_MC_H__
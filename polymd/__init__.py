@@ -8,3 +8,8 @@ Perform Molecular Dynamics simulations with HOOMD-blue using pair potentials uti
 """
 
 from hoomd.polymd import pair
+from hoomd.polymd import nlist
+from hoomd.polymd import update
+from hoomd.polymd import rerun
+from hoomd.polymd import replica
+from hoomd.polymd import analyze
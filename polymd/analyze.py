@@ -0,0 +1,150 @@
+# Copyright (c) 2009-2019 The Regents of the University of Michigan
+# This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+R""" Analyzers for polydisperse systems.
+
+:py:class:`stress_correlation` computes the Green-Kubo stress autocorrelation during the run, so that the shear
+viscosity is available without logging the pressure tensor every step.
+"""
+
+from hoomd.polymd import _polymd
+import hoomd;
+
+class stress_correlation(hoomd.analyze._analyzer):
+    R""" Stress autocorrelation with a multi-tau correlator.
+
+    Args:
+        forces (list): Forces whose virial makes up the pressure tensor, all enabled forces when None.
+        filename (str): File to write the correlation to, see :py:meth:`write`. None to only write it on request.
+        kT (float): Temperature of the viscosity column (in energy units), None to leave it out.
+        period (int): Take a sample every *period* time steps.
+        write_period (int): Rewrite *filename* every *write_period* samples, 0 to only write it on request.
+        dt (float): Time step, the one of the current integration mode when None.
+        p (int): Number of lags of each level of the correlator, a multiple of *m*.
+        m (int): Number of samples of a level averaged into one sample of the next level.
+        kinetic (bool): Include the kinetic part of the pressure tensor.
+        phase (int): When -1, start on the current time step. When >= 0, execute on steps where *(step + phase) % period == 0*.
+
+    The shear viscosity is
+
+    .. math::
+
+        \eta = \frac{V}{kT} \int_0^\infty \langle P_{xy}(0) P_{xy}(t) \rangle dt
+
+    Every sample sums the off-diagonal virial of *forces* (and the kinetic part) into :math:`P_{xy}, P_{xz}, P_{yz}`
+    (only :math:`P_{xy}` in 2D) and adds them to a multi-tau correlator: the last *p* samples are correlated at lags
+    0 to *p*-1, and every *m* samples are averaged into the next level, which covers lags up to *m* times longer. The
+    memory grows with the logarithm of the length of the run, and a sample costs O(*p*) on top of the sum of the virial,
+    which the polymd pair forces already do in their pair loop. The autocorrelations of the components are averaged.
+
+    The analyzer requests the pressure tensor, so the forces compute the virial on every sampled step. The lags are
+    given in time units, *dt* times *period* per sample, so *dt* must not change during the run.
+
+    Examples::
+
+        nl = md.nlist.cell()
+        poly = polymd.pair.polydisperse(r_cut=1.5, nlist=nl, model="polydisperse12")
+        md.integrate.mode_standard(dt=0.005)
+        md.integrate.nvt(group=hoomd.group.all(), kT=1.0, tau=1.0)
+        gk = polymd.analyze.stress_correlation(forces=[poly], filename='stress_acf.txt', kT=1.0, write_period=100000)
+        hoomd.run(1e7)
+        gk.write()
+
+    """
+    def __init__(self, forces=None, filename=None, kT=None, period=1, write_period=0, dt=None, p=16, m=2,
+                 kinetic=True, phase=0):
+        hoomd.util.print_status_line();
+
+        # initialize base class
+        hoomd.analyze._analyzer.__init__(self);
+
+        if forces is None:
+            forces = [f for f in hoomd.context.current.forces if f.enabled];
+        if len(forces) == 0:
+            hoomd.context.msg.error("analyze.stress_correlation: no forces\n");
+            raise RuntimeError("Error creating stress correlation analyzer");
+
+        if dt is None:
+            dt = getattr(hoomd.context.current.integrator, 'dt', None);
+        if dt is None:
+            hoomd.context.msg.error("analyze.stress_correlation: specify dt or set an integration mode first\n");
+            raise RuntimeError("Error creating stress correlation analyzer");
+
+        if m < 2 or p < m or p % m != 0:
+            hoomd.context.msg.error("analyze.stress_correlation: p must be a multiple of m >= 2\n");
+            raise RuntimeError("Error creating stress correlation analyzer");
+
+        # create the c++ mirror class
+        self.cpp_analyzer = _polymd.StressCorrelationAnalyzer(hoomd.context.current.system_definition, int(p), int(m),
+                                                              bool(kinetic));
+        for f in forces:
+            self.cpp_analyzer.addForce(f.cpp_force);
+        self.cpp_analyzer.setDeltaT(float(dt)*period);
+        if kT is not None:
+            self.cpp_analyzer.setTemperature(float(kT));
+        if filename is not None:
+            self.cpp_analyzer.setOutput(filename, int(write_period));
+        self.setupAnalyzer(period, phase);
+
+        # store metadata
+        self.forces = forces;
+        self.filename = filename;
+        self.kT = kT;
+        self.period = period;
+        self.write_period = write_period;
+        self.dt = dt;
+        self.p = p;
+        self.m = m;
+        self.kinetic = kinetic;
+        self.metadata_fields = ['filename', 'kT', 'period', 'write_period', 'dt', 'p', 'm', 'kinetic'];
+
+    def get(self):
+        R""" Get the correlation function.
+
+        Returns:
+            A dictionary of lists: *time*, *correlation* (of the off-diagonal pressure), *integral* (running integral
+            of the correlation, trapezoidal) and, with *kT* set, *viscosity* (V/kT times the integral, V averaged over
+            the samples).
+
+        Examples::
+
+            acf = gk.get()
+            print(acf['viscosity'][-1])
+
+        """
+        result = dict(time=self.cpp_analyzer.getTimes(),
+                      correlation=self.cpp_analyzer.getCorrelation(),
+                      integral=self.cpp_analyzer.getIntegral());
+        if self.kT is not None:
+            prefactor = self.cpp_analyzer.getAverageVolume()/self.kT;
+            result['viscosity'] = [prefactor*x for x in result['integral']];
+        return result;
+
+    def write(self, filename=None):
+        R""" Write the correlation function.
+
+        Args:
+            filename (str): File to write, the one given at construction when None.
+
+        The file has the columns time, correlation, integral and, with *kT* set, viscosity, and is overwritten. Only
+        the root rank writes.
+        """
+        hoomd.util.print_status_line();
+
+        if filename is None:
+            filename = self.filename;
+        if filename is None:
+            hoomd.context.msg.error("analyze.stress_correlation: no file name\n");
+            raise RuntimeError("Error writing the stress correlation");
+        self.cpp_analyzer.writeFile(filename);
+
+    def get_num_samples(self):
+        R""" Get the number of samples since the analyzer was created or :py:meth:`reset` was called.
+        """
+        return self.cpp_analyzer.getNumSamples();
+
+    def reset(self):
+        R""" Forget all samples, e.g. after equilibration.
+        """
+        hoomd.util.print_status_line();
+        self.cpp_analyzer.reset();
@@ -0,0 +1,957 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+/*! \file polymd_bench.cc
+    \brief Standalone CPU micro-benchmark of the pair evaluators
+
+    Builds synthetic neighbor lists of polydisperse configurations and times the evaluators over them, without a HOOMD
+    runtime or Python. The precision follows the build (polymd_bench_double or polymd_bench_single) and results are
+    written as JSON, so runs of different plugin versions can be compared directly.
+
+    Usage: polymd_bench [-o output.json] [-n particles] [-r repeats] [-s seed] [-m drift_steps]
+*/
+
+#include "EvaluatorPairLJPlugin.h"
+#include "EvaluatorPairForceShiftedLJPlugin.h"
+#include "EvaluatorPairPolydisperseMNQ.h"
+#include "PolydisperseBatch.h"
+#include "PolydisperseTable.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//! Diameter distributions of the synthetic configurations
+enum bench_distribution
+    {
+    uniform = 0,        //!< Flat between 0.72 and 1.28
+    bidisperse,         //!< Equal parts of diameter 1.0 and 1.4
+    power_law,          //!< P(d) ~ d^-3 between 0.73 and 1.62, the usual swap Monte Carlo glass former
+    num_distributions
+    };
+
+static const char *distribution_names[] = {"uniform", "bidisperse", "power_law"};
+
+//! A stream of particle pairs, stored as in the force loop of PotentialPair
+struct pair_stream
+    {
+    std::vector<Scalar> rsq;    //!< Squared pair distance
+    std::vector<Scalar> d_i;    //!< Diameter of the first particle
+    std::vector<Scalar> d_j;    //!< Diameter of the second particle
+    std::vector<unsigned int> head; //!< First pair of each particle, pairs are grouped by the first particle
+    Scalar density;             //!< Number density of the configuration
+    };
+
+//! Draw a diameter from a distribution
+static double draw_diameter(bench_distribution dist, std::mt19937& rng)
+    {
+    std::uniform_real_distribution<double> u(0.0, 1.0);
+    switch (dist)
+        {
+        case uniform:
+            return 0.72 + 0.56*u(rng);
+        case bidisperse:
+            return u(rng) < 0.5 ? 1.0 : 1.4;
+        case power_law:
+            {
+            // invert the cumulative distribution of d^-3
+            const double lo = 0.73, hi = 1.62;
+            const double a = 1.0/(lo*lo), b = 1.0/(hi*hi);
+            return 1.0/std::sqrt(a - u(rng)*(a - b));
+            }
+        default:
+            throw std::runtime_error("Unknown diameter distribution");
+        }
+    }
+
+//! A jittered lattice of polydisperse particles in a periodic box
+struct bench_config
+    {
+    unsigned int ndim;          //!< Number of dimensions
+    unsigned int N;             //!< Number of particles
+    double box;                 //!< Edge length of the periodic box
+    double density;             //!< Number density
+    double d_max;               //!< Largest diameter
+    std::vector<double> d;      //!< Diameters
+    std::vector<double> x;      //!< Positions, 3 per particle
+    };
+
+//! Build a jittered lattice of polydisperse particles
+/*! \param dist Diameter distribution
+    \param ndim Number of dimensions, 2 or 3
+    \param n_target Approximate number of particles
+    \param rng Random number generator
+
+    The number density is set so that rho <d^ndim> = 1, which is the glassy regime of the soft sphere models in both 2D
+    and 3D. Particles sit on a square lattice with jitter so that no pair overlaps strongly.
+*/
+static bench_config make_config(bench_distribution dist, unsigned int ndim, unsigned int n_target, std::mt19937& rng)
+    {
+    const unsigned int L = (unsigned int)std::lround(std::pow(double(n_target), 1.0/double(ndim)));
+
+    bench_config config;
+    config.ndim = ndim;
+    config.N = (ndim == 2) ? L*L : L*L*L;
+    config.d.resize(config.N);
+    config.d_max = 0.0;
+
+    double d_moment = 0.0;
+    for (unsigned int i = 0; i < config.N; ++i)
+        {
+        config.d[i] = draw_diameter(dist, rng);
+        d_moment += std::pow(config.d[i], double(ndim));
+        config.d_max = std::max(config.d_max, config.d[i]);
+        }
+    d_moment /= double(config.N);
+
+    config.density = 1.0/d_moment;
+    const double a = std::pow(1.0/config.density, 1.0/double(ndim));
+    config.box = a*double(L);
+
+    std::uniform_real_distribution<double> jitter(-0.15*a, 0.15*a);
+    config.x.assign(3*config.N, 0.0);
+    for (unsigned int i = 0; i < config.N; ++i)
+        {
+        unsigned int idx = i;
+        for (unsigned int k = 0; k < ndim; ++k)
+            {
+            config.x[3*i+k] = a*double(idx % L) + jitter(rng);
+            idx /= L;
+            }
+        }
+    return config;
+    }
+
+//! Build a pair stream from a configuration
+/*! \param config Particle configuration
+    \param r_list Neighbor list range in units of the mean diameter, scaled by max(d_i, d_j)
+    \param d_stored Diameters stored in the stream, NULL for those of \a config
+
+    Every pair within r_list * max(d_i, d_j) is stored, i.e. the entries of a neighbor list with diameter shifting.
+*/
+static pair_stream make_stream(const bench_config& config, double r_list, const std::vector<double> *d_stored=NULL)
+    {
+    const unsigned int N = config.N;
+    const double box = config.box;
+    const std::vector<double>& d = config.d;
+    const std::vector<double>& d_out = d_stored ? *d_stored : config.d;
+    const std::vector<double>& x = config.x;
+
+    pair_stream stream;
+    stream.density = Scalar(config.density);
+    const double r_max = r_list*config.d_max;
+    if (2.0*r_max >= box)
+        throw std::runtime_error("Benchmark box is too small for the neighbor list range");
+
+    for (unsigned int i = 0; i < N; ++i)
+        {
+        stream.head.push_back(stream.rsq.size());
+        for (unsigned int j = 0; j < N; ++j)
+            {
+            if (i == j)
+                continue;
+            double rsq = 0.0;
+            for (unsigned int k = 0; k < config.ndim; ++k)
+                {
+                double dx = x[3*i+k] - x[3*j+k];
+                dx -= box*std::round(dx/box);
+                rsq += dx*dx;
+                }
+            const double r_pair = r_list*std::max(d[i], d[j]);
+            if (rsq < r_pair*r_pair)
+                {
+                stream.rsq.push_back(Scalar(rsq));
+                stream.d_i.push_back(Scalar(d_out[i]));
+                stream.d_j.push_back(Scalar(d_out[j]));
+                }
+            }
+        }
+    stream.head.push_back(stream.rsq.size());
+    return stream;
+    }
+
+//! Build a pair stream from a new jittered lattice, see make_config() and make_stream()
+static pair_stream make_stream(bench_distribution dist, unsigned int ndim, unsigned int n_target, double r_list, std::mt19937& rng)
+    {
+    return make_stream(make_config(dist, ndim, n_target, rng), r_list);
+    }
+
+//! Timing of one evaluator over one stream
+struct bench_result
+    {
+    double ns_per_pair;         //!< Best time per pair over all repeats
+    double in_cutoff;           //!< Fraction of pairs inside the cutoff
+    double checksum;            //!< Sum of forces and energies, to compare between versions
+    double force_error;         //!< Largest force error against the Scalar batch kernel, negative if not measured
+    double energy_error;        //!< Largest energy error against the Scalar batch kernel, negative if not measured
+
+    //! Default constructor
+    bench_result()
+        : ns_per_pair(1e300), in_cutoff(0.0), checksum(0.0), force_error(-1.0), energy_error(-1.0)
+        {
+        }
+    };
+
+//! Time an evaluator over a pair stream
+template<class evaluator>
+static bench_result run_evaluator(const pair_stream& stream, Scalar rcutsq, const typename evaluator::param_type& params, unsigned int repeats)
+    {
+    const unsigned int n = stream.rsq.size();
+    bench_result result;
+
+    for (unsigned int rep = 0; rep < repeats; ++rep)
+        {
+        Scalar checksum = Scalar(0.0);
+        unsigned int n_in = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int k = 0; k < n; ++k)
+            {
+            evaluator eval(stream.rsq[k], rcutsq, params);
+            if (evaluator::needsDiameter())
+                eval.setDiameter(stream.d_i[k], stream.d_j[k]);
+
+            Scalar force_divr = Scalar(0.0);
+            Scalar pair_eng = Scalar(0.0);
+            if (eval.evalForceAndEnergy(force_divr, pair_eng, false))
+                {
+                checksum += force_divr + pair_eng;
+                ++n_in;
+                }
+            }
+        auto end = std::chrono::steady_clock::now();
+
+        double ns = std::chrono::duration<double, std::nano>(end - start).count()/double(std::max(n, 1u));
+        result.ns_per_pair = std::min(result.ns_per_pair, ns);
+        result.in_cutoff = double(n_in)/double(std::max(n, 1u));
+        result.checksum = double(checksum);
+        }
+    return result;
+    }
+
+//! Time a batch kernel over a pair stream, one call per particle
+/*! The distances and diameters are converted to \a Real once, outside of the timed loop, as PotentialPairPolymd does
+    when it gathers the neighbors.
+*/
+template<class Real>
+static bench_result time_batch(const pair_stream& stream, const polydisperse_params& params, unsigned int repeats,
+                               typename polydisperse_batch_types<Real>::batch_func batch)
+    {
+    const unsigned int n = stream.rsq.size();
+    const unsigned int n_particles = stream.head.size() - 1;
+    const std::vector<Real> rsq(stream.rsq.begin(), stream.rsq.end());
+    const std::vector<Real> d_j(stream.d_j.begin(), stream.d_j.end());
+
+    unsigned int max_neigh = 0;
+    for (unsigned int i = 0; i < n_particles; ++i)
+        max_neigh = std::max(max_neigh, stream.head[i+1] - stream.head[i]);
+    std::vector<Real> force_divr(max_neigh), pair_eng(max_neigh);
+
+    bench_result result;
+
+    for (unsigned int rep = 0; rep < repeats; ++rep)
+        {
+        Scalar checksum = Scalar(0.0);
+        unsigned int n_in = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < n_particles; ++i)
+            {
+            const unsigned int head = stream.head[i];
+            const unsigned int n_neigh = stream.head[i+1] - head;
+            if (n_neigh == 0)
+                continue;
+            n_in += batch(params, stream.d_i[head], &rsq[head], &d_j[head], n_neigh, &force_divr[0], &pair_eng[0]);
+            for (unsigned int k = 0; k < n_neigh; ++k)
+                checksum += Scalar(force_divr[k]) + Scalar(pair_eng[k]);
+            }
+        auto end = std::chrono::steady_clock::now();
+
+        double ns = std::chrono::duration<double, std::nano>(end - start).count()/double(std::max(n, 1u));
+        result.ns_per_pair = std::min(result.ns_per_pair, ns);
+        result.in_cutoff = double(n_in)/double(std::max(n, 1u));
+        result.checksum = double(checksum);
+        }
+    return result;
+    }
+
+//! Time the batch kernel (or its mixed precision or force only build) of a polydisperse evaluator over a pair stream, one call per particle
+template<class evaluator>
+static bench_result run_batch(const pair_stream& stream, const polydisperse_params& params, unsigned int repeats,
+                              bool mixed=false, bool energy=true)
+    {
+    if (mixed)
+        return time_batch<float>(stream, params, repeats, PolydisperseBatch<evaluator>::getMixed(energy));
+    return time_batch<Scalar>(stream, params, repeats, PolydisperseBatch<evaluator>::get(energy));
+    }
+
+//! Time the table lookup of a polydisperse evaluator over a pair stream, one call per particle
+/*! The table is built once with the defaults of pair.polydisperse(mode="table"), outside of the timed loop.
+*/
+template<class evaluator>
+static bench_result run_table(const pair_stream& stream, const polydisperse_params& params, unsigned int repeats)
+    {
+    const unsigned int n = stream.rsq.size();
+    const unsigned int n_particles = stream.head.size() - 1;
+    const polydisperse_table table = build_polydisperse_table<evaluator>(params, 1024, Scalar(0.5), Scalar(1e-6));
+    polydisperse_table_func lookup = getPolydisperseTableLookup();
+
+    unsigned int max_neigh = 0;
+    for (unsigned int i = 0; i < n_particles; ++i)
+        max_neigh = std::max(max_neigh, stream.head[i+1] - stream.head[i]);
+    std::vector<Scalar> force_divr(max_neigh), pair_eng(max_neigh);
+
+    bench_result result;
+
+    for (unsigned int rep = 0; rep < repeats; ++rep)
+        {
+        Scalar checksum = Scalar(0.0);
+        unsigned int n_in = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < n_particles; ++i)
+            {
+            const unsigned int head = stream.head[i];
+            const unsigned int n_neigh = stream.head[i+1] - head;
+            if (n_neigh == 0)
+                continue;
+            n_in += evalTableBatch<evaluator>(lookup, table, params, stream.d_i[head], &stream.rsq[head],
+                                              &stream.d_j[head], n_neigh, &force_divr[0], &pair_eng[0]);
+            for (unsigned int k = 0; k < n_neigh; ++k)
+                checksum += force_divr[k] + pair_eng[k];
+            }
+        auto end = std::chrono::steady_clock::now();
+
+        double ns = std::chrono::duration<double, std::nano>(end - start).count()/double(std::max(n, 1u));
+        result.ns_per_pair = std::min(result.ns_per_pair, ns);
+        result.in_cutoff = double(n_in)/double(std::max(n, 1u));
+        result.checksum = double(checksum);
+        }
+    return result;
+    }
+
+//! Time the mixed precision batch kernel of a polydisperse evaluator over a pair stream
+/*! The errors of the force and energy are measured against the Scalar batch kernel, outside of the timed loop,
+    relative to max(|value|, v0).
+*/
+template<class evaluator>
+static bench_result run_batch_mixed(const pair_stream& stream, const polydisperse_params& params, unsigned int repeats)
+    {
+    bench_result result = run_batch<evaluator>(stream, params, repeats, true);
+
+    const unsigned int n_particles = stream.head.size() - 1;
+    polydisperse_batch_func batch = PolydisperseBatch<evaluator>::get();
+    polydisperse_mixed_batch_func batch_mixed = PolydisperseBatch<evaluator>::getMixed();
+    const std::vector<float> rsq_mixed(stream.rsq.begin(), stream.rsq.end());
+    const std::vector<float> d_j_mixed(stream.d_j.begin(), stream.d_j.end());
+
+    unsigned int max_neigh = 0;
+    for (unsigned int i = 0; i < n_particles; ++i)
+        max_neigh = std::max(max_neigh, stream.head[i+1] - stream.head[i]);
+    std::vector<Scalar> force_divr(max_neigh), pair_eng(max_neigh);
+    std::vector<float> force_divr_mixed(max_neigh), pair_eng_mixed(max_neigh);
+
+    const double floor = std::max(std::fabs(double(params.v0)), 1e-300);
+    result.force_error = 0.0;
+    result.energy_error = 0.0;
+    for (unsigned int i = 0; i < n_particles; ++i)
+        {
+        const unsigned int head = stream.head[i];
+        const unsigned int n_neigh = stream.head[i+1] - head;
+        if (n_neigh == 0)
+            continue;
+        batch(params, stream.d_i[head], &stream.rsq[head], &stream.d_j[head], n_neigh, &force_divr[0], &pair_eng[0]);
+        batch_mixed(params, stream.d_i[head], &rsq_mixed[head], &d_j_mixed[head], n_neigh, &force_divr_mixed[0],
+                    &pair_eng_mixed[0]);
+        for (unsigned int k = 0; k < n_neigh; ++k)
+            {
+            const double r = std::sqrt(double(stream.rsq[head+k]));
+            const double f = double(force_divr[k])*r;
+            const double f_mixed = double(force_divr_mixed[k])*r;
+            const double e = double(pair_eng[k]);
+            const double e_mixed = double(pair_eng_mixed[k]);
+            result.force_error = std::max(result.force_error, std::fabs(f_mixed - f)/std::max(std::fabs(f), floor));
+            result.energy_error = std::max(result.energy_error, std::fabs(e_mixed - e)/std::max(std::fabs(e), floor));
+            }
+        }
+    return result;
+    }
+
+//! Energy conservation of a short NVE run
+struct drift_result
+    {
+    double drift;               //!< Slope of the total energy per particle over time, from a least squares fit
+    double max_deviation;       //!< Largest deviation of the total energy per particle from its initial value
+    double force_error;         //!< Largest error of the initial particle forces against the Scalar kernel
+    };
+
+//! Scalar or mixed precision batch kernel of an evaluator, with the type of its arrays
+template<class evaluator, bool mixed>
+struct bench_kernel
+    {
+    typedef Scalar real;    //!< Type of the distances, diameters and results
+
+    //! Get the batch kernel
+    static polydisperse_batch_func get()
+        {
+        return PolydisperseBatch<evaluator>::get();
+        }
+    };
+
+//! Mixed precision batch kernel of an evaluator, on neighbors gathered in float
+template<class evaluator>
+struct bench_kernel<evaluator, true>
+    {
+    typedef float real;     //!< Type of the distances, diameters and results
+
+    //! Get the batch kernel
+    static polydisperse_mixed_batch_func get()
+        {
+        return PolydisperseBatch<evaluator>::getMixed();
+        }
+    };
+
+//! Compute the forces and potential energy of a configuration with a Verlet list
+/*! The neighbors are gathered in the precision of the kernel.
+
+    \returns The potential energy, summed in Scalar. The forces are summed in Scalar as well.
+*/
+template<class evaluator, bool mixed>
+static Scalar compute_forces(const bench_config& config, const std::vector<Scalar>& x,
+                             const std::vector<unsigned int>& head, const std::vector<unsigned int>& nlist,
+                             const polydisperse_params& params, std::vector<Scalar>& force)
+    {
+    typedef typename bench_kernel<evaluator, mixed>::real Real;
+    static typename polydisperse_batch_types<Real>::batch_func batch = bench_kernel<evaluator, mixed>::get();
+
+    unsigned int max_neigh = 0;
+    for (unsigned int i = 0; i < config.N; ++i)
+        max_neigh = std::max(max_neigh, head[i+1] - head[i]);
+    std::vector<Scalar> dx(3*max_neigh);
+    std::vector<Real> rsq(max_neigh), dj(max_neigh), force_divr(max_neigh), pair_eng(max_neigh);
+
+    const Scalar box = Scalar(config.box);
+    Scalar energy = Scalar(0.0);
+    force.assign(3*config.N, Scalar(0.0));
+    for (unsigned int i = 0; i < config.N; ++i)
+        {
+        const unsigned int n_neigh = head[i+1] - head[i];
+        for (unsigned int k = 0; k < n_neigh; ++k)
+            {
+            const unsigned int j = nlist[head[i]+k];
+            Scalar r_sq = Scalar(0.0);
+            for (unsigned int l = 0; l < 3; ++l)
+                {
+                Scalar d = x[3*i+l] - x[3*j+l];
+                if (l < config.ndim)
+                    d -= box*std::round(d/box);
+                dx[3*k+l] = d;
+                r_sq += d*d;
+                }
+            rsq[k] = Real(r_sq);
+            dj[k] = Real(Scalar(config.d[j]));
+            }
+
+        if (n_neigh > 0)
+            batch(params, Scalar(config.d[i]), &rsq[0], &dj[0], n_neigh, &force_divr[0], &pair_eng[0]);
+
+        for (unsigned int k = 0; k < n_neigh; ++k)
+            {
+            for (unsigned int l = 0; l < 3; ++l)
+                force[3*i+l] += dx[3*k+l]*Scalar(force_divr[k]);
+            energy += Scalar(0.5)*Scalar(pair_eng[k]);
+            }
+        }
+    return energy;
+    }
+
+//! Build a full Verlet list of all pairs within r_list * max(d_i, d_j)
+static void build_nlist(const bench_config& config, const std::vector<Scalar>& x, double r_list,
+                        std::vector<unsigned int>& head, std::vector<unsigned int>& nlist)
+    {
+    head.assign(1, 0);
+    nlist.clear();
+    for (unsigned int i = 0; i < config.N; ++i)
+        {
+        for (unsigned int j = 0; j < config.N; ++j)
+            {
+            if (i == j)
+                continue;
+            double rsq = 0.0;
+            for (unsigned int k = 0; k < config.ndim; ++k)
+                {
+                double dx = double(x[3*i+k] - x[3*j+k]);
+                dx -= config.box*std::round(dx/config.box);
+                rsq += dx*dx;
+                }
+            const double r_pair = r_list*std::max(config.d[i], config.d[j]);
+            if (rsq < r_pair*r_pair)
+                nlist.push_back(j);
+            }
+        head.push_back(nlist.size());
+        }
+    }
+
+//! Molecular dynamics state of the energy drift runs
+struct md_state
+    {
+    std::vector<Scalar> x;      //!< Positions, 3 per particle
+    std::vector<Scalar> v;      //!< Velocities, 3 per particle, unit masses
+    };
+
+//! Run velocity Verlet molecular dynamics with the Scalar or the mixed precision batch kernel
+/*! \param config Configuration, only the diameters and the box are used
+    \param params Pair parameters
+    \param state Positions and velocities, updated in place
+    \param steps Number of steps
+    \param dt Time step
+    \param kT Temperature the velocities are rescaled to every 10 steps, 0 for NVE
+    \param result If not NULL, receives the energy drift of the run
+
+    The Verlet list uses a skin of 0.3 and is rebuilt when a particle moved by more than half of it.
+*/
+template<class evaluator, bool mixed>
+static void run_md(const bench_config& config, const polydisperse_params& params, md_state& state, unsigned int steps,
+                   Scalar dt, Scalar kT, drift_result *result)
+    {
+    const unsigned int N = config.N;
+    const double skin = 0.3;
+    const double r_list = std::sqrt(double(params.scaledrcutsq)) + skin;
+    if (2.0*r_list*config.d_max >= config.box)
+        throw std::runtime_error("Benchmark box is too small for the neighbor list range");
+
+    std::vector<Scalar>& x = state.x;
+    std::vector<Scalar>& v = state.v;
+    std::vector<Scalar> x_list(x), force, force_ref;
+    std::vector<unsigned int> head, nlist;
+
+    build_nlist(config, x, r_list, head, nlist);
+    Scalar pe = compute_forces<evaluator, mixed>(config, x, head, nlist, params, force);
+
+    if (result)
+        {
+        compute_forces<evaluator, false>(config, x, head, nlist, params, force_ref);
+        result->force_error = 0.0;
+        for (unsigned int i = 0; i < N; ++i)
+            {
+            double df = 0.0, f = 0.0;
+            for (unsigned int l = 0; l < 3; ++l)
+                {
+                df += double(force[3*i+l] - force_ref[3*i+l])*double(force[3*i+l] - force_ref[3*i+l]);
+                f += double(force_ref[3*i+l])*double(force_ref[3*i+l]);
+                }
+            result->force_error = std::max(result->force_error,
+                                           std::sqrt(df)/std::max(std::sqrt(f), double(params.v0)));
+            }
+        result->max_deviation = 0.0;
+        }
+
+    // total energy per particle, with sums for the least squares fit of its slope
+    double sum_t = 0.0, sum_e = 0.0, sum_tt = 0.0, sum_te = 0.0, e0 = 0.0;
+    for (unsigned int step = 0; step <= steps; ++step)
+        {
+        if (step > 0)
+            {
+            for (unsigned int k = 0; k < 3*N; ++k)
+                {
+                v[k] += Scalar(0.5)*dt*force[k];
+                x[k] += dt*v[k];
+                }
+
+            double max_move = 0.0;
+            for (unsigned int i = 0; i < N; ++i)
+                {
+                double move = 0.0;
+                for (unsigned int l = 0; l < config.ndim; ++l)
+                    {
+                    double dx = double(x[3*i+l] - x_list[3*i+l]);
+                    dx -= config.box*std::round(dx/config.box);
+                    move += dx*dx;
+                    }
+                max_move = std::max(max_move, move);
+                }
+            if (std::sqrt(max_move) > 0.5*skin)
+                {
+                build_nlist(config, x, r_list, head, nlist);
+                x_list = x;
+                }
+
+            pe = compute_forces<evaluator, mixed>(config, x, head, nlist, params, force);
+            for (unsigned int k = 0; k < 3*N; ++k)
+                v[k] += Scalar(0.5)*dt*force[k];
+            }
+
+        double ke = 0.0;
+        for (unsigned int k = 0; k < 3*N; ++k)
+            ke += 0.5*double(v[k])*double(v[k]);
+
+        if (kT > Scalar(0.0) && step % 10 == 0 && ke > 0.0)
+            {
+            const Scalar scale = Scalar(std::sqrt(0.5*double(config.ndim)*double(N)*double(kT)/ke));
+            for (unsigned int k = 0; k < 3*N; ++k)
+                v[k] *= scale;
+            }
+
+        if (!result)
+            continue;
+        const double e = (ke + double(pe))/double(N);
+        const double t = double(step)*double(dt);
+        if (step == 0)
+            e0 = e;
+        result->max_deviation = std::max(result->max_deviation, std::fabs(e - e0));
+        sum_t += t;
+        sum_e += e;
+        sum_tt += t*t;
+        sum_te += t*e;
+        }
+
+    if (result)
+        {
+        const double n_samples = double(steps + 1);
+        const double denom = n_samples*sum_tt - sum_t*sum_t;
+        result->drift = denom > 0.0 ? (n_samples*sum_te - sum_t*sum_e)/denom : 0.0;
+        }
+    }
+
+//! Prepare a thermalized state for the energy drift runs
+/*! The jittered lattice has strongly overlapping pairs, so the positions are first relaxed by capped steepest descent
+    and then thermalized with velocity rescaling, both with the Scalar kernel.
+*/
+template<class evaluator>
+static md_state equilibrate(const bench_config& config, const polydisperse_params& params, unsigned int steps,
+                            Scalar dt, Scalar kT, unsigned int seed)
+    {
+    const unsigned int N = config.N;
+    md_state state;
+    state.x.assign(config.x.begin(), config.x.end());
+    state.v.assign(3*N, Scalar(0.0));
+
+    const double r_list = std::sqrt(double(params.scaledrcutsq));
+    std::vector<unsigned int> head, nlist;
+    std::vector<Scalar> force;
+    for (unsigned int iter = 0; iter < 200; ++iter)
+        {
+        build_nlist(config, state.x, r_list, head, nlist);
+        compute_forces<evaluator, false>(config, state.x, head, nlist, params, force);
+        for (unsigned int i = 0; i < N; ++i)
+            {
+            double f = 0.0;
+            for (unsigned int l = 0; l < 3; ++l)
+                f += double(force[3*i+l])*double(force[3*i+l]);
+            const Scalar scale = Scalar(std::min(1e-3, 0.01/std::max(std::sqrt(f), 1e-300)));
+            for (unsigned int l = 0; l < 3; ++l)
+                state.x[3*i+l] += scale*force[3*i+l];
+            }
+        }
+
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> gauss(0.0, std::sqrt(double(kT)));
+    double momentum[3] = {0.0, 0.0, 0.0};
+    for (unsigned int i = 0; i < N; ++i)
+        for (unsigned int l = 0; l < config.ndim; ++l)
+            {
+            state.v[3*i+l] = Scalar(gauss(rng));
+            momentum[l] += double(state.v[3*i+l]);
+            }
+    for (unsigned int i = 0; i < N; ++i)
+        for (unsigned int l = 0; l < config.ndim; ++l)
+            state.v[3*i+l] -= Scalar(momentum[l]/double(N));
+
+    run_md<evaluator, false>(config, params, state, steps, dt, kT, NULL);
+    return state;
+    }
+
+//! Writes the results as a JSON document
+class bench_writer
+    {
+    public:
+        bench_writer(FILE *out, unsigned int n_particles, unsigned int repeats, unsigned int seed)
+            : m_out(out), m_first(true)
+            {
+            fprintf(m_out, "{\n");
+            fprintf(m_out, "  \"benchmark\": \"polymd_bench\",\n");
+            fprintf(m_out, "  \"precision\": \"%s\",\n", sizeof(Scalar) == sizeof(float) ? "single" : "double");
+            fprintf(m_out, "  \"scalar_bytes\": %u,\n", (unsigned int)sizeof(Scalar));
+#ifdef __VERSION__
+            fprintf(m_out, "  \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+            fprintf(m_out, "  \"particles\": %u,\n", n_particles);
+            fprintf(m_out, "  \"repeats\": %u,\n", repeats);
+            fprintf(m_out, "  \"seed\": %u,\n", seed);
+            fprintf(m_out, "  \"batch_isa\": \"%s\",\n", getPolydisperseBatchISA().c_str());
+            fprintf(m_out, "  \"results\": [");
+            }
+
+        ~bench_writer()
+            {
+            fprintf(m_out, "\n  ],\n  \"energy_drift\": [");
+            for (unsigned int i = 0; i < m_drift.size(); ++i)
+                fprintf(m_out, "%s\n    %s", i == 0 ? "" : ",", m_drift[i].c_str());
+            fprintf(m_out, "\n  ]\n}\n");
+            }
+
+        void write(const std::string& model, const std::string& name, bench_distribution dist, unsigned int ndim,
+                   const pair_stream& stream, const bench_result& result)
+            {
+            fprintf(m_out, "%s\n    {\"evaluator\": \"%s\", \"name\": \"%s\", \"distribution\": \"%s\", "
+                           "\"dimensions\": %u, \"density\": %.6g, \"pairs\": %u, \"ns_per_pair\": %.6g, "
+                           "\"pairs_per_second\": %.6g, \"in_cutoff_fraction\": %.6g, \"checksum\": %.17g",
+                    m_first ? "" : ",", model.c_str(), name.c_str(), distribution_names[dist], ndim,
+                    double(stream.density), (unsigned int)stream.rsq.size(), result.ns_per_pair,
+                    1e9/result.ns_per_pair, result.in_cutoff, result.checksum);
+            if (result.force_error >= 0.0)
+                fprintf(m_out, ", \"max_force_error\": %.6g, \"max_energy_error\": %.6g",
+                        result.force_error, result.energy_error);
+            fprintf(m_out, "}");
+            m_first = false;
+            fflush(m_out);
+            }
+
+        //! Keep an energy drift result, they are written after all timings
+        void writeDrift(const std::string& model, const std::string& kernel, const bench_config& config,
+                        unsigned int steps, double dt, double kT, const drift_result& result)
+            {
+            char buf[512];
+            snprintf(buf, sizeof(buf), "{\"evaluator\": \"%s\", \"kernel\": \"%s\", \"dimensions\": %u, "
+                                       "\"particles\": %u, \"steps\": %u, \"dt\": %.6g, \"kT\": %.6g, "
+                                       "\"drift_per_particle\": %.6g, \"max_deviation_per_particle\": %.6g, "
+                                       "\"max_force_error\": %.6g}",
+                     model.c_str(), kernel.c_str(), config.ndim, config.N, steps, dt, kT, result.drift,
+                     result.max_deviation, result.force_error);
+            m_drift.push_back(std::string(buf));
+            }
+
+    private:
+        FILE *m_out;        //!< Output file
+        bool m_first;       //!< True until the first result is written
+        std::vector<std::string> m_drift;   //!< Energy drift results
+    };
+
+//! Time the batch kernel of an evaluator over a stream and write the result
+template<class evaluator>
+static void bench_batch(bench_writer& writer, const std::string& model, bench_distribution dist, unsigned int ndim,
+                        const pair_stream& stream, const polydisperse_params& params, unsigned int repeats)
+    {
+    bench_result result = run_batch<evaluator>(stream, params, repeats);
+    writer.write(model + "_batch", evaluator::getName(), dist, ndim, stream, result);
+    }
+
+//! Time the force only batch kernel of an evaluator over a stream and write the result
+template<class evaluator>
+static void bench_force(bench_writer& writer, const std::string& model, bench_distribution dist, unsigned int ndim,
+                        const pair_stream& stream, const polydisperse_params& params, unsigned int repeats)
+    {
+    bench_result result = run_batch<evaluator>(stream, params, repeats, false, false);
+    writer.write(model + "_force", evaluator::getName(), dist, ndim, stream, result);
+    }
+
+//! Time the mixed precision batch kernel of an evaluator over a stream and write the result
+template<class evaluator>
+static void bench_mixed(bench_writer& writer, const std::string& model, bench_distribution dist, unsigned int ndim,
+                        const pair_stream& stream, const polydisperse_params& params, unsigned int repeats)
+    {
+    bench_result result = run_batch_mixed<evaluator>(stream, params, repeats);
+    writer.write(model + "_mixed", evaluator::getName(), dist, ndim, stream, result);
+    }
+
+//! Measure the energy drift of both kernels of an evaluator, from the same thermalized state, and keep the results
+template<class evaluator>
+static void bench_drift(bench_writer& writer, const std::string& model, const bench_config& config,
+                        const polydisperse_params& params, unsigned int steps, unsigned int seed)
+    {
+    const Scalar dt = 0.002;
+    const Scalar kT = 0.5;
+    const md_state start = equilibrate<evaluator>(config, params, steps, dt, kT, seed);
+
+    drift_result result;
+    md_state state = start;
+    run_md<evaluator, false>(config, params, state, steps, dt, Scalar(0.0), &result);
+    writer.writeDrift(model, "scalar", config, steps, dt, kT, result);
+
+    state = start;
+    run_md<evaluator, true>(config, params, state, steps, dt, Scalar(0.0), &result);
+    writer.writeDrift(model, "mixed", config, steps, dt, kT, result);
+    }
+
+//! Time the table lookup of an evaluator over a stream and write the result
+template<class evaluator>
+static void bench_table(bench_writer& writer, const std::string& model, bench_distribution dist, unsigned int ndim,
+                        const pair_stream& stream, const polydisperse_params& params, unsigned int repeats)
+    {
+    bench_result result = run_table<evaluator>(stream, params, repeats);
+    writer.write(model + "_table", evaluator::getName(), dist, ndim, stream, result);
+    }
+
+//! Time one evaluator over a stream and write the result
+template<class evaluator>
+static void bench(bench_writer& writer, const std::string& model, bench_distribution dist, unsigned int ndim,
+                  const pair_stream& stream, Scalar r_cut, const typename evaluator::param_type& params, unsigned int repeats)
+    {
+    bench_result result = run_evaluator<evaluator>(stream, r_cut*r_cut, params, repeats);
+    writer.write(model, evaluator::getName(), dist, ndim, stream, result);
+    }
+
+//! Time all kernels of an evaluator over a stream with zero diameters, write the results and check that they are finite
+/*! Pairs with sigma_ij = 0 have no range. The scalar evaluator skips them, the masked kernels must not turn them into
+    NaN, so all checksums agree with the scalar one.
+*/
+template<class evaluator>
+static void bench_zero_diameter(bench_writer& writer, const std::string& model, unsigned int ndim,
+                                const pair_stream& stream, Scalar r_cut, const polydisperse_params& params,
+                                unsigned int repeats)
+    {
+    const std::string kernels[5] = {"", "_batch", "_force", "_table", "_mixed"};
+    const bench_result results[5] = {run_evaluator<evaluator>(stream, r_cut*r_cut, params, repeats),
+                                     run_batch<evaluator>(stream, params, repeats),
+                                     run_batch<evaluator>(stream, params, repeats, false, false),
+                                     run_table<evaluator>(stream, params, repeats),
+                                     run_batch_mixed<evaluator>(stream, params, repeats)};
+    for (unsigned int k = 0; k < 5; ++k)
+        {
+        writer.write(model + "_zero_diameter" + kernels[k], evaluator::getName(), uniform, ndim, stream, results[k]);
+        if (!std::isfinite(results[k].checksum))
+            throw std::runtime_error(model + kernels[k] + " is not finite for particles of zero diameter");
+        }
+    }
+
+int main(int argc, char **argv)
+    {
+    const char *output = NULL;
+    unsigned int n_particles = 4096;
+    unsigned int repeats = 5;
+    unsigned int seed = 12345;
+    unsigned int drift_steps = 1000;
+
+    for (int i = 1; i < argc; ++i)
+        {
+        if (!strcmp(argv[i], "-o") && i+1 < argc)
+            output = argv[++i];
+        else if (!strcmp(argv[i], "-n") && i+1 < argc)
+            n_particles = (unsigned int)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-r") && i+1 < argc)
+            repeats = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "-s") && i+1 < argc)
+            seed = (unsigned int)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-m") && i+1 < argc)
+            drift_steps = (unsigned int)std::max(0, atoi(argv[++i]));
+        else
+            {
+            fprintf(stderr, "usage: %s [-o output.json] [-n particles] [-r repeats] [-s seed] [-m drift_steps]\n", argv[0]);
+            return 1;
+            }
+        }
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if (!out)
+        {
+        fprintf(stderr, "polymd_bench: cannot open %s\n", output);
+        return 1;
+        }
+
+    try
+        {
+        // reduced cutoffs and non-additivities are the defaults of pair.polydisperse
+        const polydisperse_params p12 = make_polydisperse_params<12, 0, 2>(1.0, 0.2, 1.25);
+        const polydisperse_params p18 = make_polydisperse_params<18, 0, 2>(1.0, 0.0, 1.25);
+        const polydisperse_params p10 = make_polydisperse_params<10, 0, 3>(1.0, 0.0416667, 1.48);
+        const polydisperse_params plj = make_polydisperse_params<12, 6, 2>(1.0, 0.2, 2.5);
+        const polydisperse_params p106 = make_polydisperse_params<10, 6, 2>(1.0, 0.1, 2.5);
+        const Scalar2 lj = make_scalar2(4.0, 4.0);
+        const Scalar lj_rcut = 2.5;
+
+            {
+            bench_writer writer(out, n_particles, repeats, seed);
+            for (unsigned int ndim = 2; ndim <= 3; ++ndim)
+                {
+                for (unsigned int d = 0; d < num_distributions; ++d)
+                    {
+                    bench_distribution dist = bench_distribution(d);
+                    std::mt19937 rng(seed + 17*d + ndim);
+
+                    // short range models see the list of r_cut = 1.5 with a 0.3 buffer, the LJ ones 2.5 + 0.3
+                    pair_stream short_range = make_stream(dist, ndim, n_particles, 1.8, rng);
+                    pair_stream long_range = make_stream(dist, ndim, n_particles, 2.8, rng);
+
+                    bench<EvaluatorPairPolydisperse>(writer, "polydisperse12", dist, ndim, short_range, 1.8, p12, repeats);
+                    bench<EvaluatorPairPolydisperse18>(writer, "polydisperse18", dist, ndim, short_range, 1.8, p18, repeats);
+                    bench<EvaluatorPairPolydisperse10>(writer, "polydisperse10", dist, ndim, short_range, 1.8, p10, repeats);
+                    bench<EvaluatorPairPolydisperseLJ>(writer, "polydisperselj", dist, ndim, long_range, 2.8, plj, repeats);
+                    bench<EvaluatorPairPolydisperseLJ106>(writer, "polydisperse106", dist, ndim, long_range, 2.8, p106, repeats);
+                    bench<EvaluatorPairLJPlugin>(writer, "lj_plugin", dist, ndim, long_range, lj_rcut, lj, repeats);
+                    bench<EvaluatorPairForceShiftedLJPlugin>(writer, "force_shifted_lj_plugin", dist, ndim, long_range, lj_rcut, lj, repeats);
+
+                    bench_batch<EvaluatorPairPolydisperse>(writer, "polydisperse12", dist, ndim, short_range, p12, repeats);
+                    bench_batch<EvaluatorPairPolydisperse18>(writer, "polydisperse18", dist, ndim, short_range, p18, repeats);
+                    bench_batch<EvaluatorPairPolydisperse10>(writer, "polydisperse10", dist, ndim, short_range, p10, repeats);
+                    bench_batch<EvaluatorPairPolydisperseLJ>(writer, "polydisperselj", dist, ndim, long_range, plj, repeats);
+                    bench_batch<EvaluatorPairPolydisperseLJ106>(writer, "polydisperse106", dist, ndim, long_range, p106, repeats);
+
+                    bench_force<EvaluatorPairPolydisperse>(writer, "polydisperse12", dist, ndim, short_range, p12, repeats);
+                    bench_force<EvaluatorPairPolydisperse18>(writer, "polydisperse18", dist, ndim, short_range, p18, repeats);
+                    bench_force<EvaluatorPairPolydisperse10>(writer, "polydisperse10", dist, ndim, short_range, p10, repeats);
+                    bench_force<EvaluatorPairPolydisperseLJ>(writer, "polydisperselj", dist, ndim, long_range, plj, repeats);
+                    bench_force<EvaluatorPairPolydisperseLJ106>(writer, "polydisperse106", dist, ndim, long_range, p106, repeats);
+
+                    bench_table<EvaluatorPairPolydisperse>(writer, "polydisperse12", dist, ndim, short_range, p12, repeats);
+                    bench_table<EvaluatorPairPolydisperse18>(writer, "polydisperse18", dist, ndim, short_range, p18, repeats);
+                    bench_table<EvaluatorPairPolydisperse10>(writer, "polydisperse10", dist, ndim, short_range, p10, repeats);
+                    bench_table<EvaluatorPairPolydisperseLJ>(writer, "polydisperselj", dist, ndim, long_range, plj, repeats);
+                    bench_table<EvaluatorPairPolydisperseLJ106>(writer, "polydisperse106", dist, ndim, long_range, p106, repeats);
+
+                    bench_mixed<EvaluatorPairPolydisperse>(writer, "polydisperse12", dist, ndim, short_range, p12, repeats);
+                    bench_mixed<EvaluatorPairPolydisperse18>(writer, "polydisperse18", dist, ndim, short_range, p18, repeats);
+                    bench_mixed<EvaluatorPairPolydisperse10>(writer, "polydisperse10", dist, ndim, short_range, p10, repeats);
+                    bench_mixed<EvaluatorPairPolydisperseLJ>(writer, "polydisperselj", dist, ndim, long_range, plj, repeats);
+                    bench_mixed<EvaluatorPairPolydisperseLJ106>(writer, "polydisperse106", dist, ndim, long_range, p106, repeats);
+                    }
+                }
+
+            // every fifth particle without a diameter, listed with the range of its original one, so that the pairs of
+            // two of them have sigma_ij = 0
+                {
+                std::mt19937 rng(seed);
+                const bench_config config = make_config(uniform, 3, n_particles, rng);
+                std::vector<double> d_zero(config.d);
+                for (unsigned int i = 0; i < config.N; i += 5)
+                    d_zero[i] = 0.0;
+                const pair_stream short_range = make_stream(config, 1.8, &d_zero);
+                const pair_stream long_range = make_stream(config, 2.8, &d_zero);
+                bench_zero_diameter<EvaluatorPairPolydisperse>(writer, "polydisperse12", 3, short_range, 1.8, p12,
+                                                               repeats);
+                bench_zero_diameter<EvaluatorPairPolydisperseLJ>(writer, "polydisperselj", 3, long_range, 2.8, plj,
+                                                                 repeats);
+                }
+
+            // energy conservation of the Scalar and mixed precision kernels, on a 3D power law system of ~1000
+            // particles that keeps the list range of the LJ models inside the box
+            if (drift_steps > 0)
+                {
+                std::mt19937 rng(seed);
+                const bench_config config = make_config(power_law, 3, 1000, rng);
+                bench_drift<EvaluatorPairPolydisperse>(writer, "polydisperse12", config, p12, drift_steps, seed);
+                bench_drift<EvaluatorPairPolydisperse18>(writer, "polydisperse18", config, p18, drift_steps, seed);
+                bench_drift<EvaluatorPairPolydisperse10>(writer, "polydisperse10", config, p10, drift_steps, seed);
+                bench_drift<EvaluatorPairPolydisperseLJ>(writer, "polydisperselj", config, plj, drift_steps, seed);
+                bench_drift<EvaluatorPairPolydisperseLJ106>(writer, "polydisperse106", config, p106, drift_steps, seed);
+                }
+            }
+        }
+    catch (std::exception& e)
+        {
+        fprintf(stderr, "polymd_bench: %s\n", e.what());
+        if (output)
+            fclose(out);
+        return 1;
+        }
+
+    if (output)
+        fclose(out);
+    return 0;
+    }
@@ -5,6 +5,14 @@
 // Maintainer: joaander All developers are free to add the calls needed to export their modules
 #include "AllPluginPairPotentials.h"
 #include "hoomd/md/PotentialPair.h"
+#include "LoadBalancerPolydisperse.h"
+#include "NeighborListDiameterClass.h"
+#include "PotentialPairPolymdComposite.h"
+#include "PolydisperseJIT.h"
+#include "PolymdReplicas.h"
+#include "PolymdRerun.h"
+#include "StressCorrelationAnalyzer.h"
+#include "UpdaterInflate.h"
 
 // include GPU classes
 #ifdef ENABLE_CUDA
@@ -12,6 +20,7 @@
 #endif
 
 #include <hoomd/extern/pybind/include/pybind11/pybind11.h>
+#include <hoomd/extern/pybind/include/pybind11/stl.h>
 namespace py = pybind11;
 
 //! Create the python module
@@ -20,6 +29,61 @@ namespace py = pybind11;
 */
 PYBIND11_MODULE(_polymd, m)
     {
+    pybind11::class_<polydisperse_params>(m, "polydisperse_params")
+        .def(pybind11::init<>())
+        .def_readwrite("v0", &polydisperse_params::v0)
+        .def_readwrite("eps", &polydisperse_params::eps)
+        .def_readwrite("scaledrcutsq", &polydisperse_params::scaledrcutsq)
+        ;
+    m.def("make_polydisperse12_params", &make_polydisperse_params<12, 0, 2>);
+    m.def("make_polydisperse18_params", &make_polydisperse_params<18, 0, 2>);
+    m.def("make_polydisperse10_params", &make_polydisperse_params<10, 0, 3>);
+    m.def("make_polydisperselj_params", &make_polydisperse_params<12, 6, 2>);
+    m.def("make_polydisperse106_params", &make_polydisperse_params<10, 6, 2>);
+    m.def("make_polydisperse_mnq_params", &PolydisperseJIT::makeParams);
+    m.def("is_valid_polydisperse_mnq", &PolydisperseJIT::isValid);
+    m.def("get_polydisperse_jit_source", &PolydisperseJIT::getSource);
+    m.def("broadcast_polydisperse_jit_library", &PolydisperseJIT::broadcastLibrary);
+
+    // the trajectory tool has no HOOMD dependencies, so it is exported here rather than in its own sources
+    pybind11::class_<PolymdRerun, std::shared_ptr<PolymdRerun> >(m, "PolymdRerun")
+        .def(pybind11::init< const std::string&, const std::string& >())
+        .def("getNumFrames", &PolymdRerun::getNumFrames)
+        .def("getTypes", &PolymdRerun::getTypes)
+        .def("setParams", &PolymdRerun::setParams)
+        .def("setNumThreads", &PolymdRerun::setNumThreads)
+        .def("getNumThreads", &PolymdRerun::getNumThreads)
+        .def("run", &PolymdRerun::run)
+        ;
+
+    // the same holds for the replica engine
+    pybind11::class_<PolymdReplicas, std::shared_ptr<PolymdReplicas> >(m, "PolymdReplicas")
+        .def(pybind11::init< const std::string&, unsigned int, unsigned int, unsigned int, unsigned int >())
+        .def("getNumReplicas", &PolymdReplicas::getNumReplicas)
+        .def("getN", &PolymdReplicas::getN)
+        .def("setParams", &PolymdReplicas::setParams)
+        .def("setBuffer", &PolymdReplicas::setBuffer)
+        .def("setNumThreads", &PolymdReplicas::setNumThreads)
+        .def("getNumThreads", &PolymdReplicas::getNumThreads)
+        .def("setReplica", &PolymdReplicas::setReplica)
+        .def("setVelocities", &PolymdReplicas::setVelocities)
+        .def("getPositions", &PolymdReplicas::getPositions)
+        .def("getImages", &PolymdReplicas::getImages)
+        .def("getVelocities", &PolymdReplicas::getVelocities)
+        .def("getForces", &PolymdReplicas::getForces)
+        .def("setTemperatures", &PolymdReplicas::setTemperatures)
+        .def("setLangevin", &PolymdReplicas::setLangevin)
+        .def("compute", &PolymdReplicas::compute)
+        .def("run", &PolymdReplicas::run)
+        .def("exchange", &PolymdReplicas::exchange)
+        .def("swapSlots", &PolymdReplicas::swapSlots)
+        .def("getReplicaOfSlot", &PolymdReplicas::getReplicaOfSlot)
+        .def("getEnergies", &PolymdReplicas::getEnergies)
+        .def("getPressures", &PolymdReplicas::getPressures)
+        .def("getTimestep", &PolymdReplicas::getTimestep)
+        .def("getNumBuilds", &PolymdReplicas::getNumBuilds)
+        ;
+
     export_PotentialPair<PotentialPairLJPlugin>(m, "PotentialPairLJPlugin");
     export_PotentialPair<PotentialPairForceShiftedLJPlugin>(m, "PotentialPairForceShiftedLJPlugin");
     export_PotentialPair<PotentialPairPolydisperse>(m, "PotentialPairPolydisperse");
@@ -27,6 +91,11 @@ PYBIND11_MODULE(_polymd, m)
     export_PotentialPair<PotentialPairPolydisperse18>(m, "PotentialPairPolydisperse18");
     export_PotentialPair<PotentialPairPolydisperse10>(m, "PotentialPairPolydisperse10");
     export_PotentialPair<PotentialPairPolydisperseLJ106>(m, "PotentialPairPolydisperseLJ106");
+    export_PotentialPairPolymd<PotentialPairPolymdPolydisperse, PotentialPairPolydisperse>(m, "PotentialPairPolymdPolydisperse");
+    export_PotentialPairPolymd<PotentialPairPolymdPolydisperseLJ, PotentialPairPolydisperseLJ>(m, "PotentialPairPolymdPolydisperseLJ");
+    export_PotentialPairPolymd<PotentialPairPolymdPolydisperse18, PotentialPairPolydisperse18>(m, "PotentialPairPolymdPolydisperse18");
+    export_PotentialPairPolymd<PotentialPairPolymdPolydisperse10, PotentialPairPolydisperse10>(m, "PotentialPairPolymdPolydisperse10");
+    export_PotentialPairPolymd<PotentialPairPolymdPolydisperseLJ106, PotentialPairPolydisperseLJ106>(m, "PotentialPairPolymdPolydisperseLJ106");
 
 #ifdef ENABLE_CUDA
     export_PotentialPairGPU<PotentialPairLJPluginGPU, PotentialPairLJPlugin>(m, "PotentialPairLJPluginGPU");
@@ -37,4 +106,16 @@ PYBIND11_MODULE(_polymd, m)
     export_PotentialPairGPU<PotentialPairPolydisperse10GPU, PotentialPairPolydisperse10>(m, "PotentialPairPolydisperse10GPU");
     export_PotentialPairGPU<PotentialPairPolydisperseLJ106GPU, PotentialPairPolydisperseLJ106>(m, "PotentialPairPolydisperseLJ106GPU");
 #endif
+
+    export_NeighborListDiameterClass(m);
+    export_PotentialPairPolymdComposite(m);
+    export_StressCorrelationAnalyzer(m);
+    export_LoadBalancerPolydisperse(m);
+    export_UpdaterInflate(m);
+
+    export_UpdaterSwapMC<UpdaterSwapMCPolydisperse>(m, "UpdaterSwapMCPolydisperse");
+    export_UpdaterSwapMC<UpdaterSwapMCPolydisperseLJ>(m, "UpdaterSwapMCPolydisperseLJ");
+    export_UpdaterSwapMC<UpdaterSwapMCPolydisperse18>(m, "UpdaterSwapMCPolydisperse18");
+    export_UpdaterSwapMC<UpdaterSwapMCPolydisperse10>(m, "UpdaterSwapMCPolydisperse10");
+    export_UpdaterSwapMC<UpdaterSwapMCPolydisperseLJ106>(m, "UpdaterSwapMCPolydisperseLJ106");
     }
@@ -0,0 +1,160 @@
+# Copyright (c) 2009-2019 The Regents of the University of Michigan
+# This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+R""" Neighbor lists for polydisperse systems.
+
+The polydisperse pair potentials interact out to *scaledr_cut* times the non-additive pair diameter. The standard
+:py:class:`hoomd.md.nlist.cell` searches every particle out to the range of the two largest particles, which
+:py:class:`diameter_class` avoids by grouping the particles into diameter classes.
+"""
+
+from hoomd.md import nlist as md_nlist
+from hoomd.md import _md
+from hoomd import _hoomd
+from hoomd.polymd import _polymd
+import hoomd;
+
+class diameter_class(md_nlist.nlist):
+    R""" Cell list based neighbor list that searches out to the true polydisperse cutoff.
+
+    Args:
+        r_buff (float):  Buffer width.
+        check_period (int): How often to attempt to rebuild the neighbor list.
+        d_max (float): The maximum diameter a particle will achieve, only used in the same way as :py:class:`hoomd.md.nlist.cell`
+                       for type pairs without polydisperse parameters.
+        dist_check (bool): Flag to enable / disable distance checking.
+        name (str): Optional name for this neighbor list instance.
+        classes (int): Number of diameter classes.
+
+    :py:class:`diameter_class` sorts the particles into *classes* equal width diameter classes. Every (type, class)
+    combination walks its own stencil of cells that covers *scaledr_cut* times the largest pair diameter it can
+    have with any other class, plus the buffer. A neighbor is only kept within *scaledr_cut* :math:`\sigma_{ij}` +
+    *r_buff* of the actual pair diameter, so the list only holds pairs that can come within the cutoff.
+
+    The reduced cutoff and non-additivity are read from the :py:class:`hoomd.polymd.pair.polydisperse` forces that use
+    this neighbor list when the simulation starts. With several of them, the larger cutoff and the smaller
+    non-additivity are used for each type pair.
+    Other forces on the same list, e.g. :py:class:`hoomd.md.pair.lj`, keep all pairs within their *r_cut* + *r_buff*,
+    also on the type pairs with polydisperse parameters.
+
+    With MPI, the ghost layer that every rank exchanges is also set from the polydisperse cutoff instead of *r_cut*
+    and *d_max*: particles of a type are sent as ghosts within *scaledr_cut* :math:`\sigma_{ij}` + *r_buff* of the
+    domain boundary, with :math:`\sigma_{ij}` bounded over the diameters of the particles that are close enough to a
+    boundary to interact across it. The width is recomputed at every ghost exchange, see :py:meth:`get_ghost_width`.
+
+    Note:
+        :py:class:`diameter_class` is only available on the CPU.
+
+    Examples::
+
+        nl = polymd.nlist.diameter_class(r_buff=0.3, classes=8)
+        poly = polymd.pair.polydisperse(r_cut=1.5, nlist=nl, model="polydisperse12")
+
+    """
+    def __init__(self, r_buff=0.4, check_period=1, d_max=None, dist_check=True, name=None, classes=8):
+        hoomd.util.print_status_line();
+
+        md_nlist.nlist.__init__(self);
+
+        if hoomd.context.exec_conf.isCUDAEnabled():
+            hoomd.context.msg.error("nlist.diameter_class is not supported on the GPU\n");
+            raise RuntimeError("Error creating neighbor list");
+
+        if name is None:
+            self.name = "diameter_class_nlist_%d" % diameter_class.cur_id;
+            diameter_class.cur_id += 1;
+        else:
+            self.name = name;
+
+        # create a cell list
+        self.cl = _hoomd.CellList(hoomd.context.current.system_definition);
+        hoomd.context.current.system.addCompute(self.cl, self.name + "_cl");
+
+        # create the C++ mirror class
+        self.cpp_nlist = _polymd.NeighborListDiameterClass(hoomd.context.current.system_definition, 0.0, r_buff, self.cl);
+        self.cpp_nlist.setEvery(check_period, dist_check);
+        self.cpp_nlist.setNumClasses(int(classes));
+
+        hoomd.context.current.system.addCompute(self.cpp_nlist, self.name);
+
+        # register this neighbor list with the context
+        hoomd.context.current.neighbor_lists += [self];
+
+        # save the parameters we set
+        self.r_cut = md_nlist.rcut();
+        self.r_buff = r_buff;
+
+        # save d_max and if it is set
+        if d_max is not None:
+            self.set_params(d_max = d_max);
+
+    def set_classes(self, classes):
+        R""" Change the number of diameter classes.
+
+        Args:
+            classes (int): Number of diameter classes.
+
+        More classes give tighter stencils, at the cost of more stencils to store.
+
+        Examples::
+
+            nl.set_classes(16)
+
+        """
+        hoomd.util.print_status_line();
+        self.cpp_nlist.setNumClasses(int(classes));
+
+    def get_ghost_width(self):
+        R""" Get the ghost layer width of every type.
+
+        Returns:
+            A dictionary mapping the type names to the ghost layer width requested at the last ghost exchange, empty
+            without MPI or before the first exchange.
+
+        Examples::
+
+            hoomd.run(100)
+            print(nl.get_ghost_width())
+
+        """
+        widths = self.cpp_nlist.getGhostLayerWidths();
+        pdata = hoomd.context.current.system_definition.getParticleData();
+        return dict((pdata.getNameByType(t), w) for t, w in enumerate(widths));
+
+    def update_rcut(self):
+        md_nlist.nlist.update_rcut(self);
+
+        # merge the polydisperse ranges of all forces using this neighbor list, and the cutoffs of the others
+        ranges = {};
+        plain = {};
+        pdata = hoomd.context.current.system_definition.getParticleData();
+        type_list = [pdata.getNameByType(t) for t in range(0,pdata.getNTypes())];
+        for f in hoomd.context.current.forces:
+            if getattr(f, 'nlist', None) is not self:
+                continue;
+            if not hasattr(f, 'get_polydisperse_range'):
+                r_cut = f.get_rcut();
+                if r_cut is None:
+                    continue;
+                for i in range(0,len(type_list)):
+                    for j in range(i,len(type_list)):
+                        r_cut.ensure_pair(type_list[i], type_list[j]);
+                        rc = r_cut.get_pair(type_list[i], type_list[j]);
+                        plain[(i,j)] = max(plain.get((i,j), 0.0), rc);
+                continue;
+            for pair, (scaledr_cut, eps) in f.get_polydisperse_range().items():
+                if pair in ranges:
+                    cur_rcut, cur_eps = ranges[pair];
+                    ranges[pair] = (max(cur_rcut, scaledr_cut), min(cur_eps, eps));
+                else:
+                    ranges[pair] = (scaledr_cut, eps);
+
+        # start from scratch, a pair that no force sets any more must not keep its old range
+        for i in range(0,len(type_list)):
+            for j in range(i,len(type_list)):
+                self.cpp_nlist.setPolydisperseParams(i, j, 0.0, 0.0);
+                self.cpp_nlist.setPlainRcut(i, j, float(plain.get((i,j), 0.0)));
+        for (a, b), (scaledr_cut, eps) in ranges.items():
+            self.cpp_nlist.setPolydisperseParams(pdata.getTypeByName(a), pdata.getTypeByName(b), scaledr_cut, eps);
+
+diameter_class.cur_id = 0;
@@ -30,7 +30,13 @@ from hoomd.md import force;
 from hoomd.md import nlist as nl # to avoid naming conflicts
 import hoomd;
 
+import hashlib;
 import math;
+import os;
+import platform;
+import re;
+import shutil;
+import subprocess;
 import sys;
 
 #from collections import OrderedDict
@@ -39,6 +45,100 @@ from hoomd.md import _md
 from hoomd import _hoomd
 import hoomd.md.pair as md_pair
 
+# smoothing coefficient helper and default v0, eps and scaledr_cut of every model
+_model_params = {
+    'polydisperse12': (_polymd.make_polydisperse12_params, 1.0, 0.2, 1.25),
+    'polydisperse18': (_polymd.make_polydisperse18_params, 1.0, 0.0, 1.25),
+    'polydisperse10': (_polymd.make_polydisperse10_params, 1.0, 0.0416667, 1.48),
+    'polydisperse106': (_polymd.make_polydisperse106_params, 1.0, 0.1, 2.5),
+    'lennardjones': (_polymd.make_polydisperselj_params, 1.0, 0.2, 2.5),
+};
+
+def _set_model_defaults(coeff, model):
+    make_params, v0, eps, scaledr_cut = _model_params[model];
+    coeff.set_default_coeff('v0', v0);
+    coeff.set_default_coeff('eps', eps);
+    coeff.set_default_coeff('scaledr_cut', scaledr_cut);
+
+def _cpu_id():
+    # kernels built with -march=native only run on the CPU they were built on
+    cpu = platform.machine();
+    try:
+        with open('/proc/cpuinfo') as f:
+            for line in f:
+                if line.startswith('model name') or line.startswith('flags'):
+                    cpu += line;
+                if line.strip() == '':
+                    break;
+    except IOError:
+        cpu += platform.processor();
+    return cpu;
+
+def _included_headers(source, include_paths):
+    # contents of the quoted includes of source that resolve in include_paths, followed recursively
+    contents = [];
+    seen = set();
+    pending = [source];
+    while pending:
+        text = pending.pop();
+        for line in text.splitlines():
+            match = re.match(r'\s*#\s*include\s*"([^"]+)"', line);
+            if match is None or match.group(1) in seen:
+                continue;
+            seen.add(match.group(1));
+            for path in include_paths:
+                header = os.path.join(path, match.group(1));
+                if os.path.isfile(header):
+                    with open(header) as f:
+                        contents.append(match.group(1) + '\n' + f.read());
+                    pending.append(contents[-1]);
+                    break;
+    return contents;
+
+def _compile_jit_kernel(m, n, q, compiler, flags, cache_dir):
+    # the library is named after everything that goes into it, including the headers the kernel is built from, so a
+    # cached one can be used as is
+    source = _polymd.get_polydisperse_jit_source(m, n, q);
+    include_path = os.path.join(os.path.dirname(hoomd.__file__), 'include');
+    include_path_polymd = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'include');
+    headers = _included_headers(source, [include_path_polymd, include_path]);
+    key = hashlib.sha1('\n'.join([source, compiler, ' '.join(flags), include_path, _cpu_id()] + headers).encode('utf-8')).hexdigest();
+    basename = os.path.join(cache_dir, 'polydisperse_%d_%d_%d_%s' % (m, n, q, key[:16]));
+    library = basename + '.so';
+    if os.path.isfile(library):
+        return library;
+
+    if not os.path.isdir(cache_dir):
+        try:
+            os.makedirs(cache_dir);
+        except OSError:
+            if not os.path.isdir(cache_dir):
+                raise;
+
+    # compile to a temporary file and rename it, so that concurrent ranks never load a partial library
+    tmp = '%s.%d' % (basename, os.getpid());
+    with open(tmp + '.cc', 'w') as f:
+        f.write(source);
+    cmd = [compiler] + flags + ['-std=c++11', '-fPIC', '-shared', '-I', include_path, '-I', include_path_polymd,
+                                '-o', tmp + '.so', tmp + '.cc'];
+    hoomd.context.msg.notice(2, "Notice: polydisperse_jit compiling " + ' '.join(cmd) + "\n");
+    try:
+        p = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT);
+        output = p.communicate()[0];
+        status = p.returncode;
+    except OSError as e:
+        output = str(e).encode('utf-8');
+        status = -1;
+    if status != 0:
+        for f in [tmp + '.cc', tmp + '.so']:
+            if os.path.isfile(f):
+                os.remove(f);
+        hoomd.context.msg.error("pair.polydisperse_jit: compiling the kernel failed:\n" + output.decode('utf-8', 'replace') + "\n");
+        raise RuntimeError("Error compiling pair.polydisperse_jit");
+    os.rename(tmp + '.so', library);
+    os.remove(tmp + '.cc');
+    return library;
+
 class lj_plugin(md_pair.pair):
     R""" Lennard-Jones pair potential.
 
@@ -200,12 +300,97 @@ class force_shifted_lj_plugin(md_pair.pair):
 class polydisperse(md_pair.pair):
     R""" Polydisperse's custom pair potential.
 
+    On the CPU, the forces are computed by *threads* worker threads. The particles are split into chunks with about
+    the same number of neighbor list entries, so that the large particles of a polydisperse system, which have many
+    more neighbors than the small ones, do not all end up on the same thread. Every thread starts on its own range of
+    chunks, and a thread that is done early steals chunks from the others (see :py:meth:`set_work_stealing`). Full
+    neighbor lists (``nlist.set_params(storage_mode='full')``) scale best with several threads, since with a half
+    neighbor list every thread needs its own force buffer that is summed at the end. The *threads* option is ignored
+    on the GPU.
+
+    With ``mode="table"``, the energy and force are looked up in cubic spline tables in :math:`(r/\sigma_{ij})^2`
+    instead of being evaluated. Every model depends on the distance only through :math:`r/\sigma_{ij}`, so one table
+    per type pair serves all particle pairs, whatever their diameters. The tables start with *table_width* intervals
+    between *table_rmin* :math:`\sigma_{ij}` and the cutoff, and are refined until the error of the energy and force,
+    relative to :math:`\max(|V|, v_0)`, is below *table_error*. Closer pairs are evaluated exactly. The tables are
+    built when the simulation starts and whenever the coefficients change. Table mode is slower than the exact
+    evaluation of every model here and is meant for accuracy tests, not for speed. It is only available on the CPU.
+
+    With ``mode="discrete"``, for systems where the diameters take a few discrete values (e.g. ternary mixtures or a
+    binned distribution), :math:`\sigma_{ij}` and the cutoff are precomputed for every pair of diameters and looked up
+    by the index of the diameter of each particle. Give the values in *diameters*, matched with a relative tolerance of
+    :math:`10^{-6}`, or leave it to None to detect them from the particles. At most 256 distinct diameters are
+    supported. The indices are assigned again when the particles are sorted or exchanged, at the start of every
+    :py:func:`hoomd.run`, and when the polymd updaters change the diameters. Discrete mode is only available on the
+    CPU.
+
+    With ``precision="mixed"``, the pair distances and diameters are rounded to single precision when the neighbors
+    are gathered and the pair energies and forces are evaluated in single precision, while the forces, energies and
+    virials of every particle are still summed in the precision of the build. The relative force error is of the
+    order of :math:`10^{-6}`. Mixed precision is not faster than the full precision kernels, it is meant to test how
+    sensitive a run is to the precision of the pair arithmetic. It has no effect in table mode and is only available
+    on the CPU.
+
+    With ``skip_energy=True``, the pair energies are only computed on the time steps where the potential energy is
+    requested (e.g. by :py:class:`hoomd.analyze.log` logging ``potential_energy``), in the same way as the virial is
+    only computed when the pressure is. The other steps use force only kernels and leave the per particle energies at
+    zero. The energy of this force in the log is computed on demand. Do not enable it with integrators or updaters that
+    read the per particle energies on every step, like :py:class:`hoomd.md.integrate.mode_minimize_fire`. Only
+    available on the CPU.
+
+    With ``r_cut="auto"`` (CPU only), the cutoff of every type pair and *d_max* are derived from the diameters and the
+    coefficients. The neighbor list shifts the cutoff of a pair by :math:`(d_i + d_j)/2 - 1`, so the smallest safe
+    cutoff of the type pair (a, b) is :math:`1 + (\mathrm{scaledr\_cut} - 1) (d_{\max,a} + d_{\max,b})/2` for
+    :math:`\epsilon \ge 0`, instead of a global *r_cut* large enough for the largest particles. The cutoffs are derived
+    at the start of every run and again when :py:class:`polymd.update.swap` or :py:class:`polymd.update.inflate` change
+    the diameters, and the neighbor list is rebuilt whenever they change. Diameters changed by other means during a run
+    are only seen at the start of the next run. :py:meth:`get_nlist_sizing` reports them with the expected number of neighbors. The neighbor
+    list should not be shared with other forces, since the derived cutoffs replace theirs during the run.
+
+    On the CPU, every force compute counts the neighbor list entries it visits and the pairs inside the polydisperse
+    cutoff, and measures the time of the pair loop. Log them with :py:class:`hoomd.analyze.log` as
+    ``polydisperse_pairs_visited``, ``polydisperse_pairs_evaluated``, ``polydisperse_pairs_rejected``,
+    ``polydisperse_cutoff_efficiency`` (evaluated over visited), ``polydisperse_time_ns`` and
+    ``polydisperse_thread_imbalance`` (busy time of the slowest thread over the mean of the threads), with the suffix
+    ``_name`` when *name* is given, or get them with :py:meth:`get_counters`. :py:meth:`get_thread_busy_time` returns
+    the busy time of every thread.
+
+    With ``accumulation="fixed"``, every pair contribution to the forces, energies and virials is rounded to a multiple
+    of :math:`2^{-\mathrm{fixed\_bits}}` and summed in 64 bit integers, so the sums do not depend on their order and
+    the results are bitwise identical for any number of *threads* and for half and full neighbor lists. This makes runs
+    reproducible when the thread count changes, at the cost of about 1.4 times the pair loop time. With the default of
+    32 bits, the resolution is :math:`2.3 \cdot 10^{-10}` and a single pair force, energy or virial must stay below
+    :math:`2^{20} \approx 10^6`, otherwise the compute stops with an error and fewer bits should be used. With domain
+    decomposition, a pair seen across a boundary is evaluated from a ghost, so the results only match those of another
+    decomposition where the ghost positions are identical. The xplor shift mode sums in floating point. Only available
+    on the CPU.
+
+    Examples::
+
+        poly = polymd.pair.polydisperse(r_cut=1.5, nlist=nl, model="polydisperse12", threads=8)
+        poly = polymd.pair.polydisperse(r_cut="auto", nlist=nl, model="polydisperse12")
+        poly18 = polymd.pair.polydisperse(r_cut=1.5, nlist=nl, model="polydisperse18", mode="table", table_error=1e-7)
+        poly10 = polymd.pair.polydisperse(r_cut=1.5, nlist=nl, model="polydisperse10", precision="mixed")
+        ternary = polymd.pair.polydisperse(r_cut=1.5, nlist=nl, model="polydisperse12", mode="discrete", diameters=[0.8, 1.0, 1.2])
+        poly = polymd.pair.polydisperse(r_cut=1.5, nlist=nl, model="polydisperse12", skip_energy=True)
+        poly = polymd.pair.polydisperse(r_cut=1.5, nlist=nl, model="polydisperse12", threads=8, accumulation="fixed")
+
     """
-    def __init__(self, r_cut, nlist, model,name=None, d_max = None):
+    def __init__(self, r_cut, nlist, model,name=None, d_max = None, threads=1, mode="exact", table_width=1024, table_rmin=0.5, table_error=1e-6, precision="full", skip_energy=False, diameters=None, accumulation="float", fixed_bits=32):
         hoomd.util.print_status_line();
-        
+
+        # the cutoffs are derived once the force exists, see get_rcut
+        self.auto_r_cut = False;
+        auto_r_cut = (r_cut == "auto");
+        if auto_r_cut:
+            if hoomd.context.exec_conf.isCUDAEnabled():
+                hoomd.context.msg.error("pair.polydisperse: r_cut=\"auto\" is not supported on the GPU\n");
+                raise RuntimeError("Error creating pair.polydisperse");
+            r_cut = 0.0;
+
         # initialize the base class
         md_pair.pair.__init__(self, r_cut, nlist, name);
+        self.model = model;
         
         # update the neighbor list
         if d_max is None :
@@ -220,76 +405,721 @@ class polydisperse(md_pair.pair):
         # create the c++ mirror class
         if (model == "polydisperse12"):
             if not hoomd.context.exec_conf.isCUDAEnabled():
-                self.cpp_force = _polymd.PotentialPairPolydisperse(hoomd.context.current.system_definition, self.nlist.cpp_nlist, self.name);
-                self.cpp_class = _polymd.PotentialPairPolydisperse;
+                self.cpp_force = _polymd.PotentialPairPolymdPolydisperse(hoomd.context.current.system_definition, self.nlist.cpp_nlist, self.name);
+                self.cpp_class = _polymd.PotentialPairPolymdPolydisperse;
             else:
                 self.nlist.cpp_nlist.setStorageMode(_md.NeighborList.storageMode.full);
                 self.cpp_force = _polymd.PotentialPairPolydisperseGPU(hoomd.context.current.system_definition, self.nlist.cpp_nlist, self.name);
                 self.cpp_class = _polymd.PotentialPairPolydisperseGPU;
         elif (model == "lennardjones"):
             if not hoomd.context.exec_conf.isCUDAEnabled():
-                self.cpp_force = _polymd.PotentialPairPolydisperseLJ(hoomd.context.current.system_definition, self.nlist.cpp_nlist, self.name);
-                self.cpp_class = _polymd.PotentialPairPolydisperseLJ;
+                self.cpp_force = _polymd.PotentialPairPolymdPolydisperseLJ(hoomd.context.current.system_definition, self.nlist.cpp_nlist, self.name);
+                self.cpp_class = _polymd.PotentialPairPolymdPolydisperseLJ;
             else:
                 self.nlist.cpp_nlist.setStorageMode(_md.NeighborList.storageMode.full);
                 self.cpp_force = _polymd.PotentialPairPolydisperseLJGPU(hoomd.context.current.system_definition, self.nlist.cpp_nlist, self.name);
                 self.cpp_class = _polymd.PotentialPairPolydisperseLJGPU;
         elif (model == "polydisperse18"):
             if not hoomd.context.exec_conf.isCUDAEnabled():
-                self.cpp_force = _polymd.PotentialPairPolydisperse18(hoomd.context.current.system_definition, self.nlist.cpp_nlist, self.name);
-                self.cpp_class = _polymd.PotentialPairPolydisperse18;
+                self.cpp_force = _polymd.PotentialPairPolymdPolydisperse18(hoomd.context.current.system_definition, self.nlist.cpp_nlist, self.name);
+                self.cpp_class = _polymd.PotentialPairPolymdPolydisperse18;
             else:
                 self.nlist.cpp_nlist.setStorageMode(_md.NeighborList.storageMode.full);
                 self.cpp_force = _polymd.PotentialPairPolydisperse18GPU(hoomd.context.current.system_definition, self.nlist.cpp_nlist, self.name);
                 self.cpp_class = _polymd.PotentialPairPolydisperse18GPU;
         elif (model == "polydisperse10"):
             if not hoomd.context.exec_conf.isCUDAEnabled():
-                self.cpp_force = _polymd.PotentialPairPolydisperse10(hoomd.context.current.system_definition, self.nlist.cpp_nlist, self.name);
-                self.cpp_class = _polymd.PotentialPairPolydisperse10;
+                self.cpp_force = _polymd.PotentialPairPolymdPolydisperse10(hoomd.context.current.system_definition, self.nlist.cpp_nlist, self.name);
+                self.cpp_class = _polymd.PotentialPairPolymdPolydisperse10;
             else:
                 self.nlist.cpp_nlist.setStorageMode(_md.NeighborList.storageMode.full);
                 self.cpp_force = _polymd.PotentialPairPolydisperse10GPU(hoomd.context.current.system_definition, self.nlist.cpp_nlist, self.name);
                 self.cpp_class = _polymd.PotentialPairPolydisperse10GPU;
         elif (model == "polydisperse106"):
             if not hoomd.context.exec_conf.isCUDAEnabled():
-                self.cpp_force = _polymd.PotentialPairPolydisperseLJ106(hoomd.context.current.system_definition, self.nlist.cpp_nlist, self.name);
-                self.cpp_class = _polymd.PotentialPairPolydisperseLJ106;
+                self.cpp_force = _polymd.PotentialPairPolymdPolydisperseLJ106(hoomd.context.current.system_definition, self.nlist.cpp_nlist, self.name);
+                self.cpp_class = _polymd.PotentialPairPolymdPolydisperseLJ106;
             else:
                 self.nlist.cpp_nlist.setStorageMode(_md.NeighborList.storageMode.full);
                 self.cpp_force = _polymd.PotentialPairPolydisperseLJ106GPU(hoomd.context.current.system_definition, self.nlist.cpp_nlist, self.name);
                 self.cpp_class = _polymd.PotentialPairPolydisperseLJ106GPU;
         hoomd.context.current.system.addCompute(self.cpp_force, self.force_name);
 
+        if not hoomd.context.exec_conf.isCUDAEnabled():
+            self.cpp_force.setNumThreads(int(threads));
+
+        if auto_r_cut:
+            self.cpp_force.setAutoRcut(True);
+            self.auto_r_cut = True;
+
+        if mode == "table":
+            if hoomd.context.exec_conf.isCUDAEnabled():
+                hoomd.context.msg.error("pair.polydisperse: mode=\"table\" is not supported on the GPU\n");
+                raise RuntimeError("Error creating pair.polydisperse");
+            self.cpp_force.setTable(int(table_width), float(table_rmin), float(table_error));
+        elif mode == "discrete":
+            if hoomd.context.exec_conf.isCUDAEnabled():
+                hoomd.context.msg.error("pair.polydisperse: mode=\"discrete\" is not supported on the GPU\n");
+                raise RuntimeError("Error creating pair.polydisperse");
+            self.cpp_force.setDiscrete([float(d) for d in diameters] if diameters is not None else []);
+        elif mode != "exact":
+            hoomd.context.msg.error("pair.polydisperse: unknown mode " + str(mode) + ", expected exact, table or discrete\n");
+            raise RuntimeError("Error creating pair.polydisperse");
+
+        if precision == "mixed":
+            if hoomd.context.exec_conf.isCUDAEnabled():
+                hoomd.context.msg.error("pair.polydisperse: precision=\"mixed\" is not supported on the GPU\n");
+                raise RuntimeError("Error creating pair.polydisperse");
+            self.cpp_force.setMixedPrecision(True);
+        elif precision != "full":
+            hoomd.context.msg.error("pair.polydisperse: unknown precision " + str(precision) + ", expected full or mixed\n");
+            raise RuntimeError("Error creating pair.polydisperse");
+
+        if skip_energy:
+            if hoomd.context.exec_conf.isCUDAEnabled():
+                hoomd.context.msg.error("pair.polydisperse: skip_energy is not supported on the GPU\n");
+                raise RuntimeError("Error creating pair.polydisperse");
+            self.cpp_force.setSkipEnergy(True);
+
+        if accumulation == "fixed":
+            if hoomd.context.exec_conf.isCUDAEnabled():
+                hoomd.context.msg.error("pair.polydisperse: accumulation=\"fixed\" is not supported on the GPU\n");
+                raise RuntimeError("Error creating pair.polydisperse");
+            self.cpp_force.setFixedPoint(True, int(fixed_bits));
+        elif accumulation != "float":
+            hoomd.context.msg.error("pair.polydisperse: unknown accumulation " + str(accumulation) + ", expected float or fixed\n");
+            raise RuntimeError("Error creating pair.polydisperse");
+
         # setup the coefficient options
-        if (model == "polydisperse12"):
-            self.required_coeffs = ['v0', 'eps', 'scaledr_cut'];
-            self.pair_coeff.set_default_coeff('v0', 1.0);
-            self.pair_coeff.set_default_coeff('eps', 0.2);
-            self.pair_coeff.set_default_coeff('scaledr_cut', 1.25);
-        elif (model == "polydisperse18"):
-            self.required_coeffs = ['v0', 'eps', 'scaledr_cut'];
-            self.pair_coeff.set_default_coeff('v0', 1.0);
-            self.pair_coeff.set_default_coeff('eps', 0.0);
-            self.pair_coeff.set_default_coeff('scaledr_cut', 1.25);
-        elif (model == "polydisperse10"):
-            self.required_coeffs = ['v0', 'eps', 'scaledr_cut'];
-            self.pair_coeff.set_default_coeff('v0', 1.0);
-            self.pair_coeff.set_default_coeff('eps', 0.0416667);
-            self.pair_coeff.set_default_coeff('scaledr_cut', 1.48);
-        elif (model == "polydisperse106"):
-            self.required_coeffs = ['v0', 'eps', 'scaledr_cut'];
-            self.pair_coeff.set_default_coeff('v0', 1.0);
-            self.pair_coeff.set_default_coeff('eps', 0.1);
-            self.pair_coeff.set_default_coeff('scaledr_cut', 2.5);
-        elif (model == "lennardjones"):
-            self.required_coeffs = ['v0', 'eps', 'scaledr_cut'];
-            self.pair_coeff.set_default_coeff('v0', 1.0);
-            self.pair_coeff.set_default_coeff('eps', 0.2);
-            self.pair_coeff.set_default_coeff('scaledr_cut', 2.5);
+        self.required_coeffs = ['v0', 'eps', 'scaledr_cut'];
+        if model in _model_params:
+            self.make_params = _model_params[model][0];
+            _set_model_defaults(self.pair_coeff, model);
+    def update_coeffs(self):
+        md_pair.pair.update_coeffs(self);
+
+        # the base class set the placeholder cutoffs, derive them again in get_rcut before the run
+        if self.auto_r_cut:
+            self.cpp_force.setAutoRcut(True);
+
+    def get_rcut(self):
+        if not self.auto_r_cut:
+            return md_pair.pair.get_rcut(self);
+
+        if not self.log:
+            return None;
+
+        # derive the cutoffs from the current diameters and coefficients
+        self.cpp_force.updateAutoRcut();
+        pdata = hoomd.context.current.system_definition.getParticleData();
+        ntypes = pdata.getNTypes();
+        r_cut_dict = nl.rcut();
+        for i in range(0,ntypes):
+            for j in range(i,ntypes):
+                r_cut_dict.set_pair(pdata.getNameByType(i), pdata.getNameByType(j), self.cpp_force.getAutoRcutPair(i, j));
+        return r_cut_dict;
+
+    def get_nlist_sizing(self):
+        R""" Get the cutoffs derived with ``r_cut="auto"``.
+
+        Returns:
+            A dictionary with the cutoff of every type pair (``r_cut``, a dictionary mapping (type_a, type_b) to the
+            cutoff, or -1 for pairs without interaction), the largest diameter (``d_max``) and the expected number of
+            neighbor list entries per particle for a full neighbor list with these cutoffs (``expected_neighbors``).
+
+        Examples::
+
+            poly = polymd.pair.polydisperse(r_cut="auto", nlist=nl, model="polydisperse12")
+            hoomd.run(0)
+            print(poly.get_nlist_sizing())
+
+        """
+        if not self.auto_r_cut:
+            hoomd.context.msg.error("pair.polydisperse: get_nlist_sizing needs r_cut=\"auto\"\n");
+            raise RuntimeError("Error getting the neighbor list sizing");
+
+        self.update_coeffs();
+        self.cpp_force.updateAutoRcut();
+        pdata = hoomd.context.current.system_definition.getParticleData();
+        ntypes = pdata.getNTypes();
+        r_cut = {};
+        for i in range(0,ntypes):
+            for j in range(i,ntypes):
+                r_cut[(pdata.getNameByType(i), pdata.getNameByType(j))] = self.cpp_force.getAutoRcutPair(i, j);
+        return {'r_cut': r_cut,
+                'd_max': self.cpp_force.getAutoDMax(),
+                'expected_neighbors': self.cpp_force.getExpectedNeighbors()};
+
     def process_coeff(self, coeff):
         v0 = coeff['v0'];
         eps = coeff['eps'];
         scaledr_cut = coeff['scaledr_cut'];
-        
-        return _hoomd.make_scalar3(v0,eps,scaledr_cut);
 
+        # the smoothing coefficients only depend on the pair coefficients, evaluate them once here
+        return self.make_params(v0,eps,scaledr_cut);
+
+    def set_threads(self, threads):
+        R""" Change the number of threads used to compute the forces on the CPU.
+
+        Args:
+            threads (int): Number of threads.
+
+        Examples::
+
+            poly.set_threads(4)
+
+        """
+        hoomd.util.print_status_line();
+
+        if hoomd.context.exec_conf.isCUDAEnabled():
+            hoomd.context.msg.warning("pair.polydisperse: set_threads has no effect on the GPU\n");
+            return;
+
+        self.cpp_force.setNumThreads(int(threads));
+
+    def set_work_stealing(self, enabled):
+        R""" Let the threads steal chunks of particles from each other.
+
+        Args:
+            enabled (bool): True to steal work (the default), False to keep every thread on its own range of chunks.
+
+        The chunks are balanced by the neighbor counts, so without stealing the threads are only out of balance where
+        particles with the same number of neighbors cost different times. With stealing, the chunks a thread processes
+        change from step to step, so with a half neighbor list the forces change in the last bits from run to run.
+        Disable it, or use a full neighbor list or ``accumulation="fixed"``, for reproducible runs.
+
+        Examples::
+
+            poly.set_work_stealing(False)
+
+        """
+        hoomd.util.print_status_line();
+
+        if hoomd.context.exec_conf.isCUDAEnabled():
+            hoomd.context.msg.warning("pair.polydisperse: set_work_stealing has no effect on the GPU\n");
+            return;
+
+        self.cpp_force.setWorkStealing(bool(enabled));
+
+    def get_thread_busy_time(self):
+        R""" Get the busy time of every thread in the pair loop.
+
+        Returns:
+            A list with the time in ns that every thread spent in the pair loops since the force was created, the
+            number of threads was changed or :py:meth:`reset_counters` was called, on this rank.
+
+        Examples::
+
+            hoomd.run(1000)
+            busy = poly.get_thread_busy_time()
+            print(max(busy) / (sum(busy) / len(busy)))
+
+        """
+        if hoomd.context.exec_conf.isCUDAEnabled():
+            hoomd.context.msg.error("pair.polydisperse: get_thread_busy_time is not supported on the GPU\n");
+            raise RuntimeError("Error getting the thread busy time");
+        return self.cpp_force.getThreadBusyTimes();
+
+    def set_precision(self, precision):
+        R""" Change the precision of the pair energies and forces on the CPU.
+
+        Args:
+            precision (str): ``"full"`` or ``"mixed"``.
+
+        Examples::
+
+            poly.set_precision("mixed")
+
+        """
+        hoomd.util.print_status_line();
+
+        if precision not in ("full", "mixed"):
+            hoomd.context.msg.error("pair.polydisperse: unknown precision " + str(precision) + ", expected full or mixed\n");
+            raise RuntimeError("Error changing the precision");
+
+        if hoomd.context.exec_conf.isCUDAEnabled():
+            if precision == "mixed":
+                hoomd.context.msg.error("pair.polydisperse: precision=\"mixed\" is not supported on the GPU\n");
+                raise RuntimeError("Error changing the precision");
+            return;
+
+        self.cpp_force.setMixedPrecision(precision == "mixed");
+
+    def set_skip_energy(self, skip_energy):
+        R""" Change whether the pair energies are skipped on steps where they are not requested.
+
+        Args:
+            skip_energy (bool): True to only compute the energies when the potential energy is requested.
+
+        Examples::
+
+            poly.set_skip_energy(False)
+            md.integrate.mode_minimize_fire(dt=0.005)
+
+        """
+        hoomd.util.print_status_line();
+
+        if hoomd.context.exec_conf.isCUDAEnabled():
+            if skip_energy:
+                hoomd.context.msg.warning("pair.polydisperse: skip_energy has no effect on the GPU\n");
+            return;
+
+        self.cpp_force.setSkipEnergy(bool(skip_energy));
+
+    def set_accumulation(self, accumulation, fixed_bits=32):
+        R""" Change how the pair contributions are summed on the CPU.
+
+        Args:
+            accumulation (str): ``"float"`` or ``"fixed"``.
+            fixed_bits (int): Number of fraction bits of the fixed point sums, between 16 and 48.
+
+        Examples::
+
+            poly.set_accumulation("fixed", fixed_bits=36)
+
+        """
+        hoomd.util.print_status_line();
+
+        if accumulation not in ("float", "fixed"):
+            hoomd.context.msg.error("pair.polydisperse: unknown accumulation " + str(accumulation) + ", expected float or fixed\n");
+            raise RuntimeError("Error changing the accumulation");
+
+        if hoomd.context.exec_conf.isCUDAEnabled():
+            if accumulation == "fixed":
+                hoomd.context.msg.error("pair.polydisperse: accumulation=\"fixed\" is not supported on the GPU\n");
+                raise RuntimeError("Error changing the accumulation");
+            return;
+
+        self.cpp_force.setFixedPoint(accumulation == "fixed", int(fixed_bits));
+
+    def get_table_error(self):
+        R""" Get the largest error of the spline tables.
+
+        Returns:
+            The largest error of the energy and force over all type pairs, relative to :math:`\max(|V|, v_0)`, or 0 when
+            the tables are not used.
+        """
+        if hoomd.context.exec_conf.isCUDAEnabled():
+            return 0.0;
+        self.update_coeffs();
+        return self.cpp_force.getTableError();
+
+    def get_counters(self):
+        R""" Get the counters of the pair loop.
+
+        Returns:
+            A dictionary with the neighbor list entries visited, the pairs evaluated inside the cutoff, the pairs
+            rejected by the cutoff, the cutoff efficiency (evaluated over visited), the time of the pair loop in ns,
+            the busy time of the slowest thread over the mean busy time and the number of chunks stolen by the threads
+            in the last force compute (``visited``, ``evaluated``, ``rejected``, ``cutoff_efficiency``, ``time_ns``,
+            ``thread_imbalance``, ``steals``), and the totals since the force was created or :py:meth:`reset_counters`
+            was called (``total_visited``, ``total_evaluated``, ``total_rejected``, ``total_time_ns``,
+            ``total_thread_imbalance``, ``total_steals``, ``computes``). With MPI, the counts are summed over the ranks
+            and the time and imbalance are the largest of the ranks.
+
+        A low cutoff efficiency means that *r_buff* or *d_max* make the neighbor list much longer than needed.
+
+        Examples::
+
+            hoomd.run(1000)
+            c = poly.get_counters()
+            print(c['cutoff_efficiency'], c['total_time_ns'] / c['computes'])
+
+        """
+        if hoomd.context.exec_conf.isCUDAEnabled():
+            hoomd.context.msg.error("pair.polydisperse: get_counters is not supported on the GPU\n");
+            raise RuntimeError("Error getting the counters");
+        return self.cpp_force.getCounters();
+
+    def reset_counters(self):
+        R""" Reset the total counters of the pair loop.
+        """
+        hoomd.util.print_status_line();
+        if not hoomd.context.exec_conf.isCUDAEnabled():
+            self.cpp_force.resetCounters();
+
+    def get_energy(self, rebuild_nlist=False):
+        R""" Compute the total potential energy of this force without computing the forces.
+
+        Args:
+            rebuild_nlist (bool): Rebuild the neighbor list first. Set it when the particles were moved outside of
+                                  :py:func:`hoomd.run`, e.g. by a line search through snapshots.
+
+        Returns:
+            The potential energy of the current configuration, summed over all particles (in energy units).
+
+        Only the pair energies are evaluated, the forces and virials of the last time step are left as they were, which
+        makes this cheaper than a force evaluation for line searches and Monte Carlo tests. The energy is always
+        evaluated exactly, also in table and mixed precision mode. Call it after the simulation has been set up with
+        :py:func:`hoomd.run`, e.g. ``hoomd.run(0)``.
+
+        Examples::
+
+            hoomd.run(0)
+            e0 = poly.get_energy()
+            system.restore_snapshot(trial)
+            e1 = poly.get_energy(rebuild_nlist=True)
+
+        """
+        if hoomd.context.exec_conf.isCUDAEnabled():
+            hoomd.context.msg.error("pair.polydisperse: get_energy is not supported on the GPU\n");
+            raise RuntimeError("Error computing the energy");
+
+        self.update_coeffs();
+        if rebuild_nlist:
+            self.nlist.cpp_nlist.forceUpdate();
+        return self.cpp_force.computeEnergy(hoomd.context.current.system.getCurrentTimeStep());
+
+    def get_energies(self, rebuild_nlist=False):
+        R""" Compute the potential energy of every particle without computing the forces.
+
+        Args:
+            rebuild_nlist (bool): Rebuild the neighbor list first, see :py:meth:`get_energy`.
+
+        Returns:
+            A list of the potential energies of all particles, indexed by tag. Every pair contributes half of its energy
+            to each of its particles.
+
+        See :py:meth:`get_energy`.
+        """
+        if hoomd.context.exec_conf.isCUDAEnabled():
+            hoomd.context.msg.error("pair.polydisperse: get_energies is not supported on the GPU\n");
+            raise RuntimeError("Error computing the energies");
+
+        self.update_coeffs();
+        if rebuild_nlist:
+            self.nlist.cpp_nlist.forceUpdate();
+        return self.cpp_force.computeEnergies(hoomd.context.current.system.getCurrentTimeStep());
+
+    def get_polydisperse_range(self):
+        R""" Get the reduced cutoff and non-additivity of each type pair.
+
+        Returns:
+            A dictionary mapping (type_a, type_b) to (scaledr_cut, eps), used by :py:class:`hoomd.polymd.nlist.diameter_class`
+            to search out to the true range of each pair.
+        """
+        ntypes = hoomd.context.current.system_definition.getParticleData().getNTypes();
+        type_list = [];
+        for i in range(0,ntypes):
+            type_list.append(hoomd.context.current.system_definition.getParticleData().getNameByType(i));
+
+        ranges = {};
+        for i in range(0,ntypes):
+            for j in range(i,ntypes):
+                scaledr_cut = self.pair_coeff.get(type_list[i], type_list[j], 'scaledr_cut');
+                eps = self.pair_coeff.get(type_list[i], type_list[j], 'eps');
+                if scaledr_cut is None or eps is None:
+                    continue;
+                ranges[(type_list[i], type_list[j])] = (float(scaledr_cut), float(eps));
+        return ranges;
+
+class composite(md_pair.pair):
+    R""" Several polydisperse pair potentials evaluated in one pass over the neighbor list.
+
+    Args:
+        r_cut (float): Default cutoff radius (in distance units), as for :py:class:`polydisperse`.
+        nlist (:py:mod:`hoomd.md.nlist`): Neighbor list
+        models: List of model names, or a dictionary mapping component names to model names, for several components
+            of the same model. The models are the ones of :py:class:`polydisperse`.
+        name (str): Name of the force instance.
+        d_max (float): Largest diameter for the neighbor list, the largest diameter of the particles when None.
+        threads (int): Number of threads.
+        accumulation (str): ``"float"``, or ``"fixed"`` for sums that do not depend on the number of threads, see
+            :py:class:`polydisperse`.
+        fixed_bits (int): Number of fraction bits of the fixed point sums.
+
+    Adding a :py:class:`polydisperse` force per model (e.g. a ``polydisperse12`` core on all type pairs and a
+    ``lennardjones`` attraction on some of them) makes each of them walk the neighbor list and gather the neighbors of
+    every particle. :py:class:`composite` holds all of them as components with their own *v0*, *eps* and
+    *scaledr_cut* per type pair, gathers the neighbors once, runs the kernel of every component on them and sums the
+    forces, energies and virials in one pass. Set *v0* to 0 to leave out a type pair in a component.
+
+    The coefficients of each component are set with :py:meth:`set_coeff` or its :py:class:`hoomd.md.pair.coeff` in
+    ``component_coeff``, with the defaults of the model. The energy of the force is logged as
+    ``pair_composite_energy`` and the energy of every component as ``pair_composite_<component>_energy``, with the
+    suffix ``_name`` when *name* is given.
+
+    The threads split the particles and steal work from each other as in :py:class:`polydisperse`, see
+    :py:meth:`set_work_stealing` and :py:meth:`get_thread_busy_time`.
+
+    :py:class:`composite` is only available on the CPU.
+
+    Examples::
+
+        both = polymd.pair.composite(r_cut=2.5, nlist=nl, models=['polydisperse12', 'lennardjones'])
+        both.set_coeff('polydisperse12', 'A', 'A', v0=1.0, eps=0.2, scaledr_cut=1.25)
+        both.set_coeff('lennardjones', 'A', 'A', v0=0.0)
+        both.set_coeff('lennardjones', 'A', 'B', v0=0.5, eps=0.1, scaledr_cut=2.5)
+
+        two = polymd.pair.composite(r_cut=2.5, nlist=nl, models={'core': 'polydisperse12', 'tail': 'polydisperse106'})
+
+    """
+    def __init__(self, r_cut, nlist, models, name=None, d_max = None, threads=1, accumulation="float", fixed_bits=32):
+        hoomd.util.print_status_line();
+
+        if hoomd.context.exec_conf.isCUDAEnabled():
+            hoomd.context.msg.error("pair.composite is not supported on the GPU\n");
+            raise RuntimeError("Error creating pair.composite");
+
+        if isinstance(models, dict):
+            components = list(models.items());
+        else:
+            components = [(model, model) for model in models];
+        if len(components) == 0:
+            hoomd.context.msg.error("pair.composite: at least one model is needed\n");
+            raise RuntimeError("Error creating pair.composite");
+        for component, model in components:
+            if not self._check_model(model):
+                hoomd.context.msg.error("pair.composite: unknown model " + str(model) + "\n");
+                raise RuntimeError("Error creating pair.composite");
+
+        # initialize the base class
+        md_pair.pair.__init__(self, r_cut, nlist, name);
+
+        # update the neighbor list
+        if d_max is None :
+            sysdef = hoomd.context.current.system_definition;
+            d_max = sysdef.getParticleData().getMaxDiameter()
+            hoomd.context.msg.notice(2, "Notice: composite set d_max=" + str(d_max) + "\n");
+
+        self.nlist.cpp_nlist.setDiameterShift(True);
+        self.nlist.cpp_nlist.setMaximumDiameter(d_max);
+
+        # create the c++ mirror class
+        self.cpp_force = _polymd.PotentialPairPolymdComposite(hoomd.context.current.system_definition, self.nlist.cpp_nlist, self.name);
+        self.cpp_class = _polymd.PotentialPairPolymdComposite;
+        hoomd.context.current.system.addCompute(self.cpp_force, self.force_name);
+        self.cpp_force.setNumThreads(int(threads));
+
+        if accumulation not in ("float", "fixed"):
+            hoomd.context.msg.error("pair.composite: unknown accumulation " + str(accumulation) + ", expected float or fixed\n");
+            raise RuntimeError("Error creating pair.composite");
+        self.cpp_force.setFixedPoint(accumulation == "fixed", int(fixed_bits));
+
+        # setup the coefficient options of every component
+        self.required_coeffs = ['v0', 'eps', 'scaledr_cut'];
+        self.components = [];
+        self.models = {};
+        self.component_coeff = {};
+        for component, model in components:
+            self._add_component(component, model);
+            self.components.append(component);
+            self.models[component] = model;
+
+    def _check_model(self, model):
+        return model in _model_params;
+
+    def _add_component(self, component, model):
+        self.cpp_force.addComponent(str(component), model);
+        self.component_coeff[component] = md_pair.coeff();
+        _set_model_defaults(self.component_coeff[component], model);
+
+    def _make_params(self, component, v0, eps, scaledr_cut):
+        return _model_params[self.models[component]][0](v0, eps, scaledr_cut);
+
+    def set_coeff(self, component, a, b, **coeffs):
+        R""" Set the coefficients of a component for a type pair.
+
+        Args:
+            component (str): Name of the component.
+            a (str): First particle type in the pair (or a list of type names).
+            b (str): Second particle type in the pair (or a list of type names).
+            coeffs: Named coefficients *v0*, *eps* and *scaledr_cut*.
+
+        Examples::
+
+            both.set_coeff('lennardjones', 'A', 'B', v0=0.5, eps=0.1, scaledr_cut=2.5)
+
+        """
+        hoomd.util.print_status_line();
+
+        if component not in self.component_coeff:
+            hoomd.context.msg.error("pair.composite: unknown component " + str(component) + "\n");
+            raise RuntimeError("Error setting pair coefficients");
+
+        hoomd.util.quiet_status();
+        self.component_coeff[component].set(a, b, **coeffs);
+        hoomd.util.unquiet_status();
+
+    def update_coeffs(self):
+        ntypes = hoomd.context.current.system_definition.getParticleData().getNTypes();
+        type_list = [];
+        for i in range(0,ntypes):
+            type_list.append(hoomd.context.current.system_definition.getParticleData().getNameByType(i));
+
+        for index, component in enumerate(self.components):
+            coeff = self.component_coeff[component];
+            if not coeff.verify(self.required_coeffs):
+                hoomd.context.msg.error("Not all pair coefficients are set for component " + str(component) + "\n");
+                raise RuntimeError("Error updating pair coefficients");
+
+            for i in range(0,ntypes):
+                for j in range(i,ntypes):
+                    v0 = coeff.get(type_list[i], type_list[j], 'v0');
+                    eps = coeff.get(type_list[i], type_list[j], 'eps');
+                    scaledr_cut = coeff.get(type_list[i], type_list[j], 'scaledr_cut');
+                    self.cpp_force.setParams(index, i, j, self._make_params(component, v0, eps, scaledr_cut));
+
+    def set_work_stealing(self, enabled):
+        R""" Let the threads steal chunks of particles from each other.
+
+        Args:
+            enabled (bool): True to steal work (the default), False to keep every thread on its own range of chunks.
+
+        See :py:meth:`polydisperse.set_work_stealing`.
+        """
+        hoomd.util.print_status_line();
+        self.cpp_force.setWorkStealing(bool(enabled));
+
+    def get_thread_busy_time(self):
+        R""" Get the busy time of every thread in the pair loop.
+
+        Returns:
+            A list with the time in ns that every thread spent in the pair loop since the force was created or the
+            number of threads was changed, on this rank.
+        """
+        return self.cpp_force.getThreadBusyTimes();
+
+    def get_polydisperse_range(self):
+        R""" Get the reduced cutoff and non-additivity of each type pair.
+
+        Returns:
+            A dictionary mapping (type_a, type_b) to (scaledr_cut, eps), the largest reduced cutoff and the smallest
+            non-additivity of the components that act on the pair, used by :py:class:`hoomd.polymd.nlist.diameter_class`
+            to search out to the longest range of each pair.
+        """
+        ntypes = hoomd.context.current.system_definition.getParticleData().getNTypes();
+        type_list = [];
+        for i in range(0,ntypes):
+            type_list.append(hoomd.context.current.system_definition.getParticleData().getNameByType(i));
+
+        ranges = {};
+        for component in self.components:
+            coeff = self.component_coeff[component];
+            for i in range(0,ntypes):
+                for j in range(i,ntypes):
+                    v0 = coeff.get(type_list[i], type_list[j], 'v0');
+                    scaledr_cut = coeff.get(type_list[i], type_list[j], 'scaledr_cut');
+                    eps = coeff.get(type_list[i], type_list[j], 'eps');
+                    if v0 is None or scaledr_cut is None or eps is None or float(v0) == 0.0:
+                        continue;
+                    pair = (type_list[i], type_list[j]);
+                    if pair in ranges:
+                        ranges[pair] = (max(ranges[pair][0], float(scaledr_cut)), min(ranges[pair][1], float(eps)));
+                    else:
+                        ranges[pair] = (float(scaledr_cut), float(eps));
+        return ranges;
+
+class polydisperse_jit(composite):
+    R""" Polydisperse pair potential with any exponents, compiled when the script runs.
+
+    Args:
+        r_cut (float): Default cutoff radius (in distance units), as for :py:class:`polydisperse`.
+        nlist (:py:mod:`hoomd.md.nlist`): Neighbor list
+        m (int): Exponent of the repulsive term.
+        n (int): Exponent of the attractive term, 0 for a purely repulsive potential.
+        q (int): Order of the smoothing polynomial, 1 to 4.
+        name (str): Name of the force instance.
+        d_max (float): Largest diameter for the neighbor list, the largest diameter of the particles when None.
+        threads (int): Number of threads.
+        compiler (str): C++ compiler, ``clang++`` when found in the path, else ``$CXX`` or ``c++``.
+        flags (list): Optimization flags, ``['-O3', '-march=native']`` when None.
+        cache_dir (str): Directory of the compiled kernels, ``$POLYMD_JIT_CACHE`` or ``~/.cache/polymd/jit`` when None.
+        accumulation (str): ``"float"`` or ``"fixed"``, see :py:class:`polydisperse`.
+        fixed_bits (int): Number of fraction bits of the fixed point sums.
+
+    :py:class:`polydisperse_jit` evaluates
+
+    .. math::
+
+        V(r) = v_0 \left[ \left( \frac{\sigma_{ij}}{r} \right)^{m} - \left( \frac{\sigma_{ij}}{r} \right)^{n} \right]
+               + \sum_{k=0}^{q} c_k \left( \frac{r}{\sigma_{ij}} \right)^{2k}
+
+    like the models of :py:class:`polydisperse` (``polydisperse12`` is *m* = 12, *n* = 0, *q* = 2), for exponents that
+    are not built in. The batch kernel of the model is generated from the same template, compiled with *compiler* and
+    *flags* into a shared library and loaded into the process. The library is cached in *cache_dir* under a hash of
+    the source, the compiler, the flags and the CPU, so only the first run with a new model pays for the compilation
+    (about a second). Sweeps over the exponents then run at the speed of the built in models without a rebuild. With
+    MPI, the root rank compiles first, and the other ranks load its library when *cache_dir* is on a shared file
+    system.
+
+    The compilation needs the HOOMD headers installed with the python package, and the kernel is built for the
+    precision of HOOMD. The coefficients *v0* (default 1), *eps* (default 0) and *scaledr_cut* are set with
+    ``pair_coeff`` as for :py:class:`polydisperse`. The forces are computed by :py:class:`composite` with a single
+    component, so the energy is logged as ``pair_composite_energy``. :py:class:`polydisperse_jit` is only available
+    on the CPU.
+
+    Examples::
+
+        poly14 = polymd.pair.polydisperse_jit(r_cut=1.5, nlist=nl, m=14, n=0, q=2, threads=4)
+        poly14.pair_coeff.set('A', 'A', v0=1.0, eps=0.2, scaledr_cut=1.25)
+
+        for m in [8, 10, 12, 14, 16]:
+            pot = polymd.pair.polydisperse_jit(r_cut=2.5, nlist=nl, m=m, n=m//2, q=2)
+            ...
+
+    """
+    def __init__(self, r_cut, nlist, m, n=0, q=2, name=None, d_max = None, threads=1, compiler=None, flags=None, cache_dir=None, accumulation="float", fixed_bits=32):
+        hoomd.util.print_status_line();
+
+        m = int(m);
+        n = int(n);
+        q = int(q);
+        if not _polymd.is_valid_polydisperse_mnq(m, n, q):
+            hoomd.context.msg.error("pair.polydisperse_jit: the exponents must satisfy m > n >= 0, m <= 64 and 1 <= q <= 4\n");
+            raise RuntimeError("Error creating pair.polydisperse_jit");
+
+        if compiler is None:
+            compiler = shutil.which('clang++') or os.environ.get('CXX', 'c++');
+        if flags is None:
+            flags = ['-O3', '-march=native'];
+        if cache_dir is None:
+            cache_dir = os.environ.get('POLYMD_JIT_CACHE', os.path.join(os.path.expanduser('~'), '.cache', 'polymd', 'jit'));
+
+        self.m = m;
+        self.n = n;
+        self.q = q;
+        self.compiler = compiler;
+        self.flags = list(flags);
+        self.cache_dir = cache_dir;
+
+        hoomd.util.quiet_status();
+        composite.__init__(self, r_cut, nlist, {'polydisperse_%d_%d_%d' % (m, n, q): (m, n, q)}, name=name, d_max=d_max,
+                           threads=threads, accumulation=accumulation, fixed_bits=fixed_bits);
+        hoomd.util.unquiet_status();
+
+    def _check_model(self, model):
+        return isinstance(model, tuple) and len(model) == 3;
+
+    def _add_component(self, component, model):
+        m, n, q = model;
+
+        # compile on the root rank first, so that the others find the library in a shared cache
+        library = '';
+        error = None;
+        if hoomd.comm.get_rank() == 0:
+            try:
+                library = _compile_jit_kernel(m, n, q, self.compiler, self.flags, self.cache_dir);
+            except (RuntimeError, OSError) as e:
+                error = e;
+
+        # every rank learns whether the root succeeded, so that a failure raises everywhere instead of hanging the others
+        if _polymd.broadcast_polydisperse_jit_library(library, hoomd.context.exec_conf) == '':
+            if error is not None:
+                raise error;
+            hoomd.context.msg.error("pair.polydisperse_jit: compiling the kernel failed on the root rank\n");
+            raise RuntimeError("Error compiling pair.polydisperse_jit");
+        if hoomd.comm.get_rank() != 0:
+            library = _compile_jit_kernel(m, n, q, self.compiler, self.flags, self.cache_dir);
+
+        self.cpp_force.addJITComponent(str(component), library, m, n, q);
+        self.library = library;
+
+        # the only component takes its coefficients from pair_coeff, like polydisperse
+        self.component_coeff[component] = self.pair_coeff;
+        self.pair_coeff.set_default_coeff('v0', 1.0);
+        self.pair_coeff.set_default_coeff('eps', 0.0);
+
+    def _make_params(self, component, v0, eps, scaledr_cut):
+        m, n, q = self.models[component];
+        return _polymd.make_polydisperse_mnq_params(m, n, q, v0, eps, scaledr_cut);
@@ -0,0 +1,209 @@
+# Copyright (c) 2009-2019 The Regents of the University of Michigan
+# This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+R""" Many replicas in one process.
+
+Run hundreds of small polydisperse systems, e.g. for parallel tempering or statistics over many glass samples, in one
+process without a simulation context.
+"""
+
+from hoomd.polymd import _polymd
+from hoomd.polymd import pair
+
+class ensemble(object):
+    R""" Replicas of a small polydisperse system.
+
+    Args:
+        model (str): Model, as in :py:class:`hoomd.polymd.pair.polydisperse`.
+        replicas (int): Number of replicas.
+        N (int): Number of particles of every replica.
+        types (list): Names of the particle types, shared by all replicas.
+        dimensions (int): 2 or 3.
+        r_buff (float): Buffer of the Verlet lists.
+        threads (int): Number of threads.
+
+    All replicas have the same number of particles, types and model, but their own box, positions, diameters and
+    velocities. They are kept in one array and evaluated together: every force computation sweeps over the particles
+    of all replicas at once, split over the threads by neighbor counts as in
+    :py:meth:`hoomd.polymd.pair.polydisperse.set_num_threads`, which keeps all threads busy even when every replica
+    alone is far too small to. Every replica has its own Verlet list, rebuilt when one of its particles moved by more
+    than half of *r_buff*.
+
+    :py:meth:`run` integrates all replicas with velocity Verlet and unit masses, optionally coupled to a Langevin
+    thermostat (:py:meth:`set_langevin`). For parallel tempering, every replica sits in a slot and every slot has a
+    temperature (:py:meth:`set_temperatures`). :py:meth:`exchange` attempts swaps of neighboring slots, alternating
+    between the even and odd pairs, with the acceptance probability min(1, exp((1/kT_a - 1/kT_b)(U_a - U_b))). A swap
+    only changes which slot a replica is in and rescales its velocities to the new temperature, the replica keeps its
+    index. Replica *i* starts in slot *i*.
+
+    All pairs of types interact with the defaults of the model until :py:meth:`set_coeff` changes them. The box must
+    be at least twice the largest cutoff plus *r_buff* wide. The results do not depend on the number of threads.
+
+    Examples::
+
+        ens = polymd.replica.ensemble('polydisperse12', replicas=64, N=1000, threads=8)
+        for r in range(64):
+            ens.set_replica(r, box=[L, L, L], position=pos[r], diameter=diam[r])
+        ens.set_temperatures([0.05 * 1.05**s for s in range(64)])
+        ens.set_langevin(gamma=1.0, seed=7)
+        for cycle in range(1000):
+            ens.run(100, dt=0.005)
+            ens.exchange()
+        print(ens.get_permutation(), ens.get_energy())
+
+    """
+    def __init__(self, model, replicas, N, types=['A'], dimensions=3, r_buff=0.3, threads=1):
+        if model not in pair._model_params:
+            raise RuntimeError("replica.ensemble: unknown model " + str(model));
+        if dimensions not in (2, 3):
+            raise RuntimeError("replica.ensemble: dimensions must be 2 or 3");
+
+        self.model = model;
+        self.types = list(types);
+        self.cpp_replicas = _polymd.PolymdReplicas(model, int(replicas), int(N), len(self.types), int(dimensions));
+        self.cpp_replicas.setBuffer(float(r_buff));
+        self.cpp_replicas.setNumThreads(int(threads));
+
+        make_params, v0, eps, scaledr_cut = pair._model_params[model];
+        for i in range(0,len(self.types)):
+            for j in range(i,len(self.types)):
+                self.cpp_replicas.setParams(i, j, v0, eps, scaledr_cut);
+
+    def _type_id(self, name):
+        if name not in self.types:
+            raise RuntimeError("replica.ensemble: unknown type " + str(name));
+        return self.types.index(name);
+
+    def set_coeff(self, a, b, v0=None, eps=None, scaledr_cut=None):
+        R""" Set the coefficients of a pair of types.
+
+        Args:
+            a (str): First type.
+            b (str): Second type.
+            v0 (float): Energy scale, 0 to leave out the pair.
+            eps (float): Non-additivity of the pair diameter.
+            scaledr_cut (float): Cutoff radius in units of sigma_ij.
+
+        The coefficients that are not given take the defaults of the model.
+        """
+        make_params, v0_default, eps_default, scaledr_cut_default = pair._model_params[self.model];
+        if v0 is None:
+            v0 = v0_default;
+        if eps is None:
+            eps = eps_default;
+        if scaledr_cut is None:
+            scaledr_cut = scaledr_cut_default;
+        self.cpp_replicas.setParams(self._type_id(a), self._type_id(b), float(v0), float(eps), float(scaledr_cut));
+
+    def set_replica(self, replica, box, position, diameter, typeid=None, velocity=None):
+        R""" Set the configuration of a replica.
+
+        Args:
+            replica (int): Replica index.
+            box (list): Lx, Ly, Lz and optionally the tilt factors xy, xz, yz.
+            position: N positions, e.g. a numpy array of shape (N, 3). In 2D, z is ignored.
+            diameter: N diameters.
+            typeid: N type indices into *types*, None for all of the first type.
+            velocity: N velocities, None to keep the current ones.
+
+        The positions are wrapped into the box and their images are reset.
+        """
+        N = self.cpp_replicas.getN();
+        pos = [float(x) for p in position for x in p];
+        if typeid is None:
+            typeid = [0] * N;
+        self.cpp_replicas.setReplica(int(replica), [float(x) for x in box], pos, [float(d) for d in diameter],
+                                     [int(t) for t in typeid]);
+        if velocity is not None:
+            self.cpp_replicas.setVelocities(int(replica), [float(x) for v in velocity for x in v]);
+
+    def set_temperatures(self, kT):
+        R""" Set the temperature of every slot.
+
+        Args:
+            kT (list): One temperature per slot, usually increasing.
+        """
+        self.cpp_replicas.setTemperatures([float(t) for t in kT]);
+
+    def set_langevin(self, gamma, seed):
+        R""" Couple all replicas to a Langevin thermostat at the temperature of their slot.
+
+        Args:
+            gamma (float): Drag coefficient, 0 for NVE.
+            seed (int): Seed of the thermostat and of the exchanges.
+        """
+        self.cpp_replicas.setLangevin(float(gamma), int(seed));
+
+    def run(self, steps, dt):
+        R""" Integrate all replicas.
+
+        Args:
+            steps (int): Number of steps.
+            dt (float): Time step.
+        """
+        self.cpp_replicas.run(int(steps), float(dt));
+
+    def compute(self):
+        R""" Compute the forces, energies and pressures of all replicas at their current positions.
+        """
+        self.cpp_replicas.compute();
+
+    def exchange(self):
+        R""" Attempt swaps of neighboring slots.
+
+        Returns:
+            The number of accepted swaps.
+        """
+        return self.cpp_replicas.exchange();
+
+    def swap(self, a, b):
+        R""" Swap the replicas of two slots unconditionally.
+
+        Args:
+            a (int): First slot.
+            b (int): Second slot.
+        """
+        self.cpp_replicas.swapSlots(int(a), int(b));
+
+    def get_permutation(self):
+        R""" Get the replica in every slot.
+        """
+        return list(self.cpp_replicas.getReplicaOfSlot());
+
+    def get_energy(self):
+        R""" Get the potential energy of every replica, by replica index.
+        """
+        return list(self.cpp_replicas.getEnergies());
+
+    def get_pressure(self):
+        R""" Get the configurational pressure tensor W/V of every replica, xx, xy, xz, yy, yz, zz.
+        """
+        p = self.cpp_replicas.getPressures();
+        return [list(p[6*r:6*r+6]) for r in range(0,len(p)//6)];
+
+    def _per_particle(self, values, width):
+        try:
+            import numpy;
+        except ImportError:
+            return [list(values[width*i:width*i+width]) for i in range(0,len(values)//width)];
+        return numpy.array(values).reshape(-1, width);
+
+    def get_positions(self, replica):
+        R""" Get the positions of a replica, wrapped into its box, as an (N, 3) array.
+        """
+        return self._per_particle(self.cpp_replicas.getPositions(int(replica)), 3);
+
+    def get_images(self, replica):
+        R""" Get the images of a replica as an (N, 3) array.
+        """
+        return self._per_particle(self.cpp_replicas.getImages(int(replica)), 3);
+
+    def get_velocities(self, replica):
+        R""" Get the velocities of a replica as an (N, 3) array.
+        """
+        return self._per_particle(self.cpp_replicas.getVelocities(int(replica)), 3);
+
+    def get_forces(self, replica):
+        R""" Get the forces of a replica from the last computation as an (N, 3) array.
+        """
+        return self._per_particle(self.cpp_replicas.getForces(int(replica)), 3);
@@ -0,0 +1,82 @@
+# Copyright (c) 2009-2019 The Regents of the University of Michigan
+# This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+R""" Re-evaluation of trajectories.
+
+Evaluate a polydisperse model over the frames of a GSD trajectory after a run, without a simulation context.
+"""
+
+from hoomd.polymd import _polymd
+from hoomd.polymd import pair
+
+def evaluate(filename, model, output, coeffs=None, first=0, last=None, stride=1, threads=1, per_particle=False):
+    R""" Evaluate the potential energy and pressure tensor of every frame of a GSD trajectory.
+
+    Args:
+        filename (str): GSD trajectory, e.g. written by :py:class:`hoomd.dump.gsd`.
+        model (str): Model, as in :py:class:`hoomd.polymd.pair.polydisperse`.
+        output (str): Prefix of the output files.
+        coeffs (dict): Maps (type_a, type_b) to a dictionary of *v0*, *eps* and *scaledr_cut*. Missing pairs and
+            coefficients take the defaults of the model.
+        first (int): First frame to evaluate.
+        last (int): One past the last frame to evaluate, None for the end of the trajectory.
+        stride (int): Evaluate every *stride*-th frame.
+        threads (int): Number of threads, each evaluates whole frames.
+        per_particle (bool): Also write the energy of every particle. The number of particles must not change.
+
+    Returns:
+        A dictionary of numpy arrays with the frame indices (``frame``), the potential energy (``energy``), the
+        configurational part of the pressure tensor (``pressure``, W/V in the order xx, xy, xz, yy, yz, zz, i.e.
+        ``pressure_xx`` etc. of :py:class:`hoomd.analyze.log` without the kinetic part) and, with *per_particle*, the
+        per particle energies (``energies``, one row per frame). The arrays are memory mapped from the files
+        ``<output>_frame.npy``, ``<output>_energy.npy``, ``<output>_pressure.npy`` and ``<output>_energies.npy``.
+        Without numpy, the file names are returned instead.
+
+    The frames are read from a memory map of the file and evaluated with a cell list of their own, so no simulation
+    context is needed and the frames are evaluated in parallel. The model and coefficients need not be those of the
+    run. Chunks missing in a frame are taken from frame 0, as in HOOMD. The box must be at least twice the largest
+    cutoff wide. The executable ``polymd_rerun``, installed next to this module, does the same from the command line.
+
+    Examples::
+
+        res = polymd.rerun.evaluate('dump.gsd', 'polydisperse12', 'dump_rerun', threads=8)
+        res = polymd.rerun.evaluate('dump.gsd', 'polydisperse12', 'dump_rerun',
+                                    coeffs={('A', 'A'): dict(eps=0.1)}, per_particle=True)
+        print(res['energy'].mean(), res['pressure'][:, 0].mean())
+
+    """
+    if model not in pair._model_params:
+        raise RuntimeError("rerun.evaluate: unknown model " + str(model));
+
+    rerun = _polymd.PolymdRerun(filename, model);
+    rerun.setNumThreads(int(threads));
+
+    if coeffs is None:
+        coeffs = {};
+    make_params, v0, eps, scaledr_cut = pair._model_params[model];
+    defaults = dict(v0=v0, eps=eps, scaledr_cut=scaledr_cut);
+
+    # every pair of the types of the first frame, with the given coefficients over the defaults
+    n_frames = rerun.getNumFrames();
+    if n_frames == 0:
+        raise RuntimeError("rerun.evaluate: " + str(filename) + " has no frames");
+    types = rerun.getTypes(min(first, n_frames - 1));
+    for i in range(0,len(types)):
+        for j in range(i,len(types)):
+            coeff = dict(defaults);
+            coeff.update(coeffs.get((types[i], types[j]), coeffs.get((types[j], types[i]), {})));
+            rerun.setParams(types[i], types[j], float(coeff['v0']), float(coeff['eps']), float(coeff['scaledr_cut']));
+
+    if last is None:
+        last = n_frames;
+    rerun.run(output, int(first), int(last), int(stride), bool(per_particle));
+
+    files = {'frame': output + '_frame.npy', 'energy': output + '_energy.npy', 'pressure': output + '_pressure.npy'};
+    if per_particle:
+        files['energies'] = output + '_energies.npy';
+
+    try:
+        import numpy;
+    except ImportError:
+        return files;
+    return dict((key, numpy.load(name, mmap_mode='r')) for key, name in files.items());
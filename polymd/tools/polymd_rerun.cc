@@ -0,0 +1,143 @@
+// Copyright (c) 2009-2019 The Regents of the University of Michigan
+// This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+
+// Maintainer: joaander
+
+/*! \file polymd_rerun.cc
+    \brief Re-evaluates a polydisperse model over the frames of a GSD trajectory
+
+    Command line front end of PolymdRerun, without a HOOMD runtime or Python. The coefficients of all type pairs
+    default to those of pair.polydisperse for the model, -c changes them for all pairs (v0,eps,scaledr_cut) or for one
+    pair (A,B,v0,eps,scaledr_cut) and can be repeated.
+
+    Usage: polymd_rerun [-m model] [-c [A,B,]v0,eps,scaledr_cut] [-f first] [-l last] [-s stride] [-t threads] [-p]
+                        [-o prefix] trajectory.gsd
+*/
+
+#include "PolymdRerun.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//! Split a comma separated list
+static std::vector<std::string> split(const std::string& list)
+    {
+    std::vector<std::string> items;
+    std::istringstream s(list);
+    std::string item;
+    while (std::getline(s, item, ','))
+        items.push_back(item);
+    return items;
+    }
+
+int main(int argc, char **argv)
+    {
+    std::string model = "polydisperse12";
+    std::string prefix = "rerun";
+    std::vector<std::string> coeffs;
+    uint64_t first = 0;
+    uint64_t last = std::numeric_limits<uint64_t>::max();
+    uint64_t stride = 1;
+    unsigned int threads = 1;
+    bool per_particle = false;
+    const char *filename = NULL;
+
+    for (int i = 1; i < argc; ++i)
+        {
+        if (!strcmp(argv[i], "-m") && i+1 < argc)
+            model = argv[++i];
+        else if (!strcmp(argv[i], "-c") && i+1 < argc)
+            coeffs.push_back(argv[++i]);
+        else if (!strcmp(argv[i], "-f") && i+1 < argc)
+            first = strtoull(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-l") && i+1 < argc)
+            last = strtoull(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-s") && i+1 < argc)
+            stride = strtoull(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-t") && i+1 < argc)
+            threads = (unsigned int)std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "-p"))
+            per_particle = true;
+        else if (!strcmp(argv[i], "-o") && i+1 < argc)
+            prefix = argv[++i];
+        else if (argv[i][0] != '-' && !filename)
+            filename = argv[i];
+        else
+            {
+            filename = NULL;
+            break;
+            }
+        }
+
+    if (!filename)
+        {
+        fprintf(stderr, "usage: %s [-m model] [-c [A,B,]v0,eps,scaledr_cut] [-f first] [-l last] [-s stride] "
+                        "[-t threads] [-p] [-o prefix] trajectory.gsd\n", argv[0]);
+        return 1;
+        }
+
+    try
+        {
+        // the defaults of pair.polydisperse
+        double v0 = 1.0, eps = 0.2, scaledr_cut = 1.25;
+        if (model == "polydisperse18")
+            { eps = 0.0; scaledr_cut = 1.25; }
+        else if (model == "polydisperse10")
+            { eps = 0.0416667; scaledr_cut = 1.48; }
+        else if (model == "polydisperse106")
+            { eps = 0.1; scaledr_cut = 2.5; }
+        else if (model == "lennardjones")
+            { eps = 0.2; scaledr_cut = 2.5; }
+
+        PolymdRerun rerun(filename, model);
+        rerun.setNumThreads(threads);
+
+        // every pair of the types of the first frame, then the pairs given on the command line
+        if (rerun.getNumFrames() == 0)
+            throw std::runtime_error(std::string(filename) + " has no frames");
+        const std::vector<std::string> types = rerun.getTypes(std::min(first, rerun.getNumFrames() - 1));
+        for (unsigned int k = 0; k < coeffs.size(); ++k)
+            {
+            const std::vector<std::string> items = split(coeffs[k]);
+            if (items.size() == 3)
+                {
+                v0 = atof(items[0].c_str());
+                eps = atof(items[1].c_str());
+                scaledr_cut = atof(items[2].c_str());
+                }
+            else if (items.size() != 5)
+                throw std::runtime_error("-c expects v0,eps,scaledr_cut or A,B,v0,eps,scaledr_cut");
+            }
+        for (unsigned int a = 0; a < types.size(); ++a)
+            for (unsigned int b = a; b < types.size(); ++b)
+                rerun.setParams(types[a], types[b], v0, eps, scaledr_cut);
+        for (unsigned int k = 0; k < coeffs.size(); ++k)
+            {
+            const std::vector<std::string> items = split(coeffs[k]);
+            if (items.size() == 5)
+                rerun.setParams(items[0], items[1], atof(items[2].c_str()), atof(items[3].c_str()),
+                                atof(items[4].c_str()));
+            }
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const uint64_t n_frames = rerun.run(prefix, first, last, stride, per_particle);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        fprintf(stderr, "polymd_rerun: %llu frames of %s in %.3f s, results in %s_*.npy\n",
+                (unsigned long long)n_frames, filename, seconds, prefix.c_str());
+        }
+    catch (const std::exception& e)
+        {
+        fprintf(stderr, "polymd_rerun: %s\n", e.what());
+        return 1;
+        }
+    return 0;
+    }
@@ -0,0 +1,384 @@
+# Copyright (c) 2009-2019 The Regents of the University of Michigan
+# This file is part of the HOOMD-blue project, released under the BSD 3-Clause License.
+
+R""" Updaters for polydisperse systems.
+
+Updaters change the system outside of the MD integration. :py:class:`swap` exchanges the diameters of particles with
+Monte Carlo moves, the standard way to equilibrate deeply supercooled polydisperse liquids. :py:class:`balance` moves
+the MPI domain boundaries so that every rank gets the same share of the pair force work. :py:class:`inflate` grows all
+diameters by a common factor for compression protocols.
+"""
+
+from hoomd.polymd import _polymd
+import hoomd;
+
+class swap(hoomd.update._updater):
+    R""" Diameter swap Monte Carlo.
+
+    Args:
+        pair (:py:class:`hoomd.polymd.pair.polydisperse`): Pair force whose energy drives the swaps.
+        kT (:py:mod:`hoomd.variant` or :py:obj:`float`): Temperature of the Metropolis criterion (in energy units).
+        seed (int): Seed of the random number generator.
+        period (int): Attempt swaps every *period* time steps.
+        sweeps (float): Number of swap attempts per particle at every update.
+        phase (int): When -1, start on the current time step. When >= 0, execute on steps where *(step + phase) % period == 0*.
+
+    Every update attempts *sweeps* :math:`\times N` swaps of the diameters of two randomly chosen particles, accepted
+    with probability :math:`\min(1, e^{-\Delta U/kT})`. Only the pairs of the two particles with their neighbors
+    change, so :math:`\Delta U` is computed locally from the parameters of *pair* and the cost of an attempt does not
+    depend on N. The positions are not changed, so the swaps interleave with the MD integration every *period* steps.
+    The neighbor list of *pair* is rebuilt after every update that accepted a swap.
+
+    The random numbers depend on *seed* and the time step only, so a restarted run repeats the same swaps.
+
+    Attempts that pick two particles with the same diameter change nothing and do not count as attempts in
+    :py:meth:`get_acceptance` and :py:meth:`get_counts`, see :py:meth:`get_identical`.
+
+    Note:
+        :py:class:`swap` is only available on the CPU and without MPI domain decomposition.
+
+    Examples::
+
+        nl = md.nlist.cell()
+        poly = polymd.pair.polydisperse(r_cut=1.5, nlist=nl, model="polydisperse12")
+        sw = polymd.update.swap(pair=poly, kT=0.05, seed=42, period=25, sweeps=0.2)
+        md.integrate.mode_standard(dt=0.01)
+        md.integrate.nvt(group=hoomd.group.all(), kT=0.05, tau=1.0)
+        hoomd.run(1e6)
+        print(sw.get_acceptance())
+
+    """
+    def __init__(self, pair, kT, seed, period=1, sweeps=1.0, phase=0):
+        hoomd.util.print_status_line();
+
+        # initialize base class
+        hoomd.update._updater.__init__(self);
+
+        if hoomd.context.exec_conf.isCUDAEnabled():
+            hoomd.context.msg.error("update.swap is not supported on the GPU\n");
+            raise RuntimeError("Error creating swap updater");
+
+        if not getattr(pair, 'model', None) in swap._classes:
+            hoomd.context.msg.error("update.swap: pair must be a polymd.pair.polydisperse force\n");
+            raise RuntimeError("Error creating swap updater");
+
+        self.pair = pair;
+        kT = hoomd.variant._setup_variant_input(kT);
+
+        # create the c++ mirror class
+        cpp_class = getattr(_polymd, swap._classes[pair.model]);
+        self.cpp_updater = cpp_class(hoomd.context.current.system_definition, pair.cpp_force, pair.nlist.cpp_nlist,
+                                     kT.cpp_variant, int(seed));
+        self.cpp_updater.setSweeps(float(sweeps));
+        self.setupUpdater(period, phase);
+
+        # store metadata
+        self.kT = kT;
+        self.seed = seed;
+        self.period = period;
+        self.sweeps = sweeps;
+        self.metadata_fields = ['kT', 'seed', 'period', 'sweeps'];
+
+    def set_params(self, kT=None, sweeps=None):
+        R""" Change the swap parameters.
+
+        Args:
+            kT (:py:mod:`hoomd.variant` or :py:obj:`float`): New temperature (if set).
+            sweeps (float): New number of swap attempts per particle at every update (if set).
+
+        Examples::
+
+            sw.set_params(kT=0.04)
+            sw.set_params(sweeps=0.5)
+
+        """
+        hoomd.util.print_status_line();
+        self.check_initialization();
+
+        if kT is not None:
+            kT = hoomd.variant._setup_variant_input(kT);
+            self.cpp_updater.setT(kT.cpp_variant);
+            self.kT = kT;
+
+        if sweeps is not None:
+            self.cpp_updater.setSweeps(float(sweeps));
+            self.sweeps = sweeps;
+
+    def get_acceptance(self):
+        R""" Get the fraction of accepted swaps.
+
+        Returns:
+            The number of accepted swaps divided by the number of attempts since the updater was created or
+            :py:meth:`reset_statistics` was called.
+        """
+        return self.cpp_updater.getAcceptanceRatio();
+
+    def get_counts(self):
+        R""" Get the swap counters.
+
+        Returns:
+            A tuple (attempted, accepted) since the updater was created or :py:meth:`reset_statistics` was called.
+        """
+        return (self.cpp_updater.getAttempted(), self.cpp_updater.getAccepted());
+
+    def get_identical(self):
+        R""" Get the number of attempts that picked two particles with the same diameter.
+
+        Returns:
+            The number of these attempts since the updater was created or :py:meth:`reset_statistics` was called. They
+            are not included in :py:meth:`get_counts`.
+        """
+        return self.cpp_updater.getIdentical();
+
+    def reset_statistics(self):
+        R""" Reset the swap counters.
+        """
+        hoomd.util.print_status_line();
+        self.cpp_updater.resetCounters();
+
+swap._classes = {'polydisperse12': 'UpdaterSwapMCPolydisperse',
+                 'lennardjones': 'UpdaterSwapMCPolydisperseLJ',
+                 'polydisperse18': 'UpdaterSwapMCPolydisperse18',
+                 'polydisperse10': 'UpdaterSwapMCPolydisperse10',
+                 'polydisperse106': 'UpdaterSwapMCPolydisperseLJ106'};
+
+class balance(hoomd.update._updater):
+    R""" Balance the MPI domains by the cost of the polydisperse pair forces.
+
+    Args:
+        nlist (:py:mod:`hoomd.md.nlist`): Neighbor list of the polydisperse forces, whose neighbor counts weigh the
+            particles.
+        forces (list): Polydisperse pair forces whose measured pair loop time weighs the ranks, or None to use the
+            neighbor counts alone.
+        x (bool): Balance the boundaries along x.
+        y (bool): Balance the boundaries along y.
+        z (bool): Balance the boundaries along z.
+        tolerance (float): Largest cost of a slab of domains over the mean that is left alone.
+        max_shift (float): Largest shift of a boundary in one update, relative to the width of the narrower of its two
+            domains, in (0, 0.5).
+        period (int): Balance every *period* time steps.
+        phase (int): When -1, start on the current time step. When >= 0, execute on steps where *(step + phase) % period == 0*.
+
+    :py:class:`hoomd.update.balance` gives every rank the same number of particles. In a polydisperse system, a
+    particle costs about its number of neighbors, several times more for the large particles than for the small ones,
+    so after segregation or partial crystallization the ranks with the large particles take 2-3 times longer per step
+    and the other ranks wait for them.
+
+    :py:class:`balance` weighs every particle by its neighbor list entries plus a small cost per particle, the same
+    model the threads of :py:class:`hoomd.polymd.pair.polydisperse` split their work with. When *forces* are given (the
+    :py:class:`hoomd.polymd.pair.polydisperse`, :py:class:`hoomd.polymd.pair.composite` or
+    :py:class:`hoomd.polymd.pair.polydisperse_jit` forces on the CPU), the weights of every rank are scaled to the time
+    their pair loops took on that rank since the last update, which also covers the cutoff efficiency and slower nodes.
+    The costs are binned along every decomposed direction, and the boundaries are moved to equal shares of the cost
+    in one update, at most *max_shift* of a domain at a time and never below the ghost layer width. The particles are
+    then migrated and the neighbor list rebuilt.
+
+    The largest cost of a rank over the mean, measured before the boundaries move, is logged as
+    ``polydisperse_load_imbalance``.
+
+    Note:
+        Do not use :py:class:`balance` together with :py:class:`hoomd.update.balance`. Without MPI domain
+        decomposition, :py:class:`balance` is ignored.
+
+        A domain never gets narrower than the ghost layer. When the expensive region spans only a few ghost layer
+        widths, the domains covering it stop shrinking before the costs are equal and
+        ``polydisperse_load_imbalance`` stays above 1. Decompose that direction into fewer domains.
+
+    Examples::
+
+        nl = polymd.nlist.diameter_class(r_buff=0.3)
+        poly = polymd.pair.polydisperse(r_cut=1.5, nlist=nl, model="polydisperse12")
+        polymd.update.balance(nlist=nl, forces=[poly], period=1000)
+
+    """
+    def __init__(self, nlist, forces=None, x=True, y=True, z=True, tolerance=1.05, max_shift=0.25, period=1000, phase=0):
+        hoomd.util.print_status_line();
+
+        # initialize base class
+        hoomd.update._updater.__init__(self);
+
+        # balancing cannot be done without mpi
+        if not hoomd.context.current.decomposition:
+            hoomd.context.msg.warning("update.balance: ignored without MPI domain decomposition\n");
+            return;
+
+        if forces is None:
+            forces = [];
+
+        # create the c++ mirror class
+        self.cpp_updater = _polymd.LoadBalancerPolydisperse(hoomd.context.current.system_definition, nlist.cpp_nlist);
+        for force in forces:
+            self.cpp_updater.addForce(force.cpp_force);
+        self.setupUpdater(period, phase);
+
+        # store metadata
+        self.tolerance = tolerance;
+        self.max_shift = max_shift;
+        self.period = period;
+        self.metadata_fields = ['tolerance', 'max_shift', 'period'];
+
+        self.set_params(x=x, y=y, z=z, tolerance=tolerance, max_shift=max_shift);
+
+    def set_params(self, x=None, y=None, z=None, tolerance=None, max_shift=None):
+        R""" Change the balancing parameters.
+
+        Args:
+            x (bool): Balance the boundaries along x (if set).
+            y (bool): Balance the boundaries along y (if set).
+            z (bool): Balance the boundaries along z (if set).
+            tolerance (float): Largest cost of a slab of domains over the mean that is left alone (if set).
+            max_shift (float): Largest shift of a boundary in one update (if set).
+
+        Examples::
+
+            bal.set_params(tolerance=1.1)
+            bal.set_params(z=False)
+
+        """
+        hoomd.util.print_status_line();
+
+        if not hoomd.context.current.decomposition:
+            return;
+
+        for dim, enable in enumerate((x, y, z)):
+            if enable is not None:
+                self.cpp_updater.enableDimension(dim, bool(enable));
+
+        if tolerance is not None:
+            if tolerance < 1.0:
+                hoomd.context.msg.error("update.balance: tolerance must be at least 1\n");
+                raise ValueError("tolerance must be at least 1");
+            self.cpp_updater.setTolerance(float(tolerance));
+            self.tolerance = tolerance;
+
+        if max_shift is not None:
+            self.cpp_updater.setMaxShift(float(max_shift));
+            self.max_shift = max_shift;
+
+    def get_imbalance(self):
+        R""" Get the load imbalance of the ranks.
+
+        Returns:
+            The largest cost of a rank over the mean cost of the ranks, measured in the last update before the
+            boundaries moved, 1 without MPI domain decomposition.
+        """
+        if not hoomd.context.current.decomposition:
+            return 1.0;
+        return self.cpp_updater.getImbalance();
+
+    def get_adjustments(self):
+        R""" Get the number of updates that moved the domain boundaries.
+        """
+        if not hoomd.context.current.decomposition:
+            return 0;
+        return self.cpp_updater.getNumAdjustments();
+
+class inflate(hoomd.update._updater):
+    R""" Grow all diameters by a common factor.
+
+    Args:
+        nlist (:py:mod:`hoomd.md.nlist`): Neighbor list of the polydisperse forces.
+        forces (list): All polydisperse pair forces on the CPU that act on the particles.
+        scale (:py:mod:`hoomd.variant` or :py:obj:`float`): Total factor relative to the diameters when the updater is
+            created.
+        buffer_fraction (float): Fraction of the buffer of *nlist* that the growth of the cutoffs may use before the
+            factor is written into the diameters, in (0, 1].
+        period (int): Grow the diameters every *period* time steps.
+        phase (int): When -1, start on the current time step. When >= 0, execute on steps where *(step + phase) % period == 0*.
+
+    Compression protocols in the style of Lubachevsky and Stillinger scale all diameters by a small factor many times.
+    Writing the diameters every time changes the maximum diameter and the cutoffs, and the neighbor list is rebuilt
+    after every rescale. Every polydisperse model only depends on :math:`r/\sigma_{ij}`, so :py:class:`inflate`
+    passes the factor to *forces* instead, which multiply :math:`d_i` and :math:`d_j` by it in their pair loop. The
+    forces are the same as with the scaled diameters.
+
+    The cutoffs grow with the factor. With :py:class:`hoomd.polymd.nlist.diameter_class`, the growth is taken out of
+    the buffer that the distance check allows the particles to move, so the list is only rebuilt when the particles
+    moved that far. Once the growth reaches *buffer_fraction* times *r_buff*, the factor is written into the diameters
+    (a fold) and the list is rebuilt. Other neighbor lists cannot account for the growth, and every update folds.
+
+    The total factor and the number of folds are logged as ``polydisperse_diameter_scale`` and
+    ``polydisperse_diameter_folds``.
+
+    Note:
+        Other forces, analyzers and dumps see the diameters of the last fold. :py:class:`swap` applies the pending
+        factor of its force. Call :py:meth:`apply` before reading the diameters. Use *r_cut* = "auto" in *forces* so
+        that the cutoffs follow the growth at every fold. Discrete mode and the xplor shift mode are not supported.
+
+    Examples::
+
+        nl = polymd.nlist.diameter_class(r_buff=0.3)
+        poly = polymd.pair.polydisperse(r_cut="auto", nlist=nl, model="polydisperse12")
+        grow = polymd.update.inflate(nlist=nl, forces=[poly], scale=hoomd.variant.linear_interp([(0, 1.0), (1e5, 1.1)]))
+        hoomd.run(1e5)
+        grow.apply()
+
+    """
+    def __init__(self, nlist, forces, scale, buffer_fraction=0.5, period=1, phase=0):
+        hoomd.util.print_status_line();
+
+        # initialize base class
+        hoomd.update._updater.__init__(self);
+
+        if hoomd.context.exec_conf.isCUDAEnabled():
+            hoomd.context.msg.error("update.inflate is not supported on the GPU\n");
+            raise RuntimeError("Error creating inflate updater");
+
+        scale = hoomd.variant._setup_variant_input(scale);
+
+        # create the c++ mirror class
+        self.cpp_updater = _polymd.UpdaterInflate(hoomd.context.current.system_definition, nlist.cpp_nlist,
+                                                  scale.cpp_variant);
+        for force in forces:
+            self.cpp_updater.addForce(force.cpp_force);
+        self.cpp_updater.setBufferFraction(float(buffer_fraction));
+        self.setupUpdater(period, phase);
+
+        # store metadata
+        self.scale = scale;
+        self.buffer_fraction = buffer_fraction;
+        self.period = period;
+        self.metadata_fields = ['scale', 'buffer_fraction', 'period'];
+
+    def set_params(self, scale=None, buffer_fraction=None):
+        R""" Change the growth parameters.
+
+        Args:
+            scale (:py:mod:`hoomd.variant` or :py:obj:`float`): New total factor relative to the diameters when the
+                updater was created (if set).
+            buffer_fraction (float): New fraction of the buffer used before a fold (if set).
+
+        Examples::
+
+            grow.set_params(scale=1.2)
+
+        """
+        hoomd.util.print_status_line();
+
+        if scale is not None:
+            scale = hoomd.variant._setup_variant_input(scale);
+            self.cpp_updater.setScale(scale.cpp_variant);
+            self.scale = scale;
+
+        if buffer_fraction is not None:
+            self.cpp_updater.setBufferFraction(float(buffer_fraction));
+            self.buffer_fraction = buffer_fraction;
+
+    def apply(self):
+        R""" Write the pending factor into the diameters.
+
+        After :py:meth:`apply`, the diameters of the particles include the whole factor and the neighbor list is
+        rebuilt at the next step.
+        """
+        hoomd.util.print_status_line();
+        self.cpp_updater.apply();
+
+    def get_scale(self):
+        R""" Get the total factor applied to the diameters, written or pending.
+        """
+        return self.cpp_updater.getScale();
+
+    def get_folds(self):
+        R""" Get the number of times the factor was written into the diameters.
+        """
+        return self.cpp_updater.getNumFolds();